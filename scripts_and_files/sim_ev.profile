@@ -0,0 +1,13 @@
+# ------------------------------------------------------------------------------
+# Simulator profile for an RTH board running as the EV
+#
+# The simulator plays the EVSE under test: a static +12 V until the EV is
+# plugged in, then a 5 % oscillator for digital communication.  The board
+# presents state B itself once plugged in.
+# See src/hw/sim_coprocessor.h for the format.
+# ------------------------------------------------------------------------------
+
+# time_ms   settings
+0           duty=100 prox=1.5 noise=20
+10000       ev=B
+11000       duty=5
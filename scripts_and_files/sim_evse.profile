@@ -0,0 +1,14 @@
+# ------------------------------------------------------------------------------
+# Simulator profile for an RTH board running as the EVSE
+#
+# The simulator plays the EV under test.  The board drives the oscillator
+# itself, so this profile only moves the EV through its pilot states.
+# See src/hw/sim_coprocessor.h for the format.
+# ------------------------------------------------------------------------------
+
+# time_ms   settings
+0           ev=A prox=1.5 noise=20
+10000       ev=B
+40000       ev=C
+100000      ev=B
+105000      ev=A
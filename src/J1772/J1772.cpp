@@ -29,8 +29,6 @@
 #include "common.h"
 #include "main.h"
 
-#define CH_PILOT           0
-#define CH_PROX            1
 
 // Initialize the J1772 struct with default values
 struct J1772_t J1772 =
@@ -101,10 +99,10 @@ int hex_to_signed_decimal(unsigned short hex_value)
 
 
 // -----------------------------------------------------------------------------
-// read_pilot_voltage - read the hi and lo pilot voltage values
-//  this function is void but an array is passed by reference to represent the pilot values
+// request_pilot_voltage - Asks the co-processor for the hi and lo pilot voltage values.
+//  'cb' is called with the response
 // -----------------------------------------------------------------------------
-void read_pilot_voltage()
+bool request_pilot_voltage(serial_reply_cb_t cb)
 {
     // The message to get the pilot voltage is 0x02 0x03 0x00 0x14
     // Prepare data
@@ -118,46 +116,40 @@ void read_pilot_voltage()
     uart_msg.push_back(calculate_bcc(uart_msg));
 
     // Send the data
-    write_to_serial(uart_fd, uart_msg);
-
-    // Allow some time for the device to respond
-    sleeper.sleep(config.response_delay_ms);
+    return serial_link.request(uart_msg, cb);
+}
+// -----------------------------------------------------------------------------
 
-    // Process incoming messages
-    std::vector<std::vector<unsigned char> > messages;
-    read_serial_data(uart_fd, messages);
 
-    // Parse the first valid response message
-    unsigned short pos_pilot_voltage_hex = -99;
-    unsigned short neg_pilot_voltage_hex = -99;
-    for(size_t i = 0; i < messages.size(); ++i)
+// -----------------------------------------------------------------------------
+// parse_pilot_voltage - Stores the hi and lo pilot voltages from the co-processor's response
+// -----------------------------------------------------------------------------
+void parse_pilot_voltage(const std::vector<unsigned char>& msg)
+{
+    // Validate header and length
+    if(msg.size() >= 9 && msg[0] == 0x02 && msg[1] == 0x07 && msg[3] == 0x94)
     {
-        const std::vector<unsigned char>&msg = messages[i];
-        // Validate header and length
-        if(msg.size() >= 9 && msg[0] == 0x02 && msg[1] == 0x07 && msg[3] == 0x94)
-        {
-            // Parse the hex data
-            pos_pilot_voltage_hex = (msg[5] << 8) | msg[4];
-            neg_pilot_voltage_hex = (msg[7] << 8) | msg[6];
-
-            // Convert the values to doubles and store in array
-            J1772.Vpilot = static_cast<double>(hex_to_signed_decimal(pos_pilot_voltage_hex)) * pilot_voltage_resolution;   // positive pilot voltage
-            J1772.Vpilot_min = static_cast<double>(hex_to_signed_decimal(neg_pilot_voltage_hex)) * pilot_voltage_resolution;   // negative pilot voltage
+        // Parse the hex data
+        unsigned short pos_pilot_voltage_hex = (msg[5] << 8) | msg[4];
+        unsigned short neg_pilot_voltage_hex = (msg[7] << 8) | msg[6];
 
-            break;
-        }
+        // Convert the values to doubles and store in array
+        J1772.Vpilot = static_cast<double>(hex_to_signed_decimal(pos_pilot_voltage_hex)) * pilot_voltage_resolution;   // positive pilot voltage
+        J1772.Vpilot_min = static_cast<double>(hex_to_signed_decimal(neg_pilot_voltage_hex)) * pilot_voltage_resolution;   // negative pilot voltage
 
+        // Round the readings to 3 decimal points
+        J1772.Vpilot = floor(J1772.Vpilot * 1000.0) / 1000.0;
+        J1772.Vpilot_min = floor(J1772.Vpilot_min * 1000.0) / 1000.0;
     }
-    
 }
 // -----------------------------------------------------------------------------
 
 
 // -----------------------------------------------------------------------------
-// read_prox_voltage - read the hi and lo pilot voltage values
-//  this function is void but an array is passed by reference to represent the pilot values
+// request_prox_voltage - Asks the co-processor for the prox voltage.
+//  'cb' is called with the response
 // -----------------------------------------------------------------------------
-void read_prox_voltage()
+bool request_prox_voltage(serial_reply_cb_t cb)
 {
     // The message to get the pilot voltage is 0x02 0x03 0x00 0x52
     // Prepare data
@@ -171,95 +163,39 @@ void read_prox_voltage()
     uart_msg.push_back(calculate_bcc(uart_msg));
 
     // Send the data
-    write_to_serial(uart_fd, uart_msg, false);
-
-    // Allow some time for the device to respond
-    sleeper.sleep(config.response_delay_ms);
-
-    // Read response from the serial port
-    std::vector<std::vector<unsigned char>> messages;
-
-    // Read data from the serial port and extract messages
-    read_serial_data(uart_fd, messages);
-
-    // Parse the hex data
-    unsigned short prox_voltage_hex = 0;
-    double prox_voltage = 0;
-    for(size_t i = 0; i < messages.size(); ++i)
-    {
-        const std::vector<unsigned char>& msg = messages[i];
-        // Validate header and length
-        if(msg.size() >= 7 && msg[0] == 0x02 && msg[1] == 0x05 && msg[3] == 0xD2)
-        {
-
-            // Parse the prox voltage hex data
-            prox_voltage_hex = (msg[5] << 8) | msg[4];
-
-            // Convert the value to a double and store it in the J1772 structure
-            prox_voltage = static_cast<double>(hex_to_signed_decimal(prox_voltage_hex)) * pilot_voltage_resolution;
-            J1772.Vprox = prox_voltage;
-
-            // Only one message is expected, so break the loop here
-            break;
-        }
-    }
-
+    return serial_link.request(uart_msg, cb);
 }
 // -----------------------------------------------------------------------------
 
 
 // -----------------------------------------------------------------------------
-// get_actual_voltage - Read actual voltage from a given channel
+// parse_prox_voltage - Stores the prox voltage from the co-processor's response
 // -----------------------------------------------------------------------------
-void get_actual_voltage(uint8_t channel)
-{       
-    switch (channel)
-    {	
-        // If sampling Pilot pin, need to find high and low values
-        case CH_PILOT:
-        {   
-            read_pilot_voltage();
-
-            // Update J1772 with the new values
-            // Round the readings to 3 decimal points
-            J1772.Vpilot = floor(J1772.Vpilot * 1000.0) / 1000.0;
-            J1772.Vpilot_min = floor(J1772.Vpilot_min * 1000.0) / 1000.0;
-
-            break;
-        }
-
-        // If sampling Prox pin, simply measure voltage
-        case CH_PROX:
-        {
-            // First get the raw ADC voltage
-            read_prox_voltage();
-
-            // Round the readings to 3 decimal points
-            J1772.Vprox = round(J1772.Vprox * 1000.0) / 1000.0;
-
-            break;
-        }
+void parse_prox_voltage(const std::vector<unsigned char>& msg)
+{
+    // Validate header and length
+    if(msg.size() >= 7 && msg[0] == 0x02 && msg[1] == 0x05 && msg[3] == 0xD2)
+    {
+        // Parse the prox voltage hex data
+        unsigned short prox_voltage_hex = (msg[5] << 8) | msg[4];
 
-        default:
+        // Convert the value to a double and store it in the J1772 structure
+        J1772.Vprox = static_cast<double>(hex_to_signed_decimal(prox_voltage_hex)) * pilot_voltage_resolution;
 
-            logger.log(LOG_WARNING, "Invalid channel provided (get_actual_voltage)");
-            // return -1;
-            break;
+        // Round the reading to 3 decimal points
+        J1772.Vprox = round(J1772.Vprox * 1000.0) / 1000.0;
     }
 }
 // -----------------------------------------------------------------------------
 
 
 // -----------------------------------------------------------------------------
-// get_pilot_state - This function will measure pilot high and low voltage 
-//                   and calculate pilot state based on the voltages
+// get_pilot_state - This function will calculate pilot state based on the 
+//                   pilot high and low voltages we last read
 // -----------------------------------------------------------------------------  
 uint8_t get_pilot_state()
 {
-    // Fetch the pilot voltages
-    get_actual_voltage(CH_PILOT);
-
-    // Save voltages we just fetched
+    // Save voltages we last read
     double high = J1772.Vpilot;
     double low  = J1772.Vpilot_min;
     int state;
@@ -288,14 +224,12 @@ uint8_t get_pilot_state()
 
 
 // -----------------------------------------------------------------------------
-// get_prox_state - This function will measure prox voltage and calculate state
+// get_prox_state - This function will calculate the prox state from the prox
+//                  voltage we last read
 // -----------------------------------------------------------------------------  
 uint8_t get_prox_state()
 {
-    // Fetch the prox voltage
-    get_actual_voltage(CH_PROX);
-
-    // Save voltage we just fetched
+    // Save voltage we last read
     double prox = J1772.Vprox;
     int state;
 
@@ -313,12 +247,10 @@ uint8_t get_prox_state()
 
 
 // -----------------------------------------------------------------------------
-// get_pwm_values - read the hi and lo pilot voltage values
-//  this function is void but pass two values by reference:
-//      frequency   :   this is the frequency of the PWM
-//      duty cycle  :   this is the duty cycle of the PWM
+// request_pwm_values - Asks the co-processor for the PWM frequency and duty cycle.
+//  'cb' is called with the response
 // -----------------------------------------------------------------------------
-void get_pwm_values()
+bool request_pwm_values(serial_reply_cb_t cb)
 {
     // The message to get the pilot voltage is 0x02 0x03 0x00 0x14
     // Prepare data
@@ -332,53 +264,39 @@ void get_pwm_values()
     uart_msg.push_back(calculate_bcc(uart_msg));
 
     // Send the data
-    write_to_serial(uart_fd, uart_msg);
-
-    // Allow some time for the device to respond
-    sleeper.sleep(config.response_delay_ms);
+    return serial_link.request(uart_msg, cb);
+}
+// -----------------------------------------------------------------------------
 
-    // Read response from the serial port
-    std::vector<std::vector<unsigned char>> messages;
-    read_serial_data(uart_fd, messages);
 
-    // Parse and handle each message
-    unsigned short frequency_hex = -9999;
-    unsigned short duty_cycle_hex = -9999;
-    for(size_t i = 0; i < messages.size(); ++i)
+// -----------------------------------------------------------------------------
+// parse_pwm_values - Stores the PWM values from the co-processor's response:
+//      frequency   :   this is the frequency of the PWM
+//      duty cycle  :   this is the duty cycle of the PWM
+// -----------------------------------------------------------------------------
+void parse_pwm_values(const std::vector<unsigned char>& msg)
+{
+    // Validate header and legnth
+    if(msg.size() >= 9 && msg[0] == 0x02 && msg[1] == 0x07 && msg[3] == 0x90)
     {
-        const std::vector<unsigned char>& msg = messages[i];
-
-        // Validate header and legnth
-        if(msg.size() >= 9 && msg[0] == 0x02 && msg[1] == 0x07 && msg[3] == 0x90)
-        {
-            frequency_hex = (msg[5] << 8) | msg[4];
-            duty_cycle_hex = (msg[7] << 8) | msg[6];
-
-            J1772.pilot_freq = static_cast<int>(hex_to_signed_decimal(frequency_hex));
-            J1772.pilot_duty_cycle = static_cast<double>(hex_to_signed_decimal(duty_cycle_hex)) / 10.0;
-
-            // We're only expecting one message, so break the loop
-            break;
-        }
+        unsigned short frequency_hex = (msg[5] << 8) | msg[4];
+        unsigned short duty_cycle_hex = (msg[7] << 8) | msg[6];
 
+        J1772.pilot_freq = static_cast<int>(hex_to_signed_decimal(frequency_hex));
+        J1772.pilot_duty_cycle = static_cast<double>(hex_to_signed_decimal(duty_cycle_hex)) / 10.0;
     }
-    
 }
 // -----------------------------------------------------------------------------
 
 
 // -----------------------------------------------------------------------------
-// get_pwm_comm_state - Measure the PWM duty cycle and
+// get_pwm_comm_state - From the PWM duty cycle we last read
 //                      1. Figure out if it's analog or digital comms
 //                      2. Set the pilot oscillator state
 // -----------------------------------------------------------------------------  
 uint8_t get_pwm_comm_state()
 {
-    // First measure the frequency and duty cycle
-    get_pwm_values();
-
-    // Save the duty cycle we just fetched
-    int frequency = J1772.pilot_freq;
+    // Save the duty cycle we last read
     double duty_cycle = J1772.pilot_duty_cycle;
     
     // check the duty cycle and set the PWM comm state accordingly
@@ -420,15 +338,8 @@ void control_pwm(int on_or_off)
     // Calculate the BCC and add it to the message
     uart_msg.push_back(calculate_bcc(uart_msg));
 
-    // Send the data
-    write_to_serial(uart_fd, uart_msg);
-
-    // Allow some time for the device to respond
-    sleeper.sleep(config.response_delay_ms);
-
-    // Read response from the serial port
-    std::vector<std::vector<unsigned char>> messages;
-    read_serial_data(uart_fd, messages);
+    // Send the data, and wait for the device to respond
+    serial_link.command(uart_msg);
 }
 // -----------------------------------------------------------------------------
 
@@ -470,43 +381,177 @@ void set_pwm(double duty_cycle)
     // Calculate the BCC and add it to the message
     uart_msg.push_back(calculate_bcc(uart_msg));
 
-    // Send the data
-    write_to_serial(uart_fd, uart_msg);
+    // Send the data, and wait for the device to respond
+    serial_link.command(uart_msg);
+}
+// -----------------------------------------------------------------------------
 
-    // Allow some time for the device to respond
-    sleeper.sleep(config.response_delay_ms);
 
-    // Read response from the serial port
-    std::vector<std::vector<unsigned char>> messages;
-    read_serial_data(uart_fd, messages);
+// -----------------------------------------------------------------------------
+// set_ev_pilot_state - Switch the EV-side pilot resistors to present state A, B or C
+// ----------------------------------------------------------------------------- 
+void set_ev_pilot_state(char state)
+{
+    // The EVCC pilot state codes (these differ from the datasheet):
+    //   A = no resistors, B = 2.7k, C = 2.7k || 1.3k
+    unsigned char code;
+    if      (state == 'A') code = 0x00;
+    else if (state == 'B') code = 0x01;
+    else if (state == 'C') code = 0x03;
+    else
+    {
+        std::cerr << "Invalid pilot state passed to set_ev_pilot_state()" << std::endl;
+        return;
+    }
+
+    // The message to set the pilot state is 0x02 0x04 0x00 0x15 [State Code] [BCC]
+    std::vector<unsigned char> uart_msg;
+    uart_msg.push_back(0x02);
+    uart_msg.push_back(0x04);
+    uart_msg.push_back(0x00);
+    uart_msg.push_back(0x15);
+    uart_msg.push_back(code);
+
+    // Calculate the BCC and add it to the message
+    uart_msg.push_back(calculate_bcc(uart_msg));
+
+    // Send the data, and wait for the device to respond
+    serial_link.command(uart_msg);
 }
 // -----------------------------------------------------------------------------
 
 
 // -----------------------------------------------------------------------------
-// sample_J1772 - Measure pilot and prox pins on J1772 connector    
-// -----------------------------------------------------------------------------   
-void sample_J1772()
+// The sampler - Measures the pilot and prox pins on the J1772 connector, one 
+//               request at a time. Each response sends the next request, so
+//               a sample takes only as long as the co-processor does
+// -----------------------------------------------------------------------------
+
+// The requests that make up one sample, in the order they're sent
+enum sample_steps {SAMPLE_PWM, SAMPLE_PILOT, SAMPLE_PILOT_AGAIN, SAMPLE_PROX};
+
+// Where we are in the current sample, and when it started
+static int sample_step;
+static uint64_t sample_start_ms;
+
+// Who to tell when a sample is complete
+static void (*sample_cb)() = NULL;
+
+// Forward declarations
+static void begin_sample(void*);
+static void on_sample_reply(const std::vector<unsigned char>* reply, void*);
+
+// -----------------------------------------------------------------------------
+// send_sample_request - Sends the request for the step we're on
+// -----------------------------------------------------------------------------
+static void send_sample_request()
 {
-    // Measure duty cycle and get PWM state
-    get_pwm_comm_state();
+    bool is_sent = false;
+    switch (sample_step)
+    {
+        case SAMPLE_PWM:            is_sent = request_pwm_values(on_sample_reply);      break;
+        case SAMPLE_PILOT:
+        case SAMPLE_PILOT_AGAIN:    is_sent = request_pilot_voltage(on_sample_reply);   break;
+        case SAMPLE_PROX:           is_sent = request_prox_voltage(on_sample_reply);    break;
+    }
+
+    // The UART is gone, so there's nothing more to sample
+    if (!is_sent) logger.log(LOG_ERR, "Can't send a request to the co-processor, sampling stopped");
+}
+// -----------------------------------------------------------------------------
 
-    // Measure Pilot pin voltage and get the state
-    J1772.pilot_state    = get_pilot_state();
 
-    // If the pilot state is different from last time, measure again to be sure
-    if (J1772.pilot_state != last_pilot_state)
+// -----------------------------------------------------------------------------
+// finish_sample - Hands the completed sample over, and schedules the next one
+// -----------------------------------------------------------------------------
+static void finish_sample()
+{
+    // Append the raw sample to the waveform ring (a no-op unless the recorder is enabled)
+    waveform.record(J1772);
+
+    // Let the main loop act on it
+    if (sample_cb) sample_cb();
+
+    // Start the next sample 'sample_interval_ms' after this one started, or right away
+    // if this one took longer than that
+    uint64_t elapsed_ms = msTimer::millis() - sample_start_ms;
+    if (elapsed_ms >= (uint64_t)config.sample_interval_ms) begin_sample(NULL);
+    else reactor.add_timer(config.sample_interval_ms - elapsed_ms, begin_sample);
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// begin_sample - Starts a sample with its first request
+// -----------------------------------------------------------------------------
+static void begin_sample(void*)
+{
+    sample_start_ms = msTimer::millis();
+    sample_step = SAMPLE_PWM;
+    send_sample_request();
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// on_sample_reply - Handles the response to a sample request, or its timeout. A
+//                   missing response leaves the last reading in place
+// -----------------------------------------------------------------------------
+static void on_sample_reply(const std::vector<unsigned char>* reply, void*)
+{
+    switch (sample_step)
     {
-        J1772.pilot_state = get_pilot_state();
+        // Measure duty cycle and get PWM state
+        case SAMPLE_PWM:
+            if (reply) parse_pwm_values(*reply);
+            get_pwm_comm_state();
+            sample_step = SAMPLE_PILOT;
+            break;
 
-        // Save the pilot state to compare with later (hack)
-        last_pilot_state = J1772.pilot_state;
+        // Measure Pilot pin voltage and get the state
+        case SAMPLE_PILOT:
+        case SAMPLE_PILOT_AGAIN:
+            if (reply) parse_pilot_voltage(*reply);
+            J1772.pilot_state = get_pilot_state();
+
+            // If the pilot state is different from last time, measure again to be sure
+            if (sample_step == SAMPLE_PILOT && J1772.pilot_state != last_pilot_state)
+            {
+                sample_step = SAMPLE_PILOT_AGAIN;
+                break;
+            }
+
+            // Save the pilot state to compare with later (hack)
+            if (sample_step == SAMPLE_PILOT_AGAIN) last_pilot_state = J1772.pilot_state;
+
+            // Measure the proximity pin voltage and get the state
+            #ifdef EVCC
+                sample_step = SAMPLE_PROX;
+                break;
+            #else
+                finish_sample();
+                return;
+            #endif
+
+        case SAMPLE_PROX:
+            if (reply) parse_prox_voltage(*reply);
+            J1772.prox_state = get_prox_state();
+            finish_sample();
+            return;
     }
 
-    // Measure the proximity pin voltage and get the state
-    #ifdef EVCC
-        J1772.prox_state = get_prox_state();
-    #endif
+    send_sample_request();
 }
 // -----------------------------------------------------------------------------
 
+
+// -----------------------------------------------------------------------------
+// start_sampling - Starts sampling the J1772 connector. 'on_sample' is called 
+//                  on the main thread with every new sample in J1772
+// -----------------------------------------------------------------------------
+void start_sampling(void (*on_sample)())
+{
+    sample_cb = on_sample;
+    begin_sample(NULL);
+}
+// -----------------------------------------------------------------------------
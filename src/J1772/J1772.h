@@ -93,8 +93,8 @@ enum pwm_comm_states
     INVALID = 2
 };
 
-// Function to measure pilot and prox pins on J1772 connector       
-extern void sample_J1772();
+// Function to start measuring pilot and prox pins on J1772 connector. 'on_sample' is called with each sample
+extern void start_sampling(void (*on_sample)());
 
 // Function to enable or disable PWM. Pass a 1 to enable, pass a 0 to disable
 extern void control_pwm(int on_or_off);
@@ -102,6 +102,9 @@ extern void control_pwm(int on_or_off);
 // Function to set the duty cycle of the PWM
 extern void set_pwm(double duty_cycle);
 
+// Function to set the pilot state an emulated EV presents. Pass 'A', 'B' or 'C'
+extern void set_ev_pilot_state(char state);
+
 
 #endif
 // -----------------------------------------------------------------------------
\ No newline at end of file
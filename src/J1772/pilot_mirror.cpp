@@ -0,0 +1,341 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// pilot_mirror.cpp - Mirrors control pilot changes seen by one RTH board onto the other board's pilot
+//==========================================================================================================
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "pilot_mirror.h"
+
+
+// -----------------------------------------------------------------------------
+// CPilotMirror() - Constructor
+// -----------------------------------------------------------------------------
+CPilotMirror::CPilotMirror()
+{
+    m_is_enabled       = false;
+    m_is_evse          = false;
+    m_last_state       = -1;
+    m_last_duty        = -1;
+    m_seq              = 1;
+    m_pending          = false;
+    m_peer_boot        = 0;
+    m_last_applied_seq = 0;
+    m_count            = 0;
+    m_total_us         = 0;
+    m_min_us           = 0;
+    m_max_us           = 0;
+    m_wake_fd          = -1;
+
+    memset(m_sent_seq, 0, sizeof(m_sent_seq));
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// init() - Enables mirroring
+// -----------------------------------------------------------------------------
+void CPilotMirror::init(const std::string& device_type, const std::string& tx_topic, const std::string& rx_topic)
+{
+    m_is_evse  = (device_type == "EVSE");
+    m_tx_topic = tx_topic;
+    m_rx_topic = rx_topic;
+
+    // Changes arrive on the MQTT thread, which signals the main thread through an eventfd. It's
+    // separate from the global sleeper so it can't cut short a UART response delay
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wake_fd < 0 || !reactor.add_fd(m_wake_fd, EPOLLIN, on_wake, this))
+    {
+        logger.log(LOG_WARNING, "Can't create pilot mirror eventfd, mirroring disabled");
+        return;
+    }
+
+    m_is_enabled = true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// micros() - Returns a monotonic timestamp in microseconds
+// -----------------------------------------------------------------------------
+uint64_t CPilotMirror::micros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// update() - Looks for a change the peer should mirror, and sends it right away
+// -----------------------------------------------------------------------------
+void CPilotMirror::update(const J1772_t& sample)
+{
+    if (!m_is_enabled) return;
+
+    char value[16];
+
+    // The EVSE-side board is watching the EV under test, so it reports the EV's pilot state
+    if (m_is_evse)
+    {
+        int state;
+        switch (sample.pilot_state)
+        {
+            case A1: case A2:   state = 'A'; break;
+            case B1: case B2:   state = 'B'; break;
+            case C1: case C2:   state = 'C'; break;
+            default:            return;
+        }
+
+        // The first state we see is our starting point, not a transition
+        if (m_last_state == -1) m_last_state = state;
+        if (state == m_last_state) return;
+
+        m_last_state = state;
+        snprintf(value, sizeof(value), "%c", state);
+        send('S', value);
+    }
+
+    // The EV-side board is watching the EVSE under test, so it reports the EVSE's oscillator
+    else
+    {
+        // The oscillator is off unless the duty cycle is in the range J1772 allows, and we
+        // mirror it to the nearest whole percent so ADC noise doesn't generate messages
+        double duty_cycle = sample.pilot_duty_cycle;
+        int duty = (duty_cycle >= 3 && duty_cycle <= 98) ? (int)floor(duty_cycle + 0.5) * 10 : 0;
+
+        if (m_last_duty == -1) m_last_duty = duty;
+        if (duty == m_last_duty) return;
+
+        m_last_duty = duty;
+        snprintf(value, sizeof(value), "%d", duty);
+        send('P', value);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// send() - Sends a control message to the peer and remembers when it went out
+// -----------------------------------------------------------------------------
+void CPilotMirror::send(char kind, const char* value)
+{
+    // Record when we detected the change before anything else adds to the latency
+    uint64_t now = micros();
+
+    m_mtx.lock();
+    uint32_t seq = m_seq++;
+    int slot = seq % MAX_OUTSTANDING;
+    m_sent_seq[slot] = seq;
+    m_sent_us[slot]  = now;
+    snprintf(m_sent_desc[slot], sizeof(m_sent_desc[slot]), "%c=%s", kind, value);
+    m_mtx.unlock();
+
+    // Build and publish the message
+    char message[48];
+    snprintf(message, sizeof(message), "%c,%u,%u,%s", kind, boot_id, seq, value);
+    send_message(m_tx_topic, message);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_message() - Handles a control message from the peer.  This runs on the MQTT thread,
+//                which mustn't touch the UART, so changes are handed to the main loop
+// -----------------------------------------------------------------------------
+void CPilotMirror::on_message(const std::string& message)
+{
+    if (!m_is_enabled) return;
+
+    // Note the arrival time first
+    uint64_t now = micros();
+
+    // The peer has applied a change we sent
+    char     kind;
+    unsigned boot, seq;
+    char     value[16];
+    if (sscanf(message.c_str(), "K,%u,%15s", &seq, value) == 2)
+    {
+        on_ack(seq, strtoul(value, NULL, 10));
+        return;
+    }
+
+    // Split a change into its fields
+    if (sscanf(message.c_str(), "%c,%u,%u,%15s", &kind, &boot, &seq, value) != 4) return;
+
+    // Make sure this is a change the other side is supposed to send us
+    if ((m_is_evse && kind != 'P') || (!m_is_evse && kind != 'S')) return;
+
+    // Hand the change to the main loop. If one is already waiting, this newer one replaces it
+    m_mtx.lock();
+    m_pending       = true;
+    m_pending_kind  = kind;
+    m_pending_value = (kind == 'S') ? value[0] : atoi(value);
+    m_pending_boot  = boot;
+    m_pending_seq   = seq;
+    m_pending_rx_us = now;
+    m_mtx.unlock();
+
+    // And wake the main loop up
+    uint64_t one = 1;
+    if (write(m_wake_fd, &one, sizeof(one)) < 0) {}
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_wake() - Called by the reactor when the MQTT thread has handed us a change
+// -----------------------------------------------------------------------------
+void CPilotMirror::on_wake(int fd, uint32_t, void* ctx)
+{
+    // Drain the eventfd so the reactor doesn't call us again for the same wakeup
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0) {}
+
+    // Apply whatever's arrived
+    ((CPilotMirror*)ctx)->apply_pending();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// apply_pending() - Applies the latest change from the peer to our co-processor
+// -----------------------------------------------------------------------------
+void CPilotMirror::apply_pending()
+{
+    // Fetch the pending change, if any
+    m_mtx.lock();
+    bool     pending = m_pending;
+    char     kind    = m_pending_kind;
+    int      value   = m_pending_value;
+    uint32_t boot    = m_pending_boot;
+    uint32_t seq     = m_pending_seq;
+    uint64_t rx_us   = m_pending_rx_us;
+    m_pending = false;
+    m_mtx.unlock();
+
+    if (!pending) return;
+
+    // A new boot_id means the peer restarted and is counting from 1 again
+    if (boot != m_peer_boot)
+    {
+        m_peer_boot        = boot;
+        m_last_applied_seq = 0;
+    }
+
+    // Drop a change that's older than one we've already applied
+    if (seq <= m_last_applied_seq) return;
+    m_last_applied_seq = seq;
+
+    // The EV-side board presents the EV's pilot state to the EVSE under test
+    if (kind == 'S') set_ev_pilot_state((char)value);
+
+    // The EVSE-side board drives the EV under test with the EVSE's oscillator. A static +12 V
+    // (99.9 %) is how this board represents an oscillator that is off
+    else if (kind == 'P') set_pwm(value ? value / 10.0 : 99.9);
+
+    // Tell the peer how long we took to apply it
+    char message[32];
+    snprintf(message, sizeof(message), "K,%u,%u", seq, (unsigned)(micros() - rx_us));
+    send_message(m_tx_topic, message);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_ack() - The peer applied one of our changes. Work out how long the transition took
+// -----------------------------------------------------------------------------
+void CPilotMirror::on_ack(uint32_t seq, uint32_t apply_us)
+{
+    uint64_t now = micros();
+
+    m_mtx.lock();
+
+    // Find when we sent it. If it's fallen out of our table, it's too old to matter
+    int slot = seq % MAX_OUTSTANDING;
+    if (m_sent_seq[slot] != seq)
+    {
+        m_mtx.unlock();
+        return;
+    }
+    m_sent_seq[slot] = 0;
+
+    // The broker path is assumed to be symmetric, so the transition took half of the time
+    // spent in transit, plus the time the peer spent applying it
+    uint64_t rtt_us     = now - m_sent_us[slot];
+    uint64_t transit_us = (rtt_us > apply_us) ? rtt_us - apply_us : 0;
+    uint64_t latency_us = transit_us / 2 + apply_us;
+
+    // Update the statistics
+    if (m_count == 0 || latency_us < m_min_us) m_min_us = latency_us;
+    if (latency_us > m_max_us) m_max_us = latency_us;
+    m_total_us += latency_us;
+    ++m_count;
+
+    char line[128];
+    snprintf(line, sizeof(line), "Pilot mirror %s: %.1f ms (round trip %.1f ms, peer apply %.1f ms)",
+             m_sent_desc[slot], latency_us / 1000.0, rtt_us / 1000.0, apply_us / 1000.0);
+
+    m_mtx.unlock();
+
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// report() - Prints and logs the latency statistics gathered so far
+// -----------------------------------------------------------------------------
+void CPilotMirror::report()
+{
+    if (!m_is_enabled) return;
+
+    m_mtx.lock();
+    char line[128];
+    if (m_count)
+        snprintf(line, sizeof(line), "Pilot mirror: %u transitions, latency min %.1f / avg %.1f / max %.1f ms",
+                 m_count, m_min_us / 1000.0, m_total_us / 1000.0 / m_count, m_max_us / 1000.0);
+    else
+        snprintf(line, sizeof(line), "Pilot mirror: no transitions acknowledged");
+    m_mtx.unlock();
+
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
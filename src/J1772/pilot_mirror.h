@@ -0,0 +1,123 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// pilot_mirror.h - Mirrors control pilot changes seen by one RTH board onto the other board's pilot
+//
+// The EVSE-side board watches the EV under test: when it moves between states A, B and C, the EV-side
+// board switches its pilot resistors to match.  The EV-side board watches the EVSE under test: when its
+// oscillator turns on, off, or changes duty cycle, the EVSE-side board sets its PWM to match.
+//
+// Changes travel as short control messages on their own MQTT topics rather than in the J1772 status
+// JSON, and are applied as soon as they arrive.  The receiver acknowledges each applied change, which
+// lets the sender measure the latency of every transition:
+//
+//      "S,<boot>,<seq>,<A|B|C>"     EV pilot state, EVSE-side board -> EV-side board
+//      "P,<boot>,<seq>,<duty*10>"   EVSE oscillator, EV-side board -> EVSE-side board. 0 means off
+//      "K,<seq>,<apply_us>"         Acknowledgement, including how long the peer took to apply the change
+//
+// <boot> is the sender's boot_id.  Sequence numbers start over when it changes, so a change from a
+// restarted peer is never mistaken for a stale one.
+//==========================================================================================================
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+#include "J1772.h"
+
+// -----------------------------------------------------------------------------
+// CPilotMirror - Sends local pilot changes to the peer board and applies the peer's changes locally
+// -----------------------------------------------------------------------------
+class CPilotMirror
+{
+public:
+
+    // Constructor
+    CPilotMirror();
+
+    // Call this once at startup. 'tx_topic' is ours, 'rx_topic' is the peer's
+    void    init(const std::string& device_type, const std::string& tx_topic, const std::string& rx_topic);
+
+    // Returns true if mirroring has been enabled with init()
+    bool    is_enabled() {return m_is_enabled;}
+
+    // Call this with every new sample; a change the peer should mirror is sent right away
+    void    update(const J1772_t& sample);
+
+    // Call this from the MQTT thread when a message arrives on the peer's control topic
+    void    on_message(const std::string& message);
+
+    // Prints and logs the latency statistics gathered so far
+    void    report();
+
+protected:
+
+    // Applies the latest change received from the peer, if there is one
+    void    apply_pending();
+
+    // The reactor calls this on the main thread when the MQTT thread has signalled a change
+    static void on_wake(int fd, uint32_t events, void* ctx);
+
+    // Sends a control message to the peer and remembers when it went out
+    void    send(char kind, const char* value);
+
+    // Handles an acknowledgement from the peer
+    void    on_ack(uint32_t seq, uint32_t apply_us);
+
+    // Returns a monotonic timestamp in microseconds
+    static uint64_t micros();
+
+    // Our settings
+    bool        m_is_enabled, m_is_evse;
+    std::string m_tx_topic, m_rx_topic;
+
+    // The last pilot state letter / oscillator duty (x10) we told the peer about, or -1 if none yet
+    int         m_last_state, m_last_duty;
+
+    // The sequence number of the next message we send
+    uint32_t    m_seq;
+
+    // When each recent message was detected, indexed by sequence number
+    enum {MAX_OUTSTANDING = 16};
+    uint64_t    m_sent_us[MAX_OUTSTANDING];
+    uint32_t    m_sent_seq[MAX_OUTSTANDING];
+    char        m_sent_desc[MAX_OUTSTANDING][16];
+
+    // The latest change received from the peer, waiting to be applied by the main thread
+    bool        m_pending;
+    char        m_pending_kind;
+    int         m_pending_value;
+    uint32_t    m_pending_boot, m_pending_seq;
+
+    // The peer's boot_id, and the sequence number of the last change we applied from it
+    uint32_t    m_peer_boot, m_last_applied_seq;
+    uint64_t    m_pending_rx_us;
+
+    // Latency statistics, in microseconds
+    uint32_t    m_count;
+    uint64_t    m_total_us, m_min_us, m_max_us;
+
+    // An eventfd that wakes the reactor when a change arrives
+    int         m_wake_fd;
+
+    // Protects everything shared with the MQTT thread
+    std::mutex  m_mtx;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
@@ -19,26 +19,79 @@
 
 #include "common.h"
 #include <bitset>
+#include <fcntl.h>
 #include <iomanip>
+#include <time.h>
+#include <unistd.h>
 
 // Define all global objects here
 CLogger logger;
 CSLACify SLAC;
 CSleeper sleeper;
+CReactor reactor;
 CWolfMQTT global_broker;
 UDPSock evcc_udp, secc_udp;
 NetSock secc_client, secc_server;
 TCPDump tcpdump;
 CServer Server;
+CWaveformRecorder waveform;
+CTelemetry telemetry;
+CPLCLink plc_link;
+CPilotMirror pilot_mirror;
+CSerialLink serial_link;
+CStartup startup;
+
+// The part we play, EV or EVSE. Chosen once at startup
+CRole* role = NULL;
+
+// Keeps track of whether the other board is alive
+CPeer peer;
+
+// Agrees on the link settings with the other board
+CHandshake handshake;
+
+// -----------------------------------------------------------------------------
+// make_boot_id() - Returns a random number that's different every time we start
+// -----------------------------------------------------------------------------
+static uint32_t make_boot_id()
+{
+    uint32_t id = 0;
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        if (read(fd, &id, sizeof(id)) != sizeof(id)) id = 0;
+        close(fd);
+    }
+
+    // If there's no /dev/urandom, mix up the clock and our process ID instead
+    if (id == 0)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        id = (uint32_t)ts.tv_nsec ^ ((uint32_t)ts.tv_sec << 20) ^ ((uint32_t)getpid() << 8);
+    }
+
+    // Zero is kept to mean "none yet"
+    return id ? id : 1;
+}
+// -----------------------------------------------------------------------------
+
+// Tells the other board apart from an earlier run of itself
+uint32_t boot_id = make_boot_id();
 
 // -----------------------------------------------------------------------------
 // send_message() - Handy function to publish a message on the global MQTT broker in a thread-safe manner
 // -----------------------------------------------------------------------------
 void send_message(std::string topic, std::string message)
 {
+    // The broker is connected by a startup thread; until it's done, there's nobody to talk to
+    if (!broker_connected) return;
+
     pthread_mutex_lock(&publish_mtx);
     global_broker.publish(topic.c_str(), message);
     pthread_mutex_unlock(&publish_mtx);
+
+    tcpdump.note("MQTT sent %u bytes on %s", (unsigned)message.size(), topic.c_str());
 }
 // -----------------------------------------------------------------------------
 
@@ -71,4 +124,61 @@ void convert_binary_to_hex(const char* buffer, size_t length, char* hex_output)
 // -----------------------------------------------------------------------------
 
 
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// -----------------------------------------------------------------------------
+// convert_binary_to_base64() - Function to convert binary data to a base64 string.
+//                              'output' needs room for 4 chars per 3 bytes, plus 1
+// -----------------------------------------------------------------------------
+void convert_binary_to_base64(const char* buffer, size_t length, char* output)
+{
+    const unsigned char* in = (const unsigned char*)buffer;
+    char* out = output;
+
+    for (size_t i = 0; i < length; i += 3)
+    {
+        uint32_t bits = in[i] << 16;
+        if (i + 1 < length) bits |= in[i + 1] << 8;
+        if (i + 2 < length) bits |= in[i + 2];
+
+        *out++ = base64_chars[(bits >> 18) & 0x3F];
+        *out++ = base64_chars[(bits >> 12) & 0x3F];
+        *out++ = (i + 1 < length) ? base64_chars[(bits >> 6) & 0x3F] : '=';
+        *out++ = (i + 2 < length) ? base64_chars[bits & 0x3F] : '=';
+    }
+
+    *out = '\0';  // Null-terminate the string
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// convert_base64_to_binary() - Function to convert a base64 string to binary data
+//                              and return the actual length of binary data
+// -----------------------------------------------------------------------------
+size_t convert_base64_to_binary(const char* base64_data, char* buffer)
+{
+    uint32_t bits  = 0;
+    int      count = 0;
+    size_t   length = 0;
+
+    for (const char* p = base64_data; *p && *p != '='; ++p)
+    {
+        const char* c = strchr(base64_chars, *p);
+        if (c == NULL) continue;
+
+        bits = (bits << 6) | (c - base64_chars);
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            buffer[length++] = (char)(bits >> count);
+        }
+    }
+
+    return length;
+}
+// -----------------------------------------------------------------------------
+
+
 //==========================================================================================================
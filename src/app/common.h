@@ -25,6 +25,7 @@
 
 #include "client.h"
 #include "config.h"
+#include "handshake.h"
 #include "io.h"
 #include "J1772.h"
 #include "json.h"
@@ -32,36 +33,60 @@
 #include "mqtt.h"
 #include "mstimer.h"
 #include "netsock.h"
+#include "peer.h"
+#include "pilot_hw.h"
+#include "pilot_mirror.h"
+#include "plclink.h"
+#include "reactor.h"
+#include "relay.h"
+#include "role.h"
 #include "rth_statemachine.h"
 #include "sdp.h"
+#include "serial_link.h"
 #include "server.h"
 #include "slacify.h"
 #include "sleeper.h"
+#include "startup.h"
 #include "tcpdump.h"
+#include "telemetry.h"
 #include "udpsock.h"
+#include "waveform.h"
 #include "wolfMQTT_cpp.h"
 
 // Global file descriptor for serial port
 extern int uart_fd; // This is specific to the EVACharge_SE
             // If this program will support multiple hardwares, move this to a more appropriate place
 
+// The pilot/prox hardware backend that owns uart_fd
+extern CPilotHW* pilot_hw;
+
 // Declare all external objects here
 extern CWolfMQTT global_broker;
 extern CLogger logger;
 extern CSLACify SLAC;
 extern CSleeper sleeper;
+extern CReactor reactor;
 extern UDPSock evcc_udp, secc_udp;
 extern NetSock secc_client, secc_server;
 extern TCPDump tcpdump;
 extern CServer Server;
+extern CWaveformRecorder waveform;
+extern CTelemetry telemetry;
+extern CPLCLink plc_link;
+extern CPilotMirror pilot_mirror;
+extern CSerialLink serial_link;
+extern CStartup startup;
+extern CRole* role;
+extern CPeer peer;
+extern CHandshake handshake;
 
 // Declare all external variables
 extern rth_state_t rth_state;
 extern pthread_mutex_t publish_mtx;
 extern rth_handshake_t rth_hs;
+extern uint32_t boot_id;
+extern volatile int broker_connected;
 extern J1772_t J1772;
-extern int rth_data_received;
-extern std::string rth_datapacket;
 extern std::string network_interface;
 extern int signal_captured;
 extern int J1772_status_received;
@@ -71,12 +96,15 @@ extern std::string J1772_status_msg;
 void send_message(std::string topic, std::string message);
 size_t convert_hex_to_binary(const char* hex_data, char* buffer);
 void convert_binary_to_hex(const char* buffer, size_t length, char* hex_output);
+size_t convert_base64_to_binary(const char* base64_data, char* buffer);
+void convert_binary_to_base64(const char* buffer, size_t length, char* output);
 extern void exit_app(int);
 
 // Declare global SECC variables here
 extern uint16_t SECC_port;
 extern char SECC_ipv6addr[INET6_ADDRSTRLEN];
 extern std::string ipv6_str;
+extern uint64_t SDP_done_ms;
 extern int TCP_port;
 
 // Define common colors to print to screen
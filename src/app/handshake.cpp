@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// handshake.cpp - The handshake between the two RTH boards, and the link settings it agrees on
+//==========================================================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "handshake.h"
+
+// The encodings we support
+#define LINK_ENC_OURS   (LINK_ENC_HEX | LINK_ENC_BASE64)
+
+
+// -----------------------------------------------------------------------------
+// report_link() - Prints and logs the settings the handshake agreed on
+// -----------------------------------------------------------------------------
+static void report_link(const rth_link_t& link)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "Handshake done: protocol v%d, %s relay encoding, %d-byte frames, RTT %.1f ms",
+             link.version, (link.encoding == LINK_ENC_BASE64) ? "base64" : "hex", link.max_frame, link.rtt_us / 1000.0);
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CHandshake() - Constructor
+// -----------------------------------------------------------------------------
+CHandshake::CHandshake()
+{
+    m_link.version   = RTH_PROTOCOL_MIN;
+    m_link.encoding  = LINK_ENC_HEX;
+    m_link.max_frame = LINK_MAX_FRAME;
+    m_link.rtt_us    = 0;
+    m_nonce          = 0;
+    m_peer_boot      = 0;
+    memset(m_hello_nonce, 0, sizeof(m_hello_nonce));
+    memset(m_hello_us, 0, sizeof(m_hello_us));
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// micros() - Returns a monotonic timestamp in microseconds
+// -----------------------------------------------------------------------------
+uint64_t CHandshake::micros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// link() - Returns the settings we've agreed on
+// -----------------------------------------------------------------------------
+rth_link_t CHandshake::link()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_link;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// step() - Sends, or resends, our part of the handshake
+// -----------------------------------------------------------------------------
+void CHandshake::step(bool is_initiator)
+{
+    char message[80];
+    message[0] = 0;
+
+    m_mtx.lock();
+
+    // The EVSE-side board says what it can do. Each HELLO gets a new nonce, and we remember
+    // when it went out, so we know which one an answer is for when we measure the round trip
+    if (is_initiator && rth_hs == NO_HS)
+    {
+        ++m_nonce;
+        m_hello_nonce[m_nonce % HELLO_OUTSTANDING] = m_nonce;
+        m_hello_us[m_nonce % HELLO_OUTSTANDING]    = micros();
+        snprintf(message, sizeof(message), "HELLO,%d,%d,%u,%u,%d,%d", RTH_PROTOCOL_MIN, RTH_PROTOCOL_MAX, boot_id,
+                 m_nonce, LINK_ENC_OURS, LINK_MAX_FRAME);
+    }
+
+    // The EV-side board repeats its answer until it's acknowledged
+    else if (!is_initiator && rth_hs == FIRST_HS)
+    {
+        snprintf(message, sizeof(message), "%s", m_hello_ack.c_str());
+    }
+
+    m_mtx.unlock();
+
+    if (message[0]) send_message(role->tx_message(), message);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_message() - Dispatches a handshake message from the other board
+// -----------------------------------------------------------------------------
+bool CHandshake::on_message(const std::string& message)
+{
+    const char* text = message.c_str();
+
+    if      (strncmp(text, "HELLO,",     6)  == 0) on_hello(text + 6);
+    else if (strncmp(text, "HELLO-ACK,", 10) == 0) on_hello_ack(text + 10);
+    else if (strncmp(text, "ACK,",       4)  == 0) on_ack(text + 4);
+    else return false;
+
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_hello() - The EV-side board picks the best settings both boards support
+// -----------------------------------------------------------------------------
+void CHandshake::on_hello(const char* args)
+{
+    int      min_ver, max_ver, encodings, max_frame;
+    unsigned boot, nonce;
+    if (sscanf(args, "%d,%d,%u,%u,%d,%d", &min_ver, &max_ver, &boot, &nonce, &encodings, &max_frame) != 6) return;
+
+    // The newest version we both speak
+    int version = (max_ver < RTH_PROTOCOL_MAX) ? max_ver : RTH_PROTOCOL_MAX;
+    if (version < min_ver || version < RTH_PROTOCOL_MIN)
+    {
+        char line[96];
+        snprintf(line, sizeof(line), "No common protocol version with the other board (ours %d-%d, theirs %d-%d)",
+                 RTH_PROTOCOL_MIN, RTH_PROTOCOL_MAX, min_ver, max_ver);
+        printf(BOLD_RED "%s" RESET "\n", line);
+        logger.log(LOG_ERR, line);
+        return;
+    }
+
+    // The best encoding we both support. Every version supports hex
+    int common   = encodings & LINK_ENC_OURS;
+    int encoding = (common & LINK_ENC_BASE64) ? LINK_ENC_BASE64 : LINK_ENC_HEX;
+
+    // The smaller of the two frame sizes
+    if (max_frame <= 0 || max_frame > LINK_MAX_FRAME) max_frame = LINK_MAX_FRAME;
+
+    char message[80];
+    snprintf(message, sizeof(message), "HELLO-ACK,%d,%u,%u,%d,%d", version, boot, nonce, encoding, max_frame);
+
+    // Once we've finished, a HELLO from the same run is just one that was still on its way.
+    // One with a new boot_id means the other board restarted, so we start over too
+    m_mtx.lock();
+    if (rth_hs == BOTH_HS && boot == m_peer_boot)
+    {
+        m_mtx.unlock();
+        return;
+    }
+    m_peer_boot      = boot;
+    m_link.version   = version;
+    m_link.encoding  = encoding;
+    m_link.max_frame = max_frame;
+    m_hello_ack      = message;
+    rth_hs           = FIRST_HS;
+    m_mtx.unlock();
+
+    send_message(role->tx_message(), message);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_hello_ack() - The EVSE-side board adopts the settings the EV-side board
+//                  picked, measures the round trip, and acknowledges
+// -----------------------------------------------------------------------------
+void CHandshake::on_hello_ack(const char* args)
+{
+    int      version, encoding, max_frame;
+    unsigned boot, nonce;
+    if (sscanf(args, "%d,%u,%u,%d,%d", &version, &boot, &nonce, &encoding, &max_frame) != 5) return;
+
+    // An answer meant for an earlier run of ours
+    if (boot != boot_id) return;
+
+    // The other board has to pick from what we offered
+    bool version_ok  = (version >= RTH_PROTOCOL_MIN && version <= RTH_PROTOCOL_MAX);
+    bool encoding_ok = (encoding == LINK_ENC_HEX || encoding == LINK_ENC_BASE64) && (encoding & LINK_ENC_OURS);
+    bool frame_ok    = (max_frame > 0 && max_frame <= LINK_MAX_FRAME);
+    if (!version_ok || !encoding_ok || !frame_ok)
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "Other board picked unsupported link settings (protocol v%d, encoding %d, %d-byte frames)",
+                 version, encoding, max_frame);
+        printf(BOLD_RED "%s" RESET "\n", line);
+        logger.log(LOG_ERR, line);
+        return;
+    }
+
+    char message[64];
+    bool done = false;
+
+    m_mtx.lock();
+
+    // An answer to any of our recent HELLOs will do. Its own send time gives the round trip
+    if (nonce == 0 || m_hello_nonce[nonce % HELLO_OUTSTANDING] != nonce)
+    {
+        m_mtx.unlock();
+        return;
+    }
+
+    // The first answer completes the handshake. A repeat means our ACK was lost
+    if (rth_hs != BOTH_HS)
+    {
+        m_link.version   = version;
+        m_link.encoding  = encoding;
+        m_link.max_frame = max_frame;
+        m_link.rtt_us    = micros() - m_hello_us[nonce % HELLO_OUTSTANDING];
+        rth_hs = BOTH_HS;
+        done   = true;
+    }
+    snprintf(message, sizeof(message), "ACK,%u,%u,%u", boot_id, nonce, m_link.rtt_us);
+    rth_link_t link = m_link;
+
+    m_mtx.unlock();
+
+    send_message(role->tx_message(), message);
+
+    if (done) report_link(link);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_ack() - The EV-side board's answer was acknowledged
+// -----------------------------------------------------------------------------
+void CHandshake::on_ack(const char* args)
+{
+    unsigned boot, nonce, rtt_us;
+    if (sscanf(args, "%u,%u,%u", &boot, &nonce, &rtt_us) != 3) return;
+
+    // It has to be from the run of the other board we answered
+    m_mtx.lock();
+    if (rth_hs != FIRST_HS || boot != m_peer_boot)
+    {
+        m_mtx.unlock();
+        return;
+    }
+    m_link.rtt_us = rtt_us;
+    rth_hs = BOTH_HS;
+    rth_link_t link = m_link;
+    m_mtx.unlock();
+
+    report_link(link);
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
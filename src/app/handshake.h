@@ -0,0 +1,118 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// handshake.h - The handshake between the two RTH boards, and the link settings it agrees on
+//
+// The EVSE-side board says what it can do, the EV-side board picks the best settings both boards
+// support, and the EVSE-side board acknowledges them and reports the round-trip time it measured:
+//
+//      "HELLO,<min_ver>,<max_ver>,<boot>,<nonce>,<encodings>,<max_frame>"  EVSE-side -> EV-side
+//      "HELLO-ACK,<ver>,<boot>,<nonce>,<encoding>,<max_frame>"              EV-side -> EVSE-side
+//      "ACK,<boot>,<nonce>,<rtt_us>"                                        EVSE-side -> EV-side
+//
+// <boot> is the EVSE-side board's boot_id, which changes every time it starts.  The EV-side board
+// uses it to tell a restarted EVSE-side board from a late HELLO, and the EVSE-side board ignores
+// answers meant for an earlier run.  <encodings> is a bitmask of the ways relay data can be encoded,
+// and <max_frame> is the most relay data bytes a board will take in one message.  A lost message is covered by resending the last one
+// every retry interval; both boards answer a repeat the same way they answered the original.  Each
+// resent HELLO gets a new nonce, and an answer to any of the recent ones is accepted, so a round trip
+// longer than the retry interval still completes the handshake and is measured correctly.
+//==========================================================================================================
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+// The range of handshake protocol versions we speak
+#define RTH_PROTOCOL_MIN    3
+#define RTH_PROTOCOL_MAX    3
+
+// The ways relay data can be encoded, best last
+#define LINK_ENC_HEX        0x01
+#define LINK_ENC_BASE64     0x02
+
+// The most relay data bytes we'll send or take in one message
+#define LINK_MAX_FRAME      0x10000
+
+// How many of our latest HELLOs we still accept an answer to
+#define HELLO_OUTSTANDING   32
+
+// -----------------------------------------------------------------------------
+// rth_link_t - The settings both boards have agreed on
+// -----------------------------------------------------------------------------
+struct rth_link_t
+{
+    int         version;        // Protocol version
+    int         encoding;       // How relay data is encoded, one of the LINK_ENC_ values
+    int         max_frame;      // The most relay data bytes in one message
+    uint32_t    rtt_us;         // Round-trip time between the boards, measured during the handshake
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CHandshake - Agrees on link settings with the other board
+// -----------------------------------------------------------------------------
+class CHandshake
+{
+public:
+
+    // Constructor. Until a handshake completes, the link uses the settings every version supports
+    CHandshake();
+
+    // Call this every retry interval until the handshake is done. The board that starts the
+    // handshake sends (or resends) its HELLO; the other resends its HELLO-ACK if it's waiting
+    // for the acknowledgement
+    void    step(bool is_initiator);
+
+    // Call this from the MQTT thread with every message from the other board. Returns true if
+    // it was a handshake message
+    bool    on_message(const std::string& message);
+
+    // Returns the settings we've agreed on
+    rth_link_t link();
+
+protected:
+
+    // Handle each kind of handshake message
+    void    on_hello(const char* args);
+    void    on_hello_ack(const char* args);
+    void    on_ack(const char* args);
+
+    // Returns a monotonic timestamp in microseconds
+    static uint64_t micros();
+
+    // The settings we've agreed on, or the defaults
+    rth_link_t  m_link;
+
+    // The nonce of our last HELLO, the nonces of our latest HELLOs and when each went out
+    // (nonce n is kept at n % HELLO_OUTSTANDING), and our last HELLO-ACK
+    uint32_t    m_nonce;
+    uint32_t    m_hello_nonce[HELLO_OUTSTANDING];
+    uint64_t    m_hello_us[HELLO_OUTSTANDING];
+    std::string m_hello_ack;
+
+    // On the EV-side board, the boot_id of the EVSE-side board we're answering
+    uint32_t    m_peer_boot;
+
+    // Protects everything above. The MQTT thread and the startup thread both use it
+    std::mutex  m_mtx;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
@@ -38,15 +38,14 @@ pthread_mutex_t publish_mtx = PTHREAD_MUTEX_INITIALIZER;
 // Global file descriptor for serial port
 int uart_fd = -1;
 
+// The pilot/prox hardware backend that owns uart_fd
+CPilotHW* pilot_hw = NULL;
+
 // Flag that holds status of signal if received
 int signal_captured = 0;
 
-// This is the signal handler when a signal is captured
-void sig_handler(int) {signal_captured = 1;}
-
-// Create a one-shot timer to keep track of timeouts when in remote mode
-OneShot rth_state_timer;
-OneShot j1772_publish_timer;
+// This is the signal handler when a signal is captured. It wakes the reactor so we exit right away
+void sig_handler(int) {signal_captured = 1; reactor.wakeup();}
 
 // -----------------------------------------------------------------------------
 // exit_app() - Function that handles graceful shutdown of app
@@ -56,18 +55,30 @@ void exit_app(int)
     logger.log(LOG_WARNING, "Shutting down Application");
 
     // Disable the PWM on the board
-    if (config.device_type == "EVSE") control_pwm(0); // Disable PWM 
+    if (role) role->pilot_off();
+
+    // Report how quickly pilot changes were mirrored, how often we lost the other board, and
+    // how quickly the AVLN formed
+    pilot_mirror.report();
+    peer.report();
+    SLAC.report();
 
-    // Stop tcpdump process if it wasn't already
+    // Stop the capture and write out what's left of it
     tcpdump.stop();
 
     // Disconnect from MQTT broker
     global_broker.close();
 
     // Close the uart device
-    if(uart_fd != -1) { close(uart_fd); }
+    serial_link.stop();
+    if (pilot_hw) pilot_hw->close();
+    uart_fd = -1;
 
-    if (config.device_type == "EVSE") Server.close(); // close the server-side socket
+    // Flush and close the waveform ring file
+    waveform.close();
+
+    // Close the relay's sockets
+    if (role) role->close_relay();
 
     // Exit the application
     printf("\nExit.\n");
@@ -77,161 +88,260 @@ void exit_app(int)
 
 
 
+// -----------------------------------------------------------------------------
+// export_waveform_cli() - Handles "--export-waveform <file> [csv|json] [from] [to]", where
+//                         'from' and 'to' are wall-clock times in seconds since the epoch
+// -----------------------------------------------------------------------------
+int export_waveform_cli(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s --export-waveform <file> [csv|json] [from_epoch_s] [to_epoch_s]\n", argv[0]);
+        return 1;
+    }
+
+    // Fetch the optional arguments
+    std::string format = (argc > 3) ? argv[3] : "csv";
+    uint64_t from_us   = (argc > 4) ? (uint64_t)(strtod(argv[4], NULL) * 1000000.0) : 0;
+    uint64_t to_us     = (argc > 5) ? (uint64_t)(strtod(argv[5], NULL) * 1000000.0) : 0;
+
+    // Write the requested window to stdout
+    return export_waveform(argv[2], from_us, to_us, format, stdout) < 0 ? 1 : 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// benchmark_relay_live_cli() - Handles "--benchmark-relay-live <ev_iface> <secc_ip> <secc_port> <secc_iface>".
+//                              Runs both halves of the relay in this process, for an EV end and a
+//                              SECC that are already reachable over IP, until Ctrl+C. SLAC and SDP
+//                              don't run, so this can't serve devices under test
+// -----------------------------------------------------------------------------
+int benchmark_relay_live_cli(int argc, char* argv[])
+{
+    if (argc < 6)
+    {
+        fprintf(stderr, "Usage: %s --benchmark-relay-live <ev_iface> <secc_ip> <secc_port> <secc_iface>\n", argv[0]);
+        return 1;
+    }
+
+    logger.init("RTH", logfilename);
+
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!reactor.init())
+    {
+        printf("Failed to initialize the event loop\n");
+        return 1;
+    }
+
+    // Relay every connection the EV end opens until we're interrupted
+    start_relay_benchmark(argv[2], argv[3], atoi(argv[4]), argv[5]);
+    printf("Relay benchmark: relaying TCP port %d on %s to [%s]:%s on %s, without SLAC or SDP. Ctrl+C to stop\n",
+           TCP_port, argv[2], argv[3], argv[4], argv[5]);
+    while (!signal_captured) reactor.run_once();
+
+    stop_relay_benchmark();
+    printf("\nExit.\n");
+    return 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// publish_rth_state() - Reactor timer that publishes the RTH state to the broker every 250 ms
+// -----------------------------------------------------------------------------
+void publish_rth_state(void*)
+{
+    std::string rth_state_str = "No state found.";
+    switch(rth_state) {
+        case INIT:              rth_state_str = "INIT";             break;
+        case NETWORK_CHECK:     rth_state_str = "NETWORK_CHECK";    break;
+        case BROKER_CHECK:      rth_state_str = "BROKER_CHECK";     break;
+        case RTH_HANDSHAKE:     rth_state_str = "RTH_HANDSHAKE";    break;
+        case UNPLUGGED_WAIT:    rth_state_str = "UNPLUGGED_WAIT";   break;
+        case PLUGGED_IN:        rth_state_str = "PLUGGED_IN";       break;
+        case SDP:               rth_state_str = "SDP";              break;
+        case TCP_NETWORK:       rth_state_str = "TCP_NETWORK";      break;
+        case REMOTE:            rth_state_str = "REMOTE";           break;
+        case ERROR:             rth_state_str = "ERROR";            break;
+    };
+
+    send_message(role->state_topic(), rth_state_str.c_str());
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_sample() - Called by the sampler with every new J1772 sample, as soon as the
+//               co-processor's last response arrives. Runs the state machine
+// -----------------------------------------------------------------------------
+void on_sample()
+{
+    // Publish the J1772 status if it has changed enough to matter
+    telemetry.update(J1772);
+
+    // Once both boards are talking, send the peer any pilot change it should mirror
+    if (rth_state >= UNPLUGGED_WAIT) pilot_mirror.update(J1772);
+
+    // Save the current value to compare with later
+    old_J1772 = J1772;
+
+    // Execute RTH state machine here. An error during startup is fatal, but an error in a
+    // session just ends that session
+    if (rth_state_machine() != 0)
+    {
+        char log_error[30];
+        snprintf(log_error, sizeof(log_error), "Error occured in state %d\n", rth_state);
+        logger.log(LOG_INFO, log_error);
+        if (rth_state < PLUGGED_IN) exit_app(0);
+        end_session("Error in session");
+    }
+
+    // Check if coupler got unplugged halfway through the session
+    if (rth_state >= PLUGGED_IN && (J1772.pilot_state == A1 || J1772.pilot_state == A2 || J1772.pilot_state == F))
+    {
+        printf(BOLD_RED "\nCoupler removed!! Stopping session." RESET "\n\n");
+
+        // Get ready for the next session. This also puts the EVSE's pilot back to state A
+        end_session("Coupler removed");
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
 // -----------------------------------------------------------------------------
 // main()
 // -----------------------------------------------------------------------------
-int main()
+int main(int argc, char* argv[])
 {
+    // Handle offline utilities that don't start the harness
+    if (argc > 1 && strcmp(argv[1], "--export-waveform") == 0) return export_waveform_cli(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--benchmark-codec") == 0)
+    {
+        benchmark_J1772_codec((argc > 2) ? atoi(argv[2]) : 100000);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--benchmark-relay") == 0)
+    {
+        benchmark_relay((argc > 2) ? atoi(argv[2]) : 10000);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--benchmark-relay-live") == 0) return benchmark_relay_live_cli(argc, argv);
+
      // Initialize a logger
     logger.init("RTH", logfilename);
 
     // Fetch the settings from config file
     fetch_config(config_file);
+
+    // Decide which part we play. Nothing past this point needs to look at device_type again
+    role = create_role(config.device_type);
+    if (role == NULL)
+    {
+        printf("Unknown device_type '%s', must be EV or EVSE\n", config.device_type.c_str());
+        return -1;
+    }
     char start_log[30];
-    snprintf(start_log, sizeof(start_log), "Starting RTH %s as %s.", SW_VERSION, config.device_type.c_str());
+    snprintf(start_log, sizeof(start_log), "Starting RTH %s as %s.", SW_VERSION, role->name());
     logger.log(LOG_INFO, start_log);
 
     // Display banner
     printf(BOLD_CYAN);
     printf("\n------------------------------------\n");
-    printf("Remote Test harness - %s\n", config.device_type.c_str());
+    printf("Remote Test harness - %s\n", role->name());
     printf("v%s\n", SW_VERSION);
     printf("\xC2\xA9 2025 Argonne National Laboratory");
     printf("\n------------------------------------");
     printf(RESET);
     printf("\n\n");
 
-    // Open the serial port
-    const char* serial_port = "/dev/ttyAPP2";
-    uart_fd = open_and_configure_serial_port(serial_port);
+    // Connect to the pilot/prox co-processor, real or simulated
+    pilot_hw = create_pilot_hw(config.hw_backend, config.serial_port, config.sim_profile);
+    uart_fd = pilot_hw ? pilot_hw->open() : -1;
     if(uart_fd == -1)
     {
-        printf("Failed to open serial port %s", serial_port);
+        printf("Failed to open %s co-processor\n", config.hw_backend.c_str());
         return -1;
     }
+    printf("Co-processor: %s\n", pilot_hw->name().c_str());
 
-    // Flush the uart buffer, sometimes the first read returns garbage
-    flush_read_buffer(uart_fd);
+    // Start recording raw pilot/prox samples if we've been asked to
+    if (config.waveform_recorder)
+    {
+        if (waveform.open(config.waveform_file, config.waveform_capacity, role->name()))
+            printf("Recording waveform to %s\n", config.waveform_file.c_str());
+        else
+            logger.log(LOG_WARNING, "Can't open waveform file, recorder disabled");
+    }
 
     // Register exit_app() as a signal handler so it can capture Ctrl+C and kill -15 commands
     signal(SIGINT, sig_handler);
     signal(SIGTERM, sig_handler);
     signal(SIGPIPE, SIG_IGN); // ignore SIGPIPE
 
-    // Start a tcpdump process to capture network traffic
-    tcpdump_filename += "_" + config.device_type;
-    tcpdump.start(network_interface, tcpdump_filename);
+    // Capture the PLC interface's traffic if we've been asked to
+    tcpdump_filename += std::string("_") + role->name();
+    if (config.capture && !tcpdump.start(network_interface, tcpdump_filename, (uint64_t)config.capture_rotate_mb << 20,
+                                         config.capture_rotate_s, (uint64_t)config.capture_max_disk_mb << 20,
+                                         (size_t)config.capture_max_buffer_kb << 10))
+        logger.log(LOG_WARNING, "Can't capture on the PLC interface, capture disabled");
 
     // Initialize a sleeper
     sleeper.init();
 
-    // Initialize J1772 document to hold status values
-    init_json();
+    // Initialize the event loop that drives everything below
+    if (!reactor.init())
+    {
+        printf("Failed to initialize the event loop\n");
+        return -1;
+    }
 
-    // Set EVSE to State A to begin with
-    if (config.device_type == "EVSE") 
+    // Have the event loop handle the co-processor's responses as they arrive
+    if (!serial_link.start(uart_fd, config.response_delay_ms))
     {
-        control_pwm(1); // Enable PWM
-        set_pwm(99.9);  // Set PWM to 99.9% duty cycle
-        sleep(0.5);
+        printf("Failed to watch the co-processor's UART\n");
+        return -1;
     }
 
-    // Get initial status of J1772
-    update_J1772_status();
-    sleep(0.5);
-    
+    // Initialize J1772 document to hold status values
+    init_json();
+
+    // Start bringing the harness up. The network, broker, handshake, PLC and listener steps run
+    // in the background while the J1772 pilot is initialized here
+    rth_startup();
+
     // Print the first J1772 status message
     printf("J1772 pilot state: %s\n", J1772.pilot_state_name.c_str());
 
-    // Start a timer to publish the RTH state to the MQTT broker
-    rth_state_timer.start(250); 
-    j1772_publish_timer.start(250);
+    // Publish J1772 status on our own topic whenever it changes
+    telemetry.init(role->J1772_topic(), config.telemetry_deadband_V, config.telemetry_deadband_duty, config.telemetry_deadband_freq,
+                   config.telemetry_batch_ms, config.telemetry_max_age_ms, config.telemetry_max_batch);
 
-    // Loop forever
-    while (1)
+    // Mirror pilot changes to and from the other board if we've been asked to
+    if (config.pilot_mirroring)
     {
-        // Continuously take samples
-        sample_J1772();
-        
-        // If a state change we care about is detected
-        
-        if(j1772_publish_timer.is_expired())
-        {
-            // Create a JSON payload with updated J1772 status values
-            update_J1772_status();
-
-            // Publish J1772 values to MQTT broker
-            if(config.device_type == "EV")
-            {    send_message(mqtt.ev_J1772_status_topic.c_str(), J1772_status_str.c_str()); }
-            else if(config.device_type == "EVSE")
-            {    send_message(mqtt.evse_J1772_status_topic.c_str(), J1772_status_str.c_str()); }
-
-            j1772_publish_timer.start(250);
-        }
-
-        // Save the current value to compare with later
-        old_J1772 = J1772;
-
-        std::string rth_state_str = "No state found.";
-        if (rth_state_timer.is_expired())
-        {
-            // Publish rth state to broker
-            switch(rth_state) {
-                case INIT:              rth_state_str = "INIT";             break;
-                case NETWORK_CHECK:     rth_state_str = "NETWORK_CHECK";    break;
-                case BROKER_CHECK:      rth_state_str = "BROKER_CHECK";     break;
-                case RTH_HANDSHAKE:     rth_state_str = "RTH_HANDSHAKE";    break;
-                case UNPLUGGED_WAIT:    rth_state_str = "UNPLUGGED_WAIT";   break;
-                case PLUGGED_IN:        rth_state_str = "PLUGGED_IN";       break;
-                case SDP:               rth_state_str = "SDP";              break;
-                case TCP_NETWORK:       rth_state_str = "TCP_NETWORK";      break;
-                case REMOTE:            rth_state_str = "REMOTE";           break;
-                case ERROR:             rth_state_str = "ERROR";            break;
-            };
-
-            if(config.device_type == "EV")
-            {    send_message(mqtt.ev_state.c_str(), rth_state_str.c_str()); }
-            else if(config.device_type == "EVSE")
-            {    send_message(mqtt.evse_state.c_str(), rth_state_str.c_str()); }
-                    
-
-            rth_state_timer.start(250);
-        }
-
-        // Execute RTH state machine here
-        if (rth_state_machine() != 0)
-        {
-            char log_error[30];
-            snprintf(log_error, sizeof(log_error), "Error occured in state %d\n", rth_state);
-            logger.log(LOG_INFO, log_error);
-            exit_app(0);
-        }
-
-        // Check if coupler got unplugged halfway through the session
-        if (rth_state >= PLUGGED_IN && (J1772.pilot_state_name == "A1" || J1772.pilot_state_name == "A2" || J1772.pilot_state_name == "F"))
-        {
-            printf(BOLD_RED "\nCoupler removed!! Stopping session." RESET "\n\n");
-            
-            // Turn oscillator off
-            if (config.device_type == "EVSE")
-                control_pwm(0);
-            
-            // log it
-            char log_error[30];
-            snprintf(log_error, sizeof(log_error), "Coupler removed in state %d\n", rth_state);
-            logger.log(LOG_INFO, log_error);
-            
-            // then exit the app
-            exit_app(0);
-        }
-
-        // Sleep a bit to not bog down the CPU
-        sleeper.sleep(50);
-
-        // If application interrupted by a signal, exit it
-        if (signal_captured) exit_app(0);
+        pilot_mirror.init(role->name(), role->tx_control(), role->rx_control());
     }
 
+    // Exchange heartbeats with the other board
+    peer.init(config.heartbeat_interval_ms, config.heartbeat_timeout_ms);
+
+    // Publish the RTH state to the MQTT broker every 250 ms
+    reactor.add_timer(250, publish_rth_state, NULL, true);
+
+    // Start sampling; every sample steps the state machine
+    start_sampling(on_sample);
+
+    // Run the event loop until we're interrupted by a signal
+    while (!signal_captured) reactor.run_once();
+
     printf("done.\n");
     exit_app(0);
 }
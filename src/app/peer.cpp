@@ -0,0 +1,210 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// peer.cpp - Keeps track of whether the other RTH board is still alive
+//==========================================================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "peer.h"
+
+
+// -----------------------------------------------------------------------------
+// CPeer() - Constructor
+// -----------------------------------------------------------------------------
+CPeer::CPeer()
+{
+    m_interval_ms     = 0;
+    m_timeout_ms      = 0;
+    m_tx_seq          = 0;
+    m_rx_seq          = 0;
+    m_state           = PEER_UNKNOWN;
+    m_last_heard_ms   = 0;
+    m_will_received   = false;
+    m_missed          = 0;
+    m_lost_ms         = 0;
+    m_loss_count      = 0;
+    m_detect_max_ms   = 0;
+    m_detect_total_ms = 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// init() - Starts sending heartbeats and watching for the other board's
+// -----------------------------------------------------------------------------
+void CPeer::init(int interval_ms, int timeout_ms)
+{
+    m_interval_ms = (interval_ms > 0) ? interval_ms : 200;
+    m_timeout_ms  = (timeout_ms > m_interval_ms) ? timeout_ms : m_interval_ms * 3;
+    reactor.add_timer(m_interval_ms, on_tick, this, true);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_message() - Notes that the other board is alive. Called on the MQTT thread
+// -----------------------------------------------------------------------------
+bool CPeer::on_message(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    uint64_t now = msTimer::millis();
+
+    // The broker is telling us the other board's connection dropped. We act on it the next
+    // time we tick, on the main thread
+    if (message == "L")
+    {
+        m_will_received = true;
+        return true;
+    }
+
+    // Anything else means it's alive
+    m_last_heard_ms = now;
+    if (m_state != PEER_ALIVE)
+    {
+        if (m_state == PEER_LOST)
+        {
+            char line[80];
+            snprintf(line, sizeof(line), "The other board is back after %llu ms", (unsigned long long)(now - m_lost_ms));
+            printf(BOLD_GREEN "%s" RESET "\n", line);
+            logger.log(LOG_INFO, line);
+        }
+        m_state = PEER_ALIVE;
+        m_will_received = false;
+    }
+
+    // A heartbeat. Count any we missed; a restarted board starts counting again from 1
+    if (message.size() > 2 && message[0] == 'H' && message[1] == ',')
+    {
+        uint32_t seq = strtoul(message.c_str() + 2, NULL, 10);
+        if (m_rx_seq && seq > m_rx_seq + 1) m_missed += seq - m_rx_seq - 1;
+        m_rx_seq = seq;
+        return true;
+    }
+
+    return false;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// is_lost() - Returns true if we've heard from the other board and then lost it
+// -----------------------------------------------------------------------------
+bool CPeer::is_lost()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_state == PEER_LOST;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_tick() - Reactor timer that runs every heartbeat interval
+// -----------------------------------------------------------------------------
+void CPeer::on_tick(void* ctx)
+{
+    ((CPeer*)ctx)->tick();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// tick() - Sends our heartbeat, and checks that the other board is still sending
+//          its own.  If it has gone quiet mid-session, the session ends
+// -----------------------------------------------------------------------------
+void CPeer::tick()
+{
+    // send_message() drops this until the broker is connected
+    char message[16];
+    snprintf(message, sizeof(message), "H,%u", ++m_tx_seq);
+    send_message(role->tx_message(), message);
+
+    // We can only lose a board we've heard from
+    bool just_lost = false;
+    m_mtx.lock();
+    if (m_state == PEER_ALIVE)
+    {
+        uint64_t now = msTimer::millis();
+        if (m_will_received)
+        {
+            lost("its broker connection dropped", now);
+            just_lost = true;
+        }
+        else if (now - m_last_heard_ms >= (uint64_t)m_timeout_ms)
+        {
+            lost("no heartbeat", now);
+            just_lost = true;
+        }
+    }
+    m_mtx.unlock();
+
+    // A session can't go on without the other board
+    if (just_lost && rth_state >= PLUGGED_IN) end_session("Lost the other board");
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// lost() - Marks the other board lost and records how quickly we noticed. Call
+//          with m_mtx held
+// -----------------------------------------------------------------------------
+void CPeer::lost(const char* reason, uint64_t now)
+{
+    uint64_t detect_ms = now - m_last_heard_ms;
+
+    m_state   = PEER_LOST;
+    m_lost_ms = now;
+    ++m_loss_count;
+    m_detect_total_ms += detect_ms;
+    if (detect_ms > m_detect_max_ms) m_detect_max_ms = detect_ms;
+
+    char line[128];
+    snprintf(line, sizeof(line), "Lost the other board (%s), %llu ms after we last heard from it", reason,
+             (unsigned long long)detect_ms);
+    printf(BOLD_RED "\n%s" RESET "\n\n", line);
+    logger.log(LOG_ERR, line);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// report() - Prints and logs the liveness statistics gathered so far
+// -----------------------------------------------------------------------------
+void CPeer::report()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_loss_count == 0 && m_missed == 0) return;
+
+    char line[160];
+    snprintf(line, sizeof(line), "Other board lost %d time(s), noticed after avg %llu ms, max %llu ms; %u heartbeat(s) missed",
+             m_loss_count, (unsigned long long)(m_loss_count ? m_detect_total_ms / m_loss_count : 0),
+             (unsigned long long)m_detect_max_ms, m_missed);
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
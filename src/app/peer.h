@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// peer.h - Keeps track of whether the other RTH board is still alive
+//
+// Each board sends a heartbeat on its message topic every heartbeat interval.  Any message from the
+// other board counts as a sign of life, and if nothing arrives for the heartbeat timeout, the other
+// board is considered lost.  Each board also leaves the broker a Last Will message, which the broker
+// publishes for it if its connection drops, so a crashed board is noticed without waiting at all:
+//
+//      "H,<seq>"     Heartbeat
+//      "L"           Last Will, published by the broker when the sender's connection drops
+//
+// Losing the other board mid-session ends the session, and no new session starts until it's back.
+//==========================================================================================================
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+// -----------------------------------------------------------------------------
+// CPeer - Tracks the liveness of the other RTH board
+// -----------------------------------------------------------------------------
+class CPeer
+{
+public:
+
+    // What we know about the other board
+    enum peer_state_t {PEER_UNKNOWN, PEER_ALIVE, PEER_LOST};
+
+    // Constructor
+    CPeer();
+
+    // Call this once at startup. Heartbeats go out every 'interval_ms', and the other board is
+    // lost if we don't hear from it for 'timeout_ms'
+    void    init(int interval_ms, int timeout_ms);
+
+    // Call this from the MQTT thread with every message from the other board. Returns true if the
+    // message was a liveness message, and needs no further handling
+    bool    on_message(const std::string& message);
+
+    // Returns true if we've heard from the other board and then lost it
+    bool    is_lost();
+
+    // Prints and logs how many times we lost the other board and how quickly we noticed
+    void    report();
+
+protected:
+
+    // The reactor calls this every heartbeat interval to send our heartbeat and check on theirs
+    static void on_tick(void* ctx);
+    void    tick();
+
+    // Marks the other board lost and says why
+    void    lost(const char* reason, uint64_t now);
+
+    // Settings
+    int         m_interval_ms, m_timeout_ms;
+
+    // Our heartbeat sequence number, and the last one we saw from the other board
+    uint32_t    m_tx_seq, m_rx_seq;
+
+    // State shared with the MQTT thread
+    peer_state_t m_state;
+    uint64_t    m_last_heard_ms;
+    bool        m_will_received;
+    uint32_t    m_missed;
+
+    // When we lost the other board, and statistics on how quickly we noticed
+    uint64_t    m_lost_ms;
+    int         m_loss_count;
+    uint64_t    m_detect_max_ms, m_detect_total_ms;
+
+    // Protects everything above. The MQTT thread and the main thread both use it
+    std::mutex  m_mtx;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
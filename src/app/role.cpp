@@ -0,0 +1,217 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// role.cpp - The part the harness plays: the EV side, or the EVSE side
+//==========================================================================================================
+
+#include <stdio.h>
+
+#include "common.h"
+#include "role.h"
+
+// This lives with the state machine
+extern CClient Client;
+
+
+// -----------------------------------------------------------------------------
+// define_SLAC() - Hands SLAC the profile items set in the config file
+// -----------------------------------------------------------------------------
+static void define_SLAC()
+{
+    for (size_t i = 0; i < config.slac_profile.size(); ++i)
+    {
+        SLAC.define(config.slac_profile[i].first.c_str(), config.slac_profile[i].second.c_str());
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// subscribe() - Subscribes to the topics the other board sends on
+// -----------------------------------------------------------------------------
+void CRole::subscribe()
+{
+    global_broker.subscribe(rx_message());
+    if (config.pilot_mirroring) global_broker.subscribe(rx_control());
+}
+// -----------------------------------------------------------------------------
+
+
+
+//==========================================================================================================
+// CEVRole
+//==========================================================================================================
+
+// -----------------------------------------------------------------------------
+// CEVRole() - Constructor
+// -----------------------------------------------------------------------------
+CEVRole::CEVRole()
+{
+    m_name        = "EV";
+    m_is_evse     = false;
+    m_tx_message  = &mqtt.ev_message;
+    m_rx_message  = &mqtt.evse_message;
+    m_tx_control  = &mqtt.ev_control;
+    m_rx_control  = &mqtt.evse_control;
+    m_state_topic = &mqtt.ev_state;
+    m_J1772_topic = &mqtt.ev_J1772_status_topic;
+    m_slac_topic  = &mqtt.ev_slac_trace;
+    m_plc_link_topic = &mqtt.ev_plc_link;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// init_SLAC() - Opens the PLC channel as the PEV
+// -----------------------------------------------------------------------------
+int CEVRole::init_SLAC()
+{
+    define_SLAC();
+    return SLAC.init(PEV, 'l', config.slac_attn_limit, config.slac_timeout, config.slac_retries) ? 0 : -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// SDP, relay and pilot - The EV side runs the SDP client and the relay's client
+// -----------------------------------------------------------------------------
+int  CEVRole::perform_SDP() {return perform_SDP_client();}
+void CEVRole::reset_SDP()   {reset_SDP_client();}
+
+int CEVRole::start_relay()
+{
+    printf("\nConnecting to SECC server on port %d\n", SECC_port);
+    Client.launch(ipv6_str, SECC_port);
+    return 0;
+}
+
+bool CEVRole::relay_failed()  {return Client.has_failed();}
+void CEVRole::drop_relay()    {Client.close();}
+void CEVRole::close_relay()   {Client.close();}
+void CEVRole::relay_open(uint32_t id) {Client.open(id);}
+bool CEVRole::relay_deliver(uint32_t id, const std::string& data) {return Client.deliver(id, data);}
+void CEVRole::relay_close(uint32_t id) {Client.close_connection(id);}
+// -----------------------------------------------------------------------------
+
+
+
+//==========================================================================================================
+// CEVSERole
+//==========================================================================================================
+
+// -----------------------------------------------------------------------------
+// CEVSERole() - Constructor
+// -----------------------------------------------------------------------------
+CEVSERole::CEVSERole()
+{
+    m_name        = "EVSE";
+    m_is_evse     = true;
+    m_tx_message  = &mqtt.evse_message;
+    m_rx_message  = &mqtt.ev_message;
+    m_tx_control  = &mqtt.evse_control;
+    m_rx_control  = &mqtt.ev_control;
+    m_state_topic = &mqtt.evse_state;
+    m_J1772_topic = &mqtt.evse_J1772_status_topic;
+    m_slac_topic  = &mqtt.evse_slac_trace;
+    m_plc_link_topic = &mqtt.evse_plc_link;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// init_SLAC() - Opens the PLC channel as the EVSE, and sets the network key
+// -----------------------------------------------------------------------------
+int CEVSERole::init_SLAC()
+{
+    define_SLAC();
+    return SLAC.init(EVSE) ? 0 : -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// SDP and relay - The EVSE side runs the SDP responder and the relay's server,
+//                 both of which are started with the listeners
+// -----------------------------------------------------------------------------
+int  CEVSERole::perform_SDP() {return check_SDP_responder();}
+void CEVSERole::reset_SDP()   {mark_SDP_responder();}
+
+void CEVSERole::drop_relay()  {Server.drop();}
+void CEVSERole::close_relay() {Server.close();}
+bool CEVSERole::relay_deliver(uint32_t id, const std::string& data) {return Server.deliver(id, data);}
+void CEVSERole::relay_close(uint32_t id) {Server.close_connection(id);}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// pilot_idle() - Puts the pilot at a static +12 V (state A)
+// -----------------------------------------------------------------------------
+void CEVSERole::pilot_idle()
+{
+    control_pwm(1);
+    set_pwm(99.9);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// pilot_unplugged() - Once a coupler is plugged in (B1), turns the oscillator on
+//                     at 5% so the EV under test knows to start digital comms
+// -----------------------------------------------------------------------------
+int CEVSERole::pilot_unplugged()
+{
+    if (J1772.pilot_state != B1) return 0;
+
+    set_pwm(5.00);
+
+    // Give the oscillator a bit to turn on
+    return 100;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// pilot_off() - Disables the PWM
+// -----------------------------------------------------------------------------
+void CEVSERole::pilot_off()
+{
+    control_pwm(0);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// create_role() - Creates the role named by 'device_type'
+// -----------------------------------------------------------------------------
+CRole* create_role(const std::string& device_type)
+{
+    if (device_type == "EV")   return new CEVRole;
+    if (device_type == "EVSE") return new CEVSERole;
+    return NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// role.h - The part the harness plays: the EV side, or the EVSE side
+//
+// Everything that differs between the two sides lives here: which topics we send and listen on, which
+// half of SDP and of the TCP relay we run, and what we do with the pilot.  The role is chosen once at
+// startup from the "device_type" setting, and the rest of the harness just asks it.
+//
+// Each role is an object rather than a global setting, but the roles don't own their state: both of
+// them drive the process's one Client, Server, SLAC and SDP.  So a process runs one role, except for
+// the relay, whose two halves can run side by side (see relay_set_loopback()).
+//==========================================================================================================
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// -----------------------------------------------------------------------------
+// CRole - Base class for the EV and EVSE roles
+// -----------------------------------------------------------------------------
+class CRole
+{
+public:
+
+    // Destructor
+    virtual ~CRole() {}
+
+    // Returns "EV" or "EVSE"
+    const char*         name() {return m_name;}
+
+    // True for the EVSE side. For the odd place that just needs a label or a direction
+    bool                is_evse() {return m_is_evse;}
+
+    // The topics we send on, and the ones the other board sends on
+    const std::string&  tx_message() {return *m_tx_message;}
+    const std::string&  rx_message() {return *m_rx_message;}
+    const std::string&  tx_control() {return *m_tx_control;}
+    const std::string&  rx_control() {return *m_rx_control;}
+    const std::string&  state_topic() {return *m_state_topic;}
+    const std::string&  J1772_topic() {return *m_J1772_topic;}
+    const std::string&  slac_topic() {return *m_slac_topic;}
+    const std::string&  plc_link_topic() {return *m_plc_link_topic;}
+
+    // Subscribes to the other board's topics
+    void                subscribe();
+
+    // Returns true if this role starts the handshake with the other board
+    virtual bool        starts_handshake() = 0;
+
+    // Opens the PLC channel for this side of SLAC. Returns 0 on success
+    virtual int         init_SLAC() = 0;
+
+    // Returns true if this role runs listeners (the SDP responder and the relay server) from startup
+    virtual bool        has_listeners() = 0;
+
+    // Starts this side of SDP, or checks on it. Returns 0 when it's done, 1 while it's in
+    // progress, or -1 if it failed
+    virtual int         perform_SDP() = 0;
+
+    // Gets this side of SDP ready for the next session
+    virtual void        reset_SDP() = 0;
+
+    // Starts this side of the TCP relay once SDP is done. Returns 0 on success
+    virtual int         start_relay() = 0;
+
+    // Returns true if the relay gave up and the session can't go on
+    virtual bool        relay_failed() = 0;
+
+    // Drops every relayed connection at the end of a session, or for good at exit
+    virtual void        drop_relay() = 0;
+    virtual void        close_relay() = 0;
+
+    // Relay messages from the other board, for relayed connection 'id'
+    virtual void        relay_open(uint32_t id) = 0;
+    virtual bool        relay_deliver(uint32_t id, const std::string& data) = 0;
+    virtual void        relay_close(uint32_t id) = 0;
+
+    // The pilot at idle (state A), while waiting for a plug-in, and at exit. pilot_unplugged()
+    // returns how many ms the pilot needs to settle after what it did
+    virtual void        pilot_idle() = 0;
+    virtual int         pilot_unplugged() = 0;
+    virtual void        pilot_off() = 0;
+
+protected:
+
+    const char*         m_name;
+    bool                m_is_evse;
+    const std::string  *m_tx_message, *m_rx_message, *m_tx_control, *m_rx_control;
+    const std::string  *m_state_topic, *m_J1772_topic, *m_slac_topic, *m_plc_link_topic;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CEVRole - We sit on the EV side: the EVSE under test is attached to us
+// -----------------------------------------------------------------------------
+class CEVRole : public CRole
+{
+public:
+    CEVRole();
+    bool    starts_handshake() {return false;}
+    int     init_SLAC();
+    bool    has_listeners() {return false;}
+    int     perform_SDP();
+    void    reset_SDP();
+    int     start_relay();
+    bool    relay_failed();
+    void    drop_relay();
+    void    close_relay();
+    void    relay_open(uint32_t id);
+    bool    relay_deliver(uint32_t id, const std::string& data);
+    void    relay_close(uint32_t id);
+    void    pilot_idle() {}
+    int     pilot_unplugged() {return 0;}
+    void    pilot_off() {}
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CEVSERole - We sit on the EVSE side: the EV under test is attached to us
+// -----------------------------------------------------------------------------
+class CEVSERole : public CRole
+{
+public:
+    CEVSERole();
+    bool    starts_handshake() {return true;}
+    int     init_SLAC();
+    bool    has_listeners() {return true;}
+    int     perform_SDP();
+    void    reset_SDP();
+    int     start_relay() {return 0;}
+    bool    relay_failed() {return false;}
+    void    drop_relay();
+    void    close_relay();
+    void    relay_open(uint32_t) {}
+    bool    relay_deliver(uint32_t id, const std::string& data);
+    void    relay_close(uint32_t id);
+    void    pilot_idle();
+    int     pilot_unplugged();
+    void    pilot_off();
+};
+// -----------------------------------------------------------------------------
+
+// Creates the role named by 'device_type' ("EV" or "EVSE"). Returns NULL if the name is unknown
+CRole* create_role(const std::string& device_type);
+
+//==========================================================================================================
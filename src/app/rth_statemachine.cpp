@@ -17,7 +17,22 @@
 // State machine for Remote Test Harness
 //==========================================================================================================
 
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include "common.h"
+#include "schema.h"
+
+// How long the network check waits for a connection, and how often the handshake is retried
+#define NETWORK_CHECK_TIMEOUT_MS  3000
+#define HANDSHAKE_RETRY_MS        250
+#define HANDSHAKE_TIMEOUT_MS      33000
 
 // This is the current state of RTH
 rth_state_t rth_state;
@@ -25,34 +40,144 @@ rth_state_t rth_state;
 // This is the current state of handshake. Start with assuming no handshake yet
 rth_handshake_t rth_hs = NO_HS;
 
+// This is set once the global broker is connected and it's safe to publish
+volatile int broker_connected = 0;
+
 // Keep status of SLAC
 int SLAC_init = false;
 
-// SLAC settings
-int slac_attn_limit = 70; // in dB. Use 40 for CCS cable, 70 for direct BNC connection
+// SLAC settings. The rest come from the [SLAC] section of the config file
 int slac_settle_time = 1; // in seconds. Can increase if more time is needed after AVLN is established
-int slac_timeout = 20; // timeout for SLAC waiting to connect
-int slac_retries = 10; // number of retries for SLAC
 
 // TCP/IP server objects
 CClient Client;
 int TCP_port = 65535;
 int server_flag = 0;
 
-// Create a one-shot timer to keep track of timeouts when in remote mode
-OneShot remote_timer;
+// The startup steps on the path to a working link with the other board
+static int step_network = -1, step_broker = -1;
+
+// The reactor timer that limits how long we stay in remote mode
+static int remote_timer_id = -1;
+
+// The reactor timer that checks for a plug-in once the pilot has settled
+static int plugged_in_timer_id = -1;
+
+// How many sessions we've run, and when the current one started
+static int      session_count    = 0;
+static uint64_t session_start_ms = 0;
 
 // -----------------------------------------------------------------------------
-// network_check() - This will perform a ping test to google servers to see if we have network connectivity
+// check_plugged_in() - Reactor timer that starts a session once the pilot shows B2
+// -----------------------------------------------------------------------------
+static void check_plugged_in(void*)
+{
+    plugged_in_timer_id = -1;
+    if (rth_state != UNPLUGGED_WAIT || J1772.pilot_state != B2) return;
+
+    // Don't start a session without the other board
+    if (peer.is_lost()) return;
+
+    rth_state = PLUGGED_IN;
+    session_start_ms = msTimer::millis();
+    printf("Plugged in! Starting session %d\n", ++session_count);
+    tcpdump.session(session_count);
+    tcpdump.note("Session %d started", session_count);
+    printf(BOLD_YELLOW "\nPerforming SLAC .. " RESET "\n\n");
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// remote_timeout() - Reactor timer that ends the session if remote mode runs too long
+// -----------------------------------------------------------------------------
+static void remote_timeout(void*)
+{
+    remote_timer_id = -1;
+    printf("\nTimed out.\n");
+    end_session("Timed out in remote mode");
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// end_session() - Tears down what belongs to the current session and goes back to
+//                 waiting for a coupler.  The broker connection, the PLC channel, the
+//                 listeners and the handshake with the other board all stay up
+// -----------------------------------------------------------------------------
+void end_session(const char* reason)
+{
+    // Log why and how long the session ran
+    char log_msg[128];
+    snprintf(log_msg, sizeof(log_msg), "Session %d ended in state %d after %llu ms: %s", session_count, rth_state,
+             (unsigned long long)(msTimer::millis() - session_start_ms), reason);
+    logger.log(LOG_INFO, log_msg);
+    printf(BOLD_YELLOW "\n%s" RESET "\n\n", log_msg);
+
+    // Whatever the capture sees from here on goes in a file of its own
+    tcpdump.note("%s", log_msg);
+    tcpdump.session(0);
+
+    // Stop the remote mode timer if it's still running
+    reactor.cancel_timer(remote_timer_id);
+    remote_timer_id = -1;
+
+    // Drop the V2G connections between the EV and EVSE under test. Anything still in
+    // flight for them is dropped along with them
+    role->drop_relay();
+
+    // Get SDP and SLAC ready to go again
+    role->reset_SDP();
+    if (SLAC_init) SLAC.reset();
+
+    // Put the EVSE's pilot back to a static +12 V (state A)
+    role->pilot_idle();
+
+    rth_state = UNPLUGGED_WAIT;
+    printf("\nWaiting for coupler to be plugged in .. \n\n");
+}
+// -----------------------------------------------------------------------------
+
+// -----------------------------------------------------------------------------
+// network_check() - This will check that we can reach Google's public DNS server, which tells us
+//                   we have network connectivity. It opens a TCP connection in-process rather than
+//                   shelling out to ping, and gives up after NETWORK_CHECK_TIMEOUT_MS
 // -----------------------------------------------------------------------------
 int network_check()
 {
     printf(BOLD_YELLOW "\nPerforming Network check .. " RESET "\n\n");
-    // const char* hostname = "google.com";
-    const char* hostname = "8.8.8.8";
-    std::string command = "ping -c 1 ";
-    command.append(hostname);
-    int rc = system(command.c_str());
+
+    // Create a non-blocking socket so we can put our own timeout on the connect
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sd < 0) return -1;
+    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(53);
+    inet_pton(AF_INET, "8.8.8.8", &addr.sin_addr);
+
+    // Start connecting, then wait for the socket to become writable
+    int rc = connect(sd, (struct sockaddr*)&addr, sizeof(addr));
+    if (rc < 0 && errno == EINPROGRESS)
+    {
+        struct pollfd pfd = {sd, POLLOUT, 0};
+        rc = -1;
+        if (poll(&pfd, 1, NETWORK_CHECK_TIMEOUT_MS) == 1)
+        {
+            // Writable doesn't mean connected; the socket error tells us which
+            int       error = 0;
+            socklen_t len   = sizeof(error);
+            getsockopt(sd, SOL_SOCKET, SO_ERROR, &error, &len);
+            rc = error ? -1 : 0;
+        }
+    }
+    close(sd);
+
+    if (rc != 0) printf(BOLD_RED "\nNetwork check failed.\n\n" RESET);
     return rc;
 }
 // -----------------------------------------------------------------------------
@@ -67,6 +192,9 @@ int broker_check()
 
     // Configure and connect to global MQTT broker using TLS (refer to wolfMQTT_cpp.h for init() argument details)
     global_broker.init(MQTT_QOS_0, 60, 30000, 5000, true, 80, 1024);
+
+    // If we drop off the broker, have it tell the other board right away
+    global_broker.set_will(role->tx_message(), "L");
     int rc = global_broker.connect(mqtt.broker_ip, mqtt.broker_port, mqtt.username, mqtt.password, mqtt.client_id);
     printf("connect rc: %d\n", rc);
 
@@ -80,17 +208,11 @@ int broker_check()
         return rc;
     }
 
-    // Otherwise we're good; Subscribe to relavant topic based on device type
-    if (config.device_type == "EV")
-    {
-        global_broker.subscribe(mqtt.evse_message);
-    }
-    else if (config.device_type == "EVSE")
-    {
-        global_broker.subscribe(mqtt.ev_message);
-    }
+    // Otherwise we're good; Subscribe to the other board's topics
+    role->subscribe();
 
     // If we get here, we're configured and ready to run the app properly
+    broker_connected = 1;
     logger.log(LOG_INFO, "Initialized, connected to brokers and ready for comms");
     return rc;
 }
@@ -99,56 +221,43 @@ int broker_check()
 
 
 // -----------------------------------------------------------------------------
-// rth_handshake() - This will attempt to perform a handshake with both RTH devices
+// rth_handshake() - This will attempt to perform a handshake with both RTH devices, agreeing
+//                   on the link settings (see handshake.h). Handshake messages are resent
+//                   every HANDSHAKE_RETRY_MS until HANDSHAKE_TIMEOUT_MS has passed
 // -----------------------------------------------------------------------------
 int rth_handshake()
 {
     printf(BOLD_YELLOW "\nPerforming RTH Handshake .. \n\n" RESET);
 
-    // Keep track of number of retries
-    int num_retries = 0;
+    // Keep track of how long we've been at it
+    uint64_t start_ms = msTimer::millis();
 
     while (1)
     {   
-        // EVSE will issue a handshake command first
-        if (rth_hs == NO_HS && config.device_type == "EVSE")
-        {
-            send_message(mqtt.evse_message, "1");
-        }
-            
-
-        // EV will reply back with its handshake command
-        if (rth_hs == FIRST_HS && config.device_type == "EV")
-        {
-            send_message(mqtt.ev_message, "1");
-
-            // EV will send handshake message 3 times before considering it a success
-            if (num_retries >= 3)
-                rth_hs = BOTH_HS;
-        }
+        // EVSE will send its HELLO first, and the EV will answer it until it's acknowledged
+        handshake.step(role->starts_handshake());
 
-        // EVSE received handshake response from EV
+        // Both boards have agreed on the link
         if (rth_hs == BOTH_HS)
         {
-            logger.log(LOG_INFO, "RTH Handshake established with EV");
+            logger.log(LOG_INFO, "RTH Handshake established with the other board");
             break;
         }
 
-        // Timeout after trying a few times
-        if (num_retries > 10)
+        // Timeout after trying for a while
+        if (msTimer::millis() - start_ms > HANDSHAKE_TIMEOUT_MS)
         {
             logger.log(LOG_ERR, "Error: Could not establish handshake with other RTH device");
             printf(BOLD_RED "\nRTH Handshake failed.\n\n" RESET);
 
             return -1;
         }
-        else num_retries++;
 
         // Sleep a bit to see if handshake message received before trying again
-        sleep(3);
+        usleep(HANDSHAKE_RETRY_MS * 1000);
 
-        // If application interrupted by a signal, exit it
-        if (signal_captured) exit_app(0);
+        // If application interrupted by a signal, give up. The main loop will shut us down
+        if (signal_captured) return -1;
     }
     
     printf("RTH Handshake established! \n");
@@ -160,47 +269,140 @@ int rth_handshake()
 
 
 // -----------------------------------------------------------------------------
-// perform_SLAC() - Initialize settings and perform SLAC to form AVLN
+// publish_SLAC_trace() - Publishes and logs how a SLAC attempt went
 // -----------------------------------------------------------------------------
-int perform_SLAC()
+static void publish_SLAC_trace(const slac_trace_t& trace, void*)
 {
-    printf(BOLD_YELLOW "\nPerforming SLAC .. " RESET "\n\n");
+    char message[512];
+    CJsonWriter writer(message, sizeof(message));
+    writer.begin();
+    writer.field("side",           trace.side);
+    writer.field("result",         trace.result);
+    writer.field("phase",          trace.phase);
+    writer.field("attempt",        trace.attempt);
+    writer.field("retries",        trace.retries);
+    writer.field("param_ms",       trace.param_ms);
+    writer.field("start_atten_ms", trace.start_atten_ms);
+    writer.field("first_sound_ms", trace.first_sound_ms);
+    writer.field("last_sound_ms",  trace.last_sound_ms);
+    writer.field("sounds",         trace.sounds);
+    writer.field("atten_char_ms",  trace.atten_char_ms);
+    writer.field("attenuation",    trace.attenuation);
+    writer.field("match_ms",       trace.match_ms);
+    writer.field("set_key_ms",     trace.set_key_ms);
+    writer.field("join_ms",        trace.join_ms);
+    writer.field("total_ms",       trace.total_ms);
+    if (writer.end() < 0) return;
+
+    send_message(role->slac_topic(), message);
+    logger.log(LOG_INFO, message);
+}
+// -----------------------------------------------------------------------------
 
-    // Initialize SLAC if it hasn't been done so already
-    if (SLAC_init == 0)
+
+
+// -----------------------------------------------------------------------------
+// prepare_SLAC() - Opens the PLC channel and, on the EVSE, generates and sets the network key
+// -----------------------------------------------------------------------------
+int prepare_SLAC()
+{
+    // Every SLAC attempt is traced
+    SLAC.set_tracer(publish_SLAC_trace, NULL);
+
+    // Initialize SLAC settings for our side
+    if (role->init_SLAC() != 0)
     {
-        // Initialize SLAC settings based on device type
-        if (config.device_type == "EV")
-        {
-            if (!SLAC.init(PEV, 'l', slac_attn_limit, slac_timeout, slac_retries))
-            {
-                printf("SLAC init failed.\n");
-                SLAC_init = 0;
-                return -1;
-            }
-            SLAC_init = 1;
-        }
-        else if (config.device_type == "EVSE")
-        {
-            if (!SLAC.init(EVSE))
-            {
-                printf("SLAC init failed.\n");
-                SLAC_init = 0;
-                return -1;
-            }
-            SLAC_init = 1;
-        }
+        printf("SLAC init failed.\n");
+        SLAC_init = 0;
+        return -1;
     }
+    SLAC_init = 1;
+
+    // Keep an eye on the quality of the PLC link from here on
+    if (config.plc_link_interval_ms > 0)
+    {
+        telemetry.init_plc_link(role->plc_link_topic());
+        plc_link.start(config.plc_link_interval_ms, CTelemetry::on_plc_link, &telemetry);
+    }
+
+    return 0;
+}
+// -----------------------------------------------------------------------------
+
 
-    // Attempt to perform SLAC here
-    if (SLAC.connect() <= 0)
+
+// -----------------------------------------------------------------------------
+// perform_SLAC() - Starts SLAC to form the AVLN, or checks on it. Returns 0 when
+//                  it's done, 1 while it's in progress, or -1 if it failed
+// -----------------------------------------------------------------------------
+int perform_SLAC()
+{
+    // Initialize SLAC if it hasn't been done so already
+    if (SLAC_init == 0 && prepare_SLAC() != 0) return -1;
+
+    // SLAC runs in the background
+    int rc = SLAC.connect();
+    if (rc < 0)
     {
         printf(BOLD_RED "\nSLAC failed.\n\n" RESET);
         logger.log(LOG_ERR, "SLAC failed.");
+    }
+
+    return rc;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// setup_TCP_network() - This function creates the TCP server the EV under test
+//                       connects to
+// -----------------------------------------------------------------------------
+int setup_TCP_network()
+{
+    // Create a TCP server
+    printf("Creating SECC server on port %d\n", TCP_port);
+    Server.launch(TCP_port);
+
+    return 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// create_listeners() - Starts the SDP responder and the SECC TCP server
+// -----------------------------------------------------------------------------
+int create_listeners()
+{
+    if (start_SDP_responder() != 0) return -1;
+    if (setup_TCP_network() != 0)
+    {
+        printf("TCP/IP network failed");
         return -1;
     }
+    server_flag = 1;
+    return 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// init_J1772() - Puts the pilot in its starting state and takes the first reading.
+//                This talks to the co-processor, so it runs on the main thread
+// -----------------------------------------------------------------------------
+int init_J1772()
+{
+    // Set EVSE to State A to begin with
+    if (role->is_evse())
+    {
+        role->pilot_idle();
+        sleeper.sleep(500);
+    }
 
-    // If we get here, AVLN successfully established
+    // Get initial status of J1772
+    update_J1772_status();
     return 0;
 }
 // -----------------------------------------------------------------------------
@@ -208,25 +410,52 @@ int perform_SLAC()
 
 
 // -----------------------------------------------------------------------------
-// setup_TCP_network() - This function handles creating TCP server and connecting
-//                        as client depending on device type
+// rth_startup() - Starts the startup steps. Those that don't depend on each other run at the
+//                 same time; rth_state_machine() follows their progress
 // -----------------------------------------------------------------------------
-int setup_TCP_network()
+void rth_startup()
 {
-    if (config.device_type == "EVSE")
+    step_network = startup.add_step("network", network_check);
+    step_broker  = startup.add_step("broker",  broker_check, step_network);
+    startup.add_step("handshake", rth_handshake, step_broker);
+    startup.add_step("plc", prepare_SLAC);
+    if (role->has_listeners()) startup.add_step("listeners", create_listeners);
+    startup.add_step("j1772", init_J1772, -1, -1, true);
+
+    startup.start();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// follow_startup() - Moves through the startup states as the startup steps finish
+// -----------------------------------------------------------------------------
+int follow_startup()
+{
+    // If any step failed, we can't go on
+    const char* failed = startup.failed_step();
+    if (failed)
     {
-        // Create a TCP server
-        printf("Creating SECC server on port %d\n", TCP_port);
-        Server.launch(TCP_port);
+        char log_error[64];
+        snprintf(log_error, sizeof(log_error), "Startup step '%s' failed", failed);
+        logger.log(LOG_ERR, log_error);
+        return -1;
     }
 
-    else if (config.device_type == "EV")
+    // Once everything is done, we're ready for a coupler
+    if (startup.is_ready())
     {
-        // Connect to TCP server
-        printf("\nConnecting to SECC server on port %d\n", SECC_port);
-        Client.launch(ipv6_str, SECC_port);
+        startup.report();
+        rth_state = UNPLUGGED_WAIT;
+        printf("\nWaiting for coupler to be plugged in .. \n\n");
     }
 
+    // Otherwise report how far along the critical path we are
+    else if (startup.is_done(step_broker))  rth_state = RTH_HANDSHAKE;
+    else if (startup.is_done(step_network)) rth_state = BROKER_CHECK;
+    else                                    rth_state = NETWORK_CHECK;
+
     return 0;
 }
 // -----------------------------------------------------------------------------
@@ -243,156 +472,81 @@ int rth_state_machine()
     {
         // ---------------------------------------------------------------------
         case INIT:
-            // If we get here the first time, we are initialized properly
-            rth_state = NETWORK_CHECK;
-
-            break;
-
-        // ---------------------------------------------------------------------
         case NETWORK_CHECK:
-            if (network_check() != 0)
-            {
-                return -1;
-            }
-            else
-            {
-                rth_state = BROKER_CHECK;
-                break;
-            }
-
-        // ---------------------------------------------------------------------
         case BROKER_CHECK:
-            if (broker_check() != 0)
-            {
-                return -1;
-            }
-            else
-            {
-                rth_state = RTH_HANDSHAKE;
-                break;
-            }
-
-        // ---------------------------------------------------------------------
         case RTH_HANDSHAKE:
-            if (rth_handshake() != 0)
-            {
-                return -1;
-            }
-            else
-            {
-                rth_state = UNPLUGGED_WAIT;
-                printf("\nWaiting for coupler to be plugged in .. \n\n");
-                break;
-            }
+            // The startup steps run in the background. Follow along until they're done
+            return follow_startup();
 
         // ---------------------------------------------------------------------
         case UNPLUGGED_WAIT:
-            if (server_flag == 0 && config.device_type == "EVSE")
-            {
-                if (!secc_udp.create_server(15118, "::", AF_INET6))
-                {
-                    fprintf(stderr, "Can't create listener on UDP port %i\n", 15118);
-                    exit(0);
-                }
-                if (setup_TCP_network() != 0)
-                {
-                    printf("TCP/IP network failed");
-                    return -1;
-                }
-                server_flag = 1;
-            }
-            
-            // Check if coupler is plugged in
-            if (J1772.pilot_state_name == "B1" && config.device_type == "EVSE")
-            {
-                // Turn oscillator on at 5% duty cycle
-                set_pwm(5.00);
+            // The listeners are normally created during startup
+            if (server_flag == 0 && role->has_listeners() && create_listeners() != 0) return -1;
 
-                // Wait for a bit to ensure oscillator turned on
-                sleeper.sleep(100);
-            }
+            // Still waiting on the last look at the pilot
+            if (plugged_in_timer_id >= 0) break;
 
-            // Wait for a bit till status update message received
-            sleeper.sleep(100);
-            
-            if (J1772.pilot_state_name == "B2")
-            {   
-                rth_state = PLUGGED_IN;
-                printf("Plugged in!\n");
-                break;
-            }
+            // If the coupler is plugged in, the EVSE turns its oscillator on. Give that and the
+            // status update a bit to come in, then see if we're plugged in
+            plugged_in_timer_id = reactor.add_timer(role->pilot_unplugged() + 100, check_plugged_in);
             break;
             
 
         // ---------------------------------------------------------------------
         case PLUGGED_IN:
-            // Try SLAC here
-            printf("Performing SLAC\n");
-            if (perform_SLAC() != 0)
+        {
+            // SLAC runs in the background; move on once the AVLN is formed
+            int rc = perform_SLAC();
+            if (rc < 0)
             {
                 printf("SLAC failed\n");
                 return -1;
             }
-
-            // SLAC is successful
-            else
+            if (rc == 0)
             {
                 rth_state = SDP;
                 printf("AVLN established!\n");
-                break;
             }
+            break;
+        }
         
         // ---------------------------------------------------------------------
         case SDP:
-            if (perform_SDP() != 0)
+        {
+            // SDP runs in the background; move on once it's done
+            int rc = role->perform_SDP();
+            if (rc < 0)
             {
                 printf("SDP failed\n");
                 return -1;
             }
-            else
-            {
-                rth_state = TCP_NETWORK;
-                break;
-            }
+            if (rc == 0) rth_state = TCP_NETWORK;
+            break;
+        }
         
         // ---------------------------------------------------------------------
         case TCP_NETWORK:
 
-            if (config.device_type == "EV")
+            // The EV side connects to the SECC it just found. The EVSE side's server is already up
+            if (role->start_relay() != 0)
             {
-                if (setup_TCP_network() != 0)
-                {
-                    printf("TCP/IP network failed");
-                    return -1;
-                }
-                else
-                {
-                    rth_state = REMOTE;
-                    printf("\n\033[1;33mRemote mode now enabled.\033[0m\n\n");
-                }
+                printf("TCP/IP network failed");
+                return -1;
             }
 
-            else if (config.device_type == "EVSE")
-            {
-                rth_state = REMOTE;
-                printf("\n\033[1;33mRemote mode now enabled.\033[0m\n\n");
-            }
+            rth_state = REMOTE;
+            printf("\n\033[1;33mRemote mode now enabled.\033[0m\n\n");
 
             // Set a timer for 90 seconds
-            remote_timer.start(90000);            
+            remote_timer_id = reactor.add_timer(90000, remote_timeout);
             break;
 
         // ---------------------------------------------------------------------
         case REMOTE:
 
-            // If 30 seconds have passed, exit the application
-            if (remote_timer.is_expired())
-            {
-                // Untoggle CP resistor back to 12 V
-                logger.log(LOG_ERR, "Timed out in remote mode");
-                printf("\nTimed out.\n");
-                exit_app(0);
-            }
+            // remote_timeout() ends the session when the timer runs out. We end it sooner if
+            // the EV side can't reach the SECC
+            if (role->relay_failed()) end_session("Can't connect to SECC");
             break;
 
         // ---------------------------------------------------------------------
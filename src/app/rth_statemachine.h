@@ -45,4 +45,12 @@ enum rth_handshake_t
 // This function handles all states of the RTH and dispatches appropriate functions accordingly
 int rth_state_machine();
 
+// This function ends the current session and returns to UNPLUGGED_WAIT, keeping the broker
+// connection, PLC channel and peer handshake up for the next one
+void end_session(const char* reason);
+
+// This function starts the startup steps that rth_state_machine() waits on. It initializes the
+// J1772 pilot on the calling thread before it returns
+void rth_startup();
+
 //==========================================================================================================
@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// startup.cpp - Runs the RTH startup steps as a dependency graph
+//==========================================================================================================
+
+#include <stdio.h>
+#include <thread>
+
+#include "common.h"
+#include "startup.h"
+
+
+// -----------------------------------------------------------------------------
+// CStartup() - Constructor
+// -----------------------------------------------------------------------------
+CStartup::CStartup()
+{
+    m_launch_ms = msTimer::millis();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// add_step() - Adds a step to the graph and returns its ID
+// -----------------------------------------------------------------------------
+int CStartup::add_step(const char* name, startup_fn_t fn, int dep1, int dep2, bool is_inline)
+{
+    step_t step;
+    step.name      = name;
+    step.fn        = fn;
+    step.dep1      = dep1;
+    step.dep2      = dep2;
+    step.is_inline = is_inline;
+    step.state     = WAITING;
+    step.start_ms  = 0;
+    step.end_ms    = 0;
+
+    m_steps.push_back(step);
+    return (int)m_steps.size() - 1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start() - Starts the threaded steps that are ready, then runs the inline steps
+// -----------------------------------------------------------------------------
+void CStartup::start()
+{
+    m_mtx.lock();
+    launch_ready();
+    m_mtx.unlock();
+
+    // Inline steps have no dependencies, so they're all ready now
+    for (size_t id = 0; id < m_steps.size(); ++id)
+    {
+        if (m_steps[id].is_inline) run_step(id);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// deps_met() - Returns true if every step this one depends on has succeeded
+// -----------------------------------------------------------------------------
+bool CStartup::deps_met(const step_t& step)
+{
+    if (step.dep1 >= 0 && m_steps[step.dep1].state != SUCCEEDED) return false;
+    if (step.dep2 >= 0 && m_steps[step.dep2].state != SUCCEEDED) return false;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// launch_ready() - Starts a thread for every waiting step whose dependencies are met
+// -----------------------------------------------------------------------------
+void CStartup::launch_ready()
+{
+    for (size_t id = 0; id < m_steps.size(); ++id)
+    {
+        step_t& step = m_steps[id];
+        if (step.is_inline || step.state != WAITING || !deps_met(step)) continue;
+
+        // Mark it running now, so a step finishing on another thread can't launch it twice
+        step.state = RUNNING;
+        std::thread th(launch_step, this, (int)id);
+        th.detach();
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// run_step() - Runs a single step, records how it went, and starts what it unblocks
+// -----------------------------------------------------------------------------
+void CStartup::run_step(int id)
+{
+    m_mtx.lock();
+    m_steps[id].state    = RUNNING;
+    m_steps[id].start_ms = msTimer::millis();
+    startup_fn_t fn      = m_steps[id].fn;
+    m_mtx.unlock();
+
+    int rc = fn();
+
+    m_mtx.lock();
+    m_steps[id].end_ms = msTimer::millis();
+    m_steps[id].state  = (rc == 0) ? SUCCEEDED : FAILED;
+    if (rc == 0) launch_ready();
+    m_mtx.unlock();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// is_done() - Returns true if the given step has finished successfully
+// -----------------------------------------------------------------------------
+bool CStartup::is_done(int id)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return id >= 0 && id < (int)m_steps.size() && m_steps[id].state == SUCCEEDED;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// is_ready() - Returns true once every step has succeeded
+// -----------------------------------------------------------------------------
+bool CStartup::is_ready()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (size_t id = 0; id < m_steps.size(); ++id)
+    {
+        if (m_steps[id].state != SUCCEEDED) return false;
+    }
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// failed_step() - Returns the name of the step that failed, or NULL if none have
+// -----------------------------------------------------------------------------
+const char* CStartup::failed_step()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (size_t id = 0; id < m_steps.size(); ++id)
+    {
+        if (m_steps[id].state == FAILED) return m_steps[id].name.c_str();
+    }
+    return NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// report() - Prints and logs the time to ready, and what each step contributed
+// -----------------------------------------------------------------------------
+void CStartup::report()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    // Ready is when the last step finished
+    uint64_t ready_ms = m_launch_ms;
+    for (size_t id = 0; id < m_steps.size(); ++id)
+    {
+        if (m_steps[id].end_ms > ready_ms) ready_ms = m_steps[id].end_ms;
+    }
+
+    // Build a line like "Ready in 1234 ms (network 80-210, broker 210-950, ...)" where each
+    // step shows when it started and finished, in ms since launch
+    char line[256];
+    int  len = snprintf(line, sizeof(line), "Ready in %llu ms (", (unsigned long long)(ready_ms - m_launch_ms));
+    for (size_t id = 0; id < m_steps.size() && len < (int)sizeof(line); ++id)
+    {
+        const step_t& step = m_steps[id];
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %llu-%llu", id ? ", " : "", step.name.c_str(),
+                        (unsigned long long)(step.start_ms - m_launch_ms), (unsigned long long)(step.end_ms - m_launch_ms));
+    }
+    if (len < (int)sizeof(line)) snprintf(line + len, sizeof(line) - len, ")");
+
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
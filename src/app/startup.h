@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// startup.h - Runs the RTH startup steps as a dependency graph
+//
+// Each step is a function that returns 0 on success.  A step starts as soon as every step it depends on
+// has succeeded, on a thread of its own, so steps that don't depend on each other run at the same time.
+// If a step fails, nothing that depends on it is started and the graph as a whole has failed.
+//
+// Steps marked 'inline' run on the thread that calls start(), and must not have any dependencies.  They
+// are for work that has to stay on the main thread, such as talking to the co-processor.
+//==========================================================================================================
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// A startup step. Returns 0 on success
+typedef int (*startup_fn_t)();
+
+// -----------------------------------------------------------------------------
+// CStartup - A small dependency graph of startup steps
+// -----------------------------------------------------------------------------
+class CStartup
+{
+public:
+
+    // Constructor. The time of construction is taken as the moment the application launched
+    CStartup();
+
+    // Call this to add a step, before calling start(). 'dep1' and 'dep2' are the IDs of steps
+    // that must succeed first, or -1.  Returns the ID of the new step
+    int     add_step(const char* name, startup_fn_t fn, int dep1 = -1, int dep2 = -1, bool is_inline = false);
+
+    // Call this to start every step that's ready. Inline steps have finished when this returns
+    void    start();
+
+    // Returns true if the given step has finished successfully
+    bool    is_done(int id);
+
+    // Returns true once every step has succeeded
+    bool    is_ready();
+
+    // Returns the name of the step that failed, or NULL if none have
+    const char* failed_step();
+
+    // Prints and logs the time from launch to ready, and how long each step took
+    void    report();
+
+protected:
+
+    enum step_state_t {WAITING, RUNNING, SUCCEEDED, FAILED};
+
+    struct step_t
+    {
+        std::string     name;
+        startup_fn_t    fn;
+        int             dep1, dep2;
+        bool            is_inline;
+        step_state_t    state;
+        uint64_t        start_ms, end_ms;
+    };
+
+    // Runs a single step and starts whatever it unblocks
+    void    run_step(int id);
+    static void launch_step(CStartup* p, int id) {p->run_step(id);}
+
+    // Returns true if a step's dependencies have all succeeded. Call with m_mtx held
+    bool    deps_met(const step_t& step);
+
+    // Starts a thread for every waiting step that's ready. Call with m_mtx held
+    void    launch_ready();
+
+    // The steps, in the order they were added
+    std::vector<step_t> m_steps;
+
+    // When the application launched
+    uint64_t    m_launch_ms;
+
+    // Protects m_steps once the graph is running
+    std::mutex  m_mtx;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
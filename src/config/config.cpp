@@ -66,6 +66,118 @@ void fetch_config(std::string filename)
         conf.get("evse_J1772_status_topic", &mqtt.evse_J1772_status_topic);
         conf.get("ev_state", &mqtt.ev_state);
         conf.get("evse_state", &mqtt.evse_state);
+
+        // The remaining settings are optional and keep their defaults if missing
+        conf.throw_on_fail(false);
+
+        // Get the pilot sampling rate from config file
+        config.sample_interval_ms = 50;
+        conf.set_current_section("General");
+        conf.get("sample_interval_ms", &config.sample_interval_ms);
+
+        // Get hardware settings from config file
+        config.hw_backend = "uart";
+        config.serial_port = "/dev/ttyAPP2";
+        config.sim_profile = "";
+        conf.set_current_section("Hardware");
+        conf.get("backend", &config.hw_backend);
+        conf.get("serial_port", &config.serial_port);
+        conf.get("sim_profile", &config.sim_profile);
+
+        // Get optional MQTT topics
+        mqtt.ev_control = "RTH/ev/control";
+        mqtt.evse_control = "RTH/evse/control";
+        conf.set_current_section("MQTT");
+        conf.get("ev_control", &mqtt.ev_control);
+        conf.get("evse_control", &mqtt.evse_control);
+        mqtt.ev_slac_trace = "RTH/ev/slac_trace";
+        mqtt.evse_slac_trace = "RTH/evse/slac_trace";
+        conf.get("ev_slac_trace", &mqtt.ev_slac_trace);
+        conf.get("evse_slac_trace", &mqtt.evse_slac_trace);
+        mqtt.ev_plc_link = "RTH/ev/plc_link";
+        mqtt.evse_plc_link = "RTH/evse/plc_link";
+        conf.get("ev_plc_link", &mqtt.ev_plc_link);
+        conf.get("evse_plc_link", &mqtt.evse_plc_link);
+
+        // Get pilot mirroring settings from config file
+        config.pilot_mirroring = false;
+        conf.set_current_section("Mirroring");
+        conf.get("pilot_mirroring", &config.pilot_mirroring);
+
+        // Get waveform recorder settings from config file
+        config.waveform_recorder = false;
+        config.waveform_file = "logs/RTH_waveform.bin";
+        config.waveform_capacity = 262144;
+        conf.set_current_section("Recorder");
+        conf.get("waveform_recorder", &config.waveform_recorder);
+        conf.get("waveform_file", &config.waveform_file);
+        conf.get("waveform_capacity", &config.waveform_capacity);
+
+        // Get capture settings from config file
+        config.capture = true;
+        config.capture_rotate_mb = 16;
+        config.capture_rotate_s = 600;
+        config.capture_max_disk_mb = 256;
+        config.capture_max_buffer_kb = 4096;
+        conf.set_current_section("Capture");
+        conf.get("capture", &config.capture);
+        conf.get("rotate_size_mb", &config.capture_rotate_mb);
+        conf.get("rotate_interval_s", &config.capture_rotate_s);
+        conf.get("max_disk_mb", &config.capture_max_disk_mb);
+        conf.get("max_buffer_kb", &config.capture_max_buffer_kb);
+
+        // Get J1772 status telemetry settings from config file
+        config.telemetry_deadband_V = 0.1;
+        config.telemetry_deadband_duty = 0.5;
+        config.telemetry_deadband_freq = 10;
+        config.telemetry_batch_ms = 1000;
+        config.telemetry_max_age_ms = 5000;
+        config.telemetry_max_batch = 50;
+        config.plc_link_interval_ms = 2000;
+        conf.set_current_section("Telemetry");
+        conf.get("deadband_voltage", &config.telemetry_deadband_V);
+        conf.get("deadband_duty_cycle", &config.telemetry_deadband_duty);
+        conf.get("deadband_frequency", &config.telemetry_deadband_freq);
+        conf.get("batch_interval_ms", &config.telemetry_batch_ms);
+        conf.get("max_age_ms", &config.telemetry_max_age_ms);
+        conf.get("max_batch", &config.telemetry_max_batch);
+        conf.get("plc_link_interval_ms", &config.plc_link_interval_ms);
+
+        // Get peer heartbeat settings from config file
+        config.heartbeat_interval_ms = 200;
+        config.heartbeat_timeout_ms = 700;
+        conf.set_current_section("Peer");
+        conf.get("heartbeat_interval_ms", &config.heartbeat_interval_ms);
+        conf.get("heartbeat_timeout_ms", &config.heartbeat_timeout_ms);
+
+        // Get SLAC settings from config file
+        config.slac_attn_limit = 70;
+        config.slac_timeout = 20;
+        config.slac_retries = 10;
+        conf.set_current_section("SLAC");
+        conf.get("attenuation_limit", &config.slac_attn_limit);
+        conf.get("timeout", &config.slac_timeout);
+        conf.get("retries", &config.slac_retries);
+
+        // Any of these override the same item in the evse.ini/pev.ini profile
+        static const char* slac_items[][2] =
+        {
+            {"network_membership_key", "NetworkMembershipKey"},
+            {"network_identifier",     "NetworkIdentifier"},
+            {"vehicle_identifier",     "VehicleIdentifier"},
+            {"attenuation_threshold",  "AttenuationThreshold"},
+            {"msound_pause",           "MSoundPause"},
+            {"number_of_sounds",       "NumberOfSounds"},
+            {"time_to_sound",          "TimeToSound"},
+            {"response_type",          "ResponseType"},
+        };
+        config.slac_profile.clear();
+        for (size_t i = 0; i < sizeof(slac_items) / sizeof(slac_items[0]); ++i)
+        {
+            std::string value;
+            if (conf.get(slac_items[i][0], &value))
+                config.slac_profile.push_back(std::make_pair(std::string(slac_items[i][1]), value));
+        }
     }
 
     // If any configuration setting is missing, it's fatal error
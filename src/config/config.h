@@ -20,6 +20,8 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 
 // A place to hold MQTT configuration settings extracted from the config file
 extern struct mqtt_config_t
@@ -34,6 +36,15 @@ extern struct mqtt_config_t
 
     // Global MQTT topics
     std::string ev_message, evse_message, ev_J1772_status_topic, evse_J1772_status_topic, ev_state, evse_state;
+
+    // Pilot mirroring control topics (optional)
+    std::string ev_control, evse_control;
+
+    // SLAC trace topics (optional)
+    std::string ev_slac_trace, evse_slac_trace;
+
+    // PLC link quality topics (optional)
+    std::string ev_plc_link, evse_plc_link;
 } mqtt;
 
 // A place to hold general configuration settings extracted from the config file
@@ -45,8 +56,41 @@ extern struct config_t
     // Whether the device will be emulating an EV or EVSE
     std::string device_type;
 
-    // The amount of time in ms which the program will wait between sending a message over UART and reading its response
+    // The longest time in ms which the program will wait for the response to a message sent over UART
     int response_delay_ms;
+
+    // How often in ms the pilot and prox are sampled, measured from the start of one sample to the next
+    int sample_interval_ms;
+
+    // Pilot/prox hardware: "uart" for the co-processor on 'serial_port', or "sim" for the simulator
+    std::string hw_backend, serial_port, sim_profile;
+
+    // Raw pilot/prox waveform recorder. Optional; the recorder is off unless enabled
+    bool        waveform_recorder;
+    std::string waveform_file;
+    int         waveform_capacity;
+
+    // pcapng capture of the PLC interface. Optional; see the [Capture] section of the config file
+    bool        capture;
+    int         capture_rotate_mb, capture_rotate_s, capture_max_disk_mb, capture_max_buffer_kb;
+
+    // J1772 status telemetry. Optional; see the [Telemetry] section of the config file
+    double      telemetry_deadband_V, telemetry_deadband_duty;
+    int         telemetry_deadband_freq, telemetry_batch_ms, telemetry_max_age_ms, telemetry_max_batch;
+
+    // How often the PLC modem is polled for link quality, or 0 not to poll it
+    int         plc_link_interval_ms;
+
+    // Mirror control pilot changes between the two boards. Optional; off unless enabled
+    bool        pilot_mirroring;
+
+    // Heartbeats between the two boards. Optional; see the [Peer] section of the config file
+    int         heartbeat_interval_ms, heartbeat_timeout_ms;
+
+    // SLAC. Optional; see the [SLAC] section of the config file.  'slac_profile' holds the
+    // evse.ini/pev.ini items that were set there, by their profile names
+    int         slac_attn_limit, slac_timeout, slac_retries;
+    std::vector< std::pair<std::string, std::string> > slac_profile;
 } config;
 
 // This function reads in the configuration file and saves values in memory
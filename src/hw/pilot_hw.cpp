@@ -0,0 +1,109 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// pilot_hw.cpp - Interface to the hardware that measures and drives the J1772 pilot and prox pins
+//==========================================================================================================
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "pilot_hw.h"
+
+
+// -----------------------------------------------------------------------------
+// CUartPilotHW::open() - Opens and configures the serial port
+// -----------------------------------------------------------------------------
+int CUartPilotHW::open()
+{
+    m_fd = open_and_configure_serial_port(m_serial_port.c_str());
+    if (m_fd == -1) return -1;
+
+    // Flush the uart buffer, sometimes the first read returns garbage
+    flush_read_buffer(m_fd);
+
+    return m_fd;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CUartPilotHW::close() - Closes the serial port
+// -----------------------------------------------------------------------------
+void CUartPilotHW::close()
+{
+    if (m_fd != -1) ::close(m_fd);
+    m_fd = -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CSimPilotHW::open() - Starts the simulator and opens our end of its pty
+// -----------------------------------------------------------------------------
+int CSimPilotHW::open()
+{
+    // Load the profile, if there is one
+    if (!m_profile.empty() && !m_sim.load_profile(m_profile)) return -1;
+
+    // Start the simulator
+    m_slave = m_sim.start();
+    if (m_slave.empty()) return -1;
+
+    // Open the pty just like a serial port
+    m_fd = open_and_configure_serial_port(m_slave.c_str());
+    if (m_fd == -1)
+    {
+        m_sim.stop();
+        return -1;
+    }
+
+    return m_fd;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CSimPilotHW::close() - Closes our end of the pty and stops the simulator
+// -----------------------------------------------------------------------------
+void CSimPilotHW::close()
+{
+    if (m_fd != -1) ::close(m_fd);
+    m_fd = -1;
+    m_sim.stop();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// create_pilot_hw() - Creates the backend named by 'backend'
+// -----------------------------------------------------------------------------
+CPilotHW* create_pilot_hw(const std::string& backend, const std::string& serial_port, const std::string& sim_profile)
+{
+    if (backend == "uart") return new CUartPilotHW(serial_port);
+    if (backend == "sim")  return new CSimPilotHW(sim_profile);
+
+    fprintf(stderr, "Unknown hardware backend '%s'\n", backend.c_str());
+    return NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// pilot_hw.h - Interface to the hardware that measures and drives the J1772 pilot and prox pins
+//
+// Every backend hands the application a file descriptor that speaks the EVAcharge SE co-processor
+// framing, so the J1772 code is the same whether it's talking to the real UART or to the simulator.
+//==========================================================================================================
+
+#pragma once
+
+#include <string>
+
+#include "sim_coprocessor.h"
+
+// -----------------------------------------------------------------------------
+// CPilotHW - Base class for pilot/prox hardware backends
+// -----------------------------------------------------------------------------
+class CPilotHW
+{
+public:
+
+    // Destructor
+    virtual ~CPilotHW() {}
+
+    // Call this to connect to the co-processor. Returns a file descriptor, or -1 on failure
+    virtual int         open() = 0;
+
+    // Call this to disconnect from the co-processor
+    virtual void        close() = 0;
+
+    // Returns a short description of the backend
+    virtual std::string name() = 0;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CUartPilotHW - The EVAcharge SE co-processor on a serial port
+// -----------------------------------------------------------------------------
+class CUartPilotHW : public CPilotHW
+{
+public:
+    CUartPilotHW(const std::string& serial_port) {m_serial_port = serial_port; m_fd = -1;}
+    int         open();
+    void        close();
+    std::string name() {return m_serial_port;}
+protected:
+    std::string m_serial_port;
+    int         m_fd;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CSimPilotHW - A simulated co-processor on a pseudo-terminal, driven by a profile script
+// -----------------------------------------------------------------------------
+class CSimPilotHW : public CPilotHW
+{
+public:
+    CSimPilotHW(const std::string& profile) {m_profile = profile; m_fd = -1;}
+    int         open();
+    void        close();
+    std::string name() {return "simulator (" + m_slave + ")";}
+protected:
+    std::string     m_profile, m_slave;
+    int             m_fd;
+    CSimCoprocessor m_sim;
+};
+// -----------------------------------------------------------------------------
+
+// Creates the backend named by 'backend' ("uart" or "sim"). Returns NULL if the name is unknown
+CPilotHW* create_pilot_hw(const std::string& backend, const std::string& serial_port, const std::string& sim_profile);
+
+//==========================================================================================================
@@ -0,0 +1,413 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// sim_coprocessor.cpp - A simulated EVAcharge SE pilot/prox co-processor
+//==========================================================================================================
+
+#include <fcntl.h>
+#include <fstream>
+#include <math.h>
+#include <poll.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim_coprocessor.h"
+
+// The co-processor reports voltages in counts of 29 mV
+static const double volts_per_count = 0.029;
+
+
+// -----------------------------------------------------------------------------
+// now_ms() - Returns a monotonic timestamp in milliseconds
+// -----------------------------------------------------------------------------
+static uint32_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CSimCoprocessor() - Constructor. The link starts unplugged with a static +12 V pilot
+// -----------------------------------------------------------------------------
+CSimCoprocessor::CSimCoprocessor()
+{
+    m_next_step        = 0;
+    m_profile_start_ms = 0;
+    m_ev_state         = 'A';
+    m_pwm_enabled      = true;
+    m_duty             = 100;
+    m_prox             = 1.5;
+    m_noise_mV         = 0;
+    m_master_fd        = -1;
+    m_stop             = false;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// load_profile() - Reads a profile script
+// -----------------------------------------------------------------------------
+bool CSimCoprocessor::load_profile(const std::string& filename)
+{
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        fprintf(stderr, "Can't open simulator profile %s\n", filename.c_str());
+        return false;
+    }
+
+    m_profile.clear();
+
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line))
+    {
+        ++line_no;
+
+        // Strip comments
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        // Every non-blank line starts with a time
+        std::istringstream words(line);
+        step_t step;
+        if (!(words >> step.at_ms))
+        {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            fprintf(stderr, "%s:%d: expected a time in ms\n", filename.c_str(), line_no);
+            return false;
+        }
+
+        // Followed by one or more settings
+        std::string word;
+        while (words >> word)
+        {
+            size_t equals = word.find('=');
+            step.key   = word.substr(0, equals);
+            step.value = (equals == std::string::npos) ? "" : word.substr(equals + 1);
+
+            if (step.key != "ev" && step.key != "duty" && step.key != "prox" && step.key != "noise" && step.key != "loop")
+            {
+                fprintf(stderr, "%s:%d: unknown setting '%s'\n", filename.c_str(), line_no, step.key.c_str());
+                return false;
+            }
+
+            m_profile.push_back(step);
+        }
+    }
+
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start() - Creates the pty and starts the simulator thread
+// -----------------------------------------------------------------------------
+std::string CSimCoprocessor::start()
+{
+    // Create the master side of a pty
+    m_master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (m_master_fd < 0 || grantpt(m_master_fd) != 0 || unlockpt(m_master_fd) != 0)
+    {
+        perror("Can't create simulator pty");
+        if (m_master_fd >= 0) ::close(m_master_fd);
+        m_master_fd = -1;
+        return "";
+    }
+
+    // Find the name of the slave side
+    std::string slave = ptsname(m_master_fd);
+
+    // The frames are binary, so the slave side must not translate anything. Holding it open
+    // while we configure it also keeps the pty from reporting a hangup before the app opens it
+    int fd = ::open(slave.c_str(), O_RDWR | O_NOCTTY);
+    if (fd >= 0)
+    {
+        struct termios tty;
+        tcgetattr(fd, &tty);
+        cfmakeraw(&tty);
+        tcsetattr(fd, TCSANOW, &tty);
+        ::close(fd);
+    }
+
+    // Start the profile from the beginning
+    m_next_step        = 0;
+    m_profile_start_ms = now_ms();
+    run_profile(0);
+
+    // And start answering commands
+    m_stop = false;
+    std::thread th(launch_task, this);
+    th.detach();
+
+    return slave;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// stop() - Asks the simulator thread to exit
+// -----------------------------------------------------------------------------
+void CSimCoprocessor::stop()
+{
+    m_stop = true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// task() - Reads command frames from the pty and answers them
+// -----------------------------------------------------------------------------
+void CSimCoprocessor::task()
+{
+    std::vector<unsigned char> incoming;
+
+    while (!m_stop)
+    {
+        // Wait up to 10 ms for a command, so the profile keeps running while the app is quiet
+        struct pollfd pfd;
+        pfd.fd     = m_master_fd;
+        pfd.events = POLLIN;
+        int rc = poll(&pfd, 1, 10);
+
+        // Apply any profile settings that have come due
+        run_profile(now_ms() - m_profile_start_ms);
+
+        // The slave side isn't open (yet, or any more); don't spin on the hangup
+        if (rc > 0 && (pfd.revents & POLLHUP) && !(pfd.revents & POLLIN))
+        {
+            usleep(10000);
+            continue;
+        }
+
+        if (rc <= 0) continue;
+
+        // Fetch whatever has arrived
+        unsigned char buffer[256];
+        ssize_t count = read(m_master_fd, buffer, sizeof(buffer));
+        if (count <= 0) continue;
+        incoming.insert(incoming.end(), buffer, buffer + count);
+
+        // Pull out every complete frame
+        while (true)
+        {
+            // Discard anything before the start byte
+            size_t start = 0;
+            while (start < incoming.size() && incoming[start] != 0x02) ++start;
+            incoming.erase(incoming.begin(), incoming.begin() + start);
+
+            // Wait until the whole frame has arrived
+            if (incoming.size() < 2) break;
+            size_t length = incoming[1] + 2;
+            if (incoming.size() < length) break;
+
+            // Handle it
+            std::vector<unsigned char> frame(incoming.begin(), incoming.begin() + length);
+            incoming.erase(incoming.begin(), incoming.begin() + length);
+            handle_frame(frame);
+        }
+    }
+
+    ::close(m_master_fd);
+    m_master_fd = -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// run_profile() - Applies any profile settings that have come due
+// -----------------------------------------------------------------------------
+void CSimCoprocessor::run_profile(uint32_t elapsed_ms)
+{
+    while (m_next_step < m_profile.size() && m_profile[m_next_step].at_ms <= elapsed_ms)
+    {
+        const step_t& step = m_profile[m_next_step++];
+
+        // "loop" starts the profile over from here
+        if (step.key == "loop")
+        {
+            m_next_step        = 0;
+            m_profile_start_ms = now_ms();
+            return;
+        }
+
+        apply(step.key, step.value);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// apply() - Applies a single setting to the model
+// -----------------------------------------------------------------------------
+void CSimCoprocessor::apply(const std::string& key, const std::string& value)
+{
+    if      (key == "ev" && !value.empty()) m_ev_state = value[0];
+    else if (key == "duty")                 m_duty     = strtod(value.c_str(), NULL);
+    else if (key == "prox")                 m_prox     = strtod(value.c_str(), NULL);
+    else if (key == "noise")                m_noise_mV = strtod(value.c_str(), NULL);
+
+    // A duty cycle of zero means the pilot is off, anything else turns it on
+    if (key == "duty") m_pwm_enabled = (m_duty > 0);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// counts() - Converts a voltage to co-processor counts, adding noise
+// -----------------------------------------------------------------------------
+int CSimCoprocessor::counts(double volts)
+{
+    if (m_noise_mV > 0) volts += (rand() / (double)RAND_MAX * 2 - 1) * m_noise_mV / 1000.0;
+    return (int)floor(volts / volts_per_count + 0.5);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// respond() - Sends a response frame
+// -----------------------------------------------------------------------------
+void CSimCoprocessor::respond(unsigned char cmd, const unsigned char* data, int length)
+{
+    unsigned char frame[32];
+    frame[0] = 0x02;
+    frame[1] = length + 3;
+    frame[2] = 0x00;
+    frame[3] = cmd;
+    for (int i = 0; i < length; ++i) frame[4 + i] = data[i];
+
+    // The BCC is the XOR of every byte before it
+    unsigned char bcc = 0;
+    for (int i = 0; i < length + 4; ++i) bcc ^= frame[i];
+    frame[length + 4] = bcc;
+
+    if (write(m_master_fd, frame, length + 5) < 0) perror("Simulator write");
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// handle_frame() - Handles one command frame
+// -----------------------------------------------------------------------------
+void CSimCoprocessor::handle_frame(const std::vector<unsigned char>& frame)
+{
+    // Drop any frame that's too short or fails its BCC
+    if (frame.size() < 5) return;
+    unsigned char bcc = 0;
+    for (size_t i = 0; i < frame.size(); ++i) bcc ^= frame[i];
+    if (bcc != 0) return;
+
+    unsigned char cmd = frame[3];
+    const unsigned char* data = &frame[4];
+    int length = frame.size() - 5;
+
+    // The oscillator is only running if it's enabled at less than 100 %
+    bool oscillating = m_pwm_enabled && m_duty > 0 && m_duty < 99;
+
+    unsigned char reply[8];
+    switch (cmd)
+    {
+        // Pilot voltage: high and low levels
+        case 0x14:
+        {
+            double high = 0, low = 0;
+            if (m_pwm_enabled)
+            {
+                switch (m_ev_state)
+                {
+                    case 'A': high = 12; break;
+                    case 'B': high = 9;  break;
+                    case 'C': high = 6;  break;
+                    case 'D': high = 3;  break;
+                    default:  high = 0;  break;
+                }
+                if (oscillating && m_ev_state != 'E') low = -12;
+            }
+
+            int hi = counts(high), lo = counts(low);
+            reply[0] = hi & 0xFF; reply[1] = (hi >> 8) & 0xFF;
+            reply[2] = lo & 0xFF; reply[3] = (lo >> 8) & 0xFF;
+            respond(0x94, reply, 4);
+            break;
+        }
+
+        // Prox voltage
+        case 0x52:
+        {
+            int prox = counts(m_prox);
+            reply[0] = prox & 0xFF; reply[1] = (prox >> 8) & 0xFF;
+            respond(0xD2, reply, 2);
+            break;
+        }
+
+        // PWM frequency and duty cycle (x10)
+        case 0x10:
+        {
+            int freq = oscillating ? 1000 : 0;
+            int duty = m_pwm_enabled ? (oscillating ? (int)floor(m_duty * 10 + 0.5) : 1000) : 0;
+            reply[0] = freq & 0xFF; reply[1] = (freq >> 8) & 0xFF;
+            reply[2] = duty & 0xFF; reply[3] = (duty >> 8) & 0xFF;
+            respond(0x90, reply, 4);
+            break;
+        }
+
+        // Set PWM frequency and duty cycle (x10)
+        case 0x11:
+            if (length >= 4) m_duty = ((data[3] << 8) | data[2]) / 10.0;
+            respond(0x91, NULL, 0);
+            break;
+
+        // Enable or disable the pilot
+        case 0x12:
+            if (length >= 1) m_pwm_enabled = (data[0] != 0);
+            respond(0x92, NULL, 0);
+            break;
+
+        // EVCC pilot state
+        case 0x15:
+            if (length >= 1) m_ev_state = (data[0] == 0x00) ? 'A' : (data[0] == 0x01) ? 'B' : 'C';
+            respond(0x95, NULL, 0);
+            break;
+
+        // Anything else (e.g. the prox resistor commands) is simply acknowledged
+        default:
+            respond(cmd | 0x80, NULL, 0);
+            break;
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// sim_coprocessor.h - A simulated EVAcharge SE pilot/prox co-processor
+//
+// The simulator sits on the master side of a pseudo-terminal and answers the same framed commands the
+// real co-processor does (0x02, length, 0x00, command, data..., BCC), so the application talks to it
+// through the slave side exactly as it would talk to /dev/ttyAPP2.
+//
+// It models one J1772 link: the EV's pilot state (A-E), whether the pilot oscillator is enabled, its
+// duty cycle, and the prox voltage.  The application changes the model with the same commands it sends
+// to real hardware (set_pwm, control_pwm, set_ev_pilot_state), and a profile script changes it over time
+// to stand in for the device under test.  A profile is a text file of lines like:
+//
+//      # time_ms   settings
+//      0           ev=A duty=100 prox=1.5
+//      3000        ev=B
+//      4000        duty=5
+//      6000        ev=C noise=40
+//      30000       loop
+//
+//      ev=<A|B|C|D|E>   Pilot state the EV presents
+//      duty=<percent>   Oscillator duty cycle. 100 is a static +12 V, 0 turns the pilot off
+//      prox=<volts>     Prox pin voltage
+//      noise=<mV>       Peak random noise added to every voltage reading
+//      loop             Start the profile over from time 0
+//==========================================================================================================
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// CSimCoprocessor - Answers co-processor commands on the master side of a pty
+// -----------------------------------------------------------------------------
+class CSimCoprocessor
+{
+public:
+
+    // Constructor & destructor
+    CSimCoprocessor();
+    ~CSimCoprocessor() {stop();}
+
+    // Call this to load a profile script. Returns false if the file can't be read or has errors
+    bool    load_profile(const std::string& filename);
+
+    // Call this to create the pty and start answering commands. Returns the path of the slave
+    // side for the application to open, or an empty string on failure
+    std::string start();
+
+    // Call this to stop the simulator. The simulator thread closes the pty on its way out
+    void    stop();
+
+protected:
+
+    // A single setting from the profile script
+    struct step_t
+    {
+        uint32_t    at_ms;          // When the setting takes effect, relative to the start of the profile
+        std::string key, value;     // e.g. "ev" and "C"
+    };
+
+    // This is the simulator thread
+    void    task();
+    static void launch_task(CSimCoprocessor* p) {p->task();}
+
+    // Applies any profile settings that have come due
+    void    run_profile(uint32_t elapsed_ms);
+
+    // Applies a single setting to the model
+    void    apply(const std::string& key, const std::string& value);
+
+    // Handles one complete command frame and sends the response
+    void    handle_frame(const std::vector<unsigned char>& frame);
+
+    // Sends a response frame with the given command byte and data
+    void    respond(unsigned char cmd, const unsigned char* data, int length);
+
+    // Returns a voltage reading in co-processor counts, with noise
+    int     counts(double volts);
+
+    // The profile and where we are in it
+    std::vector<step_t> m_profile;
+    size_t      m_next_step;
+    uint32_t    m_profile_start_ms;
+
+    // The model of the J1772 link
+    char        m_ev_state;
+    bool        m_pwm_enabled;
+    double      m_duty;
+    double      m_prox;
+    double      m_noise_mV;
+
+    // The master side of the pty
+    int         m_master_fd;
+
+    // Set to ask the simulator thread to exit
+    volatile bool m_stop;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
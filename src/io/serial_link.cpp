@@ -0,0 +1,261 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// serial_link.cpp - Request/response exchanges with the pilot/prox co-processor, driven by the reactor
+//==========================================================================================================
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+
+#include "common.h"
+#include "serial_link.h"
+
+// -----------------------------------------------------------------------------
+// CSerialLink() - Constructor
+// -----------------------------------------------------------------------------
+CSerialLink::CSerialLink()
+{
+    m_fd             = -1;
+    m_timeout_ms     = 0;
+    m_expect         = 0;
+    m_cb             = NULL;
+    m_ctx            = NULL;
+    m_timer_id       = -1;
+    m_in_command     = false;
+    m_command_expect = 0;
+    m_command_done   = false;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start() - Starts watching the UART for responses
+// -----------------------------------------------------------------------------
+bool CSerialLink::start(int fd, int timeout_ms)
+{
+    if (!reactor.add_fd(fd, EPOLLIN, on_readable, this)) return false;
+    m_fd         = fd;
+    m_timeout_ms = timeout_ms;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// stop() - Stops watching the UART. An outstanding request is dropped without its callback
+// -----------------------------------------------------------------------------
+void CSerialLink::stop()
+{
+    if (m_fd < 0) return;
+    reactor.remove_fd(m_fd);
+    reactor.cancel_timer(m_timer_id);
+    m_timer_id = -1;
+    m_cb       = NULL;
+    m_fd       = -1;
+    m_deferred.clear();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// request() - Sends a frame. 'cb' is called with the response when it arrives
+// -----------------------------------------------------------------------------
+bool CSerialLink::request(const std::vector<unsigned char>& frame, serial_reply_cb_t cb, void* ctx)
+{
+    if (m_fd < 0 || m_cb || frame.size() < 4) return false;
+
+    if (write_to_serial(m_fd, frame) < 0) return false;
+
+    // Remember what we're waiting for, and give up on it if it takes too long
+    m_expect   = frame[3] | 0x80;
+    m_cb       = cb;
+    m_ctx      = ctx;
+    m_timer_id = reactor.add_timer(m_timeout_ms, on_timeout, this);
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// command() - Sends a frame and waits for its response
+// -----------------------------------------------------------------------------
+bool CSerialLink::command(const std::vector<unsigned char>& frame)
+{
+    if (m_fd < 0 || frame.size() < 4) return false;
+    m_in_command = true;
+
+    // The co-processor takes one frame at a time, so let an outstanding request's response
+    // come in first. read_frames() holds on to it for the reactor to hand over later
+    uint64_t deadline = msTimer::millis() + m_timeout_ms;
+    while (m_cb && m_deferred.empty() && wait_readable(deadline)) read_frames();
+
+    // Now send ours, and wait for the co-processor to answer it
+    m_command_expect = frame[3] | 0x80;
+    m_command_done   = false;
+    if (write_to_serial(m_fd, frame) == 0)
+    {
+        deadline = msTimer::millis() + m_timeout_ms;
+        while (!m_command_done && wait_readable(deadline)) read_frames();
+    }
+
+    bool is_done = m_command_done;
+    m_command_expect = 0;
+    m_in_command     = false;
+    return is_done;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_readable() - Called by the reactor when the UART has data
+// -----------------------------------------------------------------------------
+void CSerialLink::on_readable(int, uint32_t events, void* ctx)
+{
+    CSerialLink* p = (CSerialLink*)ctx;
+
+    if (events & EPOLLIN)
+    {
+        p->read_frames();
+        return;
+    }
+
+    // The UART has gone away (the simulator's pty hangs up when it stops). Stop watching it
+    // rather than being called for the hangup over and over
+    logger.log(LOG_WARNING, "Lost the co-processor's UART");
+    p->stop();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_timeout() - Called by the reactor when a request has gone unanswered for too long
+// -----------------------------------------------------------------------------
+void CSerialLink::on_timeout(void* ctx)
+{
+    CSerialLink* p = (CSerialLink*)ctx;
+    p->m_timer_id = -1;
+    p->complete(NULL);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_deferred() - Called by the reactor to hand over a response that command() read
+// -----------------------------------------------------------------------------
+void CSerialLink::on_deferred(void* ctx)
+{
+    CSerialLink* p = (CSerialLink*)ctx;
+    p->m_timer_id = -1;
+
+    std::vector<unsigned char> reply;
+    reply.swap(p->m_deferred);
+    p->complete(&reply);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// read_frames() - Reads what the UART has and matches up the frames in it
+// -----------------------------------------------------------------------------
+void CSerialLink::read_frames()
+{
+    std::vector<std::vector<unsigned char> > messages;
+    read_serial_data(m_fd, messages);
+
+    for (size_t i = 0; i < messages.size(); ++i)
+    {
+        const std::vector<unsigned char>& msg = messages[i];
+        if (msg.size() < 4) continue;
+
+        // The response command() is waiting for
+        if (m_command_expect && msg[3] == m_command_expect)
+        {
+            m_command_done = true;
+        }
+
+        // The response to the outstanding request. If command() is waiting, the request's
+        // callback might do things command()'s caller isn't ready for, so the reactor hands
+        // it over once command() has returned
+        else if (m_cb && m_deferred.empty() && msg[3] == m_expect)
+        {
+            if (m_in_command)
+            {
+                m_deferred = msg;
+                reactor.cancel_timer(m_timer_id);
+                m_timer_id = reactor.add_timer(0, on_deferred, this);
+            }
+            else complete(&msg);
+        }
+
+        // Anything else is a late response to a request we've already given up on
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// wait_readable() - Waits for the UART to have data, until 'deadline_ms'
+// -----------------------------------------------------------------------------
+bool CSerialLink::wait_readable(uint64_t deadline_ms)
+{
+    while (true)
+    {
+        uint64_t now = msTimer::millis();
+        if (now >= deadline_ms) return false;
+
+        struct pollfd pfd;
+        pfd.fd      = m_fd;
+        pfd.events  = POLLIN;
+        pfd.revents = 0;
+        int rc = poll(&pfd, 1, (int)(deadline_ms - now));
+
+        if (rc > 0) return (pfd.revents & POLLIN) != 0;
+        if (rc == 0 || errno != EINTR) return false;
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// complete() - Finishes the outstanding request
+// -----------------------------------------------------------------------------
+void CSerialLink::complete(const std::vector<unsigned char>* reply)
+{
+    if (!m_cb) return;
+
+    reactor.cancel_timer(m_timer_id);
+    m_timer_id = -1;
+
+    // Clear the request before calling back, so the callback can send the next one
+    serial_reply_cb_t cb  = m_cb;
+    void*             ctx = m_ctx;
+    m_cb = NULL;
+    cb(reply, ctx);
+}
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
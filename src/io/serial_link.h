@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// serial_link.h - Request/response exchanges with the pilot/prox co-processor, driven by the reactor
+//
+// The co-processor only speaks when it's spoken to: every frame we send gets exactly one response, whose
+// command byte is ours with the top bit set.  We keep at most one request outstanding at a time.
+//
+// The UART is registered with the reactor, so a response is handled the moment it arrives instead of
+// after a fixed delay.  There are two ways to talk to the co-processor:
+//
+//      request()   Returns right away. The callback runs on the main thread with the response, or with
+//                  NULL if there's no response within the timeout.  The pilot sampler uses this.
+//      command()   Waits for its own response, up to the timeout.  The PWM and pilot state setters use
+//                  this, so their callers can count on the change having been made when it returns.
+//==========================================================================================================
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Called with the response to a request(), or with NULL if it timed out
+typedef void (*serial_reply_cb_t)(const std::vector<unsigned char>* reply, void* ctx);
+
+// -----------------------------------------------------------------------------
+// CSerialLink - Sends frames to the co-processor and matches up its responses
+// -----------------------------------------------------------------------------
+class CSerialLink
+{
+public:
+
+    // Constructor
+    CSerialLink();
+
+    // Call this once the UART is open and the reactor has been initialized
+    //   fd         = The UART
+    //   timeout_ms = How long we wait for a response before giving up on it
+    bool    start(int fd, int timeout_ms);
+
+    // Call this before closing the UART
+    void    stop();
+
+    // Sends 'frame' and has 'cb' called with its response. Returns false if we're not started or
+    // another request is still outstanding
+    bool    request(const std::vector<unsigned char>& frame, serial_reply_cb_t cb, void* ctx = NULL);
+
+    // Sends 'frame' and waits for its response. Returns true if the co-processor answered
+    bool    command(const std::vector<unsigned char>& frame);
+
+protected:
+
+    // The reactor calls these when the UART has data, and when a request has timed out
+    static void on_readable(int fd, uint32_t events, void* ctx);
+    static void on_timeout(void* ctx);
+
+    // The reactor calls this to hand over a response that command() read on a request's behalf
+    static void on_deferred(void* ctx);
+
+    // Reads what the UART has, and matches each complete frame against what we're waiting for
+    void    read_frames();
+
+    // Waits until the UART has data or the monotonic clock reaches 'deadline_ms'. Returns false on timeout
+    bool    wait_readable(uint64_t deadline_ms);
+
+    // Finishes the outstanding request with its response, or with NULL if it timed out
+    void    complete(const std::vector<unsigned char>* reply);
+
+    // The UART, and how long we wait for a response
+    int     m_fd, m_timeout_ms;
+
+    // The outstanding request: the response we expect, who to tell, and its timeout timer
+    unsigned char       m_expect;
+    serial_reply_cb_t   m_cb;
+    void*               m_ctx;
+    int                 m_timer_id;
+
+    // True while we're inside command(), the response it's waiting for (or 0), and whether it's arrived
+    bool                m_in_command;
+    unsigned char       m_command_expect;
+    bool                m_command_done;
+
+    // A request's response that arrived while command() was waiting
+    std::vector<unsigned char> m_deferred;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
@@ -20,31 +20,30 @@
 #include <cstring>
 #include <iostream>
 #include <stdio.h>
+#include <time.h>
 
 #include "json.h"
 #include "J1772.h"
-
-// Create JSON object for the structs we care about
-Json::Value J1772_status;
+#include "schema.h"
 
 // Variable to hold the JSON data represented in strings
 std::string J1772_status_str;
 
+// The J1772 status message is formatted into this buffer, so building it never allocates
+static char J1772_status_buf[256];
+
 // -----------------------------------------------------------------------------
 // init_json() - Initialize all JSON documents and add default key-value pairs
 // -----------------------------------------------------------------------------
 void init_json()
 {    
-    // Initialize the JSON object
-    J1772_status.clear();  // Clear in case it's reused
-
-    // Add member variables with default values to the JSON object
-    J1772_status["Vpilot"] = 0;
-    J1772_status["Vpilot_min"] = 0;
-    J1772_status["Vprox"] = 0;
-    J1772_status["pilot_duty_cycle"] = 0;
-    J1772_status["pilot_freq"] = 0;
-    J1772_status["pilot_state_name"] = "A1"; 
+    // Start with every value zeroed and the pilot in state A1
+    J1772_t defaults = J1772_t();
+    defaults.pilot_state_name = "A1";
+
+    // Build the default status message
+    int length = schema_to_json(defaults, J1772_status_buf, sizeof(J1772_status_buf));
+    if (length > 0) J1772_status_str.assign(J1772_status_buf, length);
 }
 // -----------------------------------------------------------------------------
 
@@ -67,16 +66,16 @@ std::string json_to_string(const Json::Value& json_obj)
 // -----------------------------------------------------------------------------
 void update_J1772_status()
 {
-    // Update the JSON object with data from the J1772 struct
-    J1772_status["Vpilot"] = J1772.Vpilot;
-    J1772_status["Vpilot_min"] = J1772.Vpilot_min;
-    J1772_status["Vprox"] = J1772.Vprox;
-    J1772_status["pilot_duty_cycle"] = J1772.pilot_duty_cycle;
-    J1772_status["pilot_freq"] = J1772.pilot_freq;
-    J1772_status["pilot_state_name"] = J1772.pilot_state_name;
-
-    // Convert the JSON object to string
-    J1772_status_str = json_to_string(J1772_status);
+    // Format the J1772 struct straight into our buffer
+    int length = schema_to_json(J1772, J1772_status_buf, sizeof(J1772_status_buf));
+    if (length < 0)
+    {
+        printf("Error: J1772 status doesn't fit in %d bytes\n", (int)sizeof(J1772_status_buf));
+        return;
+    }
+
+    // J1772_status_str keeps its capacity, so after the first call this doesn't allocate either
+    J1772_status_str.assign(J1772_status_buf, length);
 }
 // -----------------------------------------------------------------------------
 
@@ -86,50 +85,17 @@ void update_J1772_status()
 // -----------------------------------------------------------------------------
 int parse_J1772_status(const std::string& J1772_status_msg)
 {
-    Json::Reader reader;
-
-    // Parse the command and exit if there's an error in parsing
-    if(!reader.parse(J1772_status_msg, J1772_status))
+    // Parse and validate the whole message in one pass; J1772 is only updated if it's all good
+    const char* bad_field;
+    if (schema_from_json(J1772_status_msg.c_str(), J1772, &bad_field) != 0)
     {
-        printf("Error: Failed to parse JSON\n");
+        if (bad_field)
+            printf("Error: Missing or invalid %s\n", bad_field);
+        else
+            printf("Error: Failed to parse JSON\n");
         return -1;
     }
 
-    // Helper macros for parsing numeric fields
-    #define PARSE_DOUBLE_FIELD(jsonKey, structField)                      \
-        if (J1772_status.isMember(jsonKey) && J1772_status[jsonKey].isNumeric()) \
-            J1772.structField = J1772_status[jsonKey].asDouble();          \
-        else { printf("Error: Missing or invalid %s\n", jsonKey); return -1; }
-
-    // Helper macro for parsing integer fields
-    #define PARSE_INT_FIELD(jsonKey, structField)                          \
-    if (J1772_status.isMember(jsonKey) && J1772_status[jsonKey].isInt()) \
-        J1772.structField = J1772_status[jsonKey].asInt();             \
-    else { printf("Error: Missing or invalid %s\n", jsonKey); return -1; }
-
-    // Helper macro for parsing string fields
-    #define PARSE_STRING_FIELD(jsonKey, structField)                      \
-        if (J1772_status.isMember(jsonKey) && J1772_status[jsonKey].isString()) \
-            J1772.structField = J1772_status[jsonKey].asString();         \
-        else { printf("Error: Missing or invalid %s\n", jsonKey); return -1; }
-
-    // Helper macro for parsing boolean fields
-    #define PARSE_BOOL_FIELD(jsonKey, structField)                        \
-        if (J1772_status.isMember(jsonKey) && J1772_status[jsonKey].isBool()) \
-            J1772.structField = J1772_status[jsonKey].asBool();           \
-        else { printf("Error: Missing or invalid %s\n", jsonKey); return -1; }
-
-    // Update the J1772 struct values appropriately
-    PARSE_DOUBLE_FIELD("Vpilot", Vpilot);
-    PARSE_DOUBLE_FIELD("Vpilot_min", Vpilot_min);
-    PARSE_DOUBLE_FIELD("Vprox", Vprox);
-    PARSE_DOUBLE_FIELD("pilot_duty_cycle", pilot_duty_cycle);
-
-    // Parse integer fields
-    PARSE_INT_FIELD("pilot_freq", pilot_freq);
-
-    PARSE_STRING_FIELD("pilot_state_name", pilot_state_name);
-
     // Set the pilot_state variable based on the pilot_state_name
     if (J1772.pilot_state_name == "A1") {
         J1772.pilot_state = A1;
@@ -162,4 +128,128 @@ int parse_J1772_status(const std::string& J1772_status_msg)
 // -----------------------------------------------------------------------------
 
 
+// -----------------------------------------------------------------------------
+// elapsed_ns() - Returns the nanoseconds elapsed since 'start'
+// -----------------------------------------------------------------------------
+static double elapsed_ns(const struct timespec& start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1e9 + (now.tv_nsec - start.tv_nsec);
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// benchmark_J1772_codec() - Times the jsoncpp path against the schema codecs and prints
+//                           the cost per message of each
+// -----------------------------------------------------------------------------
+void benchmark_J1772_codec(int iterations)
+{
+    if (iterations <= 0) iterations = 1;
+
+    // A representative sample
+    J1772_t sample = J1772_t();
+    sample.Vpilot           = 8.932;
+    sample.Vpilot_min       = -11.861;
+    sample.Vprox            = 1.521;
+    sample.pilot_duty_cycle = 5.0;
+    sample.pilot_freq       = 1000;
+    sample.pilot_state_name = "B2";
+
+    // Keeps the compiler from optimizing the work away
+    volatile size_t sink = 0;
+
+    struct timespec start;
+    char text[256];
+    uint8_t binary[128];
+
+    // Encode with jsoncpp, the way update_J1772_status() used to
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    std::string jsoncpp_text;
+    for (int i = 0; i < iterations; ++i)
+    {
+        Json::Value value;
+        value["Vpilot"]           = sample.Vpilot;
+        value["Vpilot_min"]       = sample.Vpilot_min;
+        value["Vprox"]            = sample.Vprox;
+        value["pilot_duty_cycle"] = sample.pilot_duty_cycle;
+        value["pilot_freq"]       = sample.pilot_freq;
+        value["pilot_state_name"] = sample.pilot_state_name;
+        jsoncpp_text = json_to_string(value);
+        sink += jsoncpp_text.size();
+    }
+    double jsoncpp_write = elapsed_ns(start) / iterations;
+
+    // Decode with jsoncpp, the way parse_J1772_status() used to
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; ++i)
+    {
+        Json::Reader reader;
+        Json::Value  value;
+        J1772_t      result;
+        reader.parse(jsoncpp_text, value);
+        result.Vpilot           = value["Vpilot"].asDouble();
+        result.Vpilot_min       = value["Vpilot_min"].asDouble();
+        result.Vprox            = value["Vprox"].asDouble();
+        result.pilot_duty_cycle = value["pilot_duty_cycle"].asDouble();
+        result.pilot_freq       = value["pilot_freq"].asInt();
+        result.pilot_state_name = value["pilot_state_name"].asString();
+        sink += result.pilot_freq;
+    }
+    double jsoncpp_read = elapsed_ns(start) / iterations;
+
+    // Encode with the schema JSON writer
+    int text_length = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; ++i)
+    {
+        text_length = schema_to_json(sample, text, sizeof(text));
+        sink += text_length;
+    }
+    double schema_write = elapsed_ns(start) / iterations;
+
+    // Decode with the schema JSON parser
+    J1772_t result = J1772_t();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; ++i)
+    {
+        sink += schema_from_json(text, result);
+    }
+    double schema_read = elapsed_ns(start) / iterations;
+
+    // Encode with the binary codec
+    int binary_length = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; ++i)
+    {
+        binary_length = schema_to_binary(sample, binary, sizeof(binary));
+        sink += binary_length;
+    }
+    double binary_write = elapsed_ns(start) / iterations;
+
+    // Decode with the binary codec
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; ++i)
+    {
+        sink += schema_from_binary(binary, binary_length, result);
+    }
+    double binary_read = elapsed_ns(start) / iterations;
+
+    // Report the results
+    printf("J1772 status codec, %d iterations\n", iterations);
+    printf("  %-14s %6s %12s %12s\n", "codec", "bytes", "encode ns", "decode ns");
+    printf("  %-14s %6d %12.0f %12.0f\n", "jsoncpp", (int)jsoncpp_text.size(), jsoncpp_write, jsoncpp_read);
+    printf("  %-14s %6d %12.0f %12.0f\n", "schema json", text_length, schema_write, schema_read);
+    printf("  %-14s %6d %12.0f %12.0f\n", "schema binary", binary_length, binary_write, binary_read);
+
+    // Make sure the schema codecs agree with each other
+    if (result.Vpilot != sample.Vpilot || result.pilot_freq != sample.pilot_freq || result.pilot_state_name != sample.pilot_state_name)
+        printf("Error: binary round trip mismatch\n");
+    if (schema_from_json(jsoncpp_text.c_str(), result) != 0 || result.Vprox != sample.Vprox)
+        printf("Error: schema parser rejected jsoncpp output\n");
+}
+// -----------------------------------------------------------------------------
+
+
 //==========================================================================================================
@@ -29,9 +29,15 @@ extern void init_json();
 // Function to update J1772 status member values
 extern void update_J1772_status();
 
+// Converts a JSON object to a compact string
+extern std::string json_to_string(const Json::Value& json_obj);
+
 // Parses J1772 status into a struct
 extern int parse_J1772_status(const std::string& J1772_status);
 
+// Times the jsoncpp path against the schema codecs and prints the results
+extern void benchmark_J1772_codec(int iterations);
+
 // Variable to hold JSON data represented in strings
 extern std::string J1772_status_str;
 
@@ -0,0 +1,494 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// schema.cpp - The non-template parts of the schema codecs
+//==========================================================================================================
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "schema.h"
+
+
+// -----------------------------------------------------------------------------
+// CJsonWriter() - Constructor
+// -----------------------------------------------------------------------------
+CJsonWriter::CJsonWriter(char* buf, size_t size)
+{
+    m_buf      = buf;
+    m_size     = size;
+    m_length   = 0;
+    m_first    = true;
+    m_overflow = (size == 0);
+
+    // Make sure the buffer is always a valid C string
+    if (size) m_buf[0] = 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// put() - Appends characters to the buffer, leaving room for the terminating null
+// -----------------------------------------------------------------------------
+void CJsonWriter::put(const char* text, size_t length)
+{
+    if (m_overflow || m_length + length >= m_size)
+    {
+        m_overflow = true;
+        return;
+    }
+
+    memcpy(m_buf + m_length, text, length);
+    m_length += length;
+    m_buf[m_length] = 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// put_key() - Appends the separator (if needed), the key and a colon
+// -----------------------------------------------------------------------------
+void CJsonWriter::put_key(const char* key)
+{
+    if (!m_first) put(',');
+    m_first = false;
+    put_string(key, strlen(key));
+    put(':');
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// put_string() - Appends a quoted string, escaping anything JSON requires us to
+// -----------------------------------------------------------------------------
+void CJsonWriter::put_string(const char* text, size_t length)
+{
+    put('"');
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        unsigned char c = text[i];
+
+        if (c == '"' || c == '\\')
+        {
+            put('\\');
+            put(c);
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            put(escape, 6);
+        }
+        else put(c);
+    }
+
+    put('"');
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// begin() / end() - Open and close the object
+// -----------------------------------------------------------------------------
+void CJsonWriter::begin()
+{
+    put('{');
+}
+
+int CJsonWriter::end()
+{
+    put('}');
+    return m_overflow ? -1 : (int)m_length;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// field() - Writes a key-value pair
+// -----------------------------------------------------------------------------
+bool CJsonWriter::field(const char* key, double value)
+{
+    put_key(key);
+
+    // JSON has no way to represent NaN or infinity
+    if (!isfinite(value))
+    {
+        put("null", 4);
+        return !m_overflow;
+    }
+
+    // 17 significant digits is enough for the value to survive the round trip
+    char number[32];
+    int length = snprintf(number, sizeof(number), "%.17g", value);
+    put(number, length);
+    return !m_overflow;
+}
+
+bool CJsonWriter::field(const char* key, int value)
+{
+    put_key(key);
+    char number[16];
+    int length = snprintf(number, sizeof(number), "%d", value);
+    put(number, length);
+    return !m_overflow;
+}
+
+bool CJsonWriter::field(const char* key, const std::string& value)
+{
+    put_key(key);
+    put_string(value.c_str(), value.size());
+    return !m_overflow;
+}
+
+bool CJsonWriter::field(const char* key, const char* value)
+{
+    put_key(key);
+    put_string(value, strlen(value));
+    return !m_overflow;
+}
+
+bool CJsonWriter::raw(const char* key, const char* json, size_t length)
+{
+    put_key(key);
+    put(json, length);
+    return !m_overflow;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// skip_ws() - Skips JSON whitespace
+// -----------------------------------------------------------------------------
+void CJsonReader::skip_ws()
+{
+    while (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r') ++m_p;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// accept() - Consumes 'c' if it's the next non-whitespace character
+// -----------------------------------------------------------------------------
+bool CJsonReader::accept(char c)
+{
+    skip_ws();
+    if (*m_p != c) return false;
+    ++m_p;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// at_end() - Returns true if only whitespace remains
+// -----------------------------------------------------------------------------
+bool CJsonReader::at_end()
+{
+    skip_ws();
+    return *m_p == 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// read_key() - Reads an object key in place.  Our keys never need escaping, so a key that
+//              contains one can't match anything; it is rejected rather than decoded
+// -----------------------------------------------------------------------------
+bool CJsonReader::read_key(const char** key, size_t* length)
+{
+    if (!accept('"')) return false;
+
+    const char* start = m_p;
+    while (*m_p && *m_p != '"')
+    {
+        if (*m_p == '\\' || (unsigned char)*m_p < 0x20) return false;
+        ++m_p;
+    }
+    if (*m_p != '"') return false;
+
+    *key    = start;
+    *length = m_p - start;
+    ++m_p;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// read_number() - Reads a JSON number.  strtod() is more permissive than JSON (it takes "nan",
+//                 "inf", hex and a leading '+'), so the first character is checked first
+// -----------------------------------------------------------------------------
+bool CJsonReader::read_number(double* value)
+{
+    skip_ws();
+
+    // A JSON number starts with a minus sign or a digit, and a digit follows the minus
+    const char* p = m_p;
+    if (*p == '-') ++p;
+    if (*p < '0' || *p > '9') return false;
+
+    // Reject hex, which strtod() would otherwise happily accept
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) return false;
+
+    char* end;
+    *value = strtod(m_p, &end);
+    m_p = end;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// read_value() - Reads a value of a specific type
+// -----------------------------------------------------------------------------
+bool CJsonReader::read_value(double& value)
+{
+    return read_number(&value);
+}
+
+bool CJsonReader::read_value(int& value)
+{
+    // An integer written as a real (e.g. "60.0") is fine as long as it's whole and in range
+    double number;
+    if (!read_number(&number)) return false;
+    if (number != floor(number) || number < INT_MIN || number > INT_MAX) return false;
+    value = (int)number;
+    return true;
+}
+
+bool CJsonReader::read_value(std::string& value)
+{
+    if (!accept('"')) return false;
+
+    value.clear();
+
+    while (*m_p != '"')
+    {
+        unsigned char c = *m_p++;
+
+        // The string ended early, or contains a raw control character
+        if (c < 0x20) return false;
+
+        // An ordinary character
+        if (c != '\\')
+        {
+            value += c;
+            continue;
+        }
+
+        // An escape sequence
+        switch (*m_p++)
+        {
+            case '"':   value += '"';  break;
+            case '\\':  value += '\\'; break;
+            case '/':   value += '/';  break;
+            case 'b':   value += '\b'; break;
+            case 'f':   value += '\f'; break;
+            case 'n':   value += '\n'; break;
+            case 'r':   value += '\r'; break;
+            case 't':   value += '\t'; break;
+            case 'u':
+            {
+                // Decode the code point
+                unsigned int cp = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    char h = *m_p++;
+                    cp <<= 4;
+                    if      (h >= '0' && h <= '9') cp |= h - '0';
+                    else if (h >= 'a' && h <= 'f') cp |= h - 'a' + 10;
+                    else if (h >= 'A' && h <= 'F') cp |= h - 'A' + 10;
+                    else return false;
+                }
+
+                // We don't expect surrogate pairs in a status message
+                if (cp >= 0xD800 && cp <= 0xDFFF) return false;
+
+                // Store it as UTF-8
+                if (cp < 0x80)
+                    value += (char)cp;
+                else if (cp < 0x800)
+                {
+                    value += (char)(0xC0 | (cp >> 6));
+                    value += (char)(0x80 | (cp & 0x3F));
+                }
+                else
+                {
+                    value += (char)(0xE0 | (cp >> 12));
+                    value += (char)(0x80 | ((cp >> 6) & 0x3F));
+                    value += (char)(0x80 | (cp & 0x3F));
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Consume the closing quote
+    ++m_p;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// skip_value() - Skips a value we don't care about
+// -----------------------------------------------------------------------------
+bool CJsonReader::skip_value(int depth)
+{
+    // Don't let a malicious message run us out of stack
+    if (depth > 32) return false;
+
+    skip_ws();
+
+    // Strings
+    if (*m_p == '"')
+    {
+        std::string discard;
+        return read_value(discard);
+    }
+
+    // Objects
+    if (accept('{'))
+    {
+        if (accept('}')) return true;
+        do
+        {
+            // Keys here may be anything, so they're read as full strings
+            std::string discard;
+            if (!read_value(discard) || !accept(':') || !skip_value(depth + 1)) return false;
+        }
+        while (accept(','));
+        return accept('}');
+    }
+
+    // Arrays
+    if (accept('['))
+    {
+        if (accept(']')) return true;
+        do
+        {
+            if (!skip_value(depth + 1)) return false;
+        }
+        while (accept(','));
+        return accept(']');
+    }
+
+    // Literals
+    if (strncmp(m_p, "true",  4) == 0) {m_p += 4; return true;}
+    if (strncmp(m_p, "false", 5) == 0) {m_p += 5; return true;}
+    if (strncmp(m_p, "null",  4) == 0) {m_p += 4; return true;}
+
+    // Anything else had better be a number
+    double number;
+    return read_number(&number);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CBinaryWriter::field() - Appends a field in little-endian byte order
+// -----------------------------------------------------------------------------
+bool CBinaryWriter::field(const char*, double value)
+{
+    if (m_length + 8 > m_size) return false;
+
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    for (int i = 0; i < 8; ++i) m_buf[m_length++] = (uint8_t)(bits >> (8 * i));
+    return true;
+}
+
+bool CBinaryWriter::field(const char*, int value)
+{
+    if (m_length + 4 > m_size) return false;
+
+    uint32_t bits = (uint32_t)value;
+    for (int i = 0; i < 4; ++i) m_buf[m_length++] = (uint8_t)(bits >> (8 * i));
+    return true;
+}
+
+bool CBinaryWriter::field(const char*, const std::string& value)
+{
+    // The string has to fit in its fixed-size slot
+    if (m_length + SCHEMA_STRING_SIZE > m_size || value.size() > SCHEMA_STRING_SIZE - 1) return false;
+
+    m_buf[m_length] = (uint8_t)value.size();
+    memset(m_buf + m_length + 1, 0, SCHEMA_STRING_SIZE - 1);
+    memcpy(m_buf + m_length + 1, value.data(), value.size());
+    m_length += SCHEMA_STRING_SIZE;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CBinaryReader::field() - Reads a field in little-endian byte order
+// -----------------------------------------------------------------------------
+bool CBinaryReader::field(const char*, double& value)
+{
+    if (m_length + 8 > m_size) return false;
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) bits |= (uint64_t)m_buf[m_length++] << (8 * i);
+    memcpy(&value, &bits, 8);
+    return true;
+}
+
+bool CBinaryReader::field(const char*, int& value)
+{
+    if (m_length + 4 > m_size) return false;
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 4; ++i) bits |= (uint32_t)m_buf[m_length++] << (8 * i);
+    value = (int)bits;
+    return true;
+}
+
+bool CBinaryReader::field(const char*, std::string& value)
+{
+    if (m_length + SCHEMA_STRING_SIZE > m_size) return false;
+
+    // A length that doesn't fit in the slot means the buffer is corrupt
+    size_t length = m_buf[m_length];
+    if (length > SCHEMA_STRING_SIZE - 1) return false;
+
+    value.assign((const char*)m_buf + m_length + 1, length);
+    m_length += SCHEMA_STRING_SIZE;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
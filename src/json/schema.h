@@ -0,0 +1,408 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// schema.h - Compile-time field schemas for status structs, with JSON and fixed-layout binary codecs
+//
+// A struct is made serializable by specializing schema<> for it.  The specialization lists the fields
+// once, in order, by handing each one to a visitor:
+//
+//      template <> struct schema<my_status_t>
+//      {
+//          template <class V, class S> static bool visit(V& v, S& s)
+//          {
+//              return v.field("voltage", s.voltage)
+//                  && v.field("name",    s.name);
+//          }
+//      };
+//
+// The codecs below are visitors.  Supported field types are double, int and std::string.  A visitor
+// returns false from field() to stop the walk early.
+//
+// The JSON writer never allocates; it formats straight into the caller's buffer.  The JSON parser makes
+// one pass over the text, requires every schema field to be present exactly once with the right type,
+// ignores keys it doesn't know about, and only touches the output struct if the whole message is valid.
+//
+// The binary layout is the schema fields in order with no padding: a double is 8 bytes, an int is
+// 4 bytes, both little-endian, and a string is a length byte followed by SCHEMA_STRING_SIZE-1 bytes
+// of zero-padded text.
+//==========================================================================================================
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "J1772.h"
+
+// The number of bytes a string field occupies in the binary encoding, including its length byte
+#define SCHEMA_STRING_SIZE 16
+
+// The most fields a schema can have. The JSON parser keeps one bit per field in a uint64_t
+#define SCHEMA_MAX_FIELDS  64
+
+// The schema for a struct. Specialize this for every struct that should be serializable
+template <class S> struct schema;
+
+
+// -----------------------------------------------------------------------------
+// CJsonWriter - Formats a JSON object into a fixed-size buffer
+// -----------------------------------------------------------------------------
+class CJsonWriter
+{
+public:
+
+    // Constructor: 'buf' receives the JSON text, and is always null terminated
+    CJsonWriter(char* buf, size_t size);
+
+    // Writes the opening brace
+    void    begin();
+
+    // Writes a single key-value pair. Returns false if the buffer is full
+    bool    field(const char* key, double value);
+    bool    field(const char* key, int value);
+    bool    field(const char* key, const std::string& value);
+    bool    field(const char* key, const char* value);
+
+    // Writes a key whose value is already encoded as JSON
+    bool    raw(const char* key, const char* json, size_t length);
+
+    // Writes the closing brace and returns the length of the text, or -1 if it didn't fit
+    int     end();
+
+protected:
+
+    // Appends characters to the buffer
+    void    put(const char* text, size_t length);
+    void    put(char c) {put(&c, 1);}
+
+    // Appends a key and the colon that follows it
+    void    put_key(const char* key);
+
+    // Appends a quoted, escaped string
+    void    put_string(const char* text, size_t length);
+
+    // The output buffer, its size, and how much of it we've used
+    char*   m_buf;
+    size_t  m_size, m_length;
+
+    // True until the first field has been written
+    bool    m_first;
+
+    // True if we ran out of room
+    bool    m_overflow;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CJsonReader - A cursor over null-terminated JSON text
+// -----------------------------------------------------------------------------
+class CJsonReader
+{
+public:
+
+    // Constructor
+    CJsonReader(const char* text) {m_p = text;}
+
+    // Skips whitespace, then consumes 'c' if it's next. Returns true if it was
+    bool    accept(char c);
+
+    // Returns true if only whitespace remains
+    bool    at_end();
+
+    // Reads an object key, which must not contain escapes
+    bool    read_key(const char** key, size_t* length);
+
+    // Reads a value of the given type. Returns false if the next value isn't one
+    bool    read_value(double& value);
+    bool    read_value(int& value);
+    bool    read_value(std::string& value);
+
+    // Skips over a value of any type, including nested objects and arrays
+    bool    skip_value(int depth = 0);
+
+protected:
+
+    // Skips whitespace
+    void    skip_ws();
+
+    // Reads a JSON number
+    bool    read_number(double* value);
+
+    // The next character to be read
+    const char* m_p;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CJsonFieldMatcher - Visitor that reads the value of whichever schema field matches a key
+// -----------------------------------------------------------------------------
+class CJsonFieldMatcher
+{
+public:
+
+    // Constructor
+    CJsonFieldMatcher(CJsonReader& reader, const char* key, size_t length)
+        : m_reader(reader), m_key(key), m_length(length), m_index(0), m_matched(-1), m_ok(false) {}
+
+    // Called by the schema for each field, in order. Stops the walk once the key has been matched
+    template <class T> bool field(const char* name, T& value)
+    {
+        int index = m_index++;
+        if (strncmp(name, m_key, m_length) != 0 || name[m_length] != 0) return true;
+        m_matched = index;
+        m_ok = m_reader.read_value(value);
+        return false;
+    }
+
+    // The index of the field that matched, or -1 if none did
+    int     matched() {return m_matched;}
+
+    // True if the matched field's value was the right type
+    bool    ok() {return m_ok;}
+
+protected:
+
+    CJsonReader&    m_reader;
+    const char*     m_key;
+    size_t          m_length;
+    int             m_index, m_matched;
+    bool            m_ok;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CSchemaFieldName - Visitor that finds the name of the field at a given index
+// -----------------------------------------------------------------------------
+class CSchemaFieldName
+{
+public:
+    CSchemaFieldName(int index) {m_index = index; m_name = NULL;}
+    template <class T> bool field(const char* name, T&) {if (m_index-- == 0) {m_name = name; return false;} return true;}
+    const char* m_name;
+protected:
+    int         m_index;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CSchemaFieldCount - Visitor that counts the fields in a schema
+// -----------------------------------------------------------------------------
+class CSchemaFieldCount
+{
+public:
+    CSchemaFieldCount() {m_count = 0;}
+    template <class T> bool field(const char*, T&) {++m_count; return true;}
+    int m_count;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CBinaryWriter / CBinaryReader - Visitors for the fixed-layout binary encoding
+// -----------------------------------------------------------------------------
+class CBinaryWriter
+{
+public:
+    CBinaryWriter(uint8_t* buf, size_t size) {m_buf = buf; m_size = size; m_length = 0;}
+    bool    field(const char*, double value);
+    bool    field(const char*, int value);
+    bool    field(const char*, const std::string& value);
+    size_t  m_length;
+protected:
+    uint8_t*    m_buf;
+    size_t      m_size;
+};
+
+class CBinaryReader
+{
+public:
+    CBinaryReader(const uint8_t* buf, size_t size) {m_buf = buf; m_size = size; m_length = 0;}
+    bool    field(const char*, double& value);
+    bool    field(const char*, int& value);
+    bool    field(const char*, std::string& value);
+    size_t  m_length;
+protected:
+    const uint8_t*  m_buf;
+    size_t          m_size;
+};
+
+class CBinarySize
+{
+public:
+    CBinarySize() {m_length = 0;}
+    bool    field(const char*, const double&)      {m_length += 8;                  return true;}
+    bool    field(const char*, const int&)         {m_length += 4;                  return true;}
+    bool    field(const char*, const std::string&) {m_length += SCHEMA_STRING_SIZE; return true;}
+    size_t  m_length;
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// schema_to_json() - Writes 's' as a JSON object into 'buf'.
+//                    Returns the length of the text, or -1 if it didn't fit
+// -----------------------------------------------------------------------------
+template <class S> int schema_to_json(const S& s, char* buf, size_t size)
+{
+    CJsonWriter writer(buf, size);
+    writer.begin();
+    schema<S>::visit(writer, s);
+    return writer.end();
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// schema_from_json() - Parses a JSON object into 's'.  Returns 0 on success or -1 if the text isn't
+//                      valid; 's' is left untouched on failure.  If the problem is a particular field,
+//                      '*bad_field' is pointed at its name
+// -----------------------------------------------------------------------------
+template <class S> int schema_from_json(const char* text, S& s, const char** bad_field = NULL)
+{
+    // Parse into a copy so a bad message can't leave 's' half-updated
+    S result = s;
+
+    // Find out how many fields we're expecting
+    CSchemaFieldCount count;
+    schema<S>::visit(count, result);
+
+    // One bit per schema field, set as each field is seen. A schema with more fields than
+    // that can hold can't be parsed
+    if (count.m_count > SCHEMA_MAX_FIELDS) return -1;
+    uint64_t seen = 0, all = (count.m_count == SCHEMA_MAX_FIELDS) ? ~(uint64_t)0 : ((uint64_t)1 << count.m_count) - 1;
+
+    if (bad_field) *bad_field = NULL;
+
+    CJsonReader reader(text);
+    if (!reader.accept('{')) return -1;
+
+    // Walk the members of the object
+    if (!reader.accept('}'))
+    {
+        do
+        {
+            // Fetch the key
+            const char* key;
+            size_t      length;
+            if (!reader.read_key(&key, &length) || !reader.accept(':')) return -1;
+
+            // Let the schema read the value if it knows this key
+            CJsonFieldMatcher matcher(reader, key, length);
+            schema<S>::visit(matcher, result);
+
+            // Keys that aren't in the schema are skipped
+            int index = matcher.matched();
+            if (index < 0)
+            {
+                if (!reader.skip_value()) return -1;
+                continue;
+            }
+
+            // A field of the wrong type, or one that appears twice, is an error
+            if (!matcher.ok() || (seen & ((uint64_t)1 << index)))
+            {
+                if (bad_field) {CSchemaFieldName name(index); schema<S>::visit(name, result); *bad_field = name.m_name;}
+                return -1;
+            }
+
+            seen |= (uint64_t)1 << index;
+        }
+        while (reader.accept(','));
+
+        if (!reader.accept('}')) return -1;
+    }
+
+    // Nothing but whitespace is allowed after the object
+    if (!reader.at_end()) return -1;
+
+    // Every schema field must be present
+    if (seen != all)
+    {
+        int index = 0;
+        while (seen & ((uint64_t)1 << index)) ++index;
+        if (bad_field) {CSchemaFieldName name(index); schema<S>::visit(name, result); *bad_field = name.m_name;}
+        return -1;
+    }
+
+    // The message is good
+    s = result;
+    return 0;
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// schema_binary_size() - Returns the size of the binary encoding of a struct
+// -----------------------------------------------------------------------------
+template <class S> size_t schema_binary_size()
+{
+    CBinarySize size;
+    S s = S();
+    schema<S>::visit(size, s);
+    return size.m_length;
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// schema_to_binary() - Encodes 's' into 'buf'. Returns the encoded length, or -1 if it didn't fit
+// -----------------------------------------------------------------------------
+template <class S> int schema_to_binary(const S& s, uint8_t* buf, size_t size)
+{
+    CBinaryWriter writer(buf, size);
+    return schema<S>::visit(writer, s) ? (int)writer.m_length : -1;
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// schema_from_binary() - Decodes 'buf' into 's'. Returns 0 on success or -1 if 'buf' is too short
+// -----------------------------------------------------------------------------
+template <class S> int schema_from_binary(const uint8_t* buf, size_t size, S& s)
+{
+    S result = s;
+    CBinaryReader reader(buf, size);
+    if (!schema<S>::visit(reader, result)) return -1;
+    s = result;
+    return 0;
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// schema<J1772_t> - The J1772 status message
+// -----------------------------------------------------------------------------
+template <> struct schema<J1772_t>
+{
+    template <class V, class S> static bool visit(V& v, S& s)
+    {
+        return v.field("Vpilot",           s.Vpilot)
+            && v.field("Vpilot_min",       s.Vpilot_min)
+            && v.field("Vprox",            s.Vprox)
+            && v.field("pilot_duty_cycle", s.pilot_duty_cycle)
+            && v.field("pilot_freq",       s.pilot_freq)
+            && v.field("pilot_state_name", s.pilot_state_name);
+    }
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
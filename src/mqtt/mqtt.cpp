@@ -26,64 +26,43 @@
 #include "common.h"
 #include "main.h"
 
-// Flag that indicates if RTH data is received
-int rth_data_received;
-
 // Flag that indicates if a J1772 status message is received
 int J1772_status_received;
 
 // A J1772 status message
 std::string J1772_status_msg;
 
-// An RTH TCP/IP data packet
-std::string rth_datapacket;
-
 
 // -----------------------------------------------------------------------------
 // handle_message()
 // -----------------------------------------------------------------------------
 void CWolfMQTT::handle_message(const std::string& topic, const std::string& message)
 {
+    tcpdump.note("MQTT received %u bytes on %s", (unsigned)message.size(), topic.c_str());
+
     // Make sure the message arrives on the correct topic
 
     /** Global topics **/
-    if (topic == mqtt.ev_message)
+    if (topic == role->rx_message() && peer.on_message(message))
     {
-        // Handle handshake messages here
-        if (message == "1")
-        {
-            // Reply handshake message received from EV
-            rth_hs = BOTH_HS;
-            return;
-        }
-
-        // handle all other messages here
-        else
-        {
-            // Save the message received
-            rth_data_received = 1;
-            rth_datapacket = message;
-            return;
-        }
+        // A heartbeat or Last Will; the peer tracker has dealt with it
+        return;
     }
-    else if (topic == mqtt.evse_message)
+    else if (topic == role->rx_message() && handshake.on_message(message))
     {
-        // Handle handshake messages here
-        if (message == "1")
-        {
-            // First handshake message received from EVSE
-            rth_hs = FIRST_HS;
-            return;
-        }
-
-        // handle all other messages here
-        else
-        {
-            // Save the message received
-            rth_data_received = 1;
-            rth_datapacket = message;
-            return;
-        }
+        // Part of the handshake; see handshake.h
+        return;
+    }
+    else if (topic == mqtt.ev_message || topic == mqtt.evse_message)
+    {
+        // Everything else is the TCP relay
+        relay_on_message(message);
+        return;
+    }
+    /** Pilot mirroring control topics **/
+    else if (topic == mqtt.ev_control || topic == mqtt.evse_control)
+    {
+        pilot_mirror.on_message(message);
     }
     else
         logger.log(LOG_WARNING, "Message arrived on invalid topic");
@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// waveform.cpp - Records raw pilot/prox samples into a fixed-size, memory-mapped ring file
+//==========================================================================================================
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "waveform.h"
+
+
+// -----------------------------------------------------------------------------
+// open() - Opens (or creates) a ring file that holds 'capacity' samples.  An existing ring file with
+//          the same layout is appended to, so history survives an application restart
+// -----------------------------------------------------------------------------
+bool CWaveformRecorder::open(const std::string& filename, int capacity, const std::string& device_type)
+{
+    // If we already have a ring file open, close it
+    close();
+
+    // A ring needs room for at least one sample. The capacity comes straight from the config
+    // file, so a negative one is turned away here rather than wrapping to a huge ring
+    if (capacity <= 0) return false;
+
+    // Open the ring file, creating it if necessary
+    m_fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) return false;
+
+    // Compute the size of the whole file
+    m_map_size = sizeof(waveform_header_t) + (size_t)capacity * sizeof(waveform_sample_t);
+
+    // Find out whether there's an existing ring we can keep appending to
+    struct stat st;
+    bool reuse = (fstat(m_fd, &st) == 0 && (size_t)st.st_size == m_map_size);
+
+    // Make sure the file is exactly the size we need
+    if (!reuse && ftruncate(m_fd, m_map_size) != 0)
+    {
+        close();
+        return false;
+    }
+
+    // Map the entire file into memory
+    m_map = mmap(NULL, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_map == MAP_FAILED)
+    {
+        m_map = NULL;
+        close();
+        return false;
+    }
+
+    m_header  = (waveform_header_t*)m_map;
+    m_records = (waveform_sample_t*)((char*)m_map + sizeof(waveform_header_t));
+
+    // An existing ring is only reusable if its layout matches ours exactly
+    if (reuse)
+    {
+        reuse = strcmp(m_header->magic, WAVEFORM_MAGIC) == 0
+             && m_header->version     == WAVEFORM_VERSION
+             && m_header->header_size == sizeof(waveform_header_t)
+             && m_header->record_size == sizeof(waveform_sample_t)
+             && m_header->capacity    == (uint32_t)capacity;
+    }
+
+    // Otherwise, start a fresh ring
+    if (!reuse)
+    {
+        memset(m_header, 0, sizeof(waveform_header_t));
+        strcpy(m_header->magic, WAVEFORM_MAGIC);
+        m_header->version     = WAVEFORM_VERSION;
+        m_header->header_size = sizeof(waveform_header_t);
+        m_header->record_size = sizeof(waveform_sample_t);
+        m_header->capacity    = (uint32_t)capacity;
+        m_header->head        = 0;
+    }
+
+    // Remember which side of the harness recorded this ring
+    strncpy(m_header->device_type, device_type.c_str(), sizeof(m_header->device_type) - 1);
+
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// record() - Appends a sample to the ring.  This is on the sampling hot path, so it only ever
+//            stores into the mapping; the kernel writes the dirty pages back on its own schedule
+// -----------------------------------------------------------------------------
+void CWaveformRecorder::record(const J1772_t& sample)
+{
+    // If we're not recording, there's nothing to do
+    if (m_header == NULL) return;
+
+    // Fetch the wall-clock time
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    // Find the slot this sample goes into
+    waveform_sample_t& r = m_records[m_header->head % m_header->capacity];
+
+    // Fill in the record
+    r.timestamp_us     = (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+    r.Vpilot           = (float)sample.Vpilot;
+    r.Vpilot_min       = (float)sample.Vpilot_min;
+    r.Vprox            = (float)sample.Vprox;
+    r.pilot_duty_cycle = (float)sample.pilot_duty_cycle;
+    r.pilot_freq       = sample.pilot_freq;
+    r.pilot_state      = (uint8_t)sample.pilot_state;
+    r.prox_state       = (uint8_t)sample.prox_state;
+
+    // Make sure the record is complete before it becomes visible to a reader of the file
+    __sync_synchronize();
+
+    // And publish it
+    m_header->head++;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// close() - Flushes the mapping to disk and closes the ring file
+// -----------------------------------------------------------------------------
+void CWaveformRecorder::close()
+{
+    if (m_map)
+    {
+        msync(m_map, m_map_size, MS_SYNC);
+        munmap(m_map, m_map_size);
+    }
+
+    if (m_fd >= 0) ::close(m_fd);
+
+    m_fd      = -1;
+    m_map     = NULL;
+    m_header  = NULL;
+    m_records = NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// export_waveform() - Exports the samples in [from_us, to_us] from a ring file as "csv" or "json",
+//                     oldest sample first.  A bound of 0 means unbounded.
+//                     Returns the number of samples exported, or -1 on error
+// -----------------------------------------------------------------------------
+int export_waveform(const std::string& filename, uint64_t from_us, uint64_t to_us, const std::string& format, FILE* out)
+{
+    // We only know how to write these two formats
+    bool as_json = (format == "json");
+    if (!as_json && format != "csv")
+    {
+        fprintf(stderr, "Unknown export format '%s'\n", format.c_str());
+        return -1;
+    }
+
+    // Open the ring file for reading
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Can't open waveform file %s\n", filename.c_str());
+        return -1;
+    }
+
+    // Make sure the file is at least big enough to hold a header
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(waveform_header_t))
+    {
+        fprintf(stderr, "%s is not a waveform file\n", filename.c_str());
+        ::close(fd);
+        return -1;
+    }
+
+    // Map the whole thing
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Can't map waveform file %s\n", filename.c_str());
+        return -1;
+    }
+
+    // Validate the header against the file we actually have
+    const waveform_header_t* header = (const waveform_header_t*)map;
+    if (strncmp(header->magic, WAVEFORM_MAGIC, sizeof(header->magic)) != 0
+        || header->version     != WAVEFORM_VERSION
+        || header->record_size != sizeof(waveform_sample_t)
+        || header->capacity    == 0
+        || header->header_size + (uint64_t)header->capacity * header->record_size > (uint64_t)st.st_size)
+    {
+        fprintf(stderr, "%s is not a compatible waveform file\n", filename.c_str());
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    const waveform_sample_t* records = (const waveform_sample_t*)((const char*)map + header->header_size);
+
+    // Figure out where the oldest sample is and how many samples the ring holds
+    uint64_t head  = header->head;
+    uint64_t count = (head < header->capacity) ? head : header->capacity;
+    uint64_t first = head - count;
+
+    // Write the preamble
+    if (as_json)
+        fprintf(out, "{\"device_type\":\"%.8s\",\"samples\":[", header->device_type);
+    else
+        fprintf(out, "timestamp_us,Vpilot,Vpilot_min,Vprox,pilot_freq,pilot_duty_cycle,pilot_state,prox_state\n");
+
+    // Walk the ring from the oldest sample to the newest
+    int exported = 0;
+    for (uint64_t i = first; i < head; ++i)
+    {
+        const waveform_sample_t& r = records[i % header->capacity];
+
+        // Skip anything outside of the requested window
+        if (from_us && r.timestamp_us < from_us) continue;
+        if (to_us   && r.timestamp_us > to_us)   continue;
+
+        // Look up the name of the pilot state
+        const char* state = (r.pilot_state < UNKNOWN) ? pilot_state_names[r.pilot_state] : "UNKNOWN";
+
+        if (as_json)
+        {
+            fprintf(out, "%s{\"timestamp_us\":%llu,\"Vpilot\":%.3f,\"Vpilot_min\":%.3f,\"Vprox\":%.3f,"
+                         "\"pilot_freq\":%d,\"pilot_duty_cycle\":%.1f,\"pilot_state_name\":\"%s\",\"prox_state\":%d}",
+                    exported ? "," : "", (unsigned long long)r.timestamp_us, r.Vpilot, r.Vpilot_min,
+                    r.Vprox, r.pilot_freq, r.pilot_duty_cycle, state, r.prox_state);
+        }
+        else
+        {
+            fprintf(out, "%llu,%.3f,%.3f,%.3f,%d,%.1f,%s,%d\n", (unsigned long long)r.timestamp_us,
+                    r.Vpilot, r.Vpilot_min, r.Vprox, r.pilot_freq, r.pilot_duty_cycle, state, r.prox_state);
+        }
+
+        ++exported;
+    }
+
+    // Close out the JSON document
+    if (as_json) fprintf(out, "]}\n");
+
+    munmap(map, st.st_size);
+    return exported;
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// waveform.h - Records raw pilot/prox samples into a fixed-size, memory-mapped ring file
+//
+// The ring file is a small binary header followed by 'capacity' fixed-size records.  The header's 'head'
+// field counts every record ever written, so the oldest record lives at (head % capacity) once the ring
+// has wrapped.  Recording a sample is a handful of stores into the mapping; no syscalls on the hot path.
+//==========================================================================================================
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#include "J1772.h"
+
+// Identifies a waveform ring file and its layout version
+#define WAVEFORM_MAGIC   "RTHWAVE"
+#define WAVEFORM_VERSION 1
+
+// This is the header at the beginning of the ring file
+struct waveform_header_t
+{
+    char     magic[8];          // WAVEFORM_MAGIC, null terminated
+    uint32_t version;           // WAVEFORM_VERSION
+    uint32_t header_size;       // Byte offset of the first record
+    uint32_t record_size;       // sizeof(waveform_sample_t)
+    uint32_t capacity;          // Number of records the ring can hold
+    uint64_t head;              // Total number of records ever written
+    char     device_type[8];    // "EV" or "EVSE"
+    uint8_t  reserved[24];      // Pads the header to 64 bytes
+};
+
+// This is a single co-processor sample as it is stored in the ring file
+struct waveform_sample_t
+{
+    uint64_t timestamp_us;      // Wall-clock time in microseconds since the epoch
+    float    Vpilot;            // V
+    float    Vpilot_min;        // V
+    float    Vprox;             // V
+    float    pilot_duty_cycle;  // %
+    int32_t  pilot_freq;        // Hz
+    uint8_t  pilot_state;       // pilot_states
+    uint8_t  prox_state;        // prox_states
+    uint8_t  reserved[2];
+};
+
+// -----------------------------------------------------------------------------
+// CWaveformRecorder - Appends J1772 samples to a memory-mapped ring file
+// -----------------------------------------------------------------------------
+class CWaveformRecorder
+{
+public:
+
+    // Constructor & destructor
+    CWaveformRecorder() {m_fd = -1; m_map = NULL; m_map_size = 0; m_header = NULL; m_records = NULL;}
+    ~CWaveformRecorder() {close();}
+
+    // Call this to open (or create) a ring file that holds 'capacity' samples. Returns true on success
+    bool    open(const std::string& filename, int capacity, const std::string& device_type);
+
+    // Call this to append a sample to the ring. Does nothing if the recorder isn't open
+    void    record(const J1772_t& sample);
+
+    // Call this to flush the mapping to disk and close the ring file
+    void    close();
+
+    // Returns true if the recorder is open and recording
+    bool    is_open() {return m_header != NULL;}
+
+protected:
+
+    // The file descriptor of the ring file
+    int                 m_fd;
+
+    // The memory mapping of the whole ring file and its size in bytes
+    void*               m_map;
+    size_t              m_map_size;
+
+    // Convenient pointers into the mapping
+    waveform_header_t*  m_header;
+    waveform_sample_t*  m_records;
+};
+// -----------------------------------------------------------------------------
+
+// Exports the samples in [from_us, to_us] from a ring file as "csv" or "json". A bound of 0 means unbounded
+int export_waveform(const std::string& filename, uint64_t from_us, uint64_t to_us, const std::string& format, FILE* out);
+
+//==========================================================================================================
@@ -18,15 +18,20 @@
 //==========================================================================================================
 
 #include <ifaddrs.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <mutex>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <thread>
+#include <unistd.h>
 
 #include "sdp.h"
 
 // This is the interface over which HLC occurs
 std::string network_interface = "qca0";
 
-// Flag to check if SDP is initialized
-int SDP_init = 0;
-
 // This is the port number for SDP
 int SDP_port = 15118;
 
@@ -35,10 +40,6 @@ int SDP_port = 15118;
 #define SDP_REQUEST_LENGTH 10 
 #define SDP_RESPONSE_LENGTH 28 // payload = 16 IPv6 address, 2 for port, 1 for transport, 1 for security, 8 for V2GTP header
 
-// This is the byte array that holds the SDP header and payload
-uint8_t v2gtp_outStream[MAX_MSG_SIZE];
-uint8_t v2gtp_inStream[MAX_MSG_SIZE];
-
 // These are the V2GTP constants
 #define V2GTP_VERSION           0x01
 #define V2GTP_VERSION_INV       0xFE
@@ -65,8 +66,24 @@ uint16_t SECC_port;
 struct sockaddr_in6 SECCAddr;
 char SECC_ipv6addr[INET6_ADDRSTRLEN];
 std::string ipv6_str;
+uint64_t SDP_done_ms;
+
+// The EV sends an SDP request every SDP_RETRY_MS, up to SDP_MAX_REQUESTS times (DIN 70121 [V2G-DC-159])
+#define SDP_RETRY_MS     250
+#define SDP_MAX_REQUESTS 50
+
+// The EVSE's responder: the response it sends, and how many requests it has answered
+static std::mutex sdp_mtx;
+static uint8_t    sdp_response[SDP_RESPONSE_LENGTH];
+static bool       sdp_response_valid = false;
+static int        sdp_answered = 0, sdp_answered_mark = 0;
+static bool       sdp_responder_running = false;
 
-int get_ephemeral_port(int sd);
+// The EV's client
+enum sdp_client_state_t {SDP_IDLE, SDP_WAITING, SDP_DONE, SDP_FAILED};
+static sdp_client_state_t sdp_client_state = SDP_IDLE;
+static int      sdp_requests = 0, sdp_timer_id = -1;
+static uint64_t sdp_start_ms = 0;
 
 // -----------------------------------------------------------------------------
 // create_v2gtp_header() - Implements the V2GTP header based on DIN 70121 (pg 82)
@@ -124,11 +141,15 @@ int get_IPv6(const char *iface_name, char *ipv6add)
     struct ifaddrs *ifaddr, *ifa;
     int family, s, i;
 
-    // Get the list of network interfaces
+    // Stays empty if the interface has no IPv6 address
+    ipv6add[0] = '\0';
+
+    // Get the list of network interfaces. This runs on the SDP responder thread too, so a
+    // failure is the caller's to handle
     if (getifaddrs(&ifaddr) == -1)
     {
         perror("getifaddrs");
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     // Walk through the linked list of network interfaces
@@ -151,6 +172,7 @@ int get_IPv6(const char *iface_name, char *ipv6add)
                             ipv6add, INET6_ADDRSTRLEN, NULL, 0, NI_NUMERICHOST);
             if (s != 0) {
                 printf("getnameinfo() failed: %s\n", gai_strerror(s));
+                freeifaddrs(ifaddr);
                 return -1;
             }
 
@@ -168,7 +190,7 @@ int get_IPv6(const char *iface_name, char *ipv6add)
     // Free the linked list of network interfaces
     freeifaddrs(ifaddr);
 
-    return 0;
+    return ipv6add[0] ? 0 : -1;
 }
 // -----------------------------------------------------------------------------
 
@@ -181,6 +203,7 @@ int create_SDP_response(uint8_t* v2gtp_message)
 {
     // This is the IPv6 address of the device
     char ipv6str[INET6_ADDRSTRLEN];
+    struct in6_addr addr;
 
     // Define the payload length 
     int SDP_payload_length = 20; // 16 IPv6 bytes, 2 port bytes, 1 security, 1 comm type
@@ -197,8 +220,8 @@ int create_SDP_response(uint8_t* v2gtp_message)
 	else
 	{
 
-		// Convert IP from numbers and dots to binary notation and save to SECC ipv6 address to global structure
-		if(inet_pton(AF_INET6,ipv6str, (void *)&SECCAddr.sin6_addr.s6_addr) <= 0)
+		// Convert IP from numbers and dots to binary notation
+		if(inet_pton(AF_INET6,ipv6str, (void *)&addr) <= 0)
         {
 			fprintf(stderr, "Bad IPv6 Address ");
             return -1;
@@ -208,15 +231,15 @@ int create_SDP_response(uint8_t* v2gtp_message)
     // Write the IPv6 address to the SDP response payload
 	for(int i=0;i<=15;i++)
 	{
-		v2gtp_outStream[V2GTP_HEADER_LENGTH+i] = SECCAddr.sin6_addr.s6_addr[i];
+		v2gtp_message[V2GTP_HEADER_LENGTH+i] = addr.s6_addr[i];
 	}
 
     // Write the port number for the SECC TCP/IP server
-    v2gtp_outStream[24] = (uint8_t)(TCP_port & 0xFF); // Port 65535
-    v2gtp_outStream[25] = (uint8_t)((TCP_port >> 8) & 0xFF);
+    v2gtp_message[24] = (uint8_t)(TCP_port & 0xFF); // Port 65535
+    v2gtp_message[25] = (uint8_t)((TCP_port >> 8) & 0xFF);
 
-    v2gtp_outStream[26] = No_Transport_Layer_Security;
-    v2gtp_outStream[27] = SDP_TCP;
+    v2gtp_message[26] = No_Transport_Layer_Security;
+    v2gtp_message[27] = SDP_TCP;
 
     return 0;
 }
@@ -225,9 +248,10 @@ int create_SDP_response(uint8_t* v2gtp_message)
 
 
 // -----------------------------------------------------------------------------
-// parse_SDP_message() - Parse SDP message based on device type
+// parse_SDP_message() - Parse an SDP request (on the EVSE side) or an SDP response
+//                       (on the EV side)
 // -----------------------------------------------------------------------------
-int parse_SDP_message()
+int parse_SDP_message(const uint8_t* msg, int length, bool is_request)
 {
     uint16_t payload_type;
     uint32_t payload_length;
@@ -236,61 +260,49 @@ int parse_SDP_message()
     uint8_t ipv6[16];
     char ipv6str[INET6_ADDRSTRLEN];
 
-    if (config.device_type == "EVSE")
-    {
-        // Check if we support this v2gtp version
-	    if(v2gtp_inStream[0] != V2GTP_VERSION && v2gtp_inStream[1] != V2GTP_VERSION_INV)
-		    return -1;
+    // Every SDP message starts with a V2GTP header
+    if (length < V2GTP_HEADER_LENGTH) return -1;
 
-        // Check if we support this payload type
-        payload_type = v2gtp_inStream[2];
-        payload_type = (payload_type << 8 | v2gtp_inStream[3]);
-        if (payload_type != V2GTP_SDP_REQUEST_TYPE) return -1;
+    // Check if we support this v2gtp version
+    if(msg[0] != V2GTP_VERSION && msg[1] != V2GTP_VERSION_INV)
+        return -1;
 
-        // Check if the payload length is correct
-        payload_length = v2gtp_inStream[4];
-	    payload_length = (payload_length << 8 | v2gtp_inStream[5]);
-	    payload_length = (payload_length << 16 | v2gtp_inStream[6]);
-	    payload_length = (payload_length << 24 | v2gtp_inStream[7]);
-        if (payload_length != 2) return -1;
+    // Fetch the payload type and length
+    payload_type = msg[2];
+    payload_type = (payload_type << 8 | msg[3]);
+    payload_length = msg[4];
+    payload_length = (payload_length << 8 | msg[5]);
+    payload_length = (payload_length << 8 | msg[6]);
+    payload_length = (payload_length << 8 | msg[7]);
+
+    if (is_request)
+    {
+        // Check if we support this payload type, and the payload length is correct
+        if (payload_type != V2GTP_SDP_REQUEST_TYPE) return -1;
+        if (payload_length != 2 || length < SDP_REQUEST_LENGTH) return -1;
 
         // Now parse the security and transport settings
-        security = v2gtp_inStream[8];
-	    transport = v2gtp_inStream[9];
-        printf("Security: %d\n", security); // for debugging
+        security = msg[8];
+	    transport = msg[9];
         if ((security == No_Transport_Layer_Security) && (transport == SDP_TCP))
         {
-            printf("\nValid DC Charging SDP Request\n");
-            printf("Security byte = %d\n",security);
-            printf("Transport byte = %d\n",transport);
+            printf("Valid DC Charging SDP Request\n");
         }
         else
         {
-            printf("\nInvalid DC Charging SDP Request\n");
+            printf("Invalid DC Charging SDP Request (security %d, transport %d)\n", security, transport);
         }
     }
 
-    else if (config.device_type == "EV")
+    else
     {
-        // Check if we support this v2gtp version
-	    if(v2gtp_inStream[0] != V2GTP_VERSION && v2gtp_inStream[1] != V2GTP_VERSION_INV)
-		    return -1;
-
-        // Check if we support this payload type
-        payload_type = v2gtp_inStream[2];
-        payload_type = (payload_type << 8 | v2gtp_inStream[3]);
+        // Check if we support this payload type, and the payload length is correct
         if (payload_type != V2GTP_SDP_RESPONSE_TYPE) return -1;
-
-        // Check if the payload length is correct
-        payload_length = v2gtp_inStream[4];
-	    payload_length = (payload_length << 8 | v2gtp_inStream[5]);
-	    payload_length = (payload_length << 16 | v2gtp_inStream[6]);
-	    payload_length = (payload_length << 24 | v2gtp_inStream[7]);
-        if (payload_length != 20) return -1;
+        if (payload_length != 20 || length < SDP_RESPONSE_LENGTH) return -1;
 
         // Parse the security and transport settings
-        security = v2gtp_inStream[26];
-	    transport = v2gtp_inStream[27];
+        security = msg[26];
+	    transport = msg[27];
         if ((security == No_Transport_Layer_Security) && (transport == SDP_TCP))
         {
             printf("\nValid SDP Response\n");
@@ -304,8 +316,8 @@ int parse_SDP_message()
         }
 
         // Parse the SECC IPv6 port
-        SECCPort = v2gtp_inStream[24] << 8;
-	    SECCPort = SECCPort | v2gtp_inStream[25];
+        SECCPort = msg[24] << 8;
+	    SECCPort = SECCPort | msg[25];
 
         // Save SECC port to global variable
         SECC_port = SECCPort;
@@ -313,7 +325,7 @@ int parse_SDP_message()
         // Parse the SECC IPv6 address
         for(int i=0;i<=15;i++)
         {
-            ipv6[i] = v2gtp_inStream[V2GTP_HEADER_LENGTH+i];
+            ipv6[i] = msg[V2GTP_HEADER_LENGTH+i];
         }
 
         // Convert the IPv6 address from bytes to dotted notation
@@ -342,123 +354,297 @@ int parse_SDP_message()
 
 
 
+// -----------------------------------------------------------------------------
+// refresh_SDP_response() - Rebuilds the cached SDP response from the current address
+//                          of the network interface
+// -----------------------------------------------------------------------------
+static void refresh_SDP_response()
+{
+    uint8_t response[SDP_RESPONSE_LENGTH];
 
+    // If we can't read the address right now, keep answering with the one we had
+    if (create_SDP_response(response) != 0)
+    {
+        logger.log(LOG_WARNING, "Can't rebuild the SDP response, keeping the last one");
+        return;
+    }
 
+    std::lock_guard<std::mutex> lock(sdp_mtx);
+    memcpy(sdp_response, response, sizeof(sdp_response));
+    sdp_response_valid = true;
+}
 // -----------------------------------------------------------------------------
-// perform_SDP() - Setup and perform Service Discovery based on device type
-// -----------------------------------------------------------------------------
-int perform_SDP()
-{   
-    printf(BOLD_YELLOW "\nNow performing SDP .. \n\n" RESET);
 
-    // Buffer to hold received UDP messages
-    // char buffer[1024];
 
-    // Set UDP server and client based on device type
-    if (config.device_type == "EVSE")
+
+// -----------------------------------------------------------------------------
+// SDP_responder_task() - The EVSE's SDP responder thread. It answers every request
+//                        that arrives, from any number of EVs, from the cached response,
+//                        and rebuilds that response when the kernel tells us an IPv6
+//                        address was added or removed
+// -----------------------------------------------------------------------------
+static void SDP_responder_task(int nl_sd)
+{
+    uint8_t request[MAX_MSG_SIZE];
+    char    nl_buffer[4096];
+
+    while (true)
     {
-        printf("Waiting for SDP request message from client..\n");
-        std::string udp_client_IP = "";
-        int client_port;
+        struct pollfd pfds[2];
+        pfds[0].fd = secc_udp.get_sd();
+        pfds[0].events = POLLIN;
+        pfds[1].fd = nl_sd;
+        pfds[1].events = POLLIN;
+        int nfds = (nl_sd >= 0) ? 2 : 1;
+
+        if (poll(pfds, nfds, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
 
-        // Wait here until a UDP message is received
-        if (secc_udp.receive(v2gtp_inStream, sizeof(v2gtp_inStream), &udp_client_IP, &client_port)) 
+        // An address changed. We don't care which, the response is cheap to rebuild
+        if (nfds == 2 && (pfds[1].revents & POLLIN))
         {
-            printf("Message received on server from %s on port %d\n", udp_client_IP.c_str(), client_port);
-            
-            // Parse message to make sure it is correct
-            if (parse_SDP_message() < 0)
-            {
-                printf("Parsing SDP request message failed\n");
-                return -1;
-            }
+            if (recv(nl_sd, nl_buffer, sizeof(nl_buffer), 0) > 0) refresh_SDP_response();
+        }
 
-            // Create a sender to transmit messages to client
-            if (!secc_udp.create_sender(client_port, udp_client_IP, AF_INET6, network_interface, SDP_port, 10000))
+        // An SDP request arrived
+        if (pfds[0].revents & POLLIN)
+        {
+            struct sockaddr_in6 peer;
+            socklen_t addrlen = sizeof(peer);
+            int length = recvfrom(pfds[0].fd, request, sizeof(request), 0, (struct sockaddr*)&peer, &addrlen);
+            if (length <= 0 || parse_SDP_message(request, length, true) < 0) continue;
+
+            // Answer it from the socket it arrived on, so the response comes from port 15118
+            sdp_mtx.lock();
+            if (sdp_response_valid)
             {
-                fprintf(stderr, "Can't create sender on UDP port %i\n", client_port);
-                exit(0);
+                sendto(pfds[0].fd, sdp_response, SDP_RESPONSE_LENGTH, 0, (struct sockaddr*)&peer, addrlen);
+                ++sdp_answered;
             }
+            sdp_mtx.unlock();
 
-            // Create the SDP response packet and send to client
-            create_SDP_response(v2gtp_outStream);
-            printf("Sending response to client %s..\n", udp_client_IP.c_str());
-            secc_udp.send(v2gtp_outStream, SDP_RESPONSE_LENGTH);
+            printf("Answered SDP request from %s port %d\n", NetUtil::ip_to_string((struct sockaddr*)&peer).c_str(),
+                   ntohs(peer.sin6_port));
         }
     }
 
-    else if (config.device_type == "EV")
+    if (nl_sd >= 0) close(nl_sd);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start_SDP_responder() - Starts the EVSE's SDP responder. Returns 0 on success
+// -----------------------------------------------------------------------------
+int start_SDP_responder()
+{
+    if (sdp_responder_running) return 0;
+
+    // Listen for requests on the SDP port
+    if (!secc_udp.create_server(SDP_port, "::", AF_INET6))
     {
-        // Create the sender to broadcast messages
-        if (!evcc_udp.create_sender(SDP_port, "FF02::1", AF_INET6, network_interface, 0, 10000))
+        fprintf(stderr, "Can't create listener on UDP port %i\n", SDP_port);
+        return -1;
+    }
+
+    // Ask the kernel to tell us about IPv6 address changes. Without this the responder
+    // still works, it just can't notice the address changing
+    int nl_sd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if (nl_sd >= 0)
+    {
+        struct sockaddr_nl addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = RTMGRP_IPV6_IFADDR;
+        if (bind(nl_sd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
         {
-            fprintf(stderr, "Can't create sender on UDP port %i\n", SDP_port);
-            exit(0);
+            close(nl_sd);
+            nl_sd = -1;
         }
+    }
+    if (nl_sd < 0) logger.log(LOG_WARNING, "Can't watch for address changes, SDP response won't be refreshed");
 
-        // Create the SDP request packet to send to server
-        create_SDP_request(v2gtp_outStream, No_Transport_Layer_Security, SDP_TCP);
-        
-        printf("Sending SDP request to server.. \n");
-        evcc_udp.send(v2gtp_outStream, SDP_REQUEST_LENGTH);
-        int e_port = get_ephemeral_port(evcc_udp.get_sd());
-        printf("Message sent over port %d\n", e_port);
+    // Build the first response, then start answering
+    refresh_SDP_response();
+    std::thread th(SDP_responder_task, nl_sd);
+    th.detach();
 
-        // Create a listener to listen to responses
-        if (!evcc_udp.create_server(e_port, "::", AF_INET6, 10000))
-        {
-            fprintf(stderr, "Can't create listener on UDP port %i\n", e_port);
-            exit(0);
-        }
+    sdp_responder_running = true;
+    return 0;
+}
+// -----------------------------------------------------------------------------
 
-        printf("Waiting for response from server..\n");
-        std::string udp_server_IP = "";
 
-        if (evcc_udp.receive(v2gtp_inStream, sizeof(v2gtp_inStream), &udp_server_IP)) 
-        {
-            printf("Message received on client from IP %s\n", udp_server_IP.c_str());
-        }
 
-        // Parse message to make sure it is correct
-        if (parse_SDP_message() < 0)
-        {
-            printf(BOLD_RED "Parsing SDP response message failed\n" RESET);
-            return -1;
-        }
+// -----------------------------------------------------------------------------
+// stop_SDP_client() - Stops the EV's retransmit timer and stops listening for responses
+// -----------------------------------------------------------------------------
+static void stop_SDP_client()
+{
+    reactor.cancel_timer(sdp_timer_id);
+    sdp_timer_id = -1;
+    if (evcc_udp.get_sd() >= 0) reactor.remove_fd(evcc_udp.get_sd());
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// resolve_SECC_neighbour() - Gets the kernel to resolve the SECC's link-layer address
+//                            now, so the TCP connect doesn't have to wait for it
+// -----------------------------------------------------------------------------
+static void resolve_SECC_neighbour()
+{
+    int sd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sd < 0) return;
+
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family   = AF_INET6;
+    addr.sin6_port     = htons(SECC_port);
+    addr.sin6_addr     = SECCAddr.sin6_addr;
+    addr.sin6_scope_id = if_nametoindex(network_interface.c_str());
+
+    // An empty datagram is enough to start neighbour discovery
+    sendto(sd, NULL, 0, 0, (struct sockaddr*)&addr, sizeof(addr));
+    close(sd);
+}
+// -----------------------------------------------------------------------------
 
-        printf("SDP successful!\n");
+
+
+// -----------------------------------------------------------------------------
+// SDP_client_send() - Reactor timer that sends (or re-sends) the EV's SDP request
+// -----------------------------------------------------------------------------
+static void SDP_client_send(void*)
+{
+    // Give up once we've sent as many requests as we're allowed
+    if (sdp_requests >= SDP_MAX_REQUESTS)
+    {
+        stop_SDP_client();
+        sdp_client_state = SDP_FAILED;
+        printf(BOLD_RED "No SDP response after %d requests\n" RESET, sdp_requests);
+        return;
     }
-    
-    // If we get here, SDP successful
-    return 0;
+
+    uint8_t request[SDP_REQUEST_LENGTH];
+    create_SDP_request(request, No_Transport_Layer_Security, SDP_TCP);
+    evcc_udp.send(request, SDP_REQUEST_LENGTH);
+    ++sdp_requests;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// SDP_client_receive() - Called by the reactor when a response arrives for the EV
+// -----------------------------------------------------------------------------
+static void SDP_client_receive(int, uint32_t, void*)
+{
+    uint8_t response[MAX_MSG_SIZE];
+    std::string udp_server_IP;
+
+    int length = evcc_udp.receive(response, sizeof(response), &udp_server_IP);
+    if (length <= 0) return;
+
+    // Ignore anything that isn't a valid response; the next request may do better
+    printf("Message received on client from IP %s\n", udp_server_IP.c_str());
+    if (parse_SDP_message(response, length, false) < 0)
+    {
+        printf(BOLD_RED "Parsing SDP response message failed\n" RESET);
+        return;
+    }
+
+    // We have the SECC's address. Stop asking, and get its neighbour entry ready
+    SDP_done_ms = msTimer::millis();
+    stop_SDP_client();
+    resolve_SECC_neighbour();
+    sdp_client_state = SDP_DONE;
+    printf("SDP successful after %d request(s) in %llu ms\n", sdp_requests,
+           (unsigned long long)(msTimer::millis() - sdp_start_ms));
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// check_SDP_responder() - The EVSE's responder is always running. SDP is done for
+//                         this session once it has answered a request. Returns 0
+//                         when it has, or 1 while we're still waiting
+// -----------------------------------------------------------------------------
+int check_SDP_responder()
+{
+    std::lock_guard<std::mutex> lock(sdp_mtx);
+    return (sdp_answered > sdp_answered_mark) ? 0 : 1;
 }
 // -----------------------------------------------------------------------------
 
 
 
 // -----------------------------------------------------------------------------
-// get_ephemeral_port() - This function returns back the ephemeral port assigned by the OS
-//                        when using sendto() to send data over the specified socket
+// mark_SDP_responder() - Call this between sessions. The EVSE's responder keeps
+//                        running, so only requests answered from now on count
+//                        toward the next session
 // -----------------------------------------------------------------------------
-int get_ephemeral_port(int sd)
+void mark_SDP_responder()
 {
-    // Define a struct for the address of the socket (IPv6)
-    struct sockaddr_in6 my_addr;
+    std::lock_guard<std::mutex> lock(sdp_mtx);
+    sdp_answered_mark = sdp_answered;
+}
+// -----------------------------------------------------------------------------
 
-    // Zero out the memory for the struct to avoid any garbage values
-    memset(&my_addr, 0, sizeof(my_addr));
 
-    // Define a variable to hold the length of the address struct
-    socklen_t len = sizeof(my_addr);
 
-    // Retrieve the local address and port assigned to the socket identified by sd
-    if (getsockname(sd, (struct sockaddr *) &my_addr, &len) < 0)
+// -----------------------------------------------------------------------------
+// perform_SDP_client() - Performs Service Discovery for the EV. Returns 0 when SDP
+//                        is done, 1 while it's still in progress, or -1 if it failed
+// -----------------------------------------------------------------------------
+int perform_SDP_client()
+{
+    // The EV starts its client the first time through, then waits for it to finish
+    switch (sdp_client_state)
     {
-        perror("getsockname failed");
-        return 0;
+        case SDP_DONE:      return 0;
+        case SDP_FAILED:    return -1;
+        case SDP_WAITING:   return 1;
+        case SDP_IDLE:      break;
     }
 
-    // Convert the port number from network byte order to host byte order and return
-    return (ntohs(my_addr.sin6_port));
+    printf(BOLD_YELLOW "\nNow performing SDP .. \n\n" RESET);
+
+    // Create the sender to multicast requests. Responses come back to the same socket
+    if (!evcc_udp.create_sender(SDP_port, "FF02::1", AF_INET6, network_interface, 0, 10000))
+    {
+        fprintf(stderr, "Can't create sender on UDP port %i\n", SDP_port);
+        return -1;
+    }
+    reactor.add_fd(evcc_udp.get_sd(), EPOLLIN, SDP_client_receive);
+
+    // Send the first request now, and another every SDP_RETRY_MS until we hear back
+    sdp_client_state = SDP_WAITING;
+    sdp_requests     = 0;
+    sdp_start_ms     = msTimer::millis();
+    SDP_client_send(NULL);
+    sdp_timer_id = reactor.add_timer(SDP_RETRY_MS, SDP_client_send, NULL, true);
+
+    return 1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// reset_SDP_client() - Call this between sessions. The EV stops its client and
+//                      closes its socket
+// -----------------------------------------------------------------------------
+void reset_SDP_client()
+{
+    stop_SDP_client();
+    evcc_udp.close();
+    sdp_client_state = SDP_IDLE;
 }
 // -----------------------------------------------------------------------------
@@ -21,9 +21,17 @@
 
 #include "common.h"
 
-int create_SDP_request();
-int create_SDP_response();
-int parse_SDP_message();
-int perform_SDP();
+int create_SDP_request(uint8_t* v2gtp_message, int security_type, int comm_protocol_type);
+int create_SDP_response(uint8_t* v2gtp_message);
+int parse_SDP_message(const uint8_t* msg, int length, bool is_request);
+
+// The EVSE side: a responder that runs from startup, and what it has answered this session
+int start_SDP_responder();
+int check_SDP_responder();
+void mark_SDP_responder();
+
+// The EV side: a client that runs once per session
+int perform_SDP_client();
+void reset_SDP_client();
 
 //==========================================================================================================
@@ -17,144 +17,192 @@
 #include <cstring>
 #include <cstdio>
 #include <thread>
+#include <vector>
 #include "client.h"
 #include "server.h"
 #include "common.h"
 
 extern CServer Server;
 
-static void launch_task(CClient* p) {p->task();}
+static void launch_task(CClient* p, relay_conn_t* conn) {p->task(conn);}
+
+// Each connect attempt waits up to CONNECT_TIMEOUT_MS. Between attempts we back off from
+// CONNECT_BACKOFF_MIN_MS up to CONNECT_BACKOFF_MAX_MS, and give up after CONNECT_DEADLINE_MS
+#define CONNECT_TIMEOUT_MS      1000
+#define CONNECT_BACKOFF_MIN_MS  5
+#define CONNECT_BACKOFF_MAX_MS  200
+#define CONNECT_DEADLINE_MS     10000
 
 // -----------------------------------------------------------------------------
-// launch() - This will launch the client-side thread
+// launch() - This will set the SECC address and start connecting to it
 // -----------------------------------------------------------------------------
-void CClient::launch(std::string remote_ip, int remote_port)
+void CClient::launch(std::string remote_ip, int remote_port, std::string iface)
 {
+    m_mtx.lock();
     m_remote_ip = remote_ip;
     m_remote_port = remote_port;
-    std::thread th(launch_task, this);
-    th.detach();
+    m_interface = iface;
+    m_mtx.unlock();
+    m_failed = false;
+
+    // If the other board hasn't opened a connection yet, open a spare one now, so it's
+    // already connected when it does
+    if (m_conns.count() == 0) m_conns.add(new relay_conn_t(0));
+
+    // Start connecting everything, including anything the other board opened before we
+    // knew where the SECC was
+    start_connections();
 }
 // -----------------------------------------------------------------------------
 
 
 
 // -----------------------------------------------------------------------------
-// task() - The server-side task that connects to a server on a given port, listens
-//          for incoming connects and waits for data to arrive. It will also send
-//          data back on the port when needed
+// open() - The other board accepted connection 'id' from the EV under test. Hand
+//          it the spare connection if there is one, otherwise open a new one
 // -----------------------------------------------------------------------------
-void CClient::task()
+void CClient::open(uint32_t id)
 {
-    char buffer[0x10000];
+    if (m_conns.claim_spare(id)) return;
 
-again:
+    m_conns.add(new relay_conn_t(id));
 
-    // If application interrupted by a signal, exit it
-    if (signal_captured) exit_app(0);
+    // If we don't know where the SECC is yet, launch() starts it later
+    m_mtx.lock();
+    bool have_secc = !m_remote_ip.empty();
+    m_mtx.unlock();
+    if (have_secc) start_connections();
+}
+// -----------------------------------------------------------------------------
 
-    // If we have a server socket already, throw it away
-    if (m_psock)
-    {
-        m_connected = false;
-        delete m_psock;
-        m_psock = NULL;
-    }
 
-    // Create a new client socket
-    m_psock = new NetSock;
 
-    // Connect to the remote server
-    while (!m_psock->connect(m_remote_ip, m_remote_port, AF_INET6, "qca0"))
+// -----------------------------------------------------------------------------
+// start_connections() - Starts a thread for every connection that doesn't have one
+// -----------------------------------------------------------------------------
+void CClient::start_connections()
+{
+    std::vector<relay_conn_t*> conns = m_conns.take_unstarted();
+    for (size_t i = 0; i < conns.size(); ++i)
     {
-        printf("Failed to connect to %s:%i.  Retrying\n", m_remote_ip.c_str(), m_remote_port);
-        sleep(1);        
+        std::thread th(launch_task, this, conns[i]);
+        th.detach();
     }
+}
+// -----------------------------------------------------------------------------
 
-    // We have a valid connection
-    m_connected = true;
 
-    // Tell the world that we're connected
-    printf("Connected to remote server at %s\n\n", m_remote_ip.c_str());
 
-    // std::string message = "Hello!";
-    // std::string message = "a0b0c0d0e0f000182336b5cd86dd6000000000600640fe80000000000000021823fffe36b5cdfe800000000000003933e74737944644c001ffff0015afc3e089f2a3501840007d96000001fe8001000000448000dbab9371d3234b71d1b981899189d191818991d26b9b3a232b30020000040401d75726e3a69736f3a31353131383a323a323031333a4d73674465660040000000080";
-    //std::string message = "01fe8001000000228000dbab9371d3234b71d1b981899189d191818991d26b9b3a232b30020000040040";
-    // string message = "303166653830303130303030303032323830303064626162393337316433323334623731643162393831383939313839643139313831383939316432366239623361323332623330303230303030303430303430";
-    //CClient::send((void *)message.c_str(), strlen(message.c_str()));
+// -----------------------------------------------------------------------------
+// close() - This will drop every connection. Their threads finish on their own
+// -----------------------------------------------------------------------------
+void CClient::close()
+{
+    m_conns.shutdown_all();
 
-    while (true)
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_remote_ip.clear();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// task() - Connects one relayed connection to the SECC, then relays whatever the
+//          SECC sends on it to the other board, until either side closes it
+// -----------------------------------------------------------------------------
+void CClient::task(relay_conn_t* conn)
+{
+    char buffer[0x10000];
+    NetSock* psock = new NetSock;
+
+    // Our own copy of where the SECC is, so close() can't change it under us
+    m_mtx.lock();
+    std::string remote_ip   = m_remote_ip;
+    int         remote_port = m_remote_port;
+    std::string iface       = m_interface;
+    m_mtx.unlock();
+
+    // Connect to the remote server, backing off a little more after every failure, until
+    // we connect, the deadline passes, or the connection is closed
+    uint64_t start_ms   = msTimer::millis();
+    int      backoff_ms = CONNECT_BACKOFF_MIN_MS;
+    int      attempts   = 1;
+    while (!psock->connect(remote_ip, remote_port, AF_INET6, iface, CONNECT_TIMEOUT_MS))
     {
-        // If RTH data is received over MQTT
-        if (rth_data_received)
+        if (conn->closed) goto done;
+
+        // Give up once the deadline has passed
+        if (msTimer::millis() - start_ms >= CONNECT_DEADLINE_MS)
         {
-            // Convert hexadecimal string to binary
-            char rth_datapacket_bin[65536];
-            size_t bin_length = convert_hex_to_binary(rth_datapacket.c_str(), rth_datapacket_bin);
-
-            printf(BOLD_MAGENTA "<-- (MQTT)" RESET " Received EV req Datapacket (%d bytes): ", bin_length);
-            for (size_t i = 0; i < bin_length; ++i)
-                printf("%02x", (unsigned char)rth_datapacket_bin[i]);
-            printf("\n");
-
-            // Send it to the server
-            // printf("Sending request message to EVSE .. \n");
-            printf(BOLD_BLUE "--> (TCP)" RESET "  Sending EV req Datapacket\n\n");
-            CClient::send((void *)rth_datapacket_bin, bin_length);
-
-            // Wait for data to arrive.  If the client closes the socket, break
-            if (!m_psock->wait_for_data(-1)) break;
-
-            // How many bytes are available to read?
-            int bytes_ready = m_psock->bytes_available();
-            // int bytes_ready = 100;
-
-            // If the other side closed the connection, break
-            if (bytes_ready < 1) break;
-
-            // Don't ready more bytes than our buffer can hold!
-            // if (bytes_ready > sizeof(buffer)) bytes_ready = sizeof(buffer);
-            
-            // Fetch the data-bytes that are available
-            int bytes_rcvd = m_psock->receive(buffer, bytes_ready);
-
-            // If we didn't get all of our bytes, the other side closed the connection
-            if (bytes_rcvd < bytes_ready) break;
-
-
-            // Convert the buffer to a hexadecimal string of proper size
-            int buffer_hex_length = bytes_rcvd * 2 + 1;
-            char buffer_hex[buffer_hex_length];
-            convert_binary_to_hex(buffer, bytes_rcvd, buffer_hex);
-            printf(BOLD_BLUE "<-- (TCP)" RESET "  Received EVSE res Datapacket (%d bytes): %s\n", bytes_rcvd, buffer_hex);
-
-            // Send the received data to the RTH server side
-            printf(BOLD_MAGENTA "--> (MQTT)" RESET " Sending EVSE res Datapacket\n\n");
-            send_message(mqtt.ev_message, buffer_hex);
-            rth_data_received = 0;
+            printf(BOLD_RED "Can't connect to %s:%i after %d attempts\n" RESET, remote_ip.c_str(), remote_port, attempts);
+            logger.log(LOG_ERR, "Can't connect to SECC server");
+            m_failed = true;
+            goto done;
         }
-        // Wait until a new message arrives
-        sleeper.sleep(50);
+
+        usleep(backoff_ms * 1000);
+        backoff_ms = (backoff_ms * 2 > CONNECT_BACKOFF_MAX_MS) ? CONNECT_BACKOFF_MAX_MS : backoff_ms * 2;
+        ++attempts;
     }
 
-    // If we get here, connection is dropped
-    m_connected = false;
-    printf("Remote server dropped connection\n");
-    goto again;
+    // Send each request the moment it's written, and acknowledge responses right away
+    psock->set_low_latency();
 
-}
-// -----------------------------------------------------------------------------
+    // Report how long it took from the SDP response
+    {
+        char line[96];
+        snprintf(line, sizeof(line), "Connected to SECC %llu ms after SDP response (%d attempt%s)",
+                 (unsigned long long)(msTimer::millis() - SDP_done_ms), attempts, attempts == 1 ? "" : "s");
+        printf("%s\n", line);
+        logger.log(LOG_INFO, line);
+    }
 
+    // We have a valid connection. Send the SECC anything that arrived while we were connecting
+    m_conns.set_connected(conn, psock);
 
+    // If the connection was closed while we were connecting, we're done
+    if (conn->closed) goto done;
 
-// -----------------------------------------------------------------------------
-// send() - Sends a buffer to the other side of a connected socket
-// -----------------------------------------------------------------------------
-void CClient::send(void* buffer, int byte_count)
-{
-    if (m_psock && m_connected)
+    while (true)
+    {
+        // Wait for data to arrive.  If the server closes the socket, break
+        if (!psock->wait_for_data(-1)) break;
+
+        // How many bytes are available to read?
+        int bytes_ready = psock->bytes_available();
+
+        // If the other side closed the connection, break
+        if (bytes_ready < 1) break;
+
+        // Don't ready more bytes than our buffer can hold!
+        if (bytes_ready > (int)sizeof(buffer)) bytes_ready = sizeof(buffer);
+
+        // Fetch the data-bytes that are available
+        int bytes_rcvd = psock->receive(buffer, bytes_ready);
+
+        // If we didn't get all of our bytes, the other side closed the connection
+        if (bytes_rcvd < bytes_ready) break;
+
+        // Send it to the other board.  An unclaimed spare has nowhere to send it, and the
+        // SECC never speaks first anyway
+        uint32_t id = m_conns.id_of(conn);
+        if (id) relay_send_data(RELAY_EV_SIDE, id, buffer, bytes_rcvd);
+    }
+
+done:
+
+    // Once it's out of the table nothing else can send on it, so it's safe to throw away
+    m_conns.remove(conn);
+
+    // If the other board didn't close it, tell it to close its side too
+    if (!conn->closed && conn->id)
     {
-        m_psock->send(buffer, byte_count);      
-    }    
+        printf("Remote server dropped connection %u\n", conn->id);
+        relay_send_close(RELAY_EV_SIDE, conn->id);
+    }
+
+    delete psock;
+    delete conn;
 }
 // -----------------------------------------------------------------------------
@@ -15,24 +15,52 @@
 
 #pragma once
 #include <string>
+#include <stdint.h>
 #include "netsock.h"
+#include "relay.h"
 
+// The EV-side half of the TCP relay: for every connection the EV under test opens on the
+// other board, this opens a matching connection to the real SECC
 class CClient
 {
 public:
 
-    CClient() {m_psock = NULL; m_connected = false;}
+    CClient() {m_failed = false;}
 
-    void    launch(std::string remote_ip, int remote_port);
+    // Sets the SECC address, and opens a spare connection to it so the first relayed
+    // connection doesn't have to wait for a connect. 'iface' is the interface the SECC is on
+    void    launch(std::string remote_ip, int remote_port, std::string iface = "qca0");
 
-    void    send(void* buffer, int byte_count);
+    // Called from the MQTT thread when the other board opens connection 'id'
+    void    open(uint32_t id);
 
-    void    task();
+    // Called from the MQTT thread with data for, or the closing of, connection 'id'
+    bool    deliver(uint32_t id, const std::string& data) {return m_conns.deliver(id, data);}
+    void    close_connection(uint32_t id) {m_conns.shutdown(id);}
+
+    // Ends the session: drops every connection
+    void    close();
+
+    // The thread that services one connection
+    void    task(relay_conn_t* conn);
+
+    // Returns true if a connection gave up trying to connect
+    bool    has_failed() {return m_failed;}
 
 protected:
-    
-    bool        m_connected;
+
+    // Starts a thread for every connection that doesn't have one
+    void    start_connections();
+
+    volatile bool m_failed;
+
+    // Where the SECC is. Set and cleared on the main thread, and read by the MQTT thread and
+    // the connection threads, so it's guarded by m_mtx
     std::string m_remote_ip;
     int         m_remote_port;
-    NetSock*    m_psock;
+    std::string m_interface;
+    std::mutex  m_mtx;
+
+    // The connections to the SECC
+    CRelayTable m_conns;
 };
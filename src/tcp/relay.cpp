@@ -0,0 +1,553 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// relay.cpp - Relays TCP connections between the EV under test and the EVSE under test, via MQTT
+//==========================================================================================================
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "relay.h"
+
+extern CClient Client;
+
+// In loopback mode, the role that handles each half of the relay. NULL when we're using MQTT
+static CRole* loop_roles[2] = {NULL, NULL};
+
+// The ports the relay benchmark uses on the loopback interface
+#define BENCH_RELAY_PORT    61851
+#define BENCH_SECC_PORT     61852
+#define BENCH_MESSAGE_SIZE  96
+
+
+// -----------------------------------------------------------------------------
+// add() - Adds a connection to the table
+// -----------------------------------------------------------------------------
+void CRelayTable::add(relay_conn_t* conn)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_conns.push_back(conn);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// remove() - Removes a connection from the table. Nothing can deliver to it after this
+// -----------------------------------------------------------------------------
+void CRelayTable::remove(relay_conn_t* conn)
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    for (size_t i = 0; i < m_conns.size(); ++i)
+    {
+        if (m_conns[i] == conn)
+        {
+            m_conns.erase(m_conns.begin() + i);
+            break;
+        }
+    }
+
+    // The caller is about to delete it, so let any send in progress finish first
+    while (conn->senders) m_cv.wait(lock);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// deliver() - Sends data on a connection, or queues it until the connection is up
+// -----------------------------------------------------------------------------
+bool CRelayTable::deliver(uint32_t id, const std::string& data)
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    relay_conn_t* conn = NULL;
+    for (size_t i = 0; i < m_conns.size() && conn == NULL; ++i)
+    {
+        if (m_conns[i]->id == id) conn = m_conns[i];
+    }
+    if (conn == NULL) return false;
+
+    if (conn->psock == NULL)
+    {
+        conn->pending.push_back(data);
+        return true;
+    }
+
+    // Send without the table locked, so the other connections carry on meanwhile
+    ++conn->senders;
+    lock.unlock();
+
+    conn->send_mtx.lock();
+    conn->psock->send(data.c_str(), data.size());
+    conn->send_mtx.unlock();
+
+    lock.lock();
+    if (--conn->senders == 0) m_cv.notify_all();
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// set_connected() - Attaches a connected socket and flushes anything that was queued
+// -----------------------------------------------------------------------------
+void CRelayTable::set_connected(relay_conn_t* conn, NetSock* psock)
+{
+    // Anything delivered from now on goes straight to the socket, but has to wait on
+    // send_mtx until what was queued before it has gone out
+    m_mtx.lock();
+    conn->psock = psock;
+    std::deque<std::string> pending;
+    pending.swap(conn->pending);
+    conn->send_mtx.lock();
+    m_mtx.unlock();
+
+    for (size_t i = 0; i < pending.size(); ++i)
+        psock->send(pending[i].c_str(), pending[i].size());
+
+    conn->send_mtx.unlock();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// shutdown() - Closes a single connection
+// -----------------------------------------------------------------------------
+void CRelayTable::shutdown(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (size_t i = 0; i < m_conns.size(); ++i)
+    {
+        relay_conn_t* conn = m_conns[i];
+        if (conn->id != id) continue;
+
+        // A connection without a thread has nobody to clean it up but us
+        if (!conn->started)
+        {
+            m_conns.erase(m_conns.begin() + i);
+            delete conn;
+            return;
+        }
+
+        conn->closed = true;
+        if (conn->psock) conn->psock->shutdown();
+        return;
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// shutdown_all() - Closes every connection
+// -----------------------------------------------------------------------------
+void CRelayTable::shutdown_all()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (size_t i = 0; i < m_conns.size();)
+    {
+        relay_conn_t* conn = m_conns[i];
+        if (!conn->started)
+        {
+            m_conns.erase(m_conns.begin() + i);
+            delete conn;
+            continue;
+        }
+
+        conn->closed = true;
+        if (conn->psock) conn->psock->shutdown();
+        ++i;
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// claim_spare() - Gives the unclaimed spare connection an ID
+// -----------------------------------------------------------------------------
+bool CRelayTable::claim_spare(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (size_t i = 0; i < m_conns.size(); ++i)
+    {
+        if (m_conns[i]->id == 0 && !m_conns[i]->closed)
+        {
+            m_conns[i]->id = id;
+            return true;
+        }
+    }
+    return false;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// id_of() - Returns the current ID of a connection
+// -----------------------------------------------------------------------------
+uint32_t CRelayTable::id_of(relay_conn_t* conn)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return conn->id;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// take_unstarted() - Returns the connections that still need a thread
+// -----------------------------------------------------------------------------
+std::vector<relay_conn_t*> CRelayTable::take_unstarted()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    std::vector<relay_conn_t*> result;
+    for (size_t i = 0; i < m_conns.size(); ++i)
+    {
+        if (m_conns[i]->started) continue;
+        m_conns[i]->started = true;
+        result.push_back(m_conns[i]);
+    }
+    return result;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// count() - Returns the number of connections
+// -----------------------------------------------------------------------------
+size_t CRelayTable::count()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_conns.size();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// relay_topic() - Returns the topic one half of the relay sends messages on
+// -----------------------------------------------------------------------------
+static const std::string& relay_topic(relay_side_t from)
+{
+    return (from == RELAY_EVSE_SIDE) ? mqtt.evse_message : mqtt.ev_message;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// relay_set_loopback() - Puts the relay in, or takes it out of, loopback mode
+// -----------------------------------------------------------------------------
+void relay_set_loopback(CRole* evse_role, CRole* ev_role)
+{
+    loop_roles[RELAY_EVSE_SIDE] = evse_role;
+    loop_roles[RELAY_EV_SIDE]   = ev_role;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// relay_send_open() - Tells the EV-side half to open connection 'id' to the real SECC
+// -----------------------------------------------------------------------------
+void relay_send_open(uint32_t id)
+{
+    tcpdump.note("Relay [%u] opened by the EV under test", id);
+
+    if (loop_roles[RELAY_EV_SIDE])
+    {
+        loop_roles[RELAY_EV_SIDE]->relay_open(id);
+        return;
+    }
+
+    char message[16];
+    snprintf(message, sizeof(message), "O,%u", id);
+    send_message(relay_topic(RELAY_EVSE_SIDE), message);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// relay_send_data() - Sends data that arrived on connection 'id' to the other half
+// -----------------------------------------------------------------------------
+void relay_send_data(relay_side_t from, uint32_t id, const char* buffer, int length)
+{
+    tcpdump.note("Relay [%u] %d bytes from the %s", id, length, (from == RELAY_EVSE_SIDE) ? "EV under test" : "SECC");
+
+    // In loopback mode the other half takes the data as it is
+    CRole* peer = loop_roles[from == RELAY_EVSE_SIDE ? RELAY_EV_SIDE : RELAY_EVSE_SIDE];
+    if (peer)
+    {
+        peer->relay_deliver(id, std::string(buffer, length));
+        return;
+    }
+
+    // Encode the data the way the handshake agreed on, in frames no bigger than the other board takes
+    rth_link_t link    = handshake.link();
+    bool       base64  = (link.encoding == LINK_ENC_BASE64);
+    bool       is_evse = (from == RELAY_EVSE_SIDE);
+
+    printf(BOLD_BLUE "<-- (TCP)" RESET "  [%u] Received %s Datapacket (%d bytes)\n", id,
+           is_evse ? "EV req" : "EVSE res", length);
+
+    for (int offset = 0; offset < length; offset += link.max_frame)
+    {
+        int frame = (length - offset < link.max_frame) ? length - offset : link.max_frame;
+
+        // Build "B,<id>," followed by the data in base64, or "D,<id>," followed by it in hex
+        std::vector<char> message(16 + frame * 2 + 1);
+        int prefix = snprintf(&message[0], 16, "%c,%u,", base64 ? 'B' : 'D', id);
+        if (base64) convert_binary_to_base64(buffer + offset, frame, &message[prefix]);
+        else        convert_binary_to_hex(buffer + offset, frame, &message[prefix]);
+
+        printf(BOLD_MAGENTA "--> (MQTT)" RESET " [%u] Sending %s Datapacket: %s\n\n", id,
+               is_evse ? "EV req" : "EVSE res", &message[prefix]);
+
+        send_message(relay_topic(from), &message[0]);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// relay_send_close() - Tells the other half that connection 'id' closed on our side
+// -----------------------------------------------------------------------------
+void relay_send_close(relay_side_t from, uint32_t id)
+{
+    tcpdump.note("Relay [%u] closed on our side", id);
+
+    CRole* peer = loop_roles[from == RELAY_EVSE_SIDE ? RELAY_EV_SIDE : RELAY_EVSE_SIDE];
+    if (peer)
+    {
+        peer->relay_close(id);
+        return;
+    }
+
+    char message[16];
+    snprintf(message, sizeof(message), "C,%u", id);
+    send_message(relay_topic(from), message);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// relay_on_message() - Handles a relay message from the other board
+// -----------------------------------------------------------------------------
+void relay_on_message(const std::string& message)
+{
+    // Every relay message starts with its kind and a connection ID
+    char     kind;
+    unsigned id;
+    if (sscanf(message.c_str(), "%c,%u", &kind, &id) != 2 || id == 0) return;
+
+    bool is_evse = role->is_evse();
+
+    // The EVSE-side board accepted a new connection from the EV under test
+    if (kind == 'O')
+    {
+        tcpdump.note("Relay [%u] opened by the other board", id);
+        role->relay_open(id);
+    }
+
+    // Data for one of our connections
+    else if (kind == 'D' || kind == 'B')
+    {
+        // The encoded data follows the second comma
+        const char* text = strchr(message.c_str() + 2, ',');
+        if (text == NULL) return;
+        ++text;
+
+        std::vector<char> buffer(strlen(text) + 1);
+        size_t length = (kind == 'B') ? convert_base64_to_binary(text, &buffer[0])
+                                      : convert_hex_to_binary(text, &buffer[0]);
+        std::string data(&buffer[0], length);
+        tcpdump.note("Relay [%u] %u bytes from the other board", id, (unsigned)length);
+
+        printf(BOLD_MAGENTA "<-- (MQTT)" RESET " [%u] Received %s Datapacket (%u bytes): %s\n", id,
+               is_evse ? "EVSE res" : "EV req", (unsigned)length, text);
+        printf(BOLD_BLUE "--> (TCP)" RESET "  [%u] Sending %s Datapacket\n\n", id, is_evse ? "EVSE res" : "EV req");
+
+        if (!role->relay_deliver(id, data)) printf("No relay connection %u, datapacket dropped\n", id);
+    }
+
+    // The other board's side of a connection closed
+    else if (kind == 'C')
+    {
+        tcpdump.note("Relay [%u] closed by the other board", id);
+        role->relay_close(id);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start_relay_benchmark() - Starts both halves of the relay in this process, for benchmarking:
+//                           the server the EV end connects to, and the client that connects to
+//                           the SECC. SLAC and SDP don't run
+// -----------------------------------------------------------------------------
+void start_relay_benchmark(const std::string& ev_iface, const std::string& secc_ip, int secc_port,
+                           const std::string& secc_iface)
+{
+    static CEVSERole evse_role;
+    static CEVRole   ev_role;
+    relay_set_loopback(&evse_role, &ev_role);
+
+    // Start the client first, so a spare connection to the SECC is ready for the EV
+    SDP_done_ms = msTimer::millis();
+    Client.launch(secc_ip, secc_port, secc_iface);
+    Server.launch(TCP_port, ev_iface);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// stop_relay_benchmark() - Drops every relayed connection and takes the relay out of loopback mode
+// -----------------------------------------------------------------------------
+void stop_relay_benchmark()
+{
+    Server.close();
+    Client.close();
+    relay_set_loopback(NULL, NULL);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// bench_secc_task() - Stands in for the SECC in the relay benchmark, echoing back
+//                     whatever arrives on each connection
+// -----------------------------------------------------------------------------
+static void bench_secc_task(NetSock* listener)
+{
+    char buffer[0x1000];
+
+    while (true)
+    {
+        NetSock conn;
+        if (!listener->accept(-1, &conn)) continue;
+        conn.set_low_latency();
+
+        while (conn.wait_for_data(-1))
+        {
+            int bytes_ready = conn.bytes_available();
+            if (bytes_ready < 1) break;
+            if (bytes_ready > (int)sizeof(buffer)) bytes_ready = sizeof(buffer);
+            if (conn.receive(buffer, bytes_ready) < bytes_ready) break;
+            conn.send(buffer, bytes_ready);
+        }
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// benchmark_relay() - Times requests from a simulated EV through both halves of
+//                     the relay, in loopback mode, to an echoing SECC and back
+// -----------------------------------------------------------------------------
+void benchmark_relay(int iterations)
+{
+    if (iterations <= 0) iterations = 1;
+
+    // Both halves of the relay live in this process
+    CEVSERole evse_role;
+    CEVRole   ev_role;
+    relay_set_loopback(&evse_role, &ev_role);
+
+    // Start the stand-in SECC
+    NetSock secc;
+    if (!secc.create_server(BENCH_SECC_PORT, "::1", AF_INET6, "lo"))
+    {
+        fprintf(stderr, "Can't create the benchmark SECC on TCP port %d\n", BENCH_SECC_PORT);
+        return;
+    }
+    secc.listen(4);
+    std::thread th(bench_secc_task, &secc);
+    th.detach();
+
+    // Start both halves of the relay, the way the state machine would
+    Server.launch(BENCH_RELAY_PORT, "lo");
+    SDP_done_ms = msTimer::millis();
+    Client.launch("::1", BENCH_SECC_PORT, "lo");
+
+    // Connect the simulated EV. The server may take a moment to start listening
+    NetSock ev;
+    bool connected = false;
+    for (int attempt = 0; attempt < 100 && !connected; ++attempt)
+    {
+        connected = ev.connect("::1", BENCH_RELAY_PORT, AF_INET6, "lo", 1000);
+        if (!connected) usleep(10000);
+    }
+    if (!connected)
+    {
+        fprintf(stderr, "Can't connect to the relay on TCP port %d\n", BENCH_RELAY_PORT);
+        return;
+    }
+    ev.set_low_latency();
+
+    // Send each request and wait for it to come back
+    char request[BENCH_MESSAGE_SIZE], response[BENCH_MESSAGE_SIZE];
+    memset(request, 0x5a, sizeof(request));
+    std::vector<double> rtt_us(iterations);
+    for (int i = 0; i < iterations; ++i)
+    {
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        ev.send(request, sizeof(request));
+        if (!ev.wait_for_data(1000) || ev.receive(response, sizeof(response)) < (int)sizeof(response))
+        {
+            fprintf(stderr, "No response to request %d\n", i);
+            return;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        rtt_us[i] = (now.tv_sec - start.tv_sec) * 1e6 + (now.tv_nsec - start.tv_nsec) / 1e3;
+    }
+
+    // Report the spread
+    double total = 0;
+    for (int i = 0; i < iterations; ++i) total += rtt_us[i];
+    std::sort(rtt_us.begin(), rtt_us.end());
+
+    printf("Relay round trip over %d requests of %d bytes, loopback mode:\n", iterations, BENCH_MESSAGE_SIZE);
+    printf("  min %8.1f us\n", rtt_us[0]);
+    printf("  avg %8.1f us\n", total / iterations);
+    printf("  p50 %8.1f us\n", rtt_us[iterations / 2]);
+    printf("  p99 %8.1f us\n", rtt_us[(iterations * 99) / 100]);
+    printf("  max %8.1f us\n", rtt_us[iterations - 1]);
+
+    relay_set_loopback(NULL, NULL);
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// relay.h - Relays TCP connections between the EV under test and the EVSE under test, via MQTT
+//
+// The EVSE-side board accepts TCP connections from the EV under test, and the EV-side board opens a
+// matching connection to the real SECC for each one.  Each connection gets an ID from the EVSE-side
+// board, and every relay message carries it:
+//
+//      "O,<id>"          EVSE-side board -> EV-side board: the EV under test opened connection <id>
+//      "D,<id>,<hex>"    Either direction: data that arrived on connection <id>
+//      "B,<id>,<base64>" The same, in base64, when the handshake agreed on it (see handshake.h)
+//      "C,<id>"          Either direction: connection <id> was closed on this side
+//
+// Several connections can be open at once, so an EV that opens a new connection before closing the
+// old one (ISO 15118 pause/resume, for instance) never waits for the old one to be torn down.
+//
+// Normally the two halves of the relay are on different boards and talk over MQTT.  In loopback mode
+// both halves are in this process, and relay messages go straight from one to the other, as binary,
+// without touching the broker.  That gives the best relay latency we can hope for, as a baseline.
+// Loopback mode is for benchmarking only.  SLAC and SDP don't run in it at all, so no device under test
+// can form an AVLN with us or discover us: the EV end has to connect straight to our relay port, and the
+// SECC's address is given to us.  "rth --benchmark-relay" times it against a built-in EV and SECC, and
+// "rth --benchmark-relay-live" relays for EV and SECC endpoints that are already reachable over IP.
+//==========================================================================================================
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "netsock.h"
+
+class CRole;
+
+// The two halves of the relay: the server the EV under test connects to, and the client that
+// connects to the SECC of the EVSE under test
+enum relay_side_t {RELAY_EVSE_SIDE, RELAY_EV_SIDE};
+
+// -----------------------------------------------------------------------------
+// relay_conn_t - One relayed TCP connection
+// -----------------------------------------------------------------------------
+struct relay_conn_t
+{
+    uint32_t        id;         // The connection ID, or 0 for the EV-side board's unclaimed spare
+    NetSock*        psock;      // The connected socket, or NULL if we're not connected yet
+    volatile bool   closed;     // Set to make the connection's thread finish
+    bool            started;    // True once a thread owns this connection
+
+    // Data from the other board that arrived before we were connected
+    std::deque<std::string> pending;
+
+    // Sends on the socket happen outside the table's lock, one at a time. 'senders' counts the
+    // sends in progress, so the connection isn't removed from under them
+    std::mutex      send_mtx;
+    int             senders;
+
+    relay_conn_t(uint32_t conn_id) {id = conn_id; psock = NULL; closed = false; started = false; senders = 0;}
+};
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// CRelayTable - The relayed connections that are currently open.  Each connection
+//               belongs to the thread that services it; the table just finds them
+// -----------------------------------------------------------------------------
+class CRelayTable
+{
+public:
+
+    // Adds and removes a connection. remove() waits for any send on it to finish
+    void    add(relay_conn_t* conn);
+    void    remove(relay_conn_t* conn);
+
+    // Sends data on connection 'id', or queues it if that connection isn't connected yet.
+    // The send happens outside the table's lock, so a slow peer only holds up its own
+    // connection. Returns false if there's no such connection
+    bool    deliver(uint32_t id, const std::string& data);
+
+    // Attaches a newly connected socket to a connection and sends it anything that was queued
+    void    set_connected(relay_conn_t* conn, NetSock* psock);
+
+    // Closes connection 'id', or every connection.  Connections with a thread are shut down
+    // so the thread finishes; connections without one are simply discarded
+    void    shutdown(uint32_t id);
+    void    shutdown_all();
+
+    // Gives the unclaimed spare connection an ID. Returns false if there isn't one
+    bool    claim_spare(uint32_t id);
+
+    // Returns the current ID of a connection
+    uint32_t id_of(relay_conn_t* conn);
+
+    // Returns the connections that don't have a thread yet, and marks them as started
+    std::vector<relay_conn_t*> take_unstarted();
+
+    // Returns the number of connections
+    size_t  count();
+
+protected:
+
+    // There are only ever a handful of connections, so a list is all we need
+    std::vector<relay_conn_t*> m_conns;
+    std::mutex  m_mtx;
+
+    // Wakes remove() when the last send on a connection finishes
+    std::condition_variable m_cv;
+};
+// -----------------------------------------------------------------------------
+
+// Sends relay messages from one half of the relay to the other
+void relay_send_open(uint32_t id);
+void relay_send_data(relay_side_t from, uint32_t id, const char* buffer, int length);
+void relay_send_close(relay_side_t from, uint32_t id);
+
+// Handles a relay message from the other board. This runs on the MQTT thread
+void relay_on_message(const std::string& message);
+
+// Puts the relay in loopback mode, with both halves in this process. Relay messages from one
+// role go straight to the other. Pass NULLs to go back to MQTT
+void relay_set_loopback(CRole* evse_role, CRole* ev_role);
+
+// Starts both halves of the relay in loopback mode, for benchmarking. An EV end that's already
+// reachable over IP connects on 'ev_iface', on the port SDP would advertise, and each of its
+// connections is relayed to the SECC at 'secc_ip' and 'secc_port' on 'secc_iface'. Neither SLAC
+// nor SDP runs. The relay runs on its own threads until stop_relay_benchmark()
+void start_relay_benchmark(const std::string& ev_iface, const std::string& secc_ip, int secc_port,
+                           const std::string& secc_iface);
+void stop_relay_benchmark();
+
+// Runs both halves of the relay in loopback mode on this machine, between a simulated EV and
+// an echoing SECC, and prints the round-trip time through the relay
+void benchmark_relay(int iterations);
+
+//==========================================================================================================
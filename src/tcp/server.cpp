@@ -25,13 +25,15 @@
 extern CClient Client;
 
 static void launch_task(CServer* p) {p->task();}
+static void launch_connection(CServer* p, relay_conn_t* conn) {p->connection_task(conn);}
 
 // -----------------------------------------------------------------------------
 // launch() - This will launch the server-side thread
 // -----------------------------------------------------------------------------
-void CServer::launch(int local_port)
+void CServer::launch(int local_port, std::string iface)
 {
     m_local_port = local_port;
+    m_interface = iface;
     std::thread th(launch_task, this);
     th.detach();
 }
@@ -39,129 +41,121 @@ void CServer::launch(int local_port)
 
 
 // -----------------------------------------------------------------------------
-// close() - This will close the client-side thread
+// close() - This will close the listening socket and every connection
 // -----------------------------------------------------------------------------
 void CServer::close()
 {
-    m_psock->close();
+    m_conns.shutdown_all();
+    m_listener.close();
 }
 // -----------------------------------------------------------------------------
 
 
 
 // -----------------------------------------------------------------------------
-// task() - The server-side task that creates a server on agiven port, listens
-//          for incoming connects and waits for data to arrive. It will also send
-//          data back on the port when needed
+// drop() - This will disconnect every client. The server thread keeps accepting
+//          new ones
 // -----------------------------------------------------------------------------
-void CServer::task()
+void CServer::drop()
 {
-    char buffer[0x10000];
+    m_conns.shutdown_all();
+}
+// -----------------------------------------------------------------------------
 
-again:
 
-    // If application interrupted by a signal, exit it
-    if (signal_captured) exit_app(0);
 
-    // If we have a server socket already, throw it away
-    if (m_psock)
+// -----------------------------------------------------------------------------
+// task() - The server-side task that creates a server on a given port and accepts
+//          incoming connects.  Each connection gets an ID and a thread of its own,
+//          so a new connection never waits for an old one to be torn down
+// -----------------------------------------------------------------------------
+void CServer::task()
+{
+    // Create the server socket once, and keep it listening between clients
+    if (!m_listener.create_server(m_local_port, "", AF_INET6, m_interface))
     {
-        m_connected = false;
-        delete m_psock;
-        m_psock = NULL;
+        fprintf(stderr, "Can't create server on TCP port %d\n", m_local_port);
+        return;
     }
+    m_listener.listen(4);
 
-    // Create a new server socket
-    m_psock = new NetSock;
-    m_psock->create_server(m_local_port, "", AF_INET6, "qca0");
+    while (true)
+    {
+        // If application interrupted by a signal, exit it
+        if (signal_captured) exit_app(0);
+
+        // Wait for someone to connect
+        NetSock* psock = new NetSock;
+        if (!m_listener.accept(-1, psock))
+        {
+            delete psock;
+            continue;
+        }
+
+        // Answer the EV under test without Nagle or delayed-ACK stalls
+        psock->set_low_latency();
+
+        // Give the connection an ID and add it to the table
+        relay_conn_t* conn = new relay_conn_t(++m_next_id);
+        conn->started = true;
+        m_conns.add(conn);
+        m_conns.set_connected(conn, psock);
+        printf("Remote client %u connected to server (%u open)\n\n", conn->id, (unsigned)m_conns.count());
+
+        // Have the other board open a matching connection to the SECC.  This goes out before
+        // the connection's thread starts, so it always arrives ahead of the connection's data
+        relay_send_open(conn->id);
+
+        std::thread th(launch_connection, this, conn);
+        th.detach();
+    }
+}
+// -----------------------------------------------------------------------------
 
-    // Wait for someone to connect
-    m_psock->listen_and_accept();
 
-    // We have a client connected to us
-    m_connected = true;
-    printf("Remote client connected to server\n\n");
 
+// -----------------------------------------------------------------------------
+// connection_task() - Relays whatever the EV under test sends on one connection to
+//                     the other board, until either side closes it
+// -----------------------------------------------------------------------------
+void CServer::connection_task(relay_conn_t* conn)
+{
+    char buffer[0x10000];
+    NetSock* psock = conn->psock;
 
     while (true)
-    {   
+    {
         // Wait for data to arrive.  If the client closes the socket, break
-        if (!m_psock->wait_for_data(-1)) break;
-      
+        if (!psock->wait_for_data(-1)) break;
+
         // How many bytes are available to read?
-        int bytes_ready = m_psock->bytes_available();
+        int bytes_ready = psock->bytes_available();
 
         // If the other side closed the connection, break
         if (bytes_ready < 1) break;
 
         // Don't ready more bytes than our buffer can hold!
-        if (bytes_ready > sizeof(buffer)) bytes_ready = sizeof(buffer);
-        
+        if (bytes_ready > (int)sizeof(buffer)) bytes_ready = sizeof(buffer);
+
         // Fetch the data-bytes that are available
-        int bytes_rcvd = m_psock->receive(buffer, bytes_ready);
+        int bytes_rcvd = psock->receive(buffer, bytes_ready);
 
         // If we didn't get all of our bytes, the other side closed the connection
         if (bytes_rcvd < bytes_ready) break;
 
-        // Convert the buffer to a string iteratively ignoring any null terminators in the buffer
-        std::string buffer_str(buffer, bytes_rcvd);
-
-        // Convert the buffer to a hexadecimal string of proper size
-        int buffer_hex_length = bytes_rcvd * 2 + 1;
-        char buffer_hex[buffer_hex_length];
-        convert_binary_to_hex(buffer, bytes_rcvd, buffer_hex);
-        printf(BOLD_BLUE "<-- (TCP)" RESET "  Received EV req Datapacket (%d bytes): %s\n", bytes_rcvd, buffer_hex);
-
-        // Send message to the global broker
-        printf(BOLD_MAGENTA "--> (MQTT)" RESET " Sending EV req Datapacket\n\n");
-        send_message(mqtt.evse_message, buffer_hex);
-
-        // Wait here until a response is received
-        while (1)
-        {   
-            // If RTH data is received over MQTT
-            if (rth_data_received)
-            {
-                // Convert hexadecimal string to binary
-                char rth_datapacket_bin[65536];
-                size_t bin_length = convert_hex_to_binary(rth_datapacket.c_str(), rth_datapacket_bin);
-
-                printf(BOLD_MAGENTA "<-- (MQTT)" RESET " Received EVSE res Datapacket (%d bytes): ", bin_length);
-                for (size_t i = 0; i < bin_length; ++i)
-                    printf("%02x", (unsigned char)rth_datapacket_bin[i]);
-                printf("\n");
-                
-                printf(BOLD_BLUE "--> (TCP)" RESET "  Sending EVSE res Datapacket\n\n");
-                CServer::send((void *)rth_datapacket_bin, bin_length);
-                rth_data_received = 0;
-
-                break;
-            }
-
-            // Wait until a new message arrives
-            sleeper.sleep(50);
-        }
-
-        // else break;
+        // Send it to the other board
+        relay_send_data(RELAY_EVSE_SIDE, conn->id, buffer, bytes_rcvd);
     }
 
-    // Connection is closed if we get here
-    m_connected = false;
-    printf("Remote client disconnected from server\n");
-    goto again;
-}
-// -----------------------------------------------------------------------------
-
+    // Connection is closed if we get here.  Once it's out of the table nothing else can
+    // send on it, so it's safe to throw away
+    m_conns.remove(conn);
 
+    // If the other board didn't close it, tell it to close its side too
+    if (!conn->closed) relay_send_close(RELAY_EVSE_SIDE, conn->id);
 
-// -----------------------------------------------------------------------------
-// send() - Sends data over the connected socket
-// -----------------------------------------------------------------------------
-void CServer::send(void* buffer, int byte_count)
-{
-    if (m_psock && m_connected)
-    {
-        m_psock->send(buffer, byte_count);      
-    }    
+    printf("Remote client %u disconnected from server\n", conn->id);
+    delete psock;
+    delete conn;
 }
 // -----------------------------------------------------------------------------
@@ -14,24 +14,45 @@
 
 
 #pragma once
+#include <stdint.h>
+#include <string>
 #include "netsock.h"
+#include "relay.h"
 
+// The EVSE-side half of the TCP relay: accepts connections from the EV under test, and
+// services each one on a thread of its own
 class CServer
 {
 public:
-    CServer() {m_psock = NULL; m_connected = false;}
+    CServer() {m_next_id = 0;}
 
-    void    launch(int local_port);
-
-    void    send(void* buffer, int byte_count);
+    // Starts accepting connections on 'local_port' of network interface 'iface'
+    void    launch(int local_port, std::string iface = "qca0");
 
     void    task();
 
+    // The thread that services one connection
+    void    connection_task(relay_conn_t* conn);
+
+    // Called from the MQTT thread with data for, or the closing of, connection 'id'
+    bool    deliver(uint32_t id, const std::string& data) {return m_conns.deliver(id, data);}
+    void    close_connection(uint32_t id) {m_conns.shutdown(id);}
+
     void    close();
 
+    // Ends the session: drops every connected client but keeps serving
+    void    drop();
+
 protected:
 
-    bool        m_connected;
     int         m_local_port;
-    NetSock*    m_psock;
+    std::string m_interface;
+
+    // The listening socket stays open for the life of the server, so a client can connect
+    // the moment it's ready
+    NetSock     m_listener;
+
+    // The connections from the EV under test, and the ID to give the next one
+    CRelayTable m_conns;
+    uint32_t    m_next_id;
 };
@@ -0,0 +1,282 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// telemetry.cpp - Change-driven publishing of J1772 status to the MQTT broker
+//==========================================================================================================
+
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "schema.h"
+#include "telemetry.h"
+
+
+// -----------------------------------------------------------------------------
+// init() - Saves our settings and arranges for the next sample to be published
+// -----------------------------------------------------------------------------
+void CTelemetry::init(const std::string& topic, double deadband_V, double deadband_duty, int deadband_freq,
+                      int batch_ms, int max_age_ms, int max_batch)
+{
+    m_topic         = topic;
+    m_deadband_V    = deadband_V;
+    m_deadband_duty = deadband_duty;
+    m_deadband_freq = deadband_freq;
+    m_batch_ms      = batch_ms;
+    m_max_age_ms    = max_age_ms;
+    m_max_batch     = (max_batch > 0) ? max_batch : 1;
+
+    // Start with an empty batch
+    m_batch.clear();
+    m_batch_count = 0;
+
+    // Make room for a full batch plus the latest values. A batch entry is well under 192 bytes
+    m_message.resize(256 + m_max_batch * 192);
+
+    // The very first sample we see always gets published
+    m_have_published = false;
+    m_is_initialized = true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// update() - Publishes the sample now, adds it to the batch, or drops it
+// -----------------------------------------------------------------------------
+void CTelemetry::update(const J1772_t& sample)
+{
+    // If we haven't been configured, there's nowhere to publish to
+    if (!m_is_initialized) return;
+
+    // Subscribers need to know where we're starting from
+    if (!m_have_published)
+    {
+        publish(sample, "initial");
+        return;
+    }
+
+    // State changes are what the other side acts on, so they go out immediately
+    if (state_changed(sample, m_published))
+    {
+        publish(sample, "state");
+        return;
+    }
+
+    // So does an analog value that has moved significantly since we last published
+    if (beyond_deadband(sample, m_published))
+    {
+        publish(sample, "deadband");
+        return;
+    }
+
+    // Otherwise, if the sample is different from the last one we batched, add it to the batch
+    if (analog_changed(sample, m_batched))
+    {
+        // Fetch the wall-clock time in milliseconds
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+
+        // Format the entry
+        char entry[192];
+        CJsonWriter writer(entry, sizeof(entry));
+        writer.begin();
+        writer.field("t",                (double)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+        writer.field("Vpilot",           sample.Vpilot);
+        writer.field("Vpilot_min",       sample.Vpilot_min);
+        writer.field("Vprox",            sample.Vprox);
+        writer.field("pilot_duty_cycle", sample.pilot_duty_cycle);
+        writer.field("pilot_freq",       sample.pilot_freq);
+        int length = writer.end();
+
+        // And add it to the batch
+        if (length > 0)
+        {
+            m_batch += m_batch_count ? ',' : '[';
+            m_batch.append(entry, length);
+            ++m_batch_count;
+        }
+
+        // Remember what we batched so an unchanged reading isn't batched twice
+        m_batched = sample;
+
+        // If this is the first entry, start the clock on the batch
+        if (m_batch_count == 1) m_batch_timer.start(m_batch_ms);
+
+        // Don't let a noisy signal grow the batch without bound
+        if (m_batch_count >= m_max_batch)
+        {
+            publish(sample, "batch");
+            return;
+        }
+    }
+
+    // If the batch is due, publish it
+    if (m_batch_timer.is_expired())
+    {
+        publish(sample, "batch");
+        return;
+    }
+
+    // If nothing has gone out for a while, let subscribers know we're still here
+    if (m_max_age_timer.is_expired()) publish(sample, "heartbeat");
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// state_changed() - Returns true if any of the discrete J1772 states differ
+// -----------------------------------------------------------------------------
+bool CTelemetry::state_changed(const J1772_t& a, const J1772_t& b)
+{
+    return a.pilot_state      != b.pilot_state
+        || a.pilot_state_name != b.pilot_state_name
+        || a.prox_state       != b.prox_state
+        || a.pwm_comm_state   != b.pwm_comm_state;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// beyond_deadband() - Returns true if any analog value moved by more than its deadband
+// -----------------------------------------------------------------------------
+bool CTelemetry::beyond_deadband(const J1772_t& a, const J1772_t& b)
+{
+    return fabs(a.Vpilot           - b.Vpilot)           > m_deadband_V
+        || fabs(a.Vpilot_min       - b.Vpilot_min)       > m_deadband_V
+        || fabs(a.Vprox            - b.Vprox)            > m_deadband_V
+        || fabs(a.pilot_duty_cycle - b.pilot_duty_cycle) > m_deadband_duty
+        || abs(a.pilot_freq        - b.pilot_freq)       > m_deadband_freq;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// analog_changed() - Returns true if any analog value differs at all
+// -----------------------------------------------------------------------------
+bool CTelemetry::analog_changed(const J1772_t& a, const J1772_t& b)
+{
+    return a.Vpilot           != b.Vpilot
+        || a.Vpilot_min       != b.Vpilot_min
+        || a.Vprox            != b.Vprox
+        || a.pilot_duty_cycle != b.pilot_duty_cycle
+        || a.pilot_freq       != b.pilot_freq;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// publish() - Publishes a status message for 'sample', carrying the pending batch with it
+// -----------------------------------------------------------------------------
+void CTelemetry::publish(const J1772_t& sample, const char* reason)
+{
+    // The latest values go at the top level, exactly where parse_J1772_status() expects them
+    CJsonWriter writer(&m_message[0], m_message.size());
+    writer.begin();
+    schema<J1772_t>::visit(writer, sample);
+    writer.field("reason", reason);
+
+    // Any samples collected since the last publish ride along
+    if (m_batch_count)
+    {
+        m_batch += ']';
+        writer.raw("batch", m_batch.c_str(), m_batch.size());
+    }
+
+    // And send it
+    int length = writer.end();
+    if (length > 0)
+        send_message(m_topic, std::string(&m_message[0], length));
+    else
+        logger.log(LOG_WARNING, "J1772 telemetry message too large, dropped");
+
+    // The batch has been delivered
+    m_batch.clear();
+    m_batch_count = 0;
+    m_batch_timer.stop();
+
+    // Everything from here on is compared against what we just published
+    m_published      = sample;
+    m_batched        = sample;
+    m_have_published = true;
+
+    // Restart the heartbeat clock
+    m_max_age_timer.start(m_max_age_ms);
+}
+// -----------------------------------------------------------------------------
+
+
+
+
+// -----------------------------------------------------------------------------
+// on_plc_link() - Called by the PLC link poller with each result
+// -----------------------------------------------------------------------------
+void CTelemetry::on_plc_link(const plc_link_t& link, void* ctx)
+{
+    ((CTelemetry*)ctx)->publish_plc_link(link);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// publish_plc_link() - Publishes and logs one PLC link poll. The counters go out
+//                      as doubles, which hold them exactly well past anything a
+//                      modem will count to
+// -----------------------------------------------------------------------------
+void CTelemetry::publish_plc_link(const plc_link_t& link)
+{
+    if (m_plc_link_topic.empty()) return;
+
+    // This runs on the poller's thread, so it has a buffer of its own
+    char message[768];
+    CJsonWriter writer(message, sizeof(message));
+    writer.begin();
+    writer.field("peer",             link.peer);
+    writer.field("stations",         link.stations);
+    writer.field("tx_rate",          link.tx_rate);
+    writer.field("rx_rate",          link.rx_rate);
+    writer.field("carriers",         link.carriers);
+    writer.field("bits_per_carrier", link.bits_per_carrier);
+    writer.field("tx_acked",         (double)link.tx_acked);
+    writer.field("tx_collided",      (double)link.tx_collided);
+    writer.field("tx_failed",        (double)link.tx_failed);
+    writer.field("tx_pb_passed",     (double)link.tx_pb_passed);
+    writer.field("tx_pb_failed",     (double)link.tx_pb_failed);
+    writer.field("rx_acked",         (double)link.rx_acked);
+    writer.field("rx_failed",        (double)link.rx_failed);
+    writer.field("rx_pb_passed",     (double)link.rx_pb_passed);
+    writer.field("rx_pb_failed",     (double)link.rx_pb_failed);
+    writer.field("tx_pb_error_pct",  link.tx_pb_error_pct);
+    writer.field("rx_pb_error_pct",  link.rx_pb_error_pct);
+    if (writer.end() < 0)
+    {
+        logger.log(LOG_WARNING, "PLC link telemetry message too large, dropped");
+        return;
+    }
+
+    send_message(m_plc_link_topic, message);
+    logger.log(LOG_DEBUG, message);
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
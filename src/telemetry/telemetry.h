@@ -0,0 +1,110 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// telemetry.h - Change-driven publishing of J1772 status to the MQTT broker
+//
+// A status message goes out right away when a pilot/prox state changes or an analog value moves past its
+// deadband.  Smaller changes are collected into a batch that is published periodically, and if nothing
+// at all has been published for a while, a heartbeat goes out so subscribers know we're still alive.
+//
+// Every message carries the latest J1772 values at the top level (so it parses exactly like the old
+// fixed-rate status message), plus a "reason" and, for batches, a "batch" array of the collected samples.
+//==========================================================================================================
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "J1772.h"
+#include "mstimer.h"
+#include "plclink.h"
+
+// -----------------------------------------------------------------------------
+// CTelemetry - Decides when a J1772 sample is worth publishing
+// -----------------------------------------------------------------------------
+class CTelemetry
+{
+public:
+
+    // Constructor
+    CTelemetry() {m_is_initialized = false; m_have_published = false; m_batch_count = 0;}
+
+    // Call this once to configure where and how often we publish
+    //   topic          = MQTT topic to publish status messages on
+    //   deadband_V     = A change in Vpilot, Vpilot_min or Vprox larger than this is published right away
+    //   deadband_duty  = A change in pilot duty cycle (%) larger than this is published right away
+    //   deadband_freq  = A change in pilot frequency (Hz) larger than this is published right away
+    //   batch_ms       = How often batched (in-deadband) changes are published
+    //   max_age_ms     = The longest we'll go without publishing anything
+    //   max_batch      = The most samples a batch holds before it's published early
+    void    init(const std::string& topic, double deadband_V, double deadband_duty, int deadband_freq,
+                 int batch_ms, int max_age_ms, int max_batch);
+
+    // Call this with every new sample
+    void    update(const J1772_t& sample);
+
+    // Call this once to also publish the PLC link quality on 'topic'
+    void    init_plc_link(const std::string& topic) {m_plc_link_topic = topic;}
+
+    // Hand this to CPLCLink::start(), with the telemetry object as 'ctx'. It's called on the
+    // poller's thread, so it doesn't touch anything the J1772 side uses
+    static void on_plc_link(const plc_link_t& link, void* ctx);
+
+protected:
+
+    // Publishes and logs one PLC link poll
+    void    publish_plc_link(const plc_link_t& link);
+
+    // Returns true if any of the discrete J1772 states differ between two samples
+    bool    state_changed(const J1772_t& a, const J1772_t& b);
+
+    // Returns true if any analog value differs by more than its deadband between two samples
+    bool    beyond_deadband(const J1772_t& a, const J1772_t& b);
+
+    // Returns true if any analog value differs at all between two samples
+    bool    analog_changed(const J1772_t& a, const J1772_t& b);
+
+    // Publishes 'sample' along with any pending batch, then restarts the timers
+    void    publish(const J1772_t& sample, const char* reason);
+
+    // Settings handed to us by init()
+    std::string m_topic;
+    double      m_deadband_V, m_deadband_duty;
+    int         m_deadband_freq, m_batch_ms, m_max_age_ms, m_max_batch;
+
+    // The last sample that was published, and the last sample that was added to the batch
+    J1772_t     m_published, m_batched;
+
+    // Samples collected since the last publish, as a JSON array that's missing its closing bracket
+    std::string m_batch;
+    int         m_batch_count;
+
+    // Where the PLC link quality goes
+    std::string m_plc_link_topic;
+
+    // The outgoing message is formatted into this buffer
+    std::vector<char> m_message;
+
+    // Timers that trigger a batch publish and a heartbeat
+    OneShot     m_batch_timer, m_max_age_timer;
+
+    // True once init() has been called, and once the first message has gone out
+    bool        m_is_initialized, m_have_published;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
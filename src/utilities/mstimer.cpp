@@ -15,6 +15,7 @@
 
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
 #include "mstimer.h"
 
 //=========================================================================================================
@@ -110,17 +111,17 @@ bool OneShot::is_expired()
 
 
 //=========================================================================================================
-// millis() - Returns a timestamp with millisecond resolution.   This is NOT monotonic, and can 
-//            "travel back in time" if the system time is changed!
+// millis() - Returns a timestamp with millisecond resolution.  This is monotonic, so timers are
+//            unaffected by changes to the system time
 //=========================================================================================================
 uint64_t msTimer::millis()
 {
-    struct timeval ts;
+    struct timespec ts;
 
-    // Fetch the time since the eppch
-    gettimeofday(&ts, NULL);
+    // Fetch the time since some arbitrary point in the past (usually boot)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    // Return the number of milliseconds elapsed since the epoch
-    return (uint64_t)(ts.tv_sec) * 1000 + (uint64_t)(ts.tv_usec) / 1000;
+    // Return the number of milliseconds elapsed since then
+    return (uint64_t)(ts.tv_sec) * 1000 + (uint64_t)(ts.tv_nsec) / 1000000;
 }
 //=========================================================================================================
\ No newline at end of file
@@ -21,6 +21,8 @@
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
 #include <netinet/tcp.h>
@@ -37,6 +39,9 @@ NetSock::NetSock()
 
     // This socket has not yet been created
     m_is_created = false;
+
+    // And it has the default TCP behavior
+    m_low_latency = false;
 }
 //==========================================================================================================
 
@@ -52,10 +57,20 @@ void NetSock::close()
 //==========================================================================================================
 
 
+//==========================================================================================================
+// shutdown() - Shuts down both directions of the connection, but leaves the descriptor open
+//==========================================================================================================
+void NetSock::shutdown()
+{
+    if (m_sd >= 0) ::shutdown(m_sd, SHUT_RDWR);
+}
+//==========================================================================================================
+
+
 //==========================================================================================================
 // connect() - Creates the socket and connects it to a server
 //==========================================================================================================
-bool NetSock::connect(std::string server, int port, int family, std::string interface)
+bool NetSock::connect(std::string server, int port, int family, std::string interface, int timeout_ms)
 {
     addrinfo_t info;
 
@@ -101,8 +116,26 @@ bool NetSock::connect(std::string server, int port, int family, std::string inte
         }
     }
 
+    // With a timeout, the connect is non-blocking and we wait for it to finish ourselves
+    int flags = fcntl(m_sd, F_GETFL, 0);
+    if (timeout_ms >= 0) fcntl(m_sd, F_SETFL, flags | O_NONBLOCK);
+
     // Attempt to connect to the server
-    if (::connect(m_sd, info, info.addrlen) < 0)
+    int rc = ::connect(m_sd, info, info.addrlen);
+    if (rc < 0 && errno == EINPROGRESS && timeout_ms >= 0)
+    {
+        // The socket becomes writable when the connect finishes, one way or the other
+        struct pollfd pfd = {m_sd, POLLOUT, 0};
+        if (poll(&pfd, 1, timeout_ms) == 1)
+        {
+            int       error = 0;
+            socklen_t len   = sizeof(error);
+            getsockopt(m_sd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error == 0) rc = 0;
+        }
+    }
+
+    if (rc < 0)
     {
         m_error_str = "can't connect to "+server;
         m_error     = CANT_CONNECT;
@@ -110,6 +143,9 @@ bool NetSock::connect(std::string server, int port, int family, std::string inte
         return false;
     }
 
+    // Everything else expects a blocking socket
+    if (timeout_ms >= 0) fcntl(m_sd, F_SETFL, flags);
+
     // If we get here, we have a connected socket
     return true;
 }
@@ -117,6 +153,20 @@ bool NetSock::connect(std::string server, int port, int family, std::string inte
 
 
 
+//==========================================================================================================
+// set_low_latency() - Turns off Nagle's algorithm and delayed acknowledgements on a connected socket
+//==========================================================================================================
+void NetSock::set_low_latency()
+{
+    int optval = 1;
+    setsockopt(m_sd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof optval);
+    setsockopt(m_sd, IPPROTO_TCP, TCP_QUICKACK, &optval, sizeof optval);
+    m_low_latency = true;
+}
+//==========================================================================================================
+
+
+
 //==========================================================================================================
 // create_server() - Creates a server socket
 //
@@ -333,6 +383,13 @@ int NetSock::receive(void* buffer, int length, bool peek)
         // If the socket is closed, tell the caller
         if (bytes_rcvd == 0) return 0;
 
+        // The kernel can drop back to delayed acknowledgements at any time, so ask again
+        if (m_low_latency)
+        {
+            int optval = 1;
+            setsockopt(m_sd, IPPROTO_TCP, TCP_QUICKACK, &optval, sizeof optval);
+        }
+
         // Adjust our pointer and the number of bytes remaining to be read
         ptr             += bytes_rcvd;
         bytes_remaining -= bytes_rcvd;
@@ -395,6 +452,7 @@ void NetSock::copy_object(const NetSock& rhs)
 {
     m_sd         = rhs.m_sd;
     m_is_created = rhs.m_is_created;
+    m_low_latency = rhs.m_low_latency;
     m_error      = rhs.m_error;
     m_error_str  = rhs.m_error_str;
 }
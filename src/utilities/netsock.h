@@ -58,8 +58,13 @@ public:
     // Convenience call for waiting for a single incoming connection
     bool    listen_and_accept(int timeout_ms = -1);
 
-    // Call this to connect to a server
-    bool    connect(std::string server_name, int port, int family = AF_INET, std::string interface = "");
+    // Call this to connect to a server. With a timeout, the connect gives up after that many
+    // milliseconds instead of waiting for the kernel's own (much longer) timeout
+    bool    connect(std::string server_name, int port, int family = AF_INET, std::string interface = "", int timeout_ms = -1);
+
+    // Call this on a connected socket to send small messages right away (TCP_NODELAY) and
+    // acknowledge received data right away (TCP_QUICKACK)
+    void    set_low_latency();
 
     // Waits for data to arrive.  Returns 'true' if data became available before the timeout expires
     bool    wait_for_data(int milliseconds);
@@ -76,6 +81,10 @@ public:
     // Call this to close this socket.  Safe to call if socket isn't open
     void    close();
 
+    // Call this from another thread to make a blocked wait_for_data() or receive() return
+    // without closing the socket out from under it.  Safe to call if socket isn't open
+    void    shutdown();
+
 protected:
 
     // Copy another object of this type
@@ -88,6 +97,9 @@ protected:
     // This will be true on a socket for which create_server() or connect() has been called
     bool    m_is_created;
 
+    // This will be true once set_low_latency() has been called
+    bool    m_low_latency;
+
     // The socket descriptor of our socket
     int     m_sd;
 };
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <ifaddrs.h>
+#include <poll.h>
 #include <string>
 #include "netutil.h"
 
@@ -154,9 +155,8 @@ std::string NetUtil::ip_to_string(sockaddr* addr)
 //==========================================================================================================
 int NetUtil::wait_for_data(int timeout_ms, int fd1, int fd2, int fd3, int fd4)
 {
-    int    i, fd;
-    fd_set rfds;
-    timeval timeout;
+    int i;
+    struct pollfd pfds[4];
 
     // Put them into an array
     int fd_list[] = {fd1, fd2, fd3, fd4};
@@ -164,47 +164,17 @@ int NetUtil::wait_for_data(int timeout_ms, int fd1, int fd2, int fd3, int fd4)
     // Find out how many items are in the array
     const int ARRAY_COUNT = sizeof(fd_list) / sizeof(fd_list[0]);
 
-    // We don't know what the highest file descriptor is yet
-    int highest_fd = -1;
-
-    // Clear our file descriptor set
-    FD_ZERO(&rfds);
-
-    // Loop through each file descriptor that was provided by the caller...
+    // Build the poll list. poll() ignores negative descriptors, so invalid ones can stay in place
     for (i=0; i<ARRAY_COUNT; ++i)
     {
-        // Fetch this file descriptor
-        fd = fd_list[i];
-
-        // Skip any invalid file descriptor
-        if (fd < 0) continue;   
-
-        // Include this file descriptor in our fd_set
-        FD_SET(fd, &rfds);
-
-        // Keep track of the highest file descriptor we have
-        if (fd > highest_fd) highest_fd = fd;
+        pfds[i].fd      = fd_list[i];
+        pfds[i].events  = POLLIN;
+        pfds[i].revents = 0;
     }
 
-    // Assume for the moment that we are going to wait forever
-    timeval* p_timeout = NULL;
-
-    // If the caller wants us to wait for a finite amount of time...
-    if (timeout_ms != -1)
-    {
-        // Convert milliseconds to microseconds
-        int usecs = timeout_ms * 1000;
-
-        // Determine the timeout in seconds and microseconds
-        timeout.tv_sec  = usecs / 1000000;
-        timeout.tv_usec = usecs % 1000000;
-
-        // Point to the timeout structure we just initialized
-        p_timeout = &timeout;
-    }
-
-    // Wait for one of the descriptors to become available for reading
-    if (select(highest_fd+1, &rfds, NULL, NULL, p_timeout) < 1) return 0;
+    // Wait for one of the descriptors to become available for reading.  Unlike select(), poll()
+    // has no FD_SETSIZE limit on descriptor numbers, and a timeout of -1 means wait forever
+    if (poll(pfds, ARRAY_COUNT, timeout_ms) < 1) return 0;
 
     // This is going to be a bitmap of which descriptors are readable
     int result = 0;
@@ -212,14 +182,11 @@ int NetUtil::wait_for_data(int timeout_ms, int fd1, int fd2, int fd3, int fd4)
     // Loop through each possible descriptor...
     for (i=0; i<ARRAY_COUNT; ++i)
     {
-        // Fetch this file descriptor
-        fd = fd_list[i];
-
         // Skip any invalid file descriptor
-        if (fd < 0) continue;   
+        if (fd_list[i] < 0) continue;
 
-        // If this descriptor is readable, set the appropriate bit in the result
-        if (FD_ISSET(fd, &rfds)) result |= (1 << i);
+        // A hangup or error counts as readable, so the caller's read() finds out what happened
+        if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) result |= (1 << i);
     }
 
     // Hand the caller a bitmap of which of his descriptors are readable
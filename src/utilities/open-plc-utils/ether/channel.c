@@ -89,6 +89,8 @@ struct channel channel =
 
 #if defined (__linux__)
 
+	(struct ring *) (0),
+
 #elif defined (__APPLE__) || defined (__OpenBSD__) || defined (__NetBSD__) || defined (__FreeBSD__)
 
 	(struct bpf *) (0),
@@ -110,6 +110,7 @@
 #define CHANNEL_UPDATE_TARGET (1 << 5) /* used by efsu only */
 #define CHANNEL_UPDATE_SOURCE (1 << 6) /* used by efsu only */
 #define CHANNEL_LISTEN (1 << 7)        /* used by efsu only */
+#define CHANNEL_RXRING (1 << 8)        /* linux only: receive through a mapped ring */
 
 #define CHANNEL_ETHNUMBER 2
 #if defined (__linux__)
@@ -136,6 +137,16 @@
 #define CHANNEL_TIMEOUT 50
 #endif
 
+/*
+ *	receive ring geometry (CHANNEL_RXRING); a block is handed to user space
+ *	when it fills or when CHANNEL_RING_RETIRE milliseconds have passed;
+ */
+
+#define CHANNEL_RING_BLOCKS 16
+#define CHANNEL_RING_BLOCK_SIZE 8192
+#define CHANNEL_RING_FRAME_SIZE 2048
+#define CHANNEL_RING_RETIRE 1
+
 /*====================================================================*
  *   common channel error messages;
  *--------------------------------------------------------------------*/
@@ -168,6 +179,18 @@ typedef struct channel
 
 #if defined (__linux__)
 
+	struct ring
+	{
+		uint8_t * ring_map;
+		unsigned ring_length;
+		unsigned ring_blocks;
+		unsigned ring_block_size;
+		unsigned ring_block;
+		unsigned ring_frames;
+		uint8_t * ring_frame;
+	}
+	* ring;
+
 #elif defined (__APPLE__) || defined (__OpenBSD__) || defined(__NetBSD__) || defined(__FreeBSD__)
 
 	struct bpf
@@ -60,6 +60,10 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+#if defined (__linux__)
+#	include <sys/mman.h>
+#endif
+
 #include "../ether/channel.h"
 
 signed closechannel (struct channel const * channel)
@@ -68,6 +72,11 @@ signed closechannel (struct channel const * channel)
 
 #if defined (__linux__)
 
+	if (channel->ring)
+	{
+		munmap (channel->ring->ring_map, channel->ring->ring_length);
+		free (channel->ring);
+	}
 	return (close (channel->fd));
 
 #elif defined (__APPLE__) || (__OpenBSD__) || defined (__NetBSD__) || defined (__FreeBSD__)
@@ -47,6 +47,12 @@
  *
  *   open a raw ethernet channel;
  *
+ *   on linux, a socket filter passes only frames of the channel type
+ *   addressed to this host, or to a group, and never frames that this
+ *   host sent; when the channel CHANNEL_RXRING flag is set, frames are
+ *   received through a TPACKET_V3 ring mapped into our memory, and the
+ *   channel reads them from there in batches;
+ *
  *
  *   Contributor(s):
  *	Charles Maier
@@ -65,8 +71,12 @@
 #if defined (__linux__)
 #   include <net/if.h>
 #	include <net/if_arp.h>
-#	include <netpacket/packet.h>
+#	include <sys/socket.h>
 #	include <sys/ioctl.h>
+#	include <sys/mman.h>
+#	include <stdlib.h>
+#	include <linux/if_packet.h>
+#	include <linux/filter.h>
 #elif defined (__APPLE__)
 #	include <sys/ioctl.h>
 #	include <sys/stat.h>
@@ -94,12 +104,163 @@
 #	include "../ether/gethwaddr.c"
 #endif
 
+#if defined (__linux__)
+
+static struct sock_filter sock_filter [] =
+{
+	{
+		BPF_LD + BPF_W + BPF_ABS,
+		0,
+		0,
+		SKF_AD_OFF + SKF_AD_PKTTYPE
+	},
+	{
+		BPF_JMP + BPF_JEQ + BPF_K,
+		10,
+		0,
+		PACKET_OUTGOING
+	},
+	{
+		BPF_LD + BPF_H + BPF_ABS,
+		0,
+		0,
+		12
+	},
+	{
+		BPF_JMP + BPF_JEQ + BPF_K,
+		0,
+		8,
+		0
+	},
+	{
+		BPF_LD + BPF_B + BPF_ABS,
+		0,
+		0,
+		0
+	},
+	{
+		BPF_JMP + BPF_JSET + BPF_K,
+		4,
+		0,
+		0x01
+	},
+	{
+		BPF_LD + BPF_W + BPF_ABS,
+		0,
+		0,
+		0
+	},
+	{
+		BPF_JMP + BPF_JEQ + BPF_K,
+		0,
+		4,
+		0
+	},
+	{
+		BPF_LD + BPF_H + BPF_ABS,
+		0,
+		0,
+		4
+	},
+	{
+		BPF_JMP + BPF_JEQ + BPF_K,
+		0,
+		2,
+		0
+	},
+	{
+		BPF_LD + BPF_W + BPF_LEN,
+		0,
+		0,
+		0
+	},
+	{
+		BPF_RET + BPF_A,
+		0,
+		0,
+		0
+	},
+	{
+		BPF_RET + BPF_K,
+		0,
+		0,
+		0
+	}
+};
+
+/*
+ *	map a TPACKET_V3 receive ring; on failure, leave the channel as it
+ *	was so that frames are read one at a time;
+ */
+
+static void openring (struct channel * channel)
+
+{
+
+#if defined (TP_STATUS_BLK_TMO)
+
+	struct tpacket_req3 tpacket_req3;
+	struct ring * ring;
+	unsigned length = CHANNEL_RING_BLOCKS * CHANNEL_RING_BLOCK_SIZE;
+	signed version = TPACKET_V3;
+	void * map;
+	memset (&tpacket_req3, 0, sizeof (tpacket_req3));
+	tpacket_req3.tp_block_size = CHANNEL_RING_BLOCK_SIZE;
+	tpacket_req3.tp_block_nr = CHANNEL_RING_BLOCKS;
+	tpacket_req3.tp_frame_size = CHANNEL_RING_FRAME_SIZE;
+	tpacket_req3.tp_frame_nr = length / CHANNEL_RING_FRAME_SIZE;
+	tpacket_req3.tp_retire_blk_tov = CHANNEL_RING_RETIRE;
+	if (setsockopt (channel->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof (version)) == -1)
+	{
+		error (0, errno, "Can't map receive ring: %s", channel->ifname);
+		return;
+	}
+	if (setsockopt (channel->fd, SOL_PACKET, PACKET_RX_RING, &tpacket_req3, sizeof (tpacket_req3)) == -1)
+	{
+		error (0, errno, "Can't map receive ring: %s", channel->ifname);
+		return;
+	}
+	map = mmap (0, length, PROT_READ | PROT_WRITE, MAP_SHARED, channel->fd, 0);
+	ring = malloc (sizeof (* ring));
+	if ((map == MAP_FAILED) || (ring == NULL))
+	{
+		error (0, errno, "Can't map receive ring: %s", channel->ifname);
+		if (map != MAP_FAILED)
+		{
+			munmap (map, length);
+		}
+		free (ring);
+		memset (&tpacket_req3, 0, sizeof (tpacket_req3));
+		setsockopt (channel->fd, SOL_PACKET, PACKET_RX_RING, &tpacket_req3, sizeof (tpacket_req3));
+		return;
+	}
+	ring->ring_map = map;
+	ring->ring_length = length;
+	ring->ring_blocks = CHANNEL_RING_BLOCKS;
+	ring->ring_block_size = CHANNEL_RING_BLOCK_SIZE;
+	ring->ring_block = 0;
+	ring->ring_frames = 0;
+	ring->ring_frame = (uint8_t *) (0);
+	channel->ring = ring;
+
+#else
+
+	error (0, 0, "Can't map receive ring: %s: TPACKET_V3 unsupported", channel->ifname);
+
+#endif
+
+	return;
+}
+
+#endif
+
 signed openchannel (struct channel * channel)
 
 {
 
 #if defined (__linux__)
 
+	struct sock_fprog sock_fprog;
 	struct ifreq ifreq;
 	struct sockaddr_ll sockaddr_ll =
 	{
@@ -149,6 +310,39 @@ signed openchannel (struct channel * channel)
 		error (1, errno, "%s", ifreq.ifr_name);
 	}
 	memcpy (sockaddr_ll.sll_addr, ifreq.ifr_ifru.ifru_hwaddr.sa_data, sizeof (sockaddr_ll.sll_addr));
+
+/*
+ *	filter and map the ring before binding, so that no frame reaches the
+ *	socket unfiltered or lands outside the ring;
+ */
+
+	sock_fprog.len = sizeof (sock_filter) / sizeof (struct sock_filter);
+	sock_fprog.filter = sock_filter;
+	if (channel->type == ETH_P_802_2)
+	{
+		sock_filter [3].code = BPF_JMP + BPF_JGT + BPF_K;
+		sock_filter [3].jt = 8;
+		sock_filter [3].jf = 0;
+		sock_filter [3].k = ETHERMTU;
+	}
+	else
+	{
+		sock_filter [3].code = BPF_JMP + BPF_JEQ + BPF_K;
+		sock_filter [3].jt = 0;
+		sock_filter [3].jf = 8;
+		sock_filter [3].k = channel->type;
+	}
+	sock_filter [7].k = (sockaddr_ll.sll_addr [0] << 24) | (sockaddr_ll.sll_addr [1] << 16) | (sockaddr_ll.sll_addr [2] << 8) | sockaddr_ll.sll_addr [3];
+	sock_filter [9].k = (sockaddr_ll.sll_addr [4] << 8) | sockaddr_ll.sll_addr [5];
+	if (setsockopt (channel->fd, SOL_SOCKET, SO_ATTACH_FILTER, &sock_fprog, sizeof (sock_fprog)) == -1)
+	{
+		error (0, errno, "Can't store filter: %s", channel->ifname);
+	}
+	channel->ring = (struct ring *) (0);
+	if (_anyset (channel->flags, CHANNEL_RXRING))
+	{
+		openring (channel);
+	}
 	if (bind (channel->fd, (struct sockaddr *) (&sockaddr_ll), sizeof (sockaddr_ll)) == -1)
 	{
 		error (1, errno, "%s", ifreq.ifr_name);
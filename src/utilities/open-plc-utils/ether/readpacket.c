@@ -50,6 +50,10 @@
  *   return the packet size on success, 0 on timeout or -1 on error;
  *   dump packets on stdout when the channel VERBOSE flag is set;
  *
+ *   on linux, frames come from the channel receive ring when one is
+ *   mapped; a whole block of frames is consumed before the next poll;
+ *   only the part of memory past the frame is cleared;
+ *
  *   constant __MAGIC__ enables code that reads frames from stdin,
  *   instead of the network; you may use it whenever a network or
  *   transmitting device is not available;
@@ -80,6 +84,94 @@
 #include "../tools/hexload.c"
 #endif
 
+#if defined (__linux__) && !defined (__MAGIC__)
+
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+
+/*
+ *	read the next frame from the receive ring; a block belongs to us
+ *	from the time the kernel marks it TP_STATUS_USER until its last
+ *	frame is read, then it goes back to the kernel;
+ */
+
+static ssize_t readring (struct channel const * channel, void * memory, ssize_t extent)
+
+{
+
+#if defined (TP_STATUS_BLK_TMO)
+
+	struct ring * ring = channel->ring;
+	struct tpacket_block_desc * block = (struct tpacket_block_desc *) (ring->ring_map + ring->ring_block * ring->ring_block_size);
+	struct tpacket3_hdr * frame;
+	ssize_t length;
+	if (!ring->ring_frame)
+	{
+		if (!(block->hdr.bh1.block_status & TP_STATUS_USER))
+		{
+			struct pollfd pollfd =
+			{
+				channel->fd,
+				POLLIN,
+				0
+			};
+			signed status = poll (&pollfd, 1, channel->capture);
+			if ((status < 0) && (errno != EINTR))
+			{
+				error (0, errno, "%s can't poll %s", __func__, channel->ifname);
+				return (-1);
+			}
+			if (!(block->hdr.bh1.block_status & TP_STATUS_USER))
+			{
+				return (0);
+			}
+		}
+		__sync_synchronize ();
+		ring->ring_frames = block->hdr.bh1.num_pkts;
+		ring->ring_frame = (uint8_t *) (block) + block->hdr.bh1.offset_to_first_pkt;
+	}
+	length = 0;
+	if (ring->ring_frames)
+	{
+		frame = (struct tpacket3_hdr *) (ring->ring_frame);
+		length = frame->tp_snaplen;
+		if (length > extent)
+		{
+			if (_anyset (channel->flags, CHANNEL_VERBOSE))
+			{
+				error (0, 0, "Truncated incoming frame (%d -> %d bytes)", (int) (length), (int) (extent));
+			}
+			length = extent;
+		}
+		memcpy (memory, (uint8_t *) (frame) + frame->tp_mac, length);
+		memset ((uint8_t *) (memory) + length, 0, extent - length);
+		ring->ring_frame += frame->tp_next_offset;
+		ring->ring_frames--;
+	}
+	if (!ring->ring_frames)
+	{
+		__sync_synchronize ();
+		block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		ring->ring_frame = (uint8_t *) (0);
+		ring->ring_block = (ring->ring_block + 1) % ring->ring_blocks;
+	}
+	if (length && _anyset (channel->flags, CHANNEL_VERBOSE))
+	{
+		hexdump (memory, 0, length, stdout);
+	}
+	return (length);
+
+#else
+
+	return (-1);
+
+#endif
+
+}
+
+#endif
+
 ssize_t readpacket (struct channel const * channel, void * memory, ssize_t extent)
 
 {
@@ -96,15 +188,18 @@ ssize_t readpacket (struct channel const * channel, void * memory, ssize_t exten
 
 #elif defined (__linux__)
 
-#include <sys/poll.h>
 	struct pollfd pollfd =
 	{
 		channel->fd,
 		POLLIN,
 		0
 	};
-	signed status = poll (&pollfd, 1, channel->capture);
-	memset (memory, 0, extent);
+	signed status;
+	if (channel->ring)
+	{
+		return (readring (channel, memory, extent));
+	}
+	status = poll (&pollfd, 1, channel->capture);
 	if ((status < 0) && (errno != EINTR))
 	{
 		error (0, errno, "%s can't poll %s", __func__, channel->ifname);
@@ -120,6 +215,7 @@ ssize_t readpacket (struct channel const * channel, void * memory, ssize_t exten
 		}
 		if (status > 0)
 		{
+			memset ((uint8_t *) (memory) + status, 0, extent - status);
 			extent = status;
 			if (_anyset (channel->flags, CHANNEL_VERBOSE))
 			{
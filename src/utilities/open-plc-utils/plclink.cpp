@@ -0,0 +1,385 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// plclink.cpp - Polls our PLC modem for the quality of its link to the station on the other end
+//==========================================================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <thread>
+#include "plclink.h"
+
+// The following contains C code -----------------------------------------------
+// plc.h defines globals of its own, and slacify.cpp already includes it, so we talk to the
+// channel directly rather than through SendMME() and ReadMME()
+extern "C" {
+#include "../open-plc-utils/mme/mme.h"
+#include "../open-plc-utils/tools/endian.h"
+#include "../open-plc-utils/tools/flags.h"
+#include "../open-plc-utils/tools/timer.h"
+
+extern struct channel channel;
+}
+// -----------------------------------------------------------------------------
+
+// How long we wait for the modem to answer, in ms
+#define PLC_LINK_TIMEOUT 500
+
+// The link whose counters VS_LNK_STATS reports: CA1, where unprioritized traffic goes
+#define PLC_LINK_LID 1
+
+// VS_LNK_STATS directions
+#define PLC_LINK_TXRX 2
+
+// The carriers a HomePlug AV tone map covers, as plc.h has it
+#define PLC_LINK_CARRIERS 1155
+
+#ifndef __GNUC__
+#pragma pack (push,1)
+#endif
+
+// VS_NW_INFO.CNF, as NetInfo2() reads it, with the first AVLN and its first station
+struct __packed plc_link_station
+{
+    uint8_t  MAC [ETHER_ADDR_LEN];
+    uint8_t  TEI;
+    uint8_t  Reserved [3];
+    uint8_t  BDA [ETHER_ADDR_LEN];
+    uint16_t AVGTX;
+    uint8_t  COUPLING;
+    uint8_t  Reserved3;
+    uint16_t AVGRX;
+    uint16_t Reserved4;
+};
+
+struct __packed plc_link_nw_info_confirm
+{
+    struct ethernet_hdr ethernet;
+    struct qualcomm_fmi qualcomm;
+    uint8_t  SUB_VERSION;
+    uint8_t  Reserved;
+    uint16_t DATA_LEN;
+    uint8_t  Reserved1;
+    uint8_t  NUMAVLNS;
+    uint8_t  NID [7];
+    uint8_t  Reserved2 [2];
+    uint8_t  SNID;
+    uint8_t  TEI;
+    uint8_t  Reserved3 [4];
+    uint8_t  ROLE;
+    uint8_t  CCO_MAC [ETHER_ADDR_LEN];
+    uint8_t  CCO_TEI;
+    uint8_t  Reserved4 [3];
+    uint8_t  NUMSTAS;
+    uint8_t  Reserved5 [5];
+    struct plc_link_station station;
+};
+
+// VS_LNK_STATS, both directions at once: the transmit counters come first
+struct __packed plc_link_stats_request
+{
+    struct ethernet_hdr ethernet;
+    struct qualcomm_hdr qualcomm;
+    uint8_t  MCONTROL;
+    uint8_t  DIRECTION;
+    uint8_t  LID;
+    uint8_t  MACADDRESS [ETHER_ADDR_LEN];
+};
+
+struct __packed plc_link_stats_confirm
+{
+    struct ethernet_hdr ethernet;
+    struct qualcomm_hdr qualcomm;
+    uint8_t  MSTATUS;
+    uint8_t  DIRECTION;
+    uint8_t  LID;
+    uint8_t  TEI;
+    uint64_t NUMTXMPDU_ACKD;
+    uint64_t NUMTXMPDU_COLL;
+    uint64_t NUMTXMPDU_FAIL;
+    uint64_t NUMTXPBS_PASS;
+    uint64_t NUMTXPBS_FAIL;
+    uint64_t NUMRXMPDU_ACKD;
+    uint64_t NUMRXMPDU_FAIL;
+    uint64_t NUMRXPBS_PASS;
+    uint64_t NUMRXPBS_FAIL;
+};
+
+// VS_TONE_MAP_CHAR for tone map slot 0. Each carrier's modulation is a nibble
+struct __packed plc_link_tone_map_request
+{
+    struct ethernet_hdr ethernet;
+    struct qualcomm_hdr qualcomm;
+    uint8_t  MACADDRESS [ETHER_ADDR_LEN];
+    uint8_t  TMSLOT;
+};
+
+struct __packed plc_link_tone_map_confirm
+{
+    struct ethernet_hdr ethernet;
+    struct qualcomm_hdr qualcomm;
+    uint8_t  MSTATUS;
+    uint8_t  TMSLOT;
+    uint8_t  NUMTMS;
+    uint16_t TMNUMACTCARRIERS;
+    uint8_t  MOD_CARRIER [(PLC_LINK_CARRIERS + 1) / 2];
+};
+
+#ifndef __GNUC__
+#pragma pack (pop)
+#endif
+
+// The bits a carrier carries for each modulation: none, BPSK, QPSK, 8-QAM, 16-QAM, 64-QAM, 256-QAM, 1024-QAM
+static const int ModulationBits [] = {0, 1, 2, 3, 4, 6, 8, 10};
+
+
+// -----------------------------------------------------------------------------
+// error_pct() - Returns the failed blocks over an interval as a percentage of
+//               all of them, or -1 if there weren't any
+// -----------------------------------------------------------------------------
+static double error_pct(uint64_t passed, uint64_t failed, uint64_t last_passed, uint64_t last_failed)
+{
+    // A modem that was reset starts counting again
+    if (passed < last_passed || failed < last_failed) last_passed = last_failed = 0;
+
+    uint64_t total = (passed - last_passed) + (failed - last_failed);
+    return total ? 100.0 * (failed - last_failed) / total : -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CPLCLink() - Constructor
+// -----------------------------------------------------------------------------
+CPLCLink::CPLCLink()
+{
+    m_interval_ms = 0;
+    m_cb          = NULL;
+    m_ctx         = NULL;
+    m_is_started  = false;
+    m_channel     = NULL;
+    m_message     = NULL;
+    memset(&m_last, 0, sizeof(m_last));
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start() - Opens our own channel to the modem and starts polling it
+// -----------------------------------------------------------------------------
+bool CPLCLink::start(int interval_ms, plc_link_cb_t cb, void* ctx)
+{
+    if (m_is_started || interval_ms <= 0) return m_is_started;
+
+    // The same interface as the SLAC channel, read directly rather than through a ring
+    m_channel  = new struct channel;
+    *m_channel = channel;
+    m_channel->fd      = -1;
+    m_channel->ring    = NULL;
+    m_channel->capture = PLC_LINK_TIMEOUT;
+    m_channel->timeout = PLC_LINK_TIMEOUT;
+    _clrbits (m_channel->flags, CHANNEL_RXRING);
+    if (openchannel (m_channel) < 0)
+    {
+        delete m_channel;
+        m_channel = NULL;
+        return false;
+    }
+
+    m_message = new struct message;
+
+    m_interval_ms = interval_ms;
+    m_cb          = cb;
+    m_ctx         = ctx;
+    m_is_started  = true;
+
+    std::thread th(launch_task, this);
+    th.detach();
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// task() - Polls the modem every interval, at the lowest priority
+// -----------------------------------------------------------------------------
+void CPLCLink::task()
+{
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+
+    while (true)
+    {
+        usleep(m_interval_ms * 1000);
+
+        plc_link_t link;
+        memset(&link, 0, sizeof(link));
+        link.carriers         = -1;
+        link.bits_per_carrier = -1;
+        link.tx_pb_error_pct  = -1;
+        link.rx_pb_error_pct  = -1;
+
+        // Until we're in an AVLN, there's no link to ask about
+        uint8_t peer [ETHER_ADDR_LEN];
+        if (!station_info(&link, peer)) continue;
+        if (link.stations)
+        {
+            link_stats(&link, peer);
+            tone_map(&link, peer);
+        }
+
+        if (m_cb) m_cb(link, m_ctx);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// exchange() - Sends the request in m_message, and waits for the answer. Anything
+//              else that arrives meanwhile is skipped, as ReadMME() does
+// -----------------------------------------------------------------------------
+bool CPLCLink::exchange(size_t length, uint8_t MMV, uint16_t MMTYPE)
+{
+    ssize_t packetsize = (length < ETHER_MIN_LEN - ETHER_CRC_LEN) ? ETHER_MIN_LEN - ETHER_CRC_LEN : length;
+    if (sendpacket (m_channel, m_message, packetsize) <= 0) return false;
+
+    struct timeval ts, tc;
+    gettimeofday (&ts, NULL);
+    while ((packetsize = readpacket (m_channel, m_message, sizeof (*m_message))) > 0)
+    {
+        if (!UnwantedMessage (m_message, packetsize, MMV, MMTYPE)) return true;
+
+        gettimeofday (&tc, NULL);
+        if (MILLISECONDS (ts, tc) >= PLC_LINK_TIMEOUT) break;
+    }
+    return false;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// station_info() - Asks which stations are in our AVLN and their PHY rates. The
+//                  first is the other end of our link
+// -----------------------------------------------------------------------------
+bool CPLCLink::station_info(plc_link_t* link, uint8_t peer[])
+{
+    struct qualcomm* request = (struct qualcomm*)m_message;
+    struct plc_link_nw_info_confirm* confirm = (struct plc_link_nw_info_confirm*)m_message;
+
+    memset (m_message, 0, sizeof (*m_message));
+    EthernetHeader (&request->ethernet, m_channel->peer, m_channel->host, m_channel->type);
+    QualcommHeader1 (&request->qualcomm, 1, (VS_NW_INFO | MMTYPE_REQ));
+    if (!exchange(0, 1, (VS_NW_INFO | MMTYPE_CNF))) return false;
+
+    if (confirm->NUMAVLNS == 0 || confirm->NUMSTAS == 0) return true;
+
+    const struct plc_link_station* station = &confirm->station;
+    memcpy (peer, station->MAC, ETHER_ADDR_LEN);
+    snprintf(link->peer, sizeof(link->peer), "%02X:%02X:%02X:%02X:%02X:%02X",
+             peer[0], peer[1], peer[2], peer[3], peer[4], peer[5]);
+    link->stations = confirm->NUMSTAS;
+    link->tx_rate  = LE16TOH (station->AVGTX);
+    link->rx_rate  = LE16TOH (station->AVGRX);
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// link_stats() - Asks for the MPDU and PHY block counters of our link to 'peer'
+// -----------------------------------------------------------------------------
+bool CPLCLink::link_stats(plc_link_t* link, const uint8_t peer[])
+{
+    struct plc_link_stats_request* request = (struct plc_link_stats_request*)m_message;
+    struct plc_link_stats_confirm* confirm = (struct plc_link_stats_confirm*)m_message;
+
+    memset (m_message, 0, sizeof (*m_message));
+    EthernetHeader (&request->ethernet, m_channel->peer, m_channel->host, m_channel->type);
+    QualcommHeader (&request->qualcomm, 0, (VS_LNK_STATS | MMTYPE_REQ));
+    request->MCONTROL  = 0;
+    request->DIRECTION = PLC_LINK_TXRX;
+    request->LID       = PLC_LINK_LID;
+    memcpy (request->MACADDRESS, peer, ETHER_ADDR_LEN);
+    if (!exchange(sizeof(*request), 0, (VS_LNK_STATS | MMTYPE_CNF))) return false;
+    if (confirm->MSTATUS) return false;
+
+    link->tx_acked     = LE64TOH (confirm->NUMTXMPDU_ACKD);
+    link->tx_collided  = LE64TOH (confirm->NUMTXMPDU_COLL);
+    link->tx_failed    = LE64TOH (confirm->NUMTXMPDU_FAIL);
+    link->tx_pb_passed = LE64TOH (confirm->NUMTXPBS_PASS);
+    link->tx_pb_failed = LE64TOH (confirm->NUMTXPBS_FAIL);
+    link->rx_acked     = LE64TOH (confirm->NUMRXMPDU_ACKD);
+    link->rx_failed    = LE64TOH (confirm->NUMRXMPDU_FAIL);
+    link->rx_pb_passed = LE64TOH (confirm->NUMRXPBS_PASS);
+    link->rx_pb_failed = LE64TOH (confirm->NUMRXPBS_FAIL);
+
+    // The error rates are only meaningful against the same station
+    if (strcmp(link->peer, m_last.peer) == 0)
+    {
+        link->tx_pb_error_pct = error_pct(link->tx_pb_passed, link->tx_pb_failed, m_last.tx_pb_passed, m_last.tx_pb_failed);
+        link->rx_pb_error_pct = error_pct(link->rx_pb_passed, link->rx_pb_failed, m_last.rx_pb_passed, m_last.rx_pb_failed);
+    }
+    m_last = *link;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// tone_map() - Asks how the tone map to 'peer' loads its carriers
+// -----------------------------------------------------------------------------
+bool CPLCLink::tone_map(plc_link_t* link, const uint8_t peer[])
+{
+    struct plc_link_tone_map_request* request = (struct plc_link_tone_map_request*)m_message;
+    struct plc_link_tone_map_confirm* confirm = (struct plc_link_tone_map_confirm*)m_message;
+
+    memset (m_message, 0, sizeof (*m_message));
+    EthernetHeader (&request->ethernet, m_channel->peer, m_channel->host, m_channel->type);
+    QualcommHeader (&request->qualcomm, 0, (VS_TONE_MAP_CHAR | MMTYPE_REQ));
+    memcpy (request->MACADDRESS, peer, ETHER_ADDR_LEN);
+    request->TMSLOT = 0;
+    if (!exchange(sizeof(*request), 0, (VS_TONE_MAP_CHAR | MMTYPE_CNF))) return false;
+    if (confirm->MSTATUS || confirm->NUMTMS == 0) return false;
+
+    unsigned carriers = LE16TOH (confirm->TMNUMACTCARRIERS);
+    if (carriers == 0) return false;
+
+    unsigned bits = 0;
+    for (unsigned carrier = 0; carrier < PLC_LINK_CARRIERS; carrier++)
+    {
+        uint8_t mod = confirm->MOD_CARRIER [carrier >> 1];
+        mod = (carrier & 1) ? (mod >> 4) : (mod & 0x0F);
+        if (mod < sizeof(ModulationBits) / sizeof(ModulationBits[0])) bits += ModulationBits [mod];
+    }
+
+    link->carriers         = carriers;
+    link->bits_per_carrier = (double)bits / carriers;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
@@ -0,0 +1,100 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// plclink.h - Polls our PLC modem for the quality of its link to the station on the other end
+//
+// Every poll asks the modem three things:
+//
+//      VS_NW_INFO          The stations in our AVLN and the average PHY rates to and from each
+//      VS_LNK_STATS        MPDU and PHY block counters for the link to the other station
+//      VS_TONE_MAP_CHAR    How many carriers the tone map to the other station uses, and how many
+//                          bits each carries.  HomePlug Green PHY modems only use ROBO modes, and
+//                          may not have a tone map to report
+//
+// The poller runs on a thread of its own at the lowest priority, on a channel of its own, so it never
+// gets in the way of SLAC or of the relay.
+//==========================================================================================================
+
+#pragma once
+
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// plc_link_t - What one poll found.  The counters are the modem's running totals;
+//              the error percentages are over the interval since the last poll
+// -----------------------------------------------------------------------------
+struct plc_link_t
+{
+    char        peer[18];           // MAC of the other station's modem, or "" if we're not in an AVLN
+    int         stations;           // How many other stations are in our AVLN
+    int         tx_rate;            // Average PHY rate to the other station in Mbps
+    int         rx_rate;            // And from it
+    int         carriers;           // Active carriers in the tone map, or -1 if there's no tone map
+    double      bits_per_carrier;   // Average bits per active carrier, or -1
+    uint64_t    tx_acked, tx_collided, tx_failed, tx_pb_passed, tx_pb_failed;
+    uint64_t    rx_acked, rx_failed, rx_pb_passed, rx_pb_failed;
+    double      tx_pb_error_pct;    // Failed PHY blocks as a percentage of those sent, or -1
+    double      rx_pb_error_pct;    // And of those received, or -1
+};
+// -----------------------------------------------------------------------------
+
+// Called on the poller's thread with the result of each poll
+typedef void (*plc_link_cb_t)(const plc_link_t& link, void* ctx);
+
+
+// -----------------------------------------------------------------------------
+// CPLCLink - Polls our PLC modem for link quality
+// -----------------------------------------------------------------------------
+class CPLCLink
+{
+public:
+
+    // Constructor
+    CPLCLink();
+
+    // Call this once the PLC channel is open. Opens a channel of our own to the same modem and
+    // starts polling it every 'interval_ms', handing each result to 'cb'
+    bool    start(int interval_ms, plc_link_cb_t cb, void* ctx);
+
+protected:
+
+    // The poller's thread
+    void    task();
+    static void launch_task(CPLCLink* p) {p->task();}
+
+    // Each request, and its answer. Each returns true if the modem answered
+    bool    station_info(plc_link_t* link, uint8_t peer[]);
+    bool    link_stats(plc_link_t* link, const uint8_t peer[]);
+    bool    tone_map(plc_link_t* link, const uint8_t peer[]);
+
+    // Sends the request in m_message, and waits for the answer
+    bool    exchange(size_t length, uint8_t MMV, uint16_t MMTYPE);
+
+    int             m_interval_ms;
+    plc_link_cb_t   m_cb;
+    void*           m_ctx;
+    bool            m_is_started;
+
+    // Our own channel to the modem, and the message buffer
+    struct channel* m_channel;
+    struct message* m_message;
+
+    // The counters from the last poll, for the error percentages
+    plc_link_t      m_last;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
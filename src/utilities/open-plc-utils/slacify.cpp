@@ -17,8 +17,25 @@
 #include <cstring>
 #include <stdlib.h>
 #include <limits.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "logger.h"
+#include "mstimer.h"
+#include "reactor.h"
 #include "slacify.h"
 
+// These live with the application
+extern CReactor reactor;
+extern CLogger  logger;
+
 // The following contains C code -----------------------------------------------
 extern "C" {
 #include "../open-plc-utils/plc/plc.h"
@@ -31,19 +48,11 @@ extern "C" {
 
 static signed evse_identifier (struct session * session, struct channel * channel);
 static signed pev_identifier (struct session * session, struct channel * channel);
-void CreateNMK(void);
-void CreateNID(void);
+static bool CreateKeys (uint8_t NMK [], uint8_t NID []);
 static void pev_initialize (struct session * session, char const * profile, char const * section);
 static void evse_initialize (struct session * session, char const * profile, char const * section);
 static void configure ();
-static void UnoccupiedState (struct session * session, struct channel * channel, struct message * message);
-static void UnmatchedState (struct session * session, struct channel * channel, struct message * message);
-static void MatchedState (struct session * session, struct channel * channel, struct message * message);
-int EVSESlac (signed c);
-static void PEV_DisconnectedState (struct session * session, struct channel * channel, struct message * message);
-static void PEV_UnmatchedState (struct session * session, struct channel * channel, struct message * message);
-static void PEV_MatchedState (struct session * session, struct channel * channel, struct message * message);
-int PEVSlac(signed c);
+static void settings (int device_type, signed c);
 
 // Define structs to hold session details
 extern struct channel channel;
@@ -62,29 +71,44 @@ struct message Message;
 #define PEV_NID      "B0F2E695666B03"		     /* HomePlugAV*/
 
 char const *profile;
-char const *section;
+char const *section = SECTION;
 
-// Define EVSE and PEV states to use in respective state machines
-enum evse_state_t
+// The phases of SLAC. Each side goes through the ones that apply to it; on the
+// EVSE, each PEV it's running SLAC with goes through them separately
+enum slac_phase_t
 {
-    EVSE_STATE_UNAVAILABLE = 0,
-    EVSE_STATE_UNOCCUPIED  = 1,
-    EVSE_STATE_UNMATCHED   = 2,
-    EVSE_STATE_MATCHED     = 3
+    PHASE_PARAM   = 1,  // EVSE: running SLAC with the PEVs it hears.  PEV: sending CM_SLAC_PARAM.REQ until it's confirmed
+    PHASE_START   = 2,  // EVSE: waiting for CM_START_ATTEN_CHAR.IND
+    PHASE_SOUNDS  = 3,  // EVSE: collecting the sounds.  PEV: sending them
+    PHASE_ATTEN   = 4,  // EVSE: waiting for CM_ATTEN_CHAR.RSP.  PEV: waiting for CM_ATTEN_CHAR.IND
+    PHASE_MATCH   = 5,  // EVSE: waiting for CM_SLAC_MATCH.REQ.  PEV: waiting for CM_SLAC_MATCH.CNF
+    PHASE_SET_KEY = 6,  // PEV: waiting for our modem to take the EVSE's key
+    PHASE_JOIN    = 7   // Both: asking our modem until the AVLN has formed
 };
 
-enum pev_state_t
+// Where SLAC is, as connect() reports it
+enum slac_status_t
 {
-    PEV_STATE_DISCONNECTED = 1,
-    PEV_STATE_UNMATCHED    = 2,
-    PEV_STATE_MATCHED      = 3,
-    PEV_STATE_UNAVAILABLE  = 4
+    STATUS_IDLE    = 0,
+    STATUS_RUNNING = 1,
+    STATUS_DONE    = 2,
+    STATUS_FAILED  = 3
 };
 
+// How long the EVSE waits for CM_SLAC_MATCH.REQ (TT_EVSE_match_session), in ms
+#define SLAC_MATCH_TIMEOUT 10000
+
+// How soon we first ask our modem again whether the AVLN has formed, and the
+// longest we back off to, in ms
+#define SLAC_JOIN_POLL_MIN 20
+#define SLAC_JOIN_POLL_MAX 500
+
 uint8_t EVSE_NMK[HPAVKEY_NMK_LEN];
 uint8_t EVSE_NID[HPAVKEY_NID_LEN];
 
-uint8_t C_sequ_retry;
+// True if the EVSE's profile sets its network key, rather than us generating one
+static bool ProfileKeys;
+
 int slac_timeout_sec, num_retries;
 int m_slac_limit;
 }
@@ -120,33 +144,143 @@ static signed pev_identifier (struct session * session, struct channel * channel
 // -----------------------------------------------------------------------------
 // NMK and keygeneration functions for EVSE
 // -----------------------------------------------------------------------------
-void CreateNMK(void)
+
+// The number of NMK/NID pairs kept ready
+#define KEY_POOL_SIZE 4
+
+// -----------------------------------------------------------------------------
+// random_bytes() - Fills 'buffer' from the kernel's random number generator.
+//                  Returns true on success
+// -----------------------------------------------------------------------------
+static bool random_bytes(uint8_t* buffer, size_t length)
 {
-    const char *cmd = "date +%s | sha256sum | base64 | head -c 32 ; echo";  //randomish seed
-    char buf[35];
-    FILE *ptr;
+#if defined (SYS_getrandom)
+    if (syscall(SYS_getrandom, buffer, length, 0) == (long)length) return true;
+#endif
 
-	if ((ptr = popen(cmd, "r")) != NULL)
-	{
-		while (fgets(buf, sizeof(buf), ptr) != NULL)
-		{
-			//printf("%s", buf);
-		}
-		pclose(ptr);
-	}
+    // Kernels before 3.17 don't have getrandom()
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
 
-	HPAVKeyNMK(EVSE_NMK, buf);
-	/*for (i = 0;  i < HPAVKEY_NMK_LEN; i++)
-	{
-	printf ("%02x", EVSE_NMK[i]);
-	printf ("\n");
-	}
-	printf ("\n");*/
+    size_t total = 0;
+    while (total < length)
+    {
+        ssize_t count = read(fd, buffer + total, length - total);
+        if (count <= 0) break;
+        total += count;
+    }
+    ::close(fd);
+
+    return total == length;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CreateKeys() - Generates a random NMK and the NID that goes with it. Returns
+//                true on success
+// -----------------------------------------------------------------------------
+static bool CreateKeys (uint8_t NMK [], uint8_t NID [])
+{
+    if (!random_bytes(NMK, HPAVKEY_NMK_LEN)) return false;
+    HPAVKeyNID(NID, NMK, 0);
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CKeyPool - Keeps a few NMK/NID pairs ready, so the EVSE never waits on key
+//            generation.  A background thread tops the pool up
+// -----------------------------------------------------------------------------
+class CKeyPool
+{
+public:
+
+    // Constructor
+    CKeyPool() {m_count = 0; m_is_started = false;}
+
+    // Starts the thread that keeps the pool full
+    void start();
+
+    // Takes the oldest pair. If the pool is empty, a pair is generated on the spot.
+    // Returns true on success
+    bool take(uint8_t NMK [], uint8_t NID []);
+
+protected:
+
+    // Fills the pool, and refills it whenever a pair is taken
+    void task();
+    static void launch_task(CKeyPool* p) {p->task();}
+
+    uint8_t     m_nmk [KEY_POOL_SIZE][HPAVKEY_NMK_LEN];
+    uint8_t     m_nid [KEY_POOL_SIZE][HPAVKEY_NID_LEN];
+    int         m_count;
+    bool        m_is_started;
+
+    // Protects the pool, and wakes the thread when there's room in it
+    std::mutex              m_mtx;
+    std::condition_variable m_cv;
+};
+
+static CKeyPool KeyPool;
+
+
+void CKeyPool::start()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_is_started) return;
+    m_is_started = true;
+
+    std::thread th(launch_task, this);
+    th.detach();
+}
+
+
+bool CKeyPool::take(uint8_t NMK [], uint8_t NID [])
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    if (m_count == 0)
+    {
+        lock.unlock();
+        return CreateKeys(NMK, NID);
+    }
+
+    memcpy(NMK, m_nmk[0], HPAVKEY_NMK_LEN);
+    memcpy(NID, m_nid[0], HPAVKEY_NID_LEN);
+    m_count--;
+    memmove(m_nmk[0], m_nmk[1], m_count * HPAVKEY_NMK_LEN);
+    memmove(m_nid[0], m_nid[1], m_count * HPAVKEY_NID_LEN);
+    m_cv.notify_all();
+    return true;
 }
 
-void CreateNID(void)
+
+void CKeyPool::task()
 {
-	HPAVKeyNID(EVSE_NID, EVSE_NMK, 0);
+    uint8_t NMK [HPAVKEY_NMK_LEN];
+    uint8_t NID [HPAVKEY_NID_LEN];
+
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (true)
+    {
+        while (m_count == KEY_POOL_SIZE) m_cv.wait(lock);
+
+        // Generate outside the lock, so take() never waits on it
+        lock.unlock();
+        bool ok = CreateKeys(NMK, NID);
+        if (!ok) sleep(1);
+        lock.lock();
+
+        if (ok && m_count < KEY_POOL_SIZE)
+        {
+            memcpy(m_nmk[m_count], NMK, HPAVKEY_NMK_LEN);
+            memcpy(m_nid[m_count], NID, HPAVKEY_NID_LEN);
+            m_count++;
+        }
+    }
 }
 // -----------------------------------------------------------------------------
 
@@ -163,7 +297,7 @@ static void pev_initialize (struct session * session, char const * profile, char
 	hexencode (session->NID, sizeof (session->NID), configstring (profile, section, "NetworkIdentifier", PEV_NID));
 	session->limit = confignumber (profile, section, "AttenuationThreshold", m_slac_limit);
 	session->pause = confignumber (profile, section, "MSoundPause", SLAC_PAUSE);
-	session->state = PEV_STATE_DISCONNECTED;
+	session->state = PHASE_PARAM;
 	memcpy (session->original_nmk, session->NMK, sizeof (session->original_nmk));
 	memcpy (session->original_nid, session->NID, sizeof (session->original_nid));
 	slac_session (session);
@@ -173,28 +307,38 @@ static void pev_initialize (struct session * session, char const * profile, char
 
 static void evse_initialize (struct session * session, char const * profile, char const * section)
 {
-	char nmk[(HPAVKEY_NMK_LEN*2)+1];
-	char nid[(HPAVKEY_NID_LEN*2)+1];
-	int i;
+	char const * string;
 
-	CreateNMK();
-	CreateNID();
+	if (!KeyPool.take (EVSE_NMK, EVSE_NID))
+	{
+		debug (0, __func__, "Can't generate a network key");
+	}
 
-	for (i = 0;  i < HPAVKEY_NMK_LEN; i++)
+	/*a key in the profile overrides the one we generated*/
+	session->next = session->prev = session;
+	ProfileKeys = false;
+	if ((string = configstring (profile, section, "NetworkMembershipKey", NULL)))
 	{
-		sprintf(&nmk[i*2],"%02x", EVSE_NMK[i]); /*convert uint8_t array to string*/
+		hexencode (session->NMK, sizeof (session->NMK), string);
+		ProfileKeys = true;
 	}
-	for (i = 0;  i < HPAVKEY_NID_LEN; i++)
+	else
 	{
-		sprintf(&nid[i*2],"%02x", EVSE_NID[i]); /*convert uint8_t array to string*/
+		memcpy (session->NMK, EVSE_NMK, sizeof (session->NMK));
+	}
+	if ((string = configstring (profile, section, "NetworkIdentifier", NULL)))
+	{
+		hexencode (session->NID, sizeof (session->NID), string);
+		ProfileKeys = true;
+	}
+	else
+	{
+		memcpy (session->NID, EVSE_NID, sizeof (session->NID));
 	}
-	session->next = session->prev = session;
-	hexencode (session->NMK, sizeof (session->NMK), configstring (profile, section, "NetworkMembershipKey", nmk));
-	hexencode (session->NID, sizeof (session->NID), configstring (profile, section, "NetworkIdentifier", nid));
 	session->NUM_SOUNDS = confignumber (profile, section, "NumberOfSounds", SLAC_MSOUNDS);
 	session->TIME_OUT = confignumber (profile, section, "TimeToSound", SLAC_TIMETOSOUND);
 	session->RESP_TYPE = confignumber (profile, section, "ResponseType", SLAC_RESPONSE_TYPE);
-	session->state = EVSE_STATE_UNOCCUPIED;
+	session->state = PHASE_PARAM;
 	slac_session (session);
 
 	return;
@@ -211,7 +355,7 @@ static void evse_initialize (struct session * session, char const * profile, cha
 
 // #############################################################################
 // #############################################################################
-//                        EVSE state machine functions
+//                            SLAC settings
 // #############################################################################
 // #############################################################################
 
@@ -255,444 +399,1732 @@ static void configure ()
 
 /*====================================================================*
  *
- *   void UnoccupiedState (struct session * session, struct channel * channel, struct message * message);
+ *   void settings (int device_type, signed c);
+ *
+ *   apply the SLAC setting passed to CSLACify::init(); these are the
+ *   command line options of the original evse and pev programs;
  *
  *--------------------------------------------------------------------*/
 
-static void UnoccupiedState (struct session * session, struct channel * channel, struct message * message)
-{
-	 __time_t CurrentTime, DeltaTime, InitTime;
-	slac_session (session);
-	debug (0, __func__, "Listening ...");
+static void settings (int device_type, signed c)
 
-	InitTime = time(0);
-
-	while (evse_cm_slac_param (session, channel, message))
+{
+	channel.timeout = SLAC_TIMEOUT;
+	if (getenv (PLCDEVICE))
+	{
+		channel.ifname = strdup (getenv (PLCDEVICE));
+	}
+	switch (c)
 	{
-		CurrentTime = time(0);
-		DeltaTime = CurrentTime - InitTime;
-		if(DeltaTime >= slac_timeout_sec) /*allow EVSE 20 Seconds to receive CM_SLAC_PARAM.REQ*/
+	case 'c':
+		configure ();
+		break;
+	case 'C':
+		_setbits (Session.flags, SLAC_COMPARE);
+		break;
+	case 'd':
+		_setbits (Session.flags, (SLAC_VERBOSE | SLAC_SESSION));
+		break;
+	case 'i':
+		channel.ifname = optarg;
+		break;
+	case 'p':
+		profile = optarg;
+		break;
+	case 's':
+		section = optarg;
+		break;
+	case 'q':
+		if (device_type == EVSE)
 		{
-			debug (0, __func__, "CM_SLAC_PARAM.REQ TIMEOUT (20 sec)!");
-            debug (0, __func__, "Retrying ... ");
-			sleep(5);
-			if(C_sequ_retry >= num_retries)
-			{
-				session->state = EVSE_STATE_UNAVAILABLE;
-				C_sequ_retry = 0; /*clear flag*/
-			}
-			else
-			{
-			  session->state = EVSE_STATE_UNOCCUPIED;
-			  C_sequ_retry++;
-			}
-			return;
+			_setbits (channel.flags, CHANNEL_SILENCE);
 		}
+		else
+		{
+			_clrbits (channel.flags, CHANNEL_SILENCE);
+		}
+		break;
+	case 't':
+		channel.timeout = (signed)(uintspec (optarg, 0, UINT_MAX));
+		break;
+	case 'v':
+		_setbits (channel.flags, CHANNEL_VERBOSE);
+		break;
+	case 'x':
+		Session.exit = Session.exit? 0: 1;
+		break;
+	default:
+		break;
 	}
-
-	session->state = EVSE_STATE_UNMATCHED;
 	return;
 }
 
 
+
+
+
+
+
+
+// #############################################################################
+// #############################################################################
+//                        SLAC message functions
+// #############################################################################
+// #############################################################################
+
+/*
+ *	These are the halves of the evse_cm_ and pev_cm_ library functions. The
+ *	library functions send a message and then block until the answer comes;
+ *	here each one either sends a message, or handles one that has already
+ *	arrived in 'message', so the SLAC engine can wait for answers on the
+ *	reactor instead. Functions that handle a message return 0 if it was for
+ *	this session, 1 if it wasn't, or -1 if a reply couldn't be sent;
+ */
+
+#ifndef __GNUC__
+#pragma pack (push,1)
+#endif
+
+struct __packed cm_set_key_request
+{
+	struct ethernet_hdr ethernet;
+	struct homeplug_fmi homeplug;
+	uint8_t KEYTYPE;
+	uint32_t MYNOUNCE;
+	uint32_t YOURNOUNCE;
+	uint8_t PID;
+	uint16_t PRN;
+	uint8_t PMN;
+	uint8_t CCOCAP;
+	uint8_t NID [SLAC_NID_LEN];
+	uint8_t NEWEKS;
+	uint8_t NEWKEY [SLAC_NMK_LEN];
+	uint8_t RSVD [3];
+};
+
+struct __packed cm_set_key_confirm
+{
+	struct ethernet_hdr ethernet;
+	struct homeplug_fmi homeplug;
+	uint8_t RESULT;
+	uint32_t MYNOUNCE;
+	uint32_t YOURNOUNCE;
+	uint8_t PID;
+	uint16_t PRN;
+	uint8_t PMN;
+	uint8_t CCOCAP;
+	uint8_t RSVD [27];
+};
+
+struct __packed vs_nw_info_confirm
+{
+	struct ethernet_hdr ethernet;
+	struct qualcomm_fmi qualcomm;
+	uint8_t SUB_VERSION;
+	uint8_t Reserved;
+	uint16_t DATA_LEN;
+	uint8_t Reserved1;
+	uint8_t NUMAVLNS;
+	uint8_t NID [7];
+	uint8_t Reserved2 [2];
+	uint8_t SNID;
+	uint8_t TEI;
+	uint8_t Reserved3 [4];
+	uint8_t ROLE;
+	uint8_t CCO_MAC [ETHER_ADDR_LEN];
+	uint8_t CCO_TEI;
+	uint8_t Reserved4 [3];
+	uint8_t NUMSTAS;
+};
+
+#ifndef __GNUC__
+#pragma pack (pop)
+#endif
+
+
 /*====================================================================*
  *
- *   void MatchingState (struct session * session, struct channel * channel, struct message * message);
+ *   signed evse_slac_param (struct session * session, struct channel * channel, struct message * message);
  *
- *   the cm_start_atten_char message establishes msound count and
- *   timeout;
+ *   <-- CM_SLAC_PARAM.REQ, --> CM_SLAC_PARAM.CNF
  *
  *--------------------------------------------------------------------*/
 
-static void UnmatchedState (struct session * session, struct channel * channel, struct message * message)
+static signed evse_slac_param (struct session * session, struct channel * channel, struct message * message)
+
 {
-	slac_session (session);
-	debug (0, __func__, "Sounding ...");
-	if (evse_cm_start_atten_char (session, channel, message))
-	{
-		session->state = EVSE_STATE_UNOCCUPIED;
-		return;
-	}
-	if (evse_cm_mnbc_sound (session, channel, message))
-	{
-		session->state = EVSE_STATE_UNOCCUPIED;
-		return;
-	}
-	if (evse_cm_atten_char (session, channel, message))
-	{
-		session->state = EVSE_STATE_UNOCCUPIED;
-		return;
-	}
-	debug (0, __func__, "Matching ...");
-	if (evse_cm_slac_match (session, channel, message))
+	extern byte const broadcast [ETHER_ADDR_LEN];
+	struct cm_slac_param_request * request = (struct cm_slac_param_request *) (message);
+	struct cm_slac_param_confirm * confirm = (struct cm_slac_param_confirm *) (message);
+	slac_debug (session, 0, __func__, "<-- CM_SLAC_PARAM.REQ");
+	session->APPLICATION_TYPE = request->APPLICATION_TYPE;
+	session->SECURITY_TYPE = request->SECURITY_TYPE;
+	memcpy (session->PEV_MAC, request->ethernet.OSA, sizeof (session->PEV_MAC));
+	memcpy (session->RunID, request->RunID, sizeof (session->RunID));
+	slac_debug (session, 0, __func__, "--> CM_SLAC_PARAM.CNF");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&confirm->ethernet, session->PEV_MAC, channel->host, channel->type);
+	HomePlugHeader1 (&confirm->homeplug, HOMEPLUG_MMV, (CM_SLAC_PARAM | MMTYPE_CNF));
+	memcpy (confirm->MSOUND_TARGET, broadcast, sizeof (confirm->MSOUND_TARGET));
+	confirm->NUM_SOUNDS = session->NUM_SOUNDS;
+	confirm->TIME_OUT = session->TIME_OUT;
+	confirm->RESP_TYPE = session->RESP_TYPE;
+	memcpy (confirm->FORWARDING_STA, session->PEV_MAC, sizeof (confirm->FORWARDING_STA));
+	confirm->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	confirm->SECURITY_TYPE = session->SECURITY_TYPE;
+	memcpy (confirm->RunID, session->RunID, sizeof (confirm->RunID));
+	confirm->CipherSuite = HTOLE16 ((uint16_t)(session->counter));
+	if (sendmessage (channel, message, (ETHER_MIN_LEN - ETHER_CRC_LEN)) <= 0)
 	{
-		session->state = EVSE_STATE_UNOCCUPIED;
-		return;
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
 	}
-	session->state = EVSE_STATE_MATCHED;
-	return;
+	return (0);
 }
 
 
 /*====================================================================*
  *
- *   void MatchedState (struct session * session, struct channel * channel, struct message * message);
+ *   signed evse_start_atten_char (struct session * session, struct message * message);
+ *
+ *   <-- CM_START_ATTEN_CHAR.IND; the PEV sends three, and we take the
+ *   first one for this run;
  *
  *--------------------------------------------------------------------*/
 
-static void MatchedState (struct session * session, struct channel * channel, struct message * message)
-{
-	__time_t CurrentTime, DeltaTime, InitTime;
-	struct plc plc;
-	debug (0, __func__, "Connecting ...");
-	InitTime = time(0);  /*start TT_match_join timer (12 sec)*/
+static signed evse_start_atten_char (struct session * session, struct message * message)
 
-	/*determine if logical network has been established*/
-	_setbits (plc.flags, PLC_NETWORK);
-	plc.channel = channel;
-	plc.message = message;
-	while (NetInfo2 (&plc))
+{
+	struct cm_start_atten_char_indicate * indicate = (struct cm_start_atten_char_indicate *) (message);
+	if (memcmp (session->RunID, indicate->ACVarField.RunID, sizeof (session->RunID)))
 	{
-		CurrentTime = time(0);
-		DeltaTime = CurrentTime - InitTime;
-		if(DeltaTime >= slac_timeout_sec) /*allow PEV 12 Seconds to join AVLN*/
-		{
-			session->state = EVSE_STATE_UNOCCUPIED; /*timer has expired before logical network reset state machine*/
-			debug (0, __func__, "Timeout: PEV did not join logical network (30 sec)!");
-			return;
-		}
+		return (1);
 	}
-
-	return;
+	slac_debug (session, 0, __func__, "<-- CM_START_ATTEN_CHAR.IND");
+	session->NUM_SOUNDS = indicate->ACVarField.NUM_SOUNDS;
+	session->TIME_OUT = indicate->ACVarField.TIME_OUT;
+	memcpy (session->FORWARDING_STA, indicate->ACVarField.FORWARDING_STA, sizeof (session->FORWARDING_STA));
+	return (0);
 }
 
 
-
 /*====================================================================*
  *
- *   int EVSESlac (signed c);
+ *   signed evse_atten_profile (struct session * session, struct message * message, unsigned AAG []);
+ *
+ *   <-- CM_ATTEN_PROFILE.IND; our modem sends one for each sound it
+ *   heard; add its attenuation to the running total in AAG;
  *
  *--------------------------------------------------------------------*/
 
-int EVSESlac (signed c)
+static signed evse_atten_profile (struct session * session, struct message * message, unsigned AAG [])
+
 {
-	channel.timeout = SLAC_TIMEOUT;
-	if (getenv (PLCDEVICE))
+	struct cm_atten_profile_indicate * indicate = (struct cm_atten_profile_indicate *) (message);
+	if (memcmp (session->PEV_MAC, indicate->PEV_MAC, sizeof (session->PEV_MAC)))
 	{
-		channel.ifname = strdup (getenv (PLCDEVICE));
+		return (1);
 	}
-	switch (c)
-		{
-		case 'c':
-			configure ();
-			return (0);
-		case 'C':
-			_setbits (Session.flags, SLAC_COMPARE);
-			break;
-		case 'd':
-			_setbits (Session.flags, (SLAC_VERBOSE | SLAC_SESSION));
-			break;
-		case 'i':
-			channel.ifname = optarg;
-			break;
-		case 'p':
-			profile = optarg;
-			break;
-		case 's':
-			section = optarg;
-			break;
-		case 'q':
-			_setbits (channel.flags, CHANNEL_SILENCE);
-			break;
-		case 't':
-			channel.timeout = (signed)(uintspec (optarg, 0, UINT_MAX));
-			break;
-		case 'v':
-			_setbits (channel.flags, CHANNEL_VERBOSE);
-			break;
-		case 'x':
-			Session.exit = Session.exit? 0: 1;
-			break;
-		default:
-			break;
+	slac_debug (session, 0, __func__, "<-- CM_ATTEN_PROFILE.IND (%d)", session->sounds);
+	for (session->NumGroups = 0; (session->NumGroups < indicate->NumGroups) && (session->NumGroups < SLAC_GROUPS); session->NumGroups++)
+	{
+		AAG [session->NumGroups] += indicate->AAG [session->NumGroups];
 	}
+	session->sounds++;
+	return (0);
+}
+
+
+/*====================================================================*
+ *
+ *   signed evse_atten_char (struct session * session, struct channel * channel, struct message * message, unsigned AAG []);
+ *
+ *   --> CM_ATTEN_CHAR.IND with the average attenuation of the sounds
+ *   we heard;
+ *
+ *--------------------------------------------------------------------*/
+
+static signed evse_atten_char (struct session * session, struct channel * channel, struct message * message, unsigned AAG [])
 
-	while (Session.state)
+{
+	struct cm_atten_char_indicate * indicate = (struct cm_atten_char_indicate *) (message);
+	unsigned group;
+	memset (session->AAG, 0, sizeof (session->AAG));
+	if (session->sounds > 0)
 	{
-		if (Session.state == EVSE_STATE_UNOCCUPIED)
-		{
-			UnoccupiedState (&Session, &channel, &Message);
-			continue;
-		}
-		if (Session.state == EVSE_STATE_UNMATCHED)
-		{
-			UnmatchedState (&Session, &channel, &Message);
-			continue;
-		}
-		if (Session.state == EVSE_STATE_MATCHED)
+		for (group = 0; group < SLAC_GROUPS; ++group)
 		{
-			MatchedState (&Session, &channel, &Message);
-			break;
+			session->AAG [group] = AAG [group] / session->sounds;
 		}
-		debug (1, __func__, "Illegal state!");
-	}
-	closechannel (&channel);
-
-	if (Session.state == EVSE_STATE_MATCHED)
-	{
-	    return (0);
 	}
-	else
+	slac_debug (session, 0, __func__, "--> CM_ATTEN_CHAR.IND");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&indicate->ethernet, session->PEV_MAC, channel->host, channel->type);
+	HomePlugHeader1 (&indicate->homeplug, HOMEPLUG_MMV, (CM_ATTEN_CHAR | MMTYPE_IND));
+	indicate->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	indicate->SECURITY_TYPE = session->SECURITY_TYPE;
+	memcpy (indicate->ACVarField.SOURCE_ADDRESS, session->PEV_MAC, sizeof (indicate->ACVarField.SOURCE_ADDRESS));
+	memcpy (indicate->ACVarField.RunID, session->RunID, sizeof (indicate->ACVarField.RunID));
+	indicate->ACVarField.NUM_SOUNDS = session->sounds;
+	indicate->ACVarField.ATTEN_PROFILE.NumGroups = session->NumGroups;
+	memcpy (indicate->ACVarField.ATTEN_PROFILE.AAG, session->AAG, session->NumGroups);
+	if (sendmessage (channel, message, sizeof (* indicate)) <= 0)
 	{
-		return 1;
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
 	}
+	return (0);
 }
 
 
+/*====================================================================*
+ *
+ *   signed evse_atten_char_response (struct session * session, struct message * message);
+ *
+ *   <-- CM_ATTEN_CHAR.RSP
+ *
+ *--------------------------------------------------------------------*/
 
+static signed evse_atten_char_response (struct session * session, struct message * message)
 
+{
+	struct cm_atten_char_response * response = (struct cm_atten_char_response *) (message);
+	if (memcmp (session->RunID, response->ACVarField.RunID, sizeof (session->RunID)))
+	{
+		return (1);
+	}
+	slac_debug (session, 0, __func__, "<-- CM_ATTEN_CHAR.RSP");
+	return (0);
+}
 
 
+/*====================================================================*
+ *
+ *   signed evse_slac_match (struct session * session, struct channel * channel, struct message * message);
+ *
+ *   <-- CM_SLAC_MATCH.REQ, --> CM_SLAC_MATCH.CNF with our NID and NMK
+ *
+ *--------------------------------------------------------------------*/
 
+static signed evse_slac_match (struct session * session, struct channel * channel, struct message * message)
 
-// #############################################################################
-// #############################################################################
-//                         PEV state machine functions
-// #############################################################################
-// #############################################################################
+{
+	struct cm_slac_match_request * request = (struct cm_slac_match_request *) (message);
+	struct cm_slac_match_confirm * confirm = (struct cm_slac_match_confirm *) (message);
+	if (memcmp (session->RunID, request->MatchVarField.RunID, sizeof (session->RunID)))
+	{
+		return (1);
+	}
+	slac_debug (session, 0, __func__, "<-- CM_SLAC_MATCH.REQ");
+	memcpy (session->PEV_ID, request->MatchVarField.PEV_ID, sizeof (session->PEV_ID));
+	memcpy (session->PEV_MAC, request->MatchVarField.PEV_MAC, sizeof (session->PEV_MAC));
+	slac_debug (session, 0, __func__, "--> CM_SLAC_MATCH.CNF");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&confirm->ethernet, session->PEV_MAC, channel->host, channel->type);
+	HomePlugHeader1 (&confirm->homeplug, HOMEPLUG_MMV, (CM_SLAC_MATCH | MMTYPE_CNF));
+	confirm->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	confirm->SECURITY_TYPE = session->SECURITY_TYPE;
+	confirm->MVFLength = HTOLE16 (sizeof (confirm->MatchVarField));
+	memcpy (confirm->MatchVarField.PEV_ID, session->PEV_ID, sizeof (confirm->MatchVarField.PEV_ID));
+	memcpy (confirm->MatchVarField.PEV_MAC, session->PEV_MAC, sizeof (confirm->MatchVarField.PEV_MAC));
+	memcpy (confirm->MatchVarField.EVSE_ID, session->EVSE_ID, sizeof (confirm->MatchVarField.EVSE_ID));
+	memcpy (confirm->MatchVarField.EVSE_MAC, session->EVSE_MAC, sizeof (confirm->MatchVarField.EVSE_MAC));
+	memcpy (confirm->MatchVarField.RunID, session->RunID, sizeof (confirm->MatchVarField.RunID));
+	memcpy (confirm->MatchVarField.NID, session->NID, sizeof (confirm->MatchVarField.NID));
+	memcpy (confirm->MatchVarField.NMK, session->NMK, sizeof (confirm->MatchVarField.NMK));
+	if (sendmessage (channel, message, sizeof (* confirm)) <= 0)
+	{
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
+	}
+	return (0);
+}
 
 
+/*====================================================================*
+ *
+ *   signed pev_slac_param (struct session * session, struct channel * channel, struct message * message);
+ *
+ *   --> CM_SLAC_PARAM.REQ, broadcast
+ *
+ *--------------------------------------------------------------------*/
+
+static signed pev_slac_param (struct session * session, struct channel * channel, struct message * message)
 
+{
+	extern byte const broadcast [ETHER_ADDR_LEN];
+	struct cm_slac_param_request * request = (struct cm_slac_param_request *) (message);
+	slac_debug (session, 0, __func__, "--> CM_SLAC_PARAM.REQ");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&request->ethernet, broadcast, channel->host, channel->type);
+	HomePlugHeader1 (&request->homeplug, HOMEPLUG_MMV, (CM_SLAC_PARAM | MMTYPE_REQ));
+	request->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	request->SECURITY_TYPE = session->SECURITY_TYPE;
+	memcpy (request->RunID, session->RunID, sizeof (request->RunID));
+	request->CipherSuite [0] = HTOLE16 ((uint16_t)(session->counter));
+	if (sendmessage (channel, message, (ETHER_MIN_LEN - ETHER_CRC_LEN)) <= 0)
+	{
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
+	}
+	return (0);
+}
 
 
 /*====================================================================*
  *
- *   void DisconnectedState (struct session * session, struct channel * channel, struct message * message);
+ *   signed pev_slac_param_confirm (struct session * session, struct message * message);
+ *
+ *   <-- CM_SLAC_PARAM.CNF; the EVSE tells us how to sound;
  *
  *--------------------------------------------------------------------*/
 
-static void PEV_DisconnectedState (struct session * session, struct channel * channel, struct message * message)
+static signed pev_slac_param_confirm (struct session * session, struct message * message)
+
 {
-	__time_t CurrentTime, DeltaTime, InitTime;
+	struct cm_slac_param_confirm * confirm = (struct cm_slac_param_confirm *) (message);
+	if (memcmp (session->RunID, confirm->RunID, sizeof (session->RunID)))
+	{
+		return (1);
+	}
+	slac_debug (session, 0, __func__, "<-- CM_SLAC_PARAM.CNF");
+	memcpy (session->FORWARDING_STA, confirm->FORWARDING_STA, sizeof (session->FORWARDING_STA));
+	memcpy (session->MSOUND_TARGET, confirm->MSOUND_TARGET, sizeof (session->MSOUND_TARGET));
+	session->NUM_SOUNDS = confirm->NUM_SOUNDS;
+	session->TIME_OUT = confirm->TIME_OUT;
+	session->RESP_TYPE = confirm->RESP_TYPE;
+	return (0);
+}
 
-	slac_session (session);
-	debug (0, __func__, "Probing ...");
-	memincr (session->RunID, sizeof (session->RunID));
 
-	InitTime = time(0);
+/*====================================================================*
+ *
+ *   signed pev_start_atten_char (struct session * session, struct channel * channel, struct message * message);
+ *
+ *   --> CM_START_ATTEN_CHAR.IND; the GreenPHY spec says to send it
+ *   three times to ensure that it is received;
+ *
+ *--------------------------------------------------------------------*/
+
+static signed pev_start_atten_char (struct session * session, struct channel * channel, struct message * message)
 
-	while (pev_cm_slac_param (session, channel, message))
+{
+	struct cm_start_atten_char_indicate * indicate = (struct cm_start_atten_char_indicate *) (message);
+	unsigned count;
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&indicate->ethernet, session->MSOUND_TARGET, channel->host, channel->type);
+	HomePlugHeader1 (&indicate->homeplug, HOMEPLUG_MMV, (CM_START_ATTEN_CHAR | MMTYPE_IND));
+	indicate->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	indicate->SECURITY_TYPE = session->SECURITY_TYPE;
+	indicate->ACVarField.NUM_SOUNDS = session->NUM_SOUNDS;
+	indicate->ACVarField.TIME_OUT = session->TIME_OUT;
+	indicate->ACVarField.RESP_TYPE = session->RESP_TYPE;
+	memcpy (indicate->ACVarField.FORWARDING_STA, session->FORWARDING_STA, sizeof (indicate->ACVarField.FORWARDING_STA));
+	memcpy (indicate->ACVarField.RunID, session->RunID, sizeof (indicate->ACVarField.RunID));
+	for (count = 0; count < 3; count++)
 	{
-			CurrentTime = time(0);
-			DeltaTime = CurrentTime - InitTime;
-
-			if(DeltaTime >= slac_timeout_sec) /*allow PEV 20 Seconds to receive CM_SLAC_PARAM.CONF*/
-			{
-				debug (0, __func__, "CM_SLAC_PARAM.CONF TIMEOUT (20 sec)!");
-				if(C_sequ_retry >= num_retries)
-				{
-					session->state = PEV_STATE_UNAVAILABLE;
-					C_sequ_retry = 0; /*clear flag*/
-					/*Show Message on EVSE Screen*/
-				}
-				else
-				{
-				  session->state = PEV_STATE_DISCONNECTED;
-				  C_sequ_retry++;
-				}
-				return;
-			}
+		slac_debug (session, 0, __func__, "--> CM_START_ATTEN_CHAR.IND");
+		if (sendmessage (channel, message, (ETHER_MIN_LEN - ETHER_CRC_LEN)) <= 0)
+		{
+			return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
 		}
-	session->state = PEV_STATE_UNMATCHED;
-	return;
+	}
+	return (0);
 }
 
 
 /*====================================================================*
  *
- *   void MatchingState (struct session * session, struct channel * channel, struct message * message);
- *
- *   The PEV-EVSE perform GreenPPEA protocol in this state;
+ *   signed pev_mnbc_sound (struct session * session, struct channel * channel, struct message * message, unsigned count);
  *
- *   the cm_start_atten_char and cm_mnbc_sound messages are sent
- *   broadcast; the application may receive multiple cm_atten_char
- *   messages before sending the cm_slac_match message;
+ *   --> one CM_MNBC_SOUND.IND; 'count' is the number still to go
+ *   after this one;
  *
  *--------------------------------------------------------------------*/
 
-static void PEV_UnmatchedState (struct session * session, struct channel * channel, struct message * message)
+static signed pev_mnbc_sound (struct session * session, struct channel * channel, struct message * message, unsigned count)
+
 {
-	slac_session (session);
-	debug (0, __func__, "Sounding ...");
-	/*Send 3 CM_START_ATTEN_CHAR.IND*/
-	if (pev_cm_start_atten_char (session, channel, message))
-	{
-		session->state = PEV_STATE_DISCONNECTED;
-		return;
-	}
-	/*Send the number of sounding packets requested by EVSE*/
-	if (pev_cm_mnbc_sound (session, channel, message))
+	struct cm_mnbc_sound_indicate * indicate = (struct cm_mnbc_sound_indicate *) (message);
+	slac_debug (session, 0, __func__, "--> CM_MNBC_SOUND.IND");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&indicate->ethernet, session->MSOUND_TARGET, channel->host, channel->type);
+	HomePlugHeader1 (&indicate->homeplug, HOMEPLUG_MMV, (CM_MNBC_SOUND | MMTYPE_IND));
+	indicate->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	indicate->SECURITY_TYPE = session->SECURITY_TYPE;
+	memcpy (indicate->MSVarField.SenderID, session->PEV_ID, sizeof (indicate->MSVarField.SenderID));
+	indicate->MSVarField.CNT = count;
+	memcpy (indicate->MSVarField.RunID, session->RunID, sizeof (indicate->MSVarField.RunID));
+	if (sendmessage (channel, message, sizeof (* indicate)) <= 0)
 	{
-		session->state = PEV_STATE_DISCONNECTED;
-		return;
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
 	}
-	/*Wait to receive the results of the sounds (CM_ATTEN_CHAR.IND)*/
-	if (pev_cm_atten_char (session, channel, message))
+	return (0);
+}
+
+
+/*====================================================================*
+ *
+ *   signed pev_atten_char (struct session * session, struct channel * channel, struct message * message);
+ *
+ *   <-- CM_ATTEN_CHAR.IND with what the EVSE heard, --> CM_ATTEN_CHAR.RSP
+ *
+ *--------------------------------------------------------------------*/
+
+static signed pev_atten_char (struct session * session, struct channel * channel, struct message * message)
+
+{
+	struct cm_atten_char_indicate * indicate = (struct cm_atten_char_indicate *) (message);
+	struct cm_atten_char_response * response = (struct cm_atten_char_response *) (message);
+	if (memcmp (session->RunID, indicate->ACVarField.RunID, sizeof (session->RunID)))
 	{
-		session->state = PEV_STATE_DISCONNECTED;
-		return;
+		return (1);
 	}
-	/*Determine if we are connected to this EVSE*/
-	if (slac_connect (session))
+	slac_debug (session, 0, __func__, "<-- CM_ATTEN_CHAR.IND");
+	memcpy (session->EVSE_MAC, indicate->ethernet.OSA, sizeof (session->EVSE_MAC));
+	session->NUM_SOUNDS = indicate->ACVarField.NUM_SOUNDS;
+	session->NumGroups = indicate->ACVarField.ATTEN_PROFILE.NumGroups;
+	if (session->NumGroups > SLAC_GROUPS)
 	{
-		session->state = PEV_STATE_DISCONNECTED;
-		return;
+		session->NumGroups = SLAC_GROUPS;
 	}
-	/*Request NMK info*/
-	debug (0, __func__, "Matching ...");
-	if (pev_cm_slac_match (session, channel, message))
+	memcpy (session->AAG, indicate->ACVarField.ATTEN_PROFILE.AAG, session->NumGroups);
+	slac_debug (session, 0, __func__, "--> CM_ATTEN_CHAR.RSP");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&response->ethernet, session->EVSE_MAC, channel->host, channel->type);
+	HomePlugHeader1 (&response->homeplug, HOMEPLUG_MMV, (CM_ATTEN_CHAR | MMTYPE_RSP));
+	response->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	response->SECURITY_TYPE = session->SECURITY_TYPE;
+	memcpy (response->ACVarField.SOURCE_ADDRESS, session->PEV_MAC, sizeof (response->ACVarField.SOURCE_ADDRESS));
+	memcpy (response->ACVarField.RunID, session->RunID, sizeof (response->ACVarField.RunID));
+	response->ACVarField.Result = 0;
+	if (sendmessage (channel, message, sizeof (* response)) <= 0)
 	{
-		session->state = PEV_STATE_DISCONNECTED;
-		return;
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
 	}
-	session->state = PEV_STATE_MATCHED;
-	return;
+	return (0);
 }
 
 
 /*====================================================================*
  *
- *   void MatchedState (struct session * session, struct channel * channel, struct message * message);
+ *   signed pev_slac_match (struct session * session, struct channel * channel, struct message * message);
  *
- *   charge vehicle; restore original NMK/NID and disconnect; loop
- *   if SLAC_CONTINUE is set;
+ *   --> CM_SLAC_MATCH.REQ to the EVSE we matched with
  *
  *--------------------------------------------------------------------*/
 
-static void PEV_MatchedState (struct session * session, struct channel * channel, struct message * message)
-{
-	// unsigned state = 0;
-	slac_session (session);
-	struct plc plc;
-
-#if SLAC_FORMAVLN
+static signed pev_slac_match (struct session * session, struct channel * channel, struct message * message)
 
-	debug (0, __func__, "Connecting ...");
-	if (pev_cm_set_key (session, channel, message))
-	{
-		session->state = PEV_STATE_DISCONNECTED;
-		return;
-	}
-	// sleep (session->settletime); /*wait here for adapters to form AVLN*/
-	/*determine if logical network has been established*/
-	_setbits (plc.flags, PLC_NETWORK);
-	plc.channel = channel;
-	plc.message = message;
-	while (NetInfo2 (&plc))
+{
+	struct cm_slac_match_request * request = (struct cm_slac_match_request *) (message);
+	slac_debug (session, 0, __func__, "--> CM_SLAC_MATCH.REQ");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&request->ethernet, session->EVSE_MAC, channel->host, channel->type);
+	HomePlugHeader1 (&request->homeplug, HOMEPLUG_MMV, (CM_SLAC_MATCH | MMTYPE_REQ));
+	request->APPLICATION_TYPE = session->APPLICATION_TYPE;
+	request->SECURITY_TYPE = session->SECURITY_TYPE;
+	request->MVFLength = HTOLE16 (sizeof (request->MatchVarField));
+	memcpy (request->MatchVarField.PEV_ID, session->PEV_ID, sizeof (request->MatchVarField.PEV_ID));
+	memcpy (request->MatchVarField.PEV_MAC, session->PEV_MAC, sizeof (request->MatchVarField.PEV_MAC));
+	memcpy (request->MatchVarField.RunID, session->RunID, sizeof (request->MatchVarField.RunID));
+	memcpy (request->MatchVarField.EVSE_MAC, session->EVSE_MAC, sizeof (request->MatchVarField.EVSE_MAC));
+	if (sendmessage (channel, message, sizeof (* request)) <= 0)
 	{
-		// if (PollSockets() == -1)
-		//   {
-		// 	break;  /*close application*/
-		//   }
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
 	}
-
-	debug (0, __func__, "AVLN Formed.");
-#endif
-
-	session->state = 0;
-	return;
+	return (0);
 }
 
 
-
 /*====================================================================*
  *
- *   int main (int argc, char * argv[]);
+ *   signed pev_slac_match_confirm (struct session * session, struct message * message);
  *
+ *   <-- CM_SLAC_MATCH.CNF with the EVSE's NID and NMK
  *
  *--------------------------------------------------------------------*/
 
-int PEVSlac(signed c)
+static signed pev_slac_match_confirm (struct session * session, struct message * message)
+
 {
-	channel.timeout = SLAC_TIMEOUT;
-	if (getenv (PLCDEVICE))
+	struct cm_slac_match_confirm * confirm = (struct cm_slac_match_confirm *) (message);
+	if (memcmp (session->RunID, confirm->MatchVarField.RunID, sizeof (session->RunID)))
 	{
-		channel.ifname = strdup (getenv (PLCDEVICE));
+		return (1);
+	}
+	slac_debug (session, 0, __func__, "<-- CM_SLAC_MATCH.CNF");
+	memcpy (session->EVSE_ID, confirm->MatchVarField.EVSE_ID, sizeof (session->EVSE_ID));
+	memcpy (session->EVSE_MAC, confirm->MatchVarField.EVSE_MAC, sizeof (session->EVSE_MAC));
+	memcpy (session->NMK, confirm->MatchVarField.NMK, sizeof (session->NMK));
+	memcpy (session->NID, confirm->MatchVarField.NID, sizeof (session->NID));
+	return (0);
+}
+
+
+/*====================================================================*
+ *
+ *   signed pev_set_key (struct session * session, struct channel * channel, struct message * message);
+ *
+ *   --> CM_SET_KEY.REQ to our own modem, so it joins the EVSE's network
+ *
+ *--------------------------------------------------------------------*/
+
+static signed pev_set_key (struct session * session, struct channel * channel, struct message * message)
+
+{
+	struct cm_set_key_request * request = (struct cm_set_key_request *) (message);
+	slac_debug (session, 0, __func__, "--> CM_SET_KEY.REQ");
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&request->ethernet, channel->peer, channel->host, channel->type);
+	HomePlugHeader1 (&request->homeplug, HOMEPLUG_MMV, (CM_SET_KEY | MMTYPE_REQ));
+	request->KEYTYPE = SLAC_CM_SETKEY_KEYTYPE;
+	memset (&request->MYNOUNCE, 0xAA, sizeof (request->MYNOUNCE));
+	request->PID = SLAC_CM_SETKEY_PID;
+	request->PRN = HTOLE16 (SLAC_CM_SETKEY_PRN);
+	request->PMN = SLAC_CM_SETKEY_PMN;
+	request->CCOCAP = SLAC_CM_SETKEY_CCO;
+	memcpy (request->NID, session->NID, sizeof (request->NID));
+	request->NEWEKS = SLAC_CM_SETKEY_EKS;
+	memcpy (request->NEWKEY, session->NMK, sizeof (request->NEWKEY));
+	if (sendmessage (channel, message, sizeof (* request)) <= 0)
+	{
+		return (slac_debug (session, 0, __func__, CHANNEL_CANTSEND));
+	}
+	return (0);
+}
+
+
+/*====================================================================*
+ *
+ *   signed pev_set_key_confirm (struct session * session, struct message * message);
+ *
+ *   <-- CM_SET_KEY.CNF; like pev_cm_set_key(), a zero RESULT means
+ *   the modem didn't take the key;
+ *
+ *--------------------------------------------------------------------*/
+
+static signed pev_set_key_confirm (struct session * session, struct message * message)
+
+{
+	struct cm_set_key_confirm * confirm = (struct cm_set_key_confirm *) (message);
+	slac_debug (session, 0, __func__, "<-- CM_SET_KEY.CNF");
+	if (!confirm->RESULT)
+	{
+		return (slac_debug (session, 0, __func__, "Can't set keys"));
+	}
+	return (0);
+}
+
+
+/*====================================================================*
+ *
+ *   signed netinfo_request (struct channel * channel, struct message * message);
+ *
+ *   --> VS_NW_INFO.REQ to our own modem; this is the first half of
+ *   NetInfo2();
+ *
+ *--------------------------------------------------------------------*/
+
+static signed netinfo_request (struct channel * channel, struct message * message)
+
+{
+	struct qualcomm * request = (struct qualcomm *) (message);
+	memset (message, 0, sizeof (* message));
+	EthernetHeader (&request->ethernet, channel->peer, channel->host, channel->type);
+	QualcommHeader1 (&request->qualcomm, 1, (VS_NW_INFO | MMTYPE_REQ));
+	if (sendmessage (channel, message, (ETHER_MIN_LEN - ETHER_CRC_LEN)) <= 0)
+	{
+		return (-1);
 	}
+	return (0);
+}
+
+
+/*====================================================================*
+ *
+ *   signed netinfo_confirm (struct message * message);
+ *
+ *   <-- VS_NW_INFO.CNF; return the number of stations on the first
+ *   network, which is more than zero once the AVLN has formed;
+ *
+ *--------------------------------------------------------------------*/
+
+static signed netinfo_confirm (struct message * message)
+
+{
+	extern const byte localcast [ETHER_ADDR_LEN];
+	struct vs_nw_info_confirm * confirm = (struct vs_nw_info_confirm *) (message);
+	if (memcmp (localcast, confirm->qualcomm.OUI, sizeof (confirm->qualcomm.OUI)))
+	{
+		return (0);
+	}
+	return (confirm->NUMSTAS);
+}
+
+
+
+
+
+
+
+
+// #############################################################################
+// #############################################################################
+//                           SLAC engine
+// #############################################################################
+// #############################################################################
+
+/*
+ *	SLAC runs on the reactor. Each phase waits for the frame it needs on the
+ *	PLC channel, with a reactor timer for its timeout, so nothing blocks the
+ *	event loop while the EV sounds or the modems form the AVLN. The phases
+ *	follow the states of the original evse and pev programs; a failure in
+ *	any of them goes back to the start, as those did;
+ */
+
+// The most PEVs the EVSE runs SLAC with at once. On a shared PLC rig we hear
+// every PEV that's sounding, and the one plugged into us is the one we hear best
+#define SLAC_EVSE_SESSIONS 8
+
+
+// -----------------------------------------------------------------------------
+// evse_slot - A PEV the EVSE is running SLAC with
+// -----------------------------------------------------------------------------
+struct evse_slot
+{
+    struct session  session;            // Its copy of Session, linked into Session's ring
+    unsigned        AAG [SLAC_GROUPS];  // Its sounds, added up before they're averaged
+    uint64_t        start_us;           // When we started listening for its sounds
+    uint64_t        window_us;          // When we stop listening for them, or 0
+    int             timer;              // The reactor timer for the phase it's in
+    slac_trace_t    trace;              // How its attempt is going, and when it started
+    uint64_t        trace_us;
+    bool            in_use;
+    CSLACify*       owner;
+};
+// -----------------------------------------------------------------------------
+
+static struct evse_slot Slots [SLAC_EVSE_SESSIONS];
+
+
+// -----------------------------------------------------------------------------
+// now_us() - Returns a monotonic timestamp in microseconds
+// -----------------------------------------------------------------------------
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// since_ms() - Returns the ms since 'start_us'
+// -----------------------------------------------------------------------------
+static int since_ms(uint64_t start_us)
+{
+    return (int)((now_us() - start_us) / 1000);
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// average_aag() - Returns the average of a session's attenuation profile in dB,
+//                 or -1 if it doesn't have one yet
+// -----------------------------------------------------------------------------
+static int average_aag(struct session const* session)
+{
+    unsigned total = 0;
+
+    if (session->NumGroups == 0) return -1;
+    for (unsigned group = 0; group < session->NumGroups; group++) total += session->AAG [group];
+    return total / session->NumGroups;
+}
+// -----------------------------------------------------------------------------
+
+
+// -----------------------------------------------------------------------------
+// find_slot() - Returns the slot for run 'RunID', or NULL
+// -----------------------------------------------------------------------------
+static struct evse_slot* find_slot(const uint8_t* RunID)
+{
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++)
+    {
+        struct evse_slot* slot = &Slots[i];
+        if (slot->in_use && !memcmp (slot->session.RunID, RunID, sizeof (slot->session.RunID))) return slot;
+    }
+    return NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// find_sounding() - Returns the slot of the PEV with MAC 'mac' whose sounds we're
+//                   listening for, or NULL
+// -----------------------------------------------------------------------------
+static struct evse_slot* find_sounding(const uint8_t* mac)
+{
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++)
+    {
+        struct evse_slot* slot = &Slots[i];
+        if (!slot->in_use || slot->session.state != PHASE_SOUNDS) continue;
+        if (!memcmp (slot->session.PEV_MAC, mac, sizeof (slot->session.PEV_MAC))) return slot;
+    }
+    return NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// attenuation() - Returns the average attenuation we heard a PEV's sounds with,
+//                 in dB. Lower means closer; a PEV we didn't hear is furthest
+// -----------------------------------------------------------------------------
+static unsigned attenuation(struct session const* session)
+{
+    unsigned total = 0;
+
+    if (session->sounds == 0 || session->NumGroups == 0) return UINT_MAX;
+    for (unsigned group = 0; group < session->NumGroups; group++) total += session->AAG [group];
+    return total / session->NumGroups;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// CSLACify() - Constructor
+// -----------------------------------------------------------------------------
+CSLACify::CSLACify()
+{
+    m_device_type    = -1;
+    m_setting        = 0;
+    m_status         = STATUS_IDLE;
+    m_phase          = PHASE_PARAM;
+    m_timer          = -1;
+    m_retries        = 0;
+    m_sounds_left    = 0;
+    m_deadline_ms    = 0;
+    m_pacer_fd       = -1;
+    m_watch_fd       = -1;
+    m_profile_stale  = false;
+    m_train_us       = 0;
+    m_sounds_sent    = 0;
+    m_late_max_us    = m_late_total_us = 0;
+    m_gap_min_us     = m_gap_max_us = m_last_sound_us = 0;
+    m_join_us        = 0;
+    m_join_poll_ms   = SLAC_JOIN_POLL_MIN;
+    m_join_queries   = 0;
+    m_joins          = 0;
+    m_join_min_us    = m_join_max_us = m_join_total_us = 0;
+    m_trace_us       = 0;
+    m_attempts       = 0;
+    m_tracer         = NULL;
+    m_tracer_ctx     = NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start() - Starts SLAC from the beginning
+// -----------------------------------------------------------------------------
+void CSLACify::start()
+{
+    // Frames are read as they arrive, so a read never has to wait for one
+    channel.capture = 0;
+    if (!reactor.add_fd(channel.fd, EPOLLIN, on_readable, this))
+    {
+        debug (0, __func__, "Can't watch the PLC channel");
+        m_status = STATUS_FAILED;
+        return;
+    }
+
+    // The sounds are timed to the microsecond, finer than the reactor's timers
+    if (!reactor.add_fd(m_pacer_fd, EPOLLIN, on_pacer, this))
+    {
+        debug (0, __func__, "Can't watch the sound pacer");
+        reactor.remove_fd(channel.fd);
+        m_status = STATUS_FAILED;
+        return;
+    }
+
+    // init() runs on a startup thread, so the profile is watched from here, on the main thread.
+    // From now on, only the main thread touches the parsed profile
+    watch_profile();
+
+    m_status   = STATUS_RUNNING;
+    m_retries  = 0;
+    m_attempts = 0;
+    m_trace_us = 0;
+    restart();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// restart() - Goes back to the start of SLAC: the EVSE listens for a PEV, and
+//             the PEV probes for an EVSE with a new run ID
+// -----------------------------------------------------------------------------
+void CSLACify::restart()
+{
+    slac_session (&Session);
+
+    // Whatever we were in the middle of has failed
+    if (m_trace_us) trace_end(&m_trace, &m_trace_us, false, m_phase);
+
+    if (m_device_type == EVSE)
+    {
+        close_slots();
+        debug (0, __func__, "Listening ...");
+        enter(PHASE_PARAM, slac_timeout_sec * 1000);
+        return;
+    }
+
+    debug (0, __func__, "Probing ...");
+    memincr (Session.RunID, sizeof (Session.RunID));
+    trace_begin(&m_trace, &m_trace_us);
+    m_deadline_ms = msTimer::millis() + slac_timeout_sec * 1000;
+
+    // If this doesn't go out, the next one will
+    pev_slac_param (&Session, &channel, &Message);
+    enter(PHASE_PARAM, SLAC_TIMEOUT);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// stop() - Stops SLAC where it is
+// -----------------------------------------------------------------------------
+void CSLACify::stop()
+{
+    if (m_timer >= 0) reactor.cancel_timer(m_timer);
+    m_timer = -1;
+
+    // An attempt we stop in the middle of has failed
+    if (m_trace_us) trace_end(&m_trace, &m_trace_us, false, m_phase);
+
+    close_slots();
+    pace(0);
+    if (m_status == STATUS_RUNNING)
+    {
+        reactor.remove_fd(channel.fd);
+        reactor.remove_fd(m_pacer_fd);
+    }
+
+    // The library functions wait for their answers
+    channel.capture = CHANNEL_CAPTURE;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// finish() - Ends SLAC with the AVLN formed, or not
+// -----------------------------------------------------------------------------
+void CSLACify::finish(bool formed)
+{
+    const char* side = (m_device_type == EVSE) ? "EVSE" : "PEV";
+
+    if (m_trace_us) trace_end(&m_trace, &m_trace_us, formed, m_phase);
+    stop();
+    m_status = formed ? STATUS_DONE : STATUS_FAILED;
+
+    if (formed)
+    {
+        debug (0, __func__, "AVLN Formed.");
+        printf ("%s SLAC success - Connection established\n", side);
+    }
+    else
+    {
+        printf ("%s SLAC failed\n", side);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// enter() - Moves to 'phase', and gives it 'ms' before on_timeout() is called
+// -----------------------------------------------------------------------------
+void CSLACify::enter(int phase, uint32_t ms)
+{
+    m_phase = phase;
+    Session.state = phase;
+
+    if (m_timer >= 0) reactor.cancel_timer(m_timer);
+    m_timer = reactor.add_timer(ms, on_timer, this);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_readable() - Reactor callback for frames on the PLC channel
+// -----------------------------------------------------------------------------
+void CSLACify::on_readable(int, uint32_t, void* ctx)
+{
+    CSLACify* self = (CSLACify*)ctx;
+    ssize_t   length;
+
+    // Take everything that's waiting. Frames left in a ring block that has
+    // already woken us up won't wake us again
+    while (self->m_status == STATUS_RUNNING && (length = readpacket (&channel, &Message, sizeof (Message))) > 0)
+    {
+        self->on_frame(length);
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_timer() - Reactor callback for the timeout of the phase we're in
+// -----------------------------------------------------------------------------
+void CSLACify::on_timer(void* ctx)
+{
+    CSLACify* self = (CSLACify*)ctx;
+    self->m_timer = -1;
+    self->on_timeout();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// pace() - Arms the sound pacer for the absolute monotonic time 'due_us', or
+//          disarms it if 'due_us' is 0
+// -----------------------------------------------------------------------------
+void CSLACify::pace(uint64_t due_us)
+{
+    struct itimerspec its;
+    memset (&its, 0, sizeof (its));
+    its.it_value.tv_sec  = due_us / 1000000;
+    its.it_value.tv_nsec = (due_us % 1000000) * 1000;
+    timerfd_settime(m_pacer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_pacer() - Reactor callback for the sound pacer: the PEV's next sound is
+//              due, or the EVSE's time to listen for a PEV's sounds is up
+// -----------------------------------------------------------------------------
+void CSLACify::on_pacer(int fd, uint32_t, void* ctx)
+{
+    CSLACify* self = (CSLACify*)ctx;
+    uint64_t  expirations;
+
+    if (read (fd, &expirations, sizeof (expirations)) != sizeof (expirations)) return;
+    if (self->m_status != STATUS_RUNNING) return;
+
+    if (self->m_device_type == EVSE)
+    {
+        if (self->m_phase == PHASE_PARAM) self->evse_windows();
+    }
+    else if (self->m_phase == PHASE_SOUNDS) self->pev_sound();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_frame() - Checks a frame from the PLC channel and hands it to our side
+// -----------------------------------------------------------------------------
+void CSLACify::on_frame(ssize_t length)
+{
+    struct homeplug * homeplug = (struct homeplug *) (&Message);
+
+    if (length < (ssize_t)(sizeof (struct ethernet_hdr) + sizeof (struct homeplug_fmi))) return;
+    if (ntohs (homeplug->ethernet.MTYPE) != HOMEPLUG_MTYPE) return;
+    if (homeplug->homeplug.MMV != HOMEPLUG_MMV) return;
+
+    unsigned mmtype = LE16TOH (homeplug->homeplug.MMTYPE);
+
+    // Both sides finish the same way, once our modem says the AVLN has formed
+    if (m_phase == PHASE_JOIN)
+    {
+        if (mmtype == (VS_NW_INFO | MMTYPE_CNF) && netinfo_confirm (&Message) > 0) joined();
+        return;
+    }
+
+    // The EVSE runs SLAC with every PEV it hears until one of them matches
+    if (m_device_type == EVSE)
+    {
+        if (m_phase == PHASE_PARAM) evse_frame(mmtype);
+    }
+    else pev_frame(mmtype);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// evse_frame() - The EVSE's side of SLAC. Each PEV we hear gets its own slot,
+//                found again by its run ID, or by its MAC for its sounds
+// -----------------------------------------------------------------------------
+void CSLACify::evse_frame(unsigned mmtype)
+{
+    struct evse_slot* slot;
+
+    switch (mmtype)
+    {
+        // A new PEV, or one that didn't get our CM_SLAC_PARAM.CNF
+        case (CM_SLAC_PARAM | MMTYPE_REQ):
+        {
+            struct cm_slac_param_request * request = (struct cm_slac_param_request *) (&Message);
+            slot = find_slot (request->RunID);
+            if (slot && slot->session.state != PHASE_START) break;
+            if (!slot)
+            {
+                if (!(slot = open_slot()))
+                {
+                    debug (0, __func__, "Too many PEVs at once; ignoring CM_SLAC_PARAM.REQ");
+                    break;
+                }
+                trace_begin(&slot->trace, &slot->trace_us);
+            }
+            if (evse_slac_param (&slot->session, &channel, &Message))
+            {
+                close_slot(slot);
+                break;
+            }
+            slot->trace.param_ms = since_ms(slot->trace_us);
+            slac_session (&slot->session);
+            debug (0, __func__, "Sounding ...");
+            slot_enter(slot, PHASE_START, SLAC_TIMEOUT);
+            break;
+        }
+
+        case (CM_START_ATTEN_CHAR | MMTYPE_IND):
+        {
+            struct cm_start_atten_char_indicate * indicate = (struct cm_start_atten_char_indicate *) (&Message);
+            slot = find_slot (indicate->ACVarField.RunID);
+            if (!slot || slot->session.state != PHASE_START) break;
+            if (evse_start_atten_char (&slot->session, &Message)) break;
+            slot->trace.start_atten_ms = since_ms(slot->trace_us);
+            slot->session.sounds = 0;
+            memset (slot->AAG, 0, sizeof (slot->AAG));
+
+            // We listen for TIME_OUT x 100 ms from now, or until every sound is in
+            slot->start_us  = now_us();
+            slot->window_us = slot->start_us + 100000 * slot->session.TIME_OUT;
+            slot_enter(slot, PHASE_SOUNDS, 100 * slot->session.TIME_OUT + SLAC_TIMEOUT);
+            pace_windows();
+            break;
+        }
+
+        case (CM_ATTEN_PROFILE | MMTYPE_IND):
+        {
+            struct cm_atten_profile_indicate * indicate = (struct cm_atten_profile_indicate *) (&Message);
+            slot = find_sounding (indicate->PEV_MAC);
+            if (!slot) break;
+            if (evse_atten_profile (&slot->session, &Message, slot->AAG)) break;
+            slot->trace.last_sound_ms = since_ms(slot->trace_us);
+            if (slot->trace.first_sound_ms < 0) slot->trace.first_sound_ms = slot->trace.last_sound_ms;
+            slot->trace.sounds = slot->session.sounds;
+            if (slot->session.sounds >= slot->session.NUM_SOUNDS) evse_characterize(slot);
+            break;
+        }
+
+        case (CM_ATTEN_CHAR | MMTYPE_RSP):
+        {
+            struct cm_atten_char_response * response = (struct cm_atten_char_response *) (&Message);
+            slot = find_slot (response->ACVarField.RunID);
+            if (!slot || slot->session.state != PHASE_ATTEN) break;
+            if (evse_atten_char_response (&slot->session, &Message)) break;
+            slot->trace.atten_char_ms = since_ms(slot->trace_us);
+            debug (0, __func__, "Matching ...");
+            slot_enter(slot, PHASE_MATCH, SLAC_MATCH_TIMEOUT);
+            break;
+        }
+
+        // The PEV may not have waited for our CM_ATTEN_CHAR.RSP to arrive
+        case (CM_SLAC_MATCH | MMTYPE_REQ):
+        {
+            struct cm_slac_match_request * request = (struct cm_slac_match_request *) (&Message);
+            slot = find_slot (request->MatchVarField.RunID);
+            if (!slot || (slot->session.state != PHASE_ATTEN && slot->session.state != PHASE_MATCH)) break;
+            evse_match(slot);
+            break;
+        }
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// evse_characterize() - Tells a PEV what we heard of its sounds
+// -----------------------------------------------------------------------------
+void CSLACify::evse_characterize(struct evse_slot* slot)
+{
+    struct session* session = &slot->session;
+
+    uint64_t listened_us = now_us() - slot->start_us;
+    debug (0, __func__, "Heard %u of %u sounds in %.1f ms of a %u ms window", session->sounds, session->NUM_SOUNDS,
+           listened_us / 1000.0, 100 * session->TIME_OUT);
+
+    slot->window_us = 0;
+    if (evse_atten_char (session, &channel, &Message, slot->AAG))
+    {
+        close_slot(slot);
+        return;
+    }
+    slot->trace.attenuation = average_aag (session);
+    slot_enter(slot, PHASE_ATTEN, SLAC_TIMEOUT);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// evse_match() - A PEV asks for our network key. Only the PEV we hear best is
+//                plugged into us, so it only gets the key if no other PEV we've
+//                characterized was heard with less attenuation
+// -----------------------------------------------------------------------------
+void CSLACify::evse_match(struct evse_slot* slot)
+{
+    unsigned ours = attenuation (&slot->session);
+
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++)
+    {
+        struct evse_slot* other = &Slots[i];
+        if (!other->in_use || other == slot) continue;
+        if (other->session.state != PHASE_ATTEN && other->session.state != PHASE_MATCH) continue;
+
+        unsigned theirs = attenuation (&other->session);
+        if (theirs < ours)
+        {
+            debug (0, __func__, "Ignoring CM_SLAC_MATCH.REQ from a PEV heard at %u dB; another was heard at %u dB", ours, theirs);
+            return;
+        }
+    }
+
+    if (evse_slac_match (&slot->session, &channel, &Message))
+    {
+        close_slot(slot);
+        return;
+    }
+
+    // This is our PEV. Session takes on its run and its trace, and we forget the others
+    slot->trace.match_ms = since_ms(slot->trace_us);
+    m_trace    = slot->trace;
+    m_trace_us = slot->trace_us;
+    slot->trace_us = 0;
+    struct session matched = slot->session;
+    close_slots();
+    matched.next = matched.prev = &Session;
+    Session = matched;
+    join();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// evse_windows() - Stops listening for the sounds of every PEV whose time is up
+// -----------------------------------------------------------------------------
+void CSLACify::evse_windows()
+{
+    uint64_t now = now_us();
+
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++)
+    {
+        struct evse_slot* slot = &Slots[i];
+        if (slot->in_use && slot->session.state == PHASE_SOUNDS && slot->window_us && slot->window_us <= now)
+        {
+            evse_characterize(slot);
+        }
+    }
+    pace_windows();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// pace_windows() - Arms the pacer for the next PEV whose listening time is up
+// -----------------------------------------------------------------------------
+void CSLACify::pace_windows()
+{
+    uint64_t next = 0;
+
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++)
+    {
+        struct evse_slot* slot = &Slots[i];
+        if (!slot->in_use || slot->session.state != PHASE_SOUNDS || !slot->window_us) continue;
+        if (!next || slot->window_us < next) next = slot->window_us;
+    }
+    pace(next);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// open_slot() - Starts SLAC with a new PEV. Returns NULL if there's no room
+// -----------------------------------------------------------------------------
+struct evse_slot* CSLACify::open_slot()
+{
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++)
+    {
+        struct evse_slot* slot = &Slots[i];
+        if (slot->in_use) continue;
+
+        // Each PEV starts from our settings, and is linked into Session's ring
+        slot->session      = Session;
+        slot->session.next = Session.next;
+        slot->session.prev = &Session;
+        Session.next->prev = &slot->session;
+        Session.next       = &slot->session;
+
+        slot->start_us  = 0;
+        slot->window_us = 0;
+        slot->timer     = -1;
+        slot->owner     = this;
+        slot->in_use    = true;
+        return slot;
+    }
+    return NULL;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// close_slot() - Forgets a PEV, and close_slots() forgets them all
+// -----------------------------------------------------------------------------
+void CSLACify::close_slot(struct evse_slot* slot)
+{
+    if (!slot->in_use) return;
 
-	switch (c)
-		{
-		case 'c':
-			configure ();
-			return (0);
-		case 'C':
-			_setbits (Session.flags, SLAC_COMPARE);
-			break;
-		case 'd':
-			_setbits (Session.flags, (SLAC_VERBOSE | SLAC_SESSION));
-			break;
-		case 'i':
-			channel.ifname = optarg;
-			break;
-		case 'l':
-			Session.state = PEV_STATE_DISCONNECTED;
-			break;
-		case 'p':
-			profile = optarg;
-			break;
-		case 's':
-			section = optarg;
-			break;
-		case 'q':
-			_clrbits (channel.flags, CHANNEL_SILENCE);
-			break;
-		case 't':
-			channel.timeout = (unsigned)(uintspec (optarg, 0, UINT_MAX));
-			break;
-		case 'v':
-			_setbits (channel.flags, CHANNEL_VERBOSE);
-			break;
-		case 'x':
-			Session.exit = Session.exit? 0: 1;
-			break;
-		default:
-			break;
-		}
+    if (slot->timer >= 0) reactor.cancel_timer(slot->timer);
+    slot->timer = -1;
 
-	while (Session.state)
-	{
-		if (Session.state == PEV_STATE_DISCONNECTED)
-		{
-			PEV_DisconnectedState (&Session, &channel, &Message);
-			continue;
-		}
-		if (Session.state == PEV_STATE_UNMATCHED)
-		{
-			PEV_UnmatchedState (&Session, &channel, &Message);
-			continue;
-		}
-		if (Session.state == PEV_STATE_MATCHED)
-		{
-			PEV_MatchedState (&Session, &channel, &Message);
-			break;
-		}
-		if (Session.state == PEV_STATE_UNAVAILABLE)
-		{
-			break;
-		}
+    // A PEV we forget before it matched didn't get anywhere
+    if (slot->trace_us) trace_end(&slot->trace, &slot->trace_us, false, slot->session.state);
 
-		debug (1, __func__, "Illegal state!");
-	}
-	closechannel (&channel);
-	if (Session.state == PEV_STATE_UNAVAILABLE)
-	{
-		return 1;
-	}
-	else
-	{
-		return 0;
-	}
+    slot->session.prev->next = slot->session.next;
+    slot->session.next->prev = slot->session.prev;
+    slot->in_use = false;
+}
+
+void CSLACify::close_slots()
+{
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++) close_slot(&Slots[i]);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// slots_busy() - Returns true if we're in the middle of SLAC with any PEV
+// -----------------------------------------------------------------------------
+bool CSLACify::slots_busy()
+{
+    for (int i = 0; i < SLAC_EVSE_SESSIONS; i++)
+    {
+        if (Slots[i].in_use) return true;
+    }
+    return false;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// slot_enter() - Moves a PEV to 'phase', and gives it 'ms' before it times out
+// -----------------------------------------------------------------------------
+void CSLACify::slot_enter(struct evse_slot* slot, int phase, uint32_t ms)
+{
+    slot->session.state = phase;
+
+    if (slot->timer >= 0) reactor.cancel_timer(slot->timer);
+    slot->timer = reactor.add_timer(ms, on_slot_timer, slot);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_slot_timer() - Reactor callback for the timeout of the phase a PEV is in
+// -----------------------------------------------------------------------------
+void CSLACify::on_slot_timer(void* ctx)
+{
+    struct evse_slot* slot = (struct evse_slot*)ctx;
+    slot->timer = -1;
+    slot->owner->slot_timeout(slot);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// slot_timeout() - A PEV has run out of time in the phase it's in. Its sounds
+//                  are characterized with what we heard; otherwise it's dropped
+// -----------------------------------------------------------------------------
+void CSLACify::slot_timeout(struct evse_slot* slot)
+{
+    if (slot->session.state == PHASE_SOUNDS)
+    {
+        evse_characterize(slot);
+        pace_windows();
+        return;
+    }
+
+    debug (0, __func__, "Timeout in phase %d; dropping the PEV", slot->session.state);
+    close_slot(slot);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// pev_frame() - The PEV's side of SLAC
+// -----------------------------------------------------------------------------
+void CSLACify::pev_frame(unsigned mmtype)
+{
+    signed rc;
+
+    switch (m_phase)
+    {
+        case PHASE_PARAM:
+            if (mmtype != (CM_SLAC_PARAM | MMTYPE_CNF)) break;
+            if (pev_slac_param_confirm (&Session, &Message)) break;
+            m_trace.param_ms = since_ms(m_trace_us);
+            slac_session (&Session);
+            debug (0, __func__, "Sounding ...");
+            if (pev_start_atten_char (&Session, &channel, &Message))
+            {
+                restart();
+                break;
+            }
+            m_trace.start_atten_ms = since_ms(m_trace_us);
+
+            // The sounds go out on a fixed schedule from now. If the pacer doesn't
+            // get them all out in time, something is badly wrong
+            m_sounds_left   = Session.NUM_SOUNDS;
+            m_sounds_sent   = 0;
+            m_train_us      = now_us();
+            m_late_max_us   = m_late_total_us = 0;
+            m_gap_min_us    = m_gap_max_us = 0;
+            m_last_sound_us = 0;
+            enter(PHASE_SOUNDS, Session.pause * Session.NUM_SOUNDS + SLAC_TIMEOUT);
+            pev_sound();
+            break;
+
+        // The EVSE may stop listening before we've sent every sound
+        case PHASE_SOUNDS:
+        case PHASE_ATTEN:
+            if (mmtype != (CM_ATTEN_CHAR | MMTYPE_IND)) break;
+            rc = pev_atten_char (&Session, &channel, &Message);
+            if (rc > 0) break;
+
+            // Check that this is the EVSE we're plugged into
+            m_trace.atten_char_ms = since_ms(m_trace_us);
+            m_trace.attenuation = average_aag (&Session);
+            if (rc < 0 || slac_connect (&Session))
+            {
+                restart();
+                break;
+            }
+            debug (0, __func__, "Matching ...");
+            if (pev_slac_match (&Session, &channel, &Message))
+            {
+                restart();
+                break;
+            }
+            enter(PHASE_MATCH, SLAC_TIMEOUT);
+            break;
+
+        case PHASE_MATCH:
+            if (mmtype != (CM_SLAC_MATCH | MMTYPE_CNF)) break;
+            if (pev_slac_match_confirm (&Session, &Message)) break;
+            m_trace.match_ms = since_ms(m_trace_us);
+
+#if SLAC_FORMAVLN
+
+            // Give our modem the EVSE's key, so it joins the EVSE's network
+            debug (0, __func__, "Connecting ...");
+            if (pev_set_key (&Session, &channel, &Message))
+            {
+                restart();
+                break;
+            }
+            enter(PHASE_SET_KEY, SLAC_TIMEOUT);
+#else
+            finish(true);
+#endif
+            break;
+
+        case PHASE_SET_KEY:
+            if (mmtype != (CM_SET_KEY | MMTYPE_CNF)) break;
+            if (pev_set_key_confirm (&Session, &Message))
+            {
+                restart();
+                break;
+            }
+            m_trace.set_key_ms = since_ms(m_trace_us);
+            join();
+            break;
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// pev_sound() - Sends the next sound. Sound 'n' is due MSoundPause x 'n' ms after
+//               the first, so a late sound doesn't push back the ones after it
+// -----------------------------------------------------------------------------
+void CSLACify::pev_sound()
+{
+    // Once they're all out, wait for the EVSE to tell us what it heard
+    if (m_sounds_left == 0)
+    {
+        report_sounds();
+        enter(PHASE_ATTEN, SLAC_TIMEOUT);
+        return;
+    }
+
+    uint64_t pause_us = (uint64_t)Session.pause * 1000;
+    uint64_t due_us   = m_train_us + m_sounds_sent * pause_us;
+    uint64_t sent_us  = now_us();
+
+    m_sounds_left--;
+    if (pev_mnbc_sound (&Session, &channel, &Message, m_sounds_left))
+    {
+        restart();
+        return;
+    }
+
+    // Note how late it went out, and how long after the one before it
+    uint64_t late_us = (sent_us > due_us) ? sent_us - due_us : 0;
+    m_late_total_us += late_us;
+    if (late_us > m_late_max_us) m_late_max_us = late_us;
+    if (m_sounds_sent)
+    {
+        uint64_t gap_us = sent_us - m_last_sound_us;
+        if (m_sounds_sent == 1 || gap_us < m_gap_min_us) m_gap_min_us = gap_us;
+        if (gap_us > m_gap_max_us) m_gap_max_us = gap_us;
+    }
+    m_last_sound_us = sent_us;
+    m_sounds_sent++;
+
+    m_trace.last_sound_ms = since_ms(m_trace_us);
+    if (m_trace.first_sound_ms < 0) m_trace.first_sound_ms = m_trace.last_sound_ms;
+    m_trace.sounds = m_sounds_sent;
+
+    if (m_sounds_left) pace(m_train_us + m_sounds_sent * pause_us);
+    else pev_sound();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// report_sounds() - Reports how closely the sounds kept to their schedule
+// -----------------------------------------------------------------------------
+void CSLACify::report_sounds()
+{
+    if (m_sounds_sent == 0) return;
+
+    debug (0, __func__, "Sent %u sounds %u ms apart: gaps %.2f-%.2f ms, late by avg %llu us, max %llu us",
+           m_sounds_sent, Session.pause, m_gap_min_us / 1000.0, m_gap_max_us / 1000.0,
+           (unsigned long long)(m_late_total_us / m_sounds_sent), (unsigned long long)m_late_max_us);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// join() - Asks our modem, until it says the AVLN has formed
+// -----------------------------------------------------------------------------
+void CSLACify::join()
+{
+    debug (0, __func__, "Waiting for the AVLN ...");
+    m_deadline_ms  = msTimer::millis() + slac_timeout_sec * 1000;
+    m_join_us      = now_us();
+    m_join_queries = 0;
+    m_join_poll_ms = SLAC_JOIN_POLL_MIN;
+    query_network();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// query_network() - Asks our modem about its network. Its answer ends the wait
+//                   as soon as it arrives; until then we ask again, backing off
+//                   so we don't keep it (or ourselves) busy
+// -----------------------------------------------------------------------------
+void CSLACify::query_network()
+{
+    uint64_t now  = msTimer::millis();
+    uint32_t wait = m_join_poll_ms;
+
+    netinfo_request (&channel, &Message);
+    m_join_queries++;
+
+    // Don't wait past the deadline
+    if (now + wait > m_deadline_ms) wait = (now < m_deadline_ms) ? (uint32_t)(m_deadline_ms - now) : 0;
+    enter(PHASE_JOIN, wait);
+
+    m_join_poll_ms *= 2;
+    if (m_join_poll_ms > SLAC_JOIN_POLL_MAX) m_join_poll_ms = SLAC_JOIN_POLL_MAX;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// joined() - Our modem says the AVLN has formed. Notes how long that took
+// -----------------------------------------------------------------------------
+void CSLACify::joined()
+{
+    uint64_t join_us = now_us() - m_join_us;
+    if (m_trace_us) m_trace.join_ms = since_ms(m_trace_us);
+
+    m_joins++;
+    m_join_total_us += join_us;
+    if (m_joins == 1 || join_us < m_join_min_us) m_join_min_us = join_us;
+    if (join_us > m_join_max_us) m_join_max_us = join_us;
+
+    char line[96];
+    snprintf(line, sizeof(line), "AVLN formed %.1f ms after matching, %u network queries", join_us / 1000.0, m_join_queries);
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
+
+    finish(true);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// trace_begin() - Starts the trace of a new attempt
+// -----------------------------------------------------------------------------
+void CSLACify::trace_begin(slac_trace_t* trace, uint64_t* start_us)
+{
+    trace->side           = (m_device_type == EVSE) ? "EVSE" : "PEV";
+    trace->result         = "";
+    trace->phase          = "";
+    trace->attempt        = ++m_attempts;
+    trace->retries        = m_retries;
+    trace->param_ms       = -1;
+    trace->start_atten_ms = -1;
+    trace->first_sound_ms = -1;
+    trace->last_sound_ms  = -1;
+    trace->sounds         = 0;
+    trace->atten_char_ms  = -1;
+    trace->attenuation    = -1;
+    trace->match_ms       = -1;
+    trace->set_key_ms     = -1;
+    trace->join_ms        = -1;
+    trace->total_ms       = -1;
+    *start_us = now_us();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// trace_end() - Ends the trace of an attempt that ended in 'phase', and hands it
+//               to the tracer
+// -----------------------------------------------------------------------------
+void CSLACify::trace_end(slac_trace_t* trace, uint64_t* start_us, bool formed, int phase)
+{
+    static const char* phases[] = {"", "param", "start_atten", "sounds", "atten_char", "match", "set_key", "join"};
+
+    trace->result   = formed ? "formed" : "failed";
+    trace->phase    = (phase >= PHASE_PARAM && phase <= PHASE_JOIN) ? phases[phase] : "";
+    trace->total_ms = since_ms(*start_us);
+    *start_us = 0;
+
+    if (m_tracer) m_tracer(*trace, m_tracer_ctx);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// report() - Prints and logs how long the AVLN has taken to form after matching
+// -----------------------------------------------------------------------------
+void CSLACify::report()
+{
+    if (m_joins == 0) return;
+
+    char line[128];
+    snprintf(line, sizeof(line), "SLAC: %u AVLN(s) formed, join latency min %.1f / avg %.1f / max %.1f ms",
+             m_joins, m_join_min_us / 1000.0, m_join_total_us / 1000.0 / m_joins, m_join_max_us / 1000.0);
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_timeout() - The phase we're in has run out of time
+// -----------------------------------------------------------------------------
+void CSLACify::on_timeout()
+{
+    uint64_t now = msTimer::millis();
+
+    switch (m_phase)
+    {
+        case PHASE_PARAM:
+            // The PEV asks again every second until it runs out of time
+            if (m_device_type == PEV && now < m_deadline_ms)
+            {
+                pev_slac_param (&Session, &channel, &Message);
+                enter(PHASE_PARAM, SLAC_TIMEOUT);
+                break;
+            }
+
+            // The EVSE keeps listening while it's in the middle of SLAC with a PEV
+            if (m_device_type == EVSE && slots_busy())
+            {
+                enter(PHASE_PARAM, SLAC_TIMEOUT);
+                break;
+            }
+
+            debug (0, __func__, "CM_SLAC_PARAM.%s TIMEOUT (%d sec)!", (m_device_type == EVSE) ? "REQ" : "CNF", slac_timeout_sec);
+            if (m_retries >= num_retries)
+            {
+                finish(false);
+                break;
+            }
+            m_retries++;
+            debug (0, __func__, "Retrying ... ");
+            restart();
+            break;
+
+        case PHASE_JOIN:
+            if (now >= m_deadline_ms)
+            {
+                debug (0, __func__, "Timeout: %s did not join logical network (%d sec)!", (m_device_type == EVSE) ? "PEV" : "EVSE", slac_timeout_sec);
+                finish(false);
+                break;
+            }
+            query_network();
+            break;
+
+        default:
+            debug (0, __func__, "Timeout in phase %d", m_phase);
+            restart();
+            break;
+    }
 }
+// -----------------------------------------------------------------------------
+
+
+
+
+
 
 
 
@@ -720,14 +2152,31 @@ int CSLACify::init(int device_type, signed slac_setting, int slac_limit, int tim
 	m_slac_limit = slac_limit;
     slac_timeout_sec = timeout;
     num_retries = retries;
+
+    // Apply the SLAC setting before the channel is opened
+    settings (m_device_type, m_setting);
+
+    // The sounds are paced on absolute deadlines
+    if (m_pacer_fd < 0) m_pacer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_pacer_fd < 0)
+    {
+        debug (0, __func__, "Can't create the sound pacer");
+        return 0;
+    }
 	
-    // Open a raw Ethernet channel
+    // Open a raw Ethernet channel, filtered in the kernel, and read through a mapped ring
+    _setbits (channel.flags, CHANNEL_RXRING);
     openchannel (&channel);
 
+    // Parse our profile now, so initializing SLAC never reads it. start() watches it for
+    // changes from then on
+    profile = (m_device_type == EVSE) ? EVSE_PROFILE : PEV_PROFILE;
+    configload (profile);
+
     // Initialize settings based on device type
     if (m_device_type == EVSE)
     {
-        profile = EVSE_PROFILE;
+        KeyPool.start();
         evse_identifier (&Session, &channel);
 	    evse_initialize (&Session, profile, section);
         if (evse_cm_set_key (&Session, &channel, &Message))
@@ -741,7 +2190,6 @@ int CSLACify::init(int device_type, signed slac_setting, int slac_limit, int tim
 
     else if (m_device_type == PEV)
     {
-        profile = PEV_PROFILE;
         pev_identifier (&Session, &channel);
 	    pev_initialize (&Session, profile, section);
 		
@@ -756,41 +2204,75 @@ int CSLACify::init(int device_type, signed slac_setting, int slac_limit, int tim
 
 
 // -----------------------------------------------------------------------------
-// connect() - Call this to attempt SLAC and creating a logical network
+// connect() - Call this repeatedly to attempt SLAC and create a logical network.
+//             The first call starts SLAC, which then runs on the reactor.
+//             Returns 1 while SLAC is in progress, 0 once the AVLN is formed,
+//             or -1 if it failed
 // -----------------------------------------------------------------------------
 int CSLACify::connect()
 {
-	// Call the appropriate SLAC functions based on device type
-    if (m_device_type == EVSE)
+	// If we get here with the wrong device type, SLAC can't run
+    if (m_device_type != EVSE && m_device_type != PEV) return -1;
+
+    if (m_status == STATUS_IDLE) start();
+
+    if (m_status == STATUS_RUNNING) return 1;
+
+    return (m_status == STATUS_DONE) ? 0 : -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// reset() - Call this between sessions. It puts the SLAC state machine back at the
+//           start without closing the PLC channel.  The PEV also rejoins its own
+//           private network, so it leaves the AVLN it formed with the EVSE
+// -----------------------------------------------------------------------------
+void CSLACify::reset()
+{
+    stop();
+    m_status = STATUS_IDLE;
+
+    // If the profile changed, the next session uses what it says now
+    if (m_profile_stale)
     {
-		if (EVSESlac(m_setting) == 0)
-		{
-			printf ("EVSE SLAC success - Connection established\n");
-			return 1;
-		}
-		else
-		{
-			printf("EVSE SLAC failed\n");
-			return 0;
-		}  
+        m_profile_stale = false;
+        if (m_device_type == EVSE)
+        {
+            evse_initialize (&Session, profile, section);
+            if (evse_cm_set_key (&Session, &channel, &Message))
+            {
+                debug (0, __func__, "Can't set EVSE key.");
+            }
+            return;
+        }
+        pev_initialize (&Session, profile, section);
     }
 
-    if (m_device_type == PEV)
+    // Each session gets a network of its own, unless the profile sets the key
+    if (m_device_type == EVSE && !ProfileKeys)
     {
-		if(PEVSlac(m_setting) == 0)
-		{
-			printf ("PEV SLAC success - Connection established\n");
-			return 1;
-		}
-		else
-		{
-			printf("PEV SLAC failed\n");
-			return 0;
-		}
+        if (KeyPool.take (EVSE_NMK, EVSE_NID))
+        {
+            memcpy (Session.NMK, EVSE_NMK, sizeof (Session.NMK));
+            memcpy (Session.NID, EVSE_NID, sizeof (Session.NID));
+            if (evse_cm_set_key (&Session, &channel, &Message))
+            {
+                debug (0, __func__, "Can't set EVSE key.");
+            }
+        }
     }
 
-	// If we get here, device type is wrong
-	return -1;
+    else if (m_device_type == PEV)
+    {
+        memcpy (Session.NMK, Session.original_nmk, sizeof (Session.NMK));
+        memcpy (Session.NID, Session.original_nid, sizeof (Session.NID));
+        if (pev_cm_set_key (&Session, &channel, &Message))
+        {
+            debug (0, __func__, "Can't restore PEV key.");
+        }
+    }
 }
 // -----------------------------------------------------------------------------
 
@@ -801,7 +2283,99 @@ int CSLACify::connect()
 // -----------------------------------------------------------------------------
 void CSLACify::close()
 {
+    stop();
+    m_status = STATUS_IDLE;
     closechannel (&channel);
+
+    if (m_pacer_fd >= 0) ::close(m_pacer_fd);
+    m_pacer_fd = -1;
+
+    if (m_watch_fd >= 0)
+    {
+        reactor.remove_fd(m_watch_fd);
+        ::close(m_watch_fd);
+    }
+    m_watch_fd = -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// define() - Sets a profile item, overriding whatever the profile file says. The
+//            names are the ones in the profile, e.g. "NumberOfSounds"
+// -----------------------------------------------------------------------------
+void CSLACify::define(const char* item, const char* value)
+{
+    configdefine (EVSE_PROFILE, SECTION, item, value);
+    configdefine (PEV_PROFILE, SECTION, item, value);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// watch_profile() - Watches the directory our profile is in, so we hear when the
+//                   profile is written, replaced or removed
+// -----------------------------------------------------------------------------
+void CSLACify::watch_profile()
+{
+    if (m_watch_fd >= 0) return;
+
+    m_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_watch_fd < 0) return;
+
+    // The profile may not exist yet, so we watch its directory rather than the file
+    char dir[256];
+    const char* slash = strrchr(profile, '/');
+    if (slash) snprintf(dir, sizeof(dir), "%.*s", (int)(slash - profile + 1), profile);
+    else       strcpy(dir, ".");
+
+    if (inotify_add_watch(m_watch_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0)
+    {
+        ::close(m_watch_fd);
+        m_watch_fd = -1;
+        return;
+    }
+    reactor.add_fd(m_watch_fd, EPOLLIN, on_profile, this);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// on_profile() - Reactor callback for changes in the profile's directory. If the
+//                profile changed, it's parsed again here, and the session after
+//                this one picks it up
+// -----------------------------------------------------------------------------
+void CSLACify::on_profile(int fd, uint32_t events, void* ctx)
+{
+    CSLACify* p = (CSLACify*)ctx;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char* name = strrchr(profile, '/');
+    name = name ? name + 1 : profile;
+    bool changed = false;
+
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* ptr = buffer; ptr < buffer + length; )
+        {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            if (event->len && strcmp(event->name, name) == 0) changed = true;
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (!changed) return;
+
+    configflush (profile);
+    configload (profile);
+    p->m_profile_stale = true;
+
+    char line[96];
+    snprintf(line, sizeof(line), "SLAC profile %s changed, the next session will use it", profile);
+    printf("%s\n", line);
+    logger.log(LOG_INFO, line);
 }
 // -----------------------------------------------------------------------------
 
@@ -15,23 +15,174 @@
 
  #pragma once
 
+#include <stdint.h>
+#include <sys/types.h>
+
+// A PEV the EVSE is running SLAC with
+struct evse_slot;
+
+// -----------------------------------------------------------------------------
+// slac_trace_t - How one SLAC attempt went.  The times are in ms from the start
+//                of the attempt to when each step was done, or -1 if the attempt
+//                never got that far.  The PEV's attempt starts when it probes with
+//                a new run ID; the EVSE's starts when it hears that run ID
+// -----------------------------------------------------------------------------
+struct slac_trace_t
+{
+    const char* side;           // "EVSE" or "PEV"
+    const char* result;         // "formed", or "failed" if the attempt was given up on
+    const char* phase;          // The phase the attempt ended in
+    int         attempt;        // Counts the attempts since SLAC was started, from 1
+    int         retries;        // How many times CM_SLAC_PARAM timed out before this attempt
+    int         param_ms;       // CM_SLAC_PARAM exchanged
+    int         start_atten_ms; // CM_START_ATTEN_CHAR exchanged
+    int         first_sound_ms; // The first CM_MNBC_SOUND sent (PEV) or CM_ATTEN_PROFILE heard (EVSE)
+    int         last_sound_ms;  // And the last one
+    int         sounds;         // How many sounds were sent or heard
+    int         atten_char_ms;  // CM_ATTEN_CHAR exchanged
+    int         attenuation;    // The average attenuation of the sounds in dB, or -1
+    int         match_ms;       // CM_SLAC_MATCH exchanged
+    int         set_key_ms;     // CM_SET_KEY confirmed by our modem (PEV only)
+    int         join_ms;        // The AVLN formed
+    int         total_ms;       // The attempt ended
+};
+// -----------------------------------------------------------------------------
+
+// Called with the trace of each SLAC attempt when it ends
+typedef void (*slac_tracer_t)(const slac_trace_t& trace, void* ctx);
+
 class CSLACify
 {
 
 public:
 
+    // Constructor
+    CSLACify();
+
     // Call this to initialize SLAC based on device type and SLAC settings
     int init(int device_type, signed slac_setting = 'n', int slac_limit = 40, int timeout = 20, int retries = 3);
 
-    // Call this to attempt SLAC and creating a logical network
+    // Call this repeatedly to attempt SLAC and create a logical network. The first call starts SLAC,
+    // which then runs on the reactor.  Returns 1 while SLAC is in progress, 0 once the AVLN is formed,
+    // or -1 if it failed
     int connect();
 
-    // Call this to disconnect an established AVLN
+    // Call this between sessions to start SLAC over on the channel that's already open
+    void reset();
+
+    // Call this to disconnect an established AVLN and close the channel
     void close();
 
+    // Prints and logs how long the AVLN has taken to form after matching
+    void report();
+
+    // Call this to have 'tracer' called with the trace of each SLAC attempt as it ends
+    void set_tracer(slac_tracer_t tracer, void* ctx) {m_tracer = tracer; m_tracer_ctx = ctx;}
+
+    // Sets a profile item, e.g. "NumberOfSounds", overriding whatever the evse.ini or pev.ini
+    // profile says.  Call this before init()
+    void define(const char* item, const char* value);
+
 protected:
+
+    // Start SLAC from the beginning, go back to the beginning, stop, and end it
+    void start();
+    void restart();
+    void stop();
+    void finish(bool formed);
+
+    // Moves to the next phase, and gives it 'ms' before it times out
+    void enter(int phase, uint32_t ms);
+
+    // Reactor callbacks for frames on the PLC channel and for phase timeouts
+    static void on_readable(int fd, uint32_t events, void* ctx);
+    static void on_timer(void* ctx);
+
+    // Arms the sound pacer for an absolute monotonic time in us (0 disarms it), and its reactor callback
+    void pace(uint64_t due_us);
+    static void on_pacer(int fd, uint32_t events, void* ctx);
+
+    // Handle a frame, or a timeout, in the phase we're in
+    void on_frame(ssize_t length);
+    void on_timeout();
+    void evse_frame(unsigned mmtype);
+    void pev_frame(unsigned mmtype);
+
+    // The EVSE runs SLAC with each PEV it hears in a slot of its own
+    struct evse_slot* open_slot();
+    void close_slot(struct evse_slot* slot);
+    void close_slots();
+    bool slots_busy();
+    void slot_enter(struct evse_slot* slot, int phase, uint32_t ms);
+    static void on_slot_timer(void* ctx);
+    void slot_timeout(struct evse_slot* slot);
+    void evse_characterize(struct evse_slot* slot);
+    void evse_match(struct evse_slot* slot);
+    void evse_windows();
+    void pace_windows();
+
+    // Watches our profile for changes, and the reactor callback that hears about them. Both
+    // run on the main thread
+    void watch_profile();
+    static void on_profile(int fd, uint32_t events, void* ctx);
+
+    // Starts the trace of an attempt, and ends it and hands it to the tracer
+    void trace_begin(slac_trace_t* trace, uint64_t* start_us);
+    void trace_end(slac_trace_t* trace, uint64_t* start_us, bool formed, int phase);
+
+    // The steps that more than one phase can take
+    void pev_sound();
+    void report_sounds();
+    void join();
+    void query_network();
+    void joined();
+
     int m_device_type;
     int m_setting;
+
+    // Where SLAC is, and the timer for the phase we're in
+    int m_status;
+    int m_phase;
+    int m_timer;
+
+    // The retries used so far, the sounds the PEV has left to send, and when the
+    // phase we're in runs out of time
+    int      m_retries;
+    unsigned m_sounds_left;
+    uint64_t m_deadline_ms;
+
+    // The timerfd that paces the sounds
+    int      m_pacer_fd;
+
+    // The inotify descriptor that watches our profile, and whether it has changed since
+    // SLAC was last initialized from it
+    int      m_watch_fd;
+    bool     m_profile_stale;
+
+    // When the PEV's first sound was due, and how closely its sounds kept to their schedule:
+    // how many went out, how late, and the shortest and longest gaps between them, all in us
+    uint64_t m_train_us;
+    unsigned m_sounds_sent;
+    uint64_t m_late_max_us, m_late_total_us;
+    uint64_t m_gap_min_us, m_gap_max_us, m_last_sound_us;
+
+    // When we started waiting for the AVLN, how long until we next ask our modem about
+    // it, and how many times we've asked
+    uint64_t m_join_us;
+    uint32_t m_join_poll_ms;
+    unsigned m_join_queries;
+
+    // How many AVLNs have formed, and how long each took after matching, in us
+    unsigned m_joins;
+    uint64_t m_join_min_us, m_join_max_us, m_join_total_us;
+
+    // The trace of the attempt in progress and when it started (0 if none is), the attempts
+    // made since SLAC was started, and who the traces go to
+    slac_trace_t  m_trace;
+    uint64_t      m_trace_us;
+    int           m_attempts;
+    slac_tracer_t m_tracer;
+    void*         m_tracer_ctx;
 };
 
 enum device_type_t
@@ -57,6 +57,11 @@
  *   item1=string
  *   item2=string
  *
+ *   each file is parsed once, on first use, into a table that later
+ *   lookups search in memory; configflush forgets a parsed file so
+ *   the next lookup, or configload, parses it again; configdefine
+ *   sets items that take precedence over those in the file;
+ *
  *--------------------------------------------------------------------*/
 
 #ifndef CONFIG_SOURCE
@@ -67,7 +72,9 @@
  *--------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
@@ -86,6 +93,37 @@
 
 static signed c;
 
+/*====================================================================*
+ *   parsed files;
+ *--------------------------------------------------------------------*/
+
+#define CONFIG_FILES 4
+#define CONFIG_NAME 256
+
+struct _item
+
+{
+	struct _item * next;
+	char * part;
+	char * item;
+	char * text;
+};
+
+static struct _file
+
+{
+	char * name;
+	struct _item * items;
+	struct _item * defines;
+	bool loaded;
+}
+
+files [CONFIG_FILES];
+
+/*lookups can come from more than one thread*/
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /*====================================================================*
  *
  *   bool _compare (FILE * fp, char const *sp);
@@ -199,27 +237,379 @@ static void _discard (FILE * fp)
 }
 
 
+/*====================================================================*
+ *
+ *   void _name (FILE * fp, char buffer [], size_t length, signed stop);
+ *
+ *   collect a part or item name up to the stop character or end of
+ *   line; blanks are dropped and letters are converted to uppercase
+ *   so that names compare the way _compare compares them;
+ *
+ *--------------------------------------------------------------------*/
+
+static void _name (FILE * fp, char buffer [], size_t length, signed stop) 
+
+{
+	while ((c != stop) && nobreak (c)) 
+	{
+		if ((!isblank (c)) && (length > 1)) 
+		{
+			*buffer++ = toupper (c);
+			length--;
+		}
+		c = getc (fp);
+	}
+	*buffer = '\0';
+	return;
+}
+
+
+/*====================================================================*
+ *
+ *   void _key (char buffer [], size_t length, char const * sp);
+ *
+ *   convert a part or item name argument the same way _name does;
+ *
+ *--------------------------------------------------------------------*/
+
+static void _key (char buffer [], size_t length, char const * sp) 
+
+{
+	while ((*sp) && (length > 1)) 
+	{
+		if (!isblank (*sp)) 
+		{
+			*buffer++ = toupper (*sp);
+			length--;
+		}
+		sp++;
+	}
+	*buffer = '\0';
+	return;
+}
+
+
+/*====================================================================*
+ *
+ *   struct _item * _find (struct _item * list, char const * part, char const * item);
+ *
+ *   return the list entry for the named part and item or NULL; the
+ *   names must have been converted by _key or _name;
+ *
+ *--------------------------------------------------------------------*/
+
+static struct _item * _find (struct _item * list, char const * part, char const * item) 
+
+{
+	while (list) 
+	{
+		if ((!strcmp (list->part, part)) && (!strcmp (list->item, item))) 
+		{
+			return (list);
+		}
+		list = list->next;
+	}
+	return ((struct _item *)(0));
+}
+
+
+/*====================================================================*
+ *
+ *   void _append (struct _item ** list, char const * part, char const * item, char const * text);
+ *
+ *   add an entry to the end of a list;
+ *
+ *--------------------------------------------------------------------*/
+
+static void _append (struct _item ** list, char const * part, char const * item, char const * text) 
+
+{
+	struct _item * entry = malloc (sizeof (struct _item));
+	if (!entry) 
+	{
+		return;
+	}
+	entry->next = (struct _item *)(0);
+	entry->part = strdup (part);
+	entry->item = strdup (item);
+	entry->text = strdup (text);
+	while (*list) 
+	{
+		list = &(*list)->next;
+	}
+	*list = entry;
+	return;
+}
+
+
+/*====================================================================*
+ *
+ *   void _release (struct _item ** list);
+ *
+ *   free every entry in a list;
+ *
+ *--------------------------------------------------------------------*/
+
+static void _release (struct _item ** list) 
+
+{
+	while (*list) 
+	{
+		struct _item * entry = *list;
+		*list = entry->next;
+		free (entry->part);
+		free (entry->item);
+		free (entry->text);
+		free (entry);
+	}
+	return;
+}
+
+
+/*====================================================================*
+ *
+ *   struct _file * _file (char const * name);
+ *
+ *   return the table entry for the named file, adding one if needed;
+ *   return NULL if the table is full;
+ *
+ *--------------------------------------------------------------------*/
+
+static struct _file * _file (char const * name) 
+
+{
+	struct _file * file;
+	for (file = files; file < files + CONFIG_FILES; file++) 
+	{
+		if ((file->name) && (!strcmp (file->name, name))) 
+		{
+			return (file);
+		}
+	}
+	for (file = files; file < files + CONFIG_FILES; file++) 
+	{
+		if (!file->name) 
+		{
+			file->name = strdup (name);
+			return (file);
+		}
+	}
+	return ((struct _file *)(0));
+}
+
+
+/*====================================================================*
+ *
+ *   void _load (struct _file * file);
+ *
+ *   parse the file into its table; only the first occurance of each
+ *   part and the first occurance of each item within it are kept, so
+ *   lookups find what a scan of the file would find; a missing file
+ *   leaves an empty table;
+ *
+ *--------------------------------------------------------------------*/
+
+static void _load (struct _file * file) 
+
+{
+	FILE *fp;
+	char part [CONFIG_NAME];
+	char item [CONFIG_NAME];
+	static char buffer [1024];
+	bool active = false;
+	_release (&file->items);
+	file->loaded = true;
+	if (!(fp = fopen (file->name, "rb")))
+	{
+		return;
+	}
+	for (c = getc (fp); c != EOF; _discard (fp)) 
+	{
+		while (isblank (c))
+		{
+			c = getc (fp);
+		}
+		if (c == '[')
+		{
+			c = getc (fp);
+			_name (fp, part, sizeof (part), ']');
+
+			/*an empty item marks the part as seen*/
+
+			active = (c == ']') && (!_find (file->items, part, ""));
+			if (active) 
+			{
+				_append (&file->items, part, "", "");
+			}
+			continue;
+		}
+		if ((!active) || (c == ';'))
+		{
+			continue;
+		}
+		_name (fp, item, sizeof (item), '=');
+		if ((c != '=') || (!*item))
+		{
+			continue;
+		}
+		do
+		{
+			c = getc (fp);
+		}
+		while (isblank (c));
+		_collect (fp, buffer, sizeof (buffer));
+		if (!_find (file->items, part, item)) 
+		{
+			_append (&file->items, part, item, buffer);
+		}
+	}
+	fclose (fp);
+	return;
+}
+
+
+/*====================================================================*
+ *
+ *   void configload (char const * file);
+ *
+ *   parse the named file now, rather than on the first lookup;
+ *
+ *--------------------------------------------------------------------*/
+
+void configload (char const * name) 
+
+{
+	struct _file * file;
+	if (!name)
+	{
+		return;
+	}
+	pthread_mutex_lock (&mutex);
+	if ((file = _file (name)))
+	{
+		_load (file);
+	}
+	pthread_mutex_unlock (&mutex);
+	return;
+}
+
+
+/*====================================================================*
+ *
+ *   void configflush (char const * file);
+ *
+ *   forget the parsed contents of the named file, or of every file
+ *   when the name is NULL, so the next lookup parses it again; items
+ *   set by configdefine are kept;
+ *
+ *--------------------------------------------------------------------*/
+
+void configflush (char const * name) 
+
+{
+	struct _file * file;
+	pthread_mutex_lock (&mutex);
+	for (file = files; file < files + CONFIG_FILES; file++) 
+	{
+		if ((file->name) && ((!name) || (!strcmp (file->name, name)))) 
+		{
+			_release (&file->items);
+			file->loaded = false;
+		}
+	}
+	pthread_mutex_unlock (&mutex);
+	return;
+}
+
+
+/*====================================================================*
+ *
+ *   void configdefine (char const * file, char const * part, char const * item, char const * text);
+ *
+ *   set an item that takes precedence over the same item in the
+ *   named file, whether or not the file has it;
+ *
+ *--------------------------------------------------------------------*/
+
+void configdefine (char const * name, char const * part, char const * item, char const * text) 
+
+{
+	struct _file * file;
+	struct _item * entry;
+	char p [CONFIG_NAME];
+	char i [CONFIG_NAME];
+	if ((!name) || (!part) || (!item) || (!text))
+	{
+		return;
+	}
+	_key (p, sizeof (p), part);
+	_key (i, sizeof (i), item);
+	pthread_mutex_lock (&mutex);
+	if ((file = _file (name)))
+	{
+		if ((entry = _find (file->defines, p, i))) 
+		{
+			free (entry->text);
+			entry->text = strdup (text);
+		}
+		else 
+		{
+			_append (&file->defines, p, i, text);
+		}
+	}
+	pthread_mutex_unlock (&mutex);
+	return;
+}
+
+
 /*====================================================================*
  *
  *   Const char * configstring (char const * file, char const * part, char const * item, char const * text)
  *
- *   open the named file, locate the named part and return the named
+ *   locate the named part of the named file and return the named
  *   item text, if present; return alternative text if the file part
  *   or item is missing; the calling function must preserve returned
  *   text because it may be over-written on successive calls;
  *
+ *   the file is parsed on the first lookup and searched in memory
+ *   after that; should the table of files be full, the file is
+ *   scanned instead;
+ *
  *--------------------------------------------------------------------*/
 
-char const * configstring (char const * file, char const * part, char const * item, char const * string) 
+char const * configstring (char const * name, char const * part, char const * item, char const * string) 
 
 {
 	FILE *fp;
+	struct _file * file;
+	struct _item * entry;
+	char p [CONFIG_NAME];
+	char i [CONFIG_NAME];
 	static char buffer [1024];
-	if ((!file) || (!part) || (!item))
+	if ((!name) || (!part) || (!item))
 	{
 		return (string);
 	}
-	if ((fp = fopen (file, "rb")))
+	_key (p, sizeof (p), part);
+	_key (i, sizeof (i), item);
+	pthread_mutex_lock (&mutex);
+	if ((file = _file (name)))
+	{
+		if (!file->loaded) 
+		{
+			_load (file);
+		}
+		if ((entry = _find (file->defines, p, i)) || (entry = _find (file->items, p, i))) 
+		{
+			strncpy (buffer, entry->text, sizeof (buffer) - 1);
+			buffer [sizeof (buffer) - 1] = '\0';
+			string = buffer;
+		}
+		pthread_mutex_unlock (&mutex);
+		return (string);
+	}
+	pthread_mutex_unlock (&mutex);
+	if ((fp = fopen (name, "rb")))
 	{
 		for (c = getc (fp); c != EOF; _discard (fp)) 
 		{
@@ -278,7 +668,7 @@ char const * configstring (char const * file, char const * part, char const * it
 
 #if 0
 
-	fprintf (stderr, "[%s][%s][%s]='%s'\n", file, part, item, string);
+	fprintf (stderr, "[%s][%s][%s]='%s'\n", name, part, item, string);
 
 #endif
 
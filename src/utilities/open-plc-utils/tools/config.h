@@ -54,6 +54,9 @@
 
 char const * configstring (char const * file, char const * part, char const * item, char const * text);
 unsigned confignumber (char const * file, char const * part, char const * item, unsigned number);
+void configload (char const * file);
+void configflush (char const * file);
+void configdefine (char const * file, char const * part, char const * item, char const * text);
 unsigned confignumber_range (char const * file, char const * part, char const * item, unsigned number, unsigned min, unsigned max);
 
 /*====================================================================*
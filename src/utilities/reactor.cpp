@@ -0,0 +1,439 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// reactor.cpp - A single-threaded event loop built on epoll, with timers on CLOCK_MONOTONIC
+//==========================================================================================================
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "mstimer.h"
+#include "reactor.h"
+
+// The most events we'll dispatch from a single call to epoll_wait()
+#define MAX_EVENTS  16
+
+// -----------------------------------------------------------------------------
+// CReactor() - Constructor
+// -----------------------------------------------------------------------------
+CReactor::CReactor()
+{
+    m_epoll_fd      = -1;
+    m_timer_fd      = -1;
+    m_wake_fd       = -1;
+    m_active_timers = 0;
+    m_current_tick  = 0;
+    m_base_ms       = 0;
+    m_armed_tick    = 0;
+
+    // Every slot on the wheel starts out empty
+    for (int i = 0; i < REACTOR_WHEEL_SIZE; ++i) m_wheel[i] = -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// init() - Creates the epoll instance, the timerfd and the wakeup eventfd
+// -----------------------------------------------------------------------------
+bool CReactor::init()
+{
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    m_wake_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (m_epoll_fd < 0 || m_timer_fd < 0 || m_wake_fd < 0)
+    {
+        close();
+        return false;
+    }
+
+    // Both of our own descriptors are watched like any other, with no callback
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = m_timer_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &ev);
+    ev.data.fd = m_wake_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &ev);
+
+    // Tick 0 is now
+    m_base_ms      = msTimer::millis();
+    m_current_tick = 0;
+    m_armed_tick   = 0;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// close() - Releases our descriptors
+// -----------------------------------------------------------------------------
+void CReactor::close()
+{
+    if (m_epoll_fd >= 0) ::close(m_epoll_fd);
+    if (m_timer_fd >= 0) ::close(m_timer_fd);
+    if (m_wake_fd  >= 0) ::close(m_wake_fd);
+    m_epoll_fd = m_timer_fd = m_wake_fd = -1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// add_fd() - Starts watching a file descriptor
+// -----------------------------------------------------------------------------
+bool CReactor::add_fd(int fd, uint32_t events, reactor_fd_cb_t cb, void* ctx)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+
+    fd_handler_t& handler = m_handlers[fd];
+    handler.cb  = cb;
+    handler.ctx = ctx;
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// modify_fd() - Changes the events we're watching for on a file descriptor
+// -----------------------------------------------------------------------------
+bool CReactor::modify_fd(int fd, uint32_t events)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = events;
+    ev.data.fd = fd;
+    return epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// remove_fd() - Stops watching a file descriptor
+// -----------------------------------------------------------------------------
+void CReactor::remove_fd(int fd)
+{
+    // Older kernels insist on a non-NULL event pointer, even for a delete
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+    m_handlers.erase(fd);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// now_tick() - Returns the number of ticks since init()
+// -----------------------------------------------------------------------------
+uint64_t CReactor::now_tick()
+{
+    return (msTimer::millis() - m_base_ms) / REACTOR_TICK_MS;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// add_timer() - Starts a timer. Returns its ID, or -1 on failure
+// -----------------------------------------------------------------------------
+int CReactor::add_timer(uint32_t ms, reactor_timer_cb_t cb, void* ctx, bool repeat)
+{
+    // Round up to whole ticks, and never fire on the tick we're already in
+    uint32_t ticks = (ms + REACTOR_TICK_MS - 1) / REACTOR_TICK_MS;
+    if (ticks == 0) ticks = 1;
+
+    // Reuse a free entry if there is one, otherwise grow the table
+    int index;
+    if (!m_free.empty())
+    {
+        index = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        // The index has to fit in the low 16 bits of the timer ID
+        if (m_timers.size() >= 0x10000) return -1;
+        index = (int)m_timers.size();
+        timer_entry_t entry;
+        memset(&entry, 0, sizeof(entry));
+        m_timers.push_back(entry);
+    }
+
+    // Fill in the timer and put it on the wheel
+    timer_entry_t& timer = m_timers[index];
+    timer.expiry = now_tick() + ticks;
+    timer.period = repeat ? ticks : 0;
+    timer.cb     = cb;
+    timer.ctx    = ctx;
+    timer.active = true;
+    link_timer(index);
+    ++m_active_timers;
+
+    // Make sure the timerfd will wake us in time for it
+    arm();
+    return make_id(index);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// cancel_timer() - Cancels a timer. Stale and invalid IDs are ignored
+// -----------------------------------------------------------------------------
+void CReactor::cancel_timer(int id)
+{
+    if (id < 0) return;
+
+    // Make sure the ID refers to the timer that's in this entry now
+    int index = id & 0xFFFF;
+    if (index >= (int)m_timers.size()) return;
+    timer_entry_t& timer = m_timers[index];
+    if (!timer.active || (int)(timer.generation & 0x7FFF) != (id >> 16)) return;
+
+    if (timer.linked) unlink_timer(index);
+    free_timer(index);
+
+    // The timerfd will be re-armed the next time around run_once(). Firing early is harmless
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// free_timer() - Retires a timer entry so its ID can never match again
+// -----------------------------------------------------------------------------
+void CReactor::free_timer(int index)
+{
+    m_timers[index].active = false;
+    ++m_timers[index].generation;
+    m_free.push_back(index);
+    --m_active_timers;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// link_timer() - Pushes a timer onto the front of its wheel slot
+// -----------------------------------------------------------------------------
+void CReactor::link_timer(int index)
+{
+    timer_entry_t& timer = m_timers[index];
+    int slot = timer.expiry % REACTOR_WHEEL_SIZE;
+
+    timer.prev = -1;
+    timer.next = m_wheel[slot];
+    if (timer.next != -1) m_timers[timer.next].prev = index;
+    m_wheel[slot] = index;
+    timer.linked = true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// unlink_timer() - Removes a timer from its wheel slot
+// -----------------------------------------------------------------------------
+void CReactor::unlink_timer(int index)
+{
+    timer_entry_t& timer = m_timers[index];
+    int slot = timer.expiry % REACTOR_WHEEL_SIZE;
+
+    if (timer.prev != -1) m_timers[timer.prev].next = timer.next;
+    else m_wheel[slot] = timer.next;
+    if (timer.next != -1) m_timers[timer.next].prev = timer.prev;
+
+    timer.prev = timer.next = -1;
+    timer.linked = false;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// advance() - Fires every timer that's due up to and including 'tick'
+// -----------------------------------------------------------------------------
+void CReactor::advance(uint64_t tick)
+{
+    if (tick <= m_current_tick) return;
+
+    // If we've fallen a whole revolution behind, visiting every slot once is enough
+    uint64_t first = m_current_tick + 1;
+    if (tick - m_current_tick > REACTOR_WHEEL_SIZE) first = tick - REACTOR_WHEEL_SIZE + 1;
+
+    for (uint64_t t = first; t <= tick; ++t)
+    {
+        m_current_tick = t;
+
+        // Take the due timers off the slot first, so that callbacks are free to add and cancel
+        // timers without disturbing the list we're walking. Timers with the same slot but a
+        // later revolution stay where they are
+        std::vector<std::pair<int, uint32_t> > due;
+        int slot = t % REACTOR_WHEEL_SIZE;
+        for (int index = m_wheel[slot]; index != -1; index = m_timers[index].next)
+        {
+            if (m_timers[index].expiry <= tick) due.push_back(std::make_pair(index, m_timers[index].generation));
+        }
+        for (size_t i = 0; i < due.size(); ++i) unlink_timer(due[i].first);
+
+        // Now fire them
+        for (size_t i = 0; i < due.size(); ++i)
+        {
+            int      index      = due[i].first;
+            uint32_t generation = due[i].second;
+
+            // An earlier callback may have cancelled this one
+            if (!m_timers[index].active || m_timers[index].generation != generation) continue;
+
+            // Copy what we need, since the callback may add timers and grow the table
+            reactor_timer_cb_t cb  = m_timers[index].cb;
+            void*              ctx = m_timers[index].ctx;
+            uint32_t        period = m_timers[index].period;
+
+            // A one-shot is finished before its callback runs, so the callback may reuse its entry
+            if (period == 0) free_timer(index);
+
+            cb(ctx);
+
+            // Put a repeating timer back on the wheel unless the callback cancelled it. If we fell
+            // behind, skip the periods we missed rather than firing them all at once
+            if (period && m_timers[index].active && m_timers[index].generation == generation)
+            {
+                m_timers[index].expiry += period;
+                if (m_timers[index].expiry <= tick) m_timers[index].expiry = tick + 1;
+                link_timer(index);
+            }
+        }
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// arm() - Arms the timerfd for the next tick that has a timer due
+// -----------------------------------------------------------------------------
+void CReactor::arm()
+{
+    uint64_t next = 0;
+
+    if (m_active_timers)
+    {
+        // Look for the nearest non-empty slot within one revolution. Everything that was due up
+        // to the current tick has fired, so a timer found this way is due exactly on that tick
+        for (uint64_t t = m_current_tick + 1; t <= m_current_tick + REACTOR_WHEEL_SIZE && !next; ++t)
+        {
+            for (int index = m_wheel[t % REACTOR_WHEEL_SIZE]; index != -1; index = m_timers[index].next)
+            {
+                if (m_timers[index].expiry <= t) {next = t; break;}
+            }
+        }
+
+        // Every timer is more than a revolution away, so find the earliest one
+        if (!next)
+        {
+            for (size_t index = 0; index < m_timers.size(); ++index)
+            {
+                const timer_entry_t& timer = m_timers[index];
+                if (timer.linked && (!next || timer.expiry < next)) next = timer.expiry;
+            }
+        }
+    }
+
+    // Nothing to do if it's already armed for that tick
+    if (next == m_armed_tick) return;
+    m_armed_tick = next;
+
+    // Arm it for the absolute time of that tick, or disarm it if there are no timers
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (next)
+    {
+        uint64_t ms = m_base_ms + next * REACTOR_TICK_MS;
+        its.it_value.tv_sec  = ms / 1000;
+        its.it_value.tv_nsec = (ms % 1000) * 1000000;
+    }
+    timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// wakeup() - Makes run_once() return. This is async-signal-safe
+// -----------------------------------------------------------------------------
+void CReactor::wakeup()
+{
+    uint64_t one = 1;
+    if (m_wake_fd >= 0 && write(m_wake_fd, &one, sizeof(one)) < 0) {}
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// run_once() - Waits for events, then dispatches them and any timers that are due
+// -----------------------------------------------------------------------------
+void CReactor::run_once(int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(m_epoll_fd, events, MAX_EVENTS, timeout_ms);
+
+    // A signal interrupts the wait, which is how we find out about Ctrl+C
+    if (count < 0 && errno != EINTR) return;
+
+    for (int i = 0; i < count; ++i)
+    {
+        int fd = events[i].data.fd;
+
+        // Our own descriptors just need draining
+        if (fd == m_timer_fd || fd == m_wake_fd)
+        {
+            uint64_t value;
+            if (read(fd, &value, sizeof(value)) < 0) {}
+            continue;
+        }
+
+        // An earlier callback may have removed this descriptor
+        std::map<int, fd_handler_t>::iterator it = m_handlers.find(fd);
+        if (it == m_handlers.end()) continue;
+
+        // Copy the handler, since the callback may remove itself
+        fd_handler_t handler = it->second;
+        handler.cb(fd, events[i].events, handler.ctx);
+    }
+
+    // Fire whatever timers have come due, and arm the timerfd for the next one
+    advance(now_tick());
+    arm();
+}
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
@@ -0,0 +1,143 @@
+/*
+ * Copyright © 2025, UChicago Argonne, LLC
+ * All Rights Reserved
+ * Software Name: Remote Test Harness
+ * By: Argonne National Laboratory
+ *
+ * GNU GENERAL PUBLIC LICENSE
+ * Version 3, 29 June 2007
+ * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
+ * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+
+//==========================================================================================================
+// reactor.h - A single-threaded event loop built on epoll, with timers on CLOCK_MONOTONIC
+//
+// File descriptors are registered with a callback that runs when they become ready.  Timers live on a
+// hashed timer wheel with REACTOR_TICK_MS resolution, so starting and cancelling one is O(1) no matter
+// how many are pending.  A single timerfd is armed for the next tick that actually has a timer due, so
+// an idle reactor sleeps in epoll_wait() until there is real work to do.
+//
+// Callbacks run on the thread that calls run_once().  Other threads (and signal handlers) may only
+// call wakeup().
+//==========================================================================================================
+
+#pragma once
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Timer resolution, and the number of slots in the timer wheel (one revolution = 2.56 seconds)
+#define REACTOR_TICK_MS     10
+#define REACTOR_WHEEL_SIZE  256
+
+// Callback signatures
+typedef void (*reactor_fd_cb_t)(int fd, uint32_t events, void* ctx);
+typedef void (*reactor_timer_cb_t)(void* ctx);
+
+// -----------------------------------------------------------------------------
+// CReactor - epoll event loop with a timer wheel
+// -----------------------------------------------------------------------------
+class CReactor
+{
+public:
+
+    // Constructor & destructor
+    CReactor();
+    ~CReactor() {close();}
+
+    // Call this once before using the reactor. Returns false if the kernel objects can't be created
+    bool    init();
+
+    // Call this to release the epoll, timer and wakeup descriptors
+    void    close();
+
+    // Call this to have 'cb' called whenever 'fd' has any of 'events' (EPOLLIN, EPOLLOUT, ...)
+    bool    add_fd(int fd, uint32_t events, reactor_fd_cb_t cb, void* ctx = NULL);
+
+    // Call this to change the events we're waiting for on 'fd'
+    bool    modify_fd(int fd, uint32_t events);
+
+    // Call this to stop watching 'fd'. Do this before closing it
+    void    remove_fd(int fd);
+
+    // Call this to have 'cb' called after 'ms' milliseconds, and every 'ms' thereafter if 'repeat'
+    // is true.  Returns a timer ID for cancel_timer(), or -1 on failure
+    int     add_timer(uint32_t ms, reactor_timer_cb_t cb, void* ctx = NULL, bool repeat = false);
+
+    // Call this to cancel a timer. It's safe to cancel a timer that has already fired
+    void    cancel_timer(int id);
+
+    // Wakes up run_once() from another thread or from a signal handler
+    void    wakeup();
+
+    // Waits up to 'timeout_ms' (-1 = forever) for events, then dispatches them
+    void    run_once(int timeout_ms = -1);
+
+protected:
+
+    // A timer on the wheel. Timers on the same slot form a doubly-linked list of indices
+    struct timer_entry_t
+    {
+        uint64_t            expiry;     // Tick on which the timer fires
+        uint32_t            period;     // Repeat interval in ticks, or 0 for a one-shot
+        reactor_timer_cb_t  cb;
+        void*               ctx;
+        int                 prev, next; // Neighbours on the slot list, or -1
+        uint32_t            generation; // Bumped every time the entry is reused, so stale IDs are harmless
+        bool                active;     // False once the timer has fired (one-shot) or been cancelled
+        bool                linked;     // True while the timer is on the wheel
+    };
+
+    // A registered file descriptor
+    struct fd_handler_t
+    {
+        reactor_fd_cb_t     cb;
+        void*               ctx;
+    };
+
+    // Returns the current tick
+    uint64_t    now_tick();
+
+    // Puts a timer onto / takes a timer off of its wheel slot
+    void    link_timer(int index);
+    void    unlink_timer(int index);
+
+    // Fires every timer that's due up to and including 'tick'
+    void    advance(uint64_t tick);
+
+    // Arms the timerfd for the next tick that has a timer due
+    void    arm();
+
+    // Returns a timer entry to the free list
+    void    free_timer(int index);
+
+    // Timer IDs combine the entry index with the low bits of its generation
+    int     make_id(int index) {return (int)(((m_timers[index].generation & 0x7FFF) << 16) | index);}
+
+    // Our kernel objects
+    int         m_epoll_fd, m_timer_fd, m_wake_fd;
+
+    // Registered file descriptors
+    std::map<int, fd_handler_t> m_handlers;
+
+    // Timer storage, the free list, and the head of each wheel slot's list
+    std::vector<timer_entry_t> m_timers;
+    std::vector<int>     m_free;
+    int         m_wheel[REACTOR_WHEEL_SIZE];
+    int         m_active_timers;
+
+    // The last tick we processed, and the monotonic time (ms) of tick 0
+    uint64_t    m_current_tick, m_base_ms;
+
+    // The tick the timerfd is currently armed for, or 0 if it's disarmed
+    uint64_t    m_armed_tick;
+};
+// -----------------------------------------------------------------------------
+
+//==========================================================================================================
@@ -1,71 +1,635 @@
-/* 
+/*
  * Copyright © 2025, UChicago Argonne, LLC
  * All Rights Reserved
  * Software Name: Remote Test Harness
  * By: Argonne National Laboratory
- * 
+ *
  * GNU GENERAL PUBLIC LICENSE
  * Version 3, 29 June 2007
  * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
  * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
- * 
+ *
  * See the LICENSE file for the full license text.
  */
 
 
-//==============================================================================
-//==============================================================================
+//==========================================================================================================
+// tcpdump.cpp - Captures the PLC interface's V2G, SDP and HomePlug traffic into pcapng files
+//==========================================================================================================
 
+#include <arpa/inet.h>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "logger.h"
 #include "tcpdump.h"
-#include <cstdlib>
-#include <ctime>
+
+// This lives in common.cpp
+extern CLogger logger;
 
 // This will be the file's extension
-std::string file_extension = ".pcap";
+#define CAPTURE_EXTENSION       ".pcapng"
+
+// The most of each frame we keep. The PLC interface's MTU is far below this. The filter
+// keeps whole frames, so we still learn the real length of anything longer
+#define CAPTURE_SNAPLEN         2048
+
+// How often the capture thread checks whether it's been stopped, and how often the writer
+// flushes even if the buffer is nowhere near full
+#define CAPTURE_POLL_MS         250
+#define CAPTURE_FLUSH_MS        1000
+
+// The writer is woken early once this much is waiting
+#define CAPTURE_FLUSH_BYTES     (64 * 1024)
+
+// The ports SDP and V2G use. V2G's TCP port is picked by the SECC, so we take all IPv6 TCP
+#define SDP_UDP_PORT            15118
+
+// The ethertypes of HomePlug AV management messages, and of Qualcomm's vendor-specific ones
+#define ETH_P_HOMEPLUG_AV       0x88E1
+#define ETH_P_HOMEPLUG_VS       0x8912
+
+// pcapng block types, option codes and link types
+#define PCAPNG_SHB              0x0A0D0D0A
+#define PCAPNG_IDB              0x00000001
+#define PCAPNG_EPB              0x00000006
+#define PCAPNG_BYTE_ORDER       0x1A2B3C4D
+#define OPT_ENDOFOPT            0
+#define OPT_COMMENT             1
+#define OPT_SHB_USERAPPL        4
+#define OPT_IF_NAME             2
+#define OPT_EPB_FLAGS           2
+#define EPB_INBOUND             1
+#define EPB_OUTBOUND            2
+#define LINKTYPE_ETHERNET       1
+#define LINKTYPE_USER0          147
+
+// The interfaces in every file: the PLC interface, and the one notes go on
+#define IF_PLC                  0
+#define IF_EVENTS               1
+
+// Rounds a length up to a multiple of 4, as every pcapng field is
+#define PAD4(n)                 (((n) + 3) & ~3u)
+
+
+// -----------------------------------------------------------------------------
+// The kernel filter. It keeps HomePlug frames, IPv6 TCP (V2G), and IPv6 UDP to
+// or from the SDP port, and drops everything else before it ever reaches us.
+// IPv6 extension headers aren't followed; the EV and EVSE don't use them
+// -----------------------------------------------------------------------------
+static struct sock_filter capture_filter[] =
+{
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 12),                          //  0: ethertype
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ETH_P_HOMEPLUG_AV, 10, 0),    //  1: HomePlug AV?
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ETH_P_HOMEPLUG_VS,  9, 0),    //  2: Vendor-specific?
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ETH_P_IPV6,         0, 7),    //  3: IPv6?
+    BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 20),                          //  4: next header
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_TCP,        6, 0),    //  5: TCP?
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP,        0, 4),    //  6: UDP?
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 54),                          //  7: UDP source port
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   SDP_UDP_PORT,       3, 0),    //  8: SDP?
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 56),                          //  9: UDP destination port
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   SDP_UDP_PORT,       1, 0),    // 10: SDP?
+    BPF_STMT(BPF_RET | BPF_K,             0),                           // 11: drop
+    BPF_STMT(BPF_RET | BPF_K,             0xFFFF),                      // 12: keep, all of it
+};
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// These build pcapng blocks at the end of a buffer. A block is begun, given its
+// fields and options, and ended, which fills in its length at both ends
+// -----------------------------------------------------------------------------
+static void put(std::vector<char>& b, const void* data, size_t length)
+{
+    size_t at = b.size();
+    b.resize(at + PAD4(length), 0);
+    memcpy(&b[at], data, length);
+}
+
+static void put16(std::vector<char>& b, uint16_t value) {b.insert(b.end(), (char*)&value, (char*)&value + 2);}
+static void put32(std::vector<char>& b, uint32_t value) {b.insert(b.end(), (char*)&value, (char*)&value + 4);}
 
-//==============================================================================
-// start() - Starts tcpdump with the given network interface and filename.
-//           The function appends the current date and time, as well as .pcap extension
-//==============================================================================
-int TCPDump::start(const std::string& interface, const std::string& filename)
+static void put_option(std::vector<char>& b, uint16_t code, const void* value, size_t length)
 {
-    // Get the current datetime
-    time_t now = time(NULL);
+    put16(b, code);
+    put16(b, length);
+    put(b, value, length);
+}
+
+static size_t begin_block(std::vector<char>& b, uint32_t type)
+{
+    size_t start = b.size();
+    put32(b, type);
+    put32(b, 0);
+    return start;
+}
+
+static void end_block(std::vector<char>& b, size_t start, bool has_options)
+{
+    if (has_options) put32(b, OPT_ENDOFOPT);
+    uint32_t length = b.size() + 4 - start;
+    put32(b, length);
+    memcpy(&b[start + 4], &length, 4);
+}
+
+static void interface_block(std::vector<char>& b, uint16_t linktype, const std::string& name)
+{
+    size_t start = begin_block(b, PCAPNG_IDB);
+    put16(b, linktype);
+    put16(b, 0);
+    put32(b, CAPTURE_SNAPLEN);
+    put_option(b, OPT_IF_NAME, name.c_str(), name.size());
+    end_block(b, start, true);
+}
+
+static void packet_block(std::vector<char>& b, uint32_t interface, uint64_t ts_us, const void* data,
+                         uint32_t caplen, uint32_t origlen, uint32_t flags, const char* comment)
+{
+    size_t start = begin_block(b, PCAPNG_EPB);
+    put32(b, interface);
+    put32(b, ts_us >> 32);
+    put32(b, ts_us & 0xFFFFFFFF);
+    put32(b, caplen);
+    put32(b, origlen);
+    if (caplen) put(b, data, caplen);
+    if (flags) put_option(b, OPT_EPB_FLAGS, &flags, 4);
+    if (comment) put_option(b, OPT_COMMENT, comment, strlen(comment));
+    end_block(b, start, flags || comment);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// now_us() - Returns the wall-clock time in microseconds, the capture's timebase
+// -----------------------------------------------------------------------------
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+// -----------------------------------------------------------------------------
+
 
-    // Format the datetime properly
-    char dt[100];
-    std::strftime(dt, sizeof(dt), "%Y%m%d-%H%M%S", localtime(&now));
-    
-    // Create the filename with datetime and extension
-    std::string full_filename = filename + "_" + dt + file_extension;
 
+// -----------------------------------------------------------------------------
+// write_all() - Writes 'length' bytes to 'fd'. Returns false if it couldn't
+// -----------------------------------------------------------------------------
+static bool write_all(int fd, const char* data, size_t length)
+{
+    while (length)
+    {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data   += n;
+        length -= n;
+    }
+    return true;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// TCPDump() - Constructor
+// -----------------------------------------------------------------------------
+TCPDump::TCPDump()
+{
+    m_fd               = -1;
+    m_is_running       = false;
+    m_is_stopping      = false;
+    m_threads          = 0;
+    m_rotate_bytes     = 0;
+    m_max_disk_bytes   = 0;
+    m_rotate_s         = 0;
+    m_max_buffer_bytes = 0;
+    m_dropped          = 0;
+    m_split            = -1;
+    m_next_session     = 0;
+    m_file_fd          = -1;
+    m_file_bytes       = 0;
+    m_file_header      = 0;
+    m_file_opened      = 0;
+    m_session          = 0;
+    m_part             = 0;
+    m_disk_bytes       = 0;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// start() - Opens a raw socket on the interface, and starts the capture and
+//           writer threads
+// -----------------------------------------------------------------------------
+int TCPDump::start(const std::string& interface, const std::string& filename, uint64_t rotate_bytes,
+                   int rotate_s, uint64_t max_disk_bytes, size_t max_buffer_bytes)
+{
     // Check if both interface and filename are not empty
-    if (!interface.empty() && !filename.empty())
+    if (m_is_running || interface.empty() || filename.empty()) return 0;
+
+    int ifindex = if_nametoindex(interface.c_str());
+    if (ifindex == 0) return 0;
+
+    // The filter goes on before the socket is bound, so nothing unfiltered gets queued
+    struct sock_fprog program = {sizeof(capture_filter) / sizeof(capture_filter[0]), capture_filter};
+    m_fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) return 0;
+
+    int on = 1;
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family   = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex  = ifindex;
+
+    if (setsockopt(m_fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0
+     || setsockopt(m_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0
+     || bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+        return 0;
+    }
+
+    // No file may be bigger than the disk limit allows
+    if (rotate_bytes == 0 || (max_disk_bytes && rotate_bytes > max_disk_bytes))
+        rotate_bytes = max_disk_bytes ? max_disk_bytes : ~(uint64_t)0;
+
+    m_interface        = interface;
+    m_filename         = filename;
+    m_rotate_bytes     = rotate_bytes;
+    m_rotate_s         = rotate_s;
+    m_max_disk_bytes   = max_disk_bytes;
+    m_max_buffer_bytes = max_buffer_bytes;
+    m_is_stopping      = false;
+    m_is_running       = true;
+    m_threads          = 2;
+
+    // Traffic before the first session goes in an idle file
+    open_file(0);
+
+    std::thread capture(launch_capture, this);
+    capture.detach();
+    std::thread writer(launch_writer, this);
+    writer.detach();
+
+    return 1;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// session() - Marks where the next session's file starts, and wakes the writer
+//             so it moves on to that file right away
+// -----------------------------------------------------------------------------
+void TCPDump::session(int id)
+{
+    if (!m_is_running) return;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_split        = m_pending.size();
+    m_next_session = id;
+    m_cv.notify_all();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// note() - Adds an event to the timeline, as a comment on a zero-length frame
+// -----------------------------------------------------------------------------
+void TCPDump::note(const char* format, ...)
+{
+    if (!m_is_running) return;
+
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    append_packet(IF_EVENTS, now_us(), NULL, 0, 0, 0, text);
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// append_packet() - Appends a block to the buffer. If the buffer would grow past
+//                   its limit, the block is taken back off and counted as dropped
+// -----------------------------------------------------------------------------
+void TCPDump::append_packet(uint32_t interface, uint64_t ts_us, const void* data, uint32_t caplen,
+                            uint32_t origlen, uint32_t flags, const char* comment)
+{
+    size_t size = m_pending.size();
+    packet_block(m_pending, interface, ts_us, data, caplen, origlen, flags, comment);
+
+    if (m_pending.size() > m_max_buffer_bytes)
+    {
+        m_pending.resize(size);
+        ++m_dropped;
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// capture_task() - Reads frames from the socket as they arrive, with the time the
+//                  kernel received (or sent) each one
+// -----------------------------------------------------------------------------
+void TCPDump::capture_task()
+{
+    std::vector<char> frame(CAPTURE_SNAPLEN);
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+
+    while (!m_is_stopping)
+    {
+        struct pollfd pfd;
+        pfd.fd     = m_fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, CAPTURE_POLL_MS) <= 0) continue;
+
+        // Take everything that's waiting
+        while (true)
+        {
+            struct sockaddr_ll from;
+            struct iovec       iov = {&frame[0], frame.size()};
+            struct msghdr      msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name       = &from;
+            msg.msg_namelen    = sizeof(from);
+            msg.msg_iov        = &iov;
+            msg.msg_iovlen     = 1;
+            msg.msg_control    = control;
+            msg.msg_controllen = sizeof(control);
+
+            // MSG_TRUNC gives us the frame's real length even if we only keep part of it
+            ssize_t length = recvmsg(m_fd, &msg, MSG_DONTWAIT | MSG_TRUNC);
+            if (length < 0) break;
+
+            uint64_t ts_us = 0;
+            for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+            {
+                if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+                {
+                    struct timespec ts;
+                    memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                    ts_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+                }
+            }
+            if (ts_us == 0) ts_us = now_us();
+
+            uint32_t caplen = ((size_t)length < frame.size()) ? length : frame.size();
+            uint32_t flags  = (from.sll_pkttype == PACKET_OUTGOING) ? EPB_OUTBOUND : EPB_INBOUND;
+
+            m_mtx.lock();
+            append_packet(IF_PLC, ts_us, &frame[0], caplen, length, flags, NULL);
+            bool wake = m_pending.size() >= CAPTURE_FLUSH_BYTES;
+            m_mtx.unlock();
+
+            if (wake) m_cv.notify_all();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    --m_threads;
+    m_cv.notify_all();
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// writer_task() - Moves the buffer to disk once a second, or sooner when it fills
+//                 up or a session starts or ends
+// -----------------------------------------------------------------------------
+void TCPDump::writer_task()
+{
+    std::vector<char> out;
+    uint64_t reported = 0;
+
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (true)
     {
-        // Construct the tcpdump command to run in the background
-        std::string command = "tcpdump -i " + interface + " -w " + full_filename + " &";
+        if (!m_is_stopping && m_split < 0 && m_pending.size() < CAPTURE_FLUSH_BYTES)
+            m_cv.wait_for(lock, std::chrono::milliseconds(CAPTURE_FLUSH_MS));
 
-        // Execute the command to start tcpdump process
-        system(command.c_str());
-        return 1;
+        // Take what's waiting, so the capture thread can carry on while we write it
+        out.swap(m_pending);
+        long     split    = m_split;
+        int      session  = m_next_session;
+        bool     stopping = m_is_stopping;
+        uint64_t dropped  = m_dropped;
+        m_split = -1;
+        lock.unlock();
+
+        const char* begin = out.empty() ? NULL : &out[0];
+        if (split >= 0)
+        {
+            write_blocks(begin, begin + split);
+            open_file(session);
+            write_blocks(begin + split, begin + out.size());
+        }
+        else write_blocks(begin, begin + out.size());
+        out.clear();
+
+        // Say so in the capture, and in the log, if frames didn't fit in the buffer
+        if (dropped != reported)
+        {
+            char text[96];
+            snprintf(text, sizeof(text), "Capture buffer full, %llu frames dropped",
+                     (unsigned long long)(dropped - reported));
+            logger.log(LOG_WARNING, text);
+            packet_block(out, IF_EVENTS, now_us(), NULL, 0, 0, 0, text);
+            write_blocks(&out[0], &out[0] + out.size());
+            out.clear();
+            reported = dropped;
+        }
+
+        // Start a new file if this one is too old and has anything in it
+        if (m_rotate_s > 0 && m_file_bytes > m_file_header && time(NULL) - m_file_opened >= m_rotate_s)
+            open_file(m_session);
+
+        if (stopping) break;
+        lock.lock();
     }
 
-    // Names are empty, tell the caller
-    else return 0;
+    close_file();
+
+    lock.lock();
+    --m_threads;
+    m_cv.notify_all();
 }
-//==============================================================================
+// -----------------------------------------------------------------------------
 
 
 
-//==============================================================================
-// stop() - Stops the tcpdump process
-//==============================================================================
+// -----------------------------------------------------------------------------
+// write_blocks() - Writes whole blocks, moving on to a new file whenever the next
+//                  block would take the current one past its size limit
+// -----------------------------------------------------------------------------
+void TCPDump::write_blocks(const char* begin, const char* end)
+{
+    while (begin < end)
+    {
+        // Find the run of blocks that fits. A file always takes at least one block
+        const char* p    = begin;
+        uint64_t    size = m_file_bytes;
+        while (p < end)
+        {
+            uint32_t length;
+            memcpy(&length, p + 4, sizeof(length));
+            if (size + length > m_rotate_bytes && size > m_file_header) break;
+            size += length;
+            p    += length;
+        }
+
+        // This file is full
+        if (p == begin)
+        {
+            open_file(m_session);
+            continue;
+        }
+
+        if (m_file_fd >= 0 && !write_all(m_file_fd, begin, p - begin))
+        {
+            logger.log(LOG_WARNING, "Can't write capture file, capture stopped until the next file");
+            close_file();
+        }
+        m_file_bytes = size;
+        begin        = p;
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// open_file() - Moves on to the next file, deleting our oldest files if the new
+//               one could take us past the disk limit
+// -----------------------------------------------------------------------------
+void TCPDump::open_file(int session)
+{
+    close_file();
+
+    // Number the parts of each session's capture
+    m_part    = (session == m_session && m_file_opened) ? m_part + 1 : 1;
+    m_session = session;
+
+    while (m_max_disk_bytes && !m_files.empty() && m_disk_bytes + m_rotate_bytes > m_max_disk_bytes)
+    {
+        unlink(m_files.front().first.c_str());
+        m_disk_bytes -= m_files.front().second;
+        m_files.pop_front();
+    }
+
+    // Get the current datetime, formatted properly
+    m_file_opened = time(NULL);
+    char dt[32];
+    strftime(dt, sizeof(dt), "%Y%m%d-%H%M%S", localtime(&m_file_opened));
+
+    char name[32];
+    if (session) snprintf(name, sizeof(name), "session%d", session);
+    else         snprintf(name, sizeof(name), "idle");
+
+    char part[16];
+    snprintf(part, sizeof(part), "%d", m_part);
+
+    std::string filename = m_filename + "_" + name + "_" + dt + "_" + part + CAPTURE_EXTENSION;
+
+    // Every file is a complete capture: the section header, then both interfaces
+    std::vector<char> header;
+    size_t start = begin_block(header, PCAPNG_SHB);
+    put32(header, PCAPNG_BYTE_ORDER);
+    put16(header, 1);
+    put16(header, 0);
+    put32(header, 0xFFFFFFFF);
+    put32(header, 0xFFFFFFFF);
+    put_option(header, OPT_SHB_USERAPPL, "Open-RTH", 8);
+    end_block(header, start, true);
+    interface_block(header, LINKTYPE_ETHERNET, m_interface);
+    interface_block(header, LINKTYPE_USER0, "rth-events");
+
+    m_file_header = header.size();
+    m_file_bytes  = m_file_header;
+    m_file_fd     = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_file_fd < 0)
+    {
+        logger.log(LOG_WARNING, ("Can't create capture file " + filename).c_str());
+        return;
+    }
+
+    m_files.push_back(std::make_pair(filename, (uint64_t)0));
+    if (!write_all(m_file_fd, &header[0], header.size()))
+    {
+        logger.log(LOG_WARNING, ("Can't write capture file " + filename).c_str());
+        close_file();
+    }
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// close_file() - Closes the current file, and counts it against the disk limit
+// -----------------------------------------------------------------------------
+void TCPDump::close_file()
+{
+    if (m_file_fd < 0) return;
+
+    close(m_file_fd);
+    m_file_fd = -1;
+
+    m_files.back().second = m_file_bytes;
+    m_disk_bytes += m_file_bytes;
+}
+// -----------------------------------------------------------------------------
+
+
+
+// -----------------------------------------------------------------------------
+// stop() - Stops both threads, waits for the writer to empty the buffer, and
+//          closes the socket
+// -----------------------------------------------------------------------------
 void TCPDump::stop()
 {
-    // Construct the command to kill all tcpdump processes gracefully
-    std::string command = "pkill -15 tcpdump";
+    if (!m_is_running) return;
+
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_is_stopping = true;
+    m_cv.notify_all();
 
-    // Execute the command to stop tcpdump
-    system(command.c_str());
+    // Don't hang on the way out if a thread is stuck on a slow disk
+    for (int i = 0; i < 20 && m_threads > 0; ++i)
+        m_cv.wait_for(lock, std::chrono::milliseconds(CAPTURE_POLL_MS));
+
+    m_is_running = false;
+    lock.unlock();
+
+    if (m_threads == 0) close(m_fd);
+    m_fd = -1;
 }
-//==============================================================================
+// -----------------------------------------------------------------------------
+
+
+//==========================================================================================================
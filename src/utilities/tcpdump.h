@@ -1,36 +1,135 @@
-/* 
+/*
  * Copyright © 2025, UChicago Argonne, LLC
  * All Rights Reserved
  * Software Name: Remote Test Harness
  * By: Argonne National Laboratory
- * 
+ *
  * GNU GENERAL PUBLIC LICENSE
  * Version 3, 29 June 2007
  * Copyright © 2007 Free Software Foundation, Inc. <https://fsf.org/>
  * Everyone is permitted to copy and distribute verbatim copies of this license document, but changing it is not allowed.
- * 
+ *
  * See the LICENSE file for the full license text.
  */
 
 
-//==============================================================================
-// tcpdump.h - Defines a class for capturing network activity using tcpdump
-//==============================================================================
+//==========================================================================================================
+// tcpdump.h - Captures the PLC interface's V2G, SDP and HomePlug traffic into pcapng files
+//
+// This does what "tcpdump -w" used to do for us, without a second process.  A raw socket on the PLC
+// interface, with a kernel filter that only lets through HomePlug frames, IPv6 TCP and SDP, feeds a
+// capture thread.  The capture thread turns each frame into a pcapng block in a memory buffer, and a
+// writer thread moves the buffer to disk.
+//
+// Every file starts over when a session starts or ends, and whenever it reaches its size or age limit.
+// Files are named from the session they belong to:
+//
+//      <filename>_session<N>_<date>-<time>_<part>.pcapng       Traffic during session N
+//      <filename>_idle_<date>-<time>_<part>.pcapng             Traffic between sessions
+//
+// Memory and disk are both capped.  If the writer falls behind and the buffer fills, frames are dropped
+// (and the drop is noted in the capture).  When the files we've written reach the disk limit, the oldest
+// of them is deleted to make room.
+//
+// Anything else that happens, such as relay and MQTT messages, can be noted on the same timeline.  Notes
+// are zero-length frames on a second interface, "rth-events", with the text in the frame's comment.
+//==========================================================================================================
+
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
 #include <string>
+#include <time.h>
+#include <vector>
 
 class TCPDump
 {
 public:
-    
-    // Destructor ensures that tcpdump is stopped when the object is destroyed
+
+    // Constructor
+    TCPDump();
+
+    // Destructor ensures that the capture is stopped and flushed when the object is destroyed
     ~TCPDump() {stop();}
 
-    // Starts tcpdump with the given network interface and filename
-    int start(const std::string& interface, const std::string& filename);
+    // Starts capturing on the given network interface. Returns 1 on success, 0 on failure
+    //   interface          = The PLC interface
+    //   filename           = The start of each file's name. The rest is filled in as shown above
+    //   rotate_bytes       = A file starts over when it reaches this size
+    //   rotate_s           = A file starts over when it's this old, or 0 for no age limit
+    //   max_disk_bytes     = The most the files we write may add up to, or 0 for no limit
+    //   max_buffer_bytes   = The most captured data we hold in memory while it waits to be written
+    int     start(const std::string& interface, const std::string& filename, uint64_t rotate_bytes,
+                  int rotate_s, uint64_t max_disk_bytes, size_t max_buffer_bytes);
+
+    // Starts a new file for session 'id', or for the time between sessions if 'id' is 0
+    void    session(int id);
+
+    // Notes an event on the capture's timeline. Safe to call from any thread, and cheap when
+    // we're not capturing
+    void    note(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Stops the capture, and writes out whatever is still in memory
+    void    stop();
+
+protected:
+
+    // The capture thread reads frames from the socket into the buffer
+    void    capture_task();
+    static void launch_capture(TCPDump* p) {p->capture_task();}
+
+    // The writer thread moves the buffer to disk
+    void    writer_task();
+    static void launch_writer(TCPDump* p) {p->writer_task();}
+
+    // Appends an enhanced packet block to the buffer, unless that would overflow it.
+    // Call this with m_mtx held
+    void    append_packet(uint32_t interface, uint64_t ts_us, const void* data, uint32_t caplen,
+                          uint32_t origlen, uint32_t flags, const char* comment);
+
+    // Writes the blocks in [begin, end) to the current file, starting a new file whenever
+    // the current one is full
+    void    write_blocks(const char* begin, const char* end);
+
+    // Closes the current file, and opens the next one for 'session'
+    void    open_file(int session);
+    void    close_file();
+
+    // The raw socket, and where we are in the life of the capture
+    int             m_fd;
+    volatile bool   m_is_running, m_is_stopping;
+    int             m_threads;
+
+    // Settings handed to us by start()
+    std::string     m_interface, m_filename;
+    uint64_t        m_rotate_bytes, m_max_disk_bytes;
+    int             m_rotate_s;
+    size_t          m_max_buffer_bytes;
+
+    // Blocks waiting to be written, and how many frames didn't fit. m_split is the offset in
+    // m_pending where session m_next_session starts, or -1
+    std::vector<char> m_pending;
+    uint64_t        m_dropped;
+    long            m_split;
+    int             m_next_session;
+
+    // Protects everything above that both threads use, and wakes the writer
+    std::mutex              m_mtx;
+    std::condition_variable m_cv;
+
+    // The file we're writing: its descriptor, its size and the size of its header, when it was
+    // opened, which session it belongs to and which part of that session it is. Only the writer
+    // thread uses these
+    int             m_file_fd;
+    uint64_t        m_file_bytes, m_file_header;
+    time_t          m_file_opened;
+    int             m_session, m_part;
 
-    // Stops the tcpdump process
-    void stop();
+    // The files we've finished, oldest first, and their total size
+    std::deque<std::pair<std::string, uint64_t> > m_files;
+    uint64_t        m_disk_bytes;
 };
-//==============================================================================
\ No newline at end of file
+//==========================================================================================================
@@ -450,6 +450,19 @@ int CWolfMQTTBase::connect(std::string ip, int port, std::string username, std::
     mqttObj.connect.client_id = client_id.c_str();
     mqttObj.connect.username = username.c_str();
     mqttObj.connect.password = password.c_str();
+
+    // Leave the broker our Last Will, if we have one
+    if (!m_will_topic.empty())
+    {
+        memset(&m_will, 0, sizeof(m_will));
+        m_will.qos        = MQTT_QOS;
+        m_will.topic_name = m_will_topic.c_str();
+        m_will.buffer     = (byte*)m_will_message.c_str();
+        m_will.total_len  = m_will_message.size();
+        m_will.buffer_len = m_will_message.size();
+        mqttObj.connect.enable_lwt = 1;
+        mqttObj.connect.lwt_msg    = &m_will;
+    }
     rc = MqttClient_Connect(&mClient, &mqttObj.connect);
     if (rc != MQTT_CODE_SUCCESS) return rc;
         // goto exit;
@@ -471,6 +484,18 @@ int CWolfMQTTBase::connect(std::string ip, int port, std::string username, std::
 
 
 
+// -----------------------------------------------------------------------------
+// set_will() - Call this before connect() to leave the broker a Last Will message
+// -----------------------------------------------------------------------------
+void CWolfMQTTBase::set_will(std::string topic, std::string message)
+{
+    m_will_topic = topic;
+    m_will_message = message;
+}
+// -----------------------------------------------------------------------------
+
+
+
 // -----------------------------------------------------------------------------
 // subscribe() - Call this to subscribe to an MQTT topic on the broker
 // -----------------------------------------------------------------------------
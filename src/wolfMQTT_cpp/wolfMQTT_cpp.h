@@ -45,6 +45,10 @@ public:
         int _MQTT_MAX_PACKET_SIZE = 1024
     );
 
+    // Call this before connect() to leave the broker a Last Will message, which the broker
+    // publishes on our behalf if our connection drops without a proper disconnect
+    void set_will(std::string topic, std::string message);
+
     // Call this to connect to an MQTT broker
     int connect(std::string ip, int port, std::string username, std::string password, std::string client_id);
 
@@ -83,6 +87,10 @@ protected:
     int PRINT_BUFFER_SIZE;
     int MQTT_MAX_PACKET_SIZE;
 
+    // The Last Will message, if we have one
+    std::string m_will_topic, m_will_message;
+    MqttMessage m_will;
+
     // wolfMQTT variables
     MqttNet m_network;
     MqttObject mqttObj;